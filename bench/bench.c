@@ -0,0 +1,768 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup bench bench
+ * @brief Send path benchmark
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file bench.c
+
+    iotsend Benchmark
+
+    The iotsend-bench utility measures how fast the iotsend send path
+    pushes messages.  It is linked with a mock IOTClient backend instead
+    of the IOTClient library, so it measures the overhead of iotsend
+    itself without a live IOTHub service.
+
+    Records of a configurable size are sent with a configurable number
+    of headers, either as one message each or packed into batches, over
+    one or more connections.  Messages are sent synchronously, or
+    through a send pipeline per connection with a number of messages in
+    flight, exactly as iotsend sends them.
+
+    The message and record rates, the payload throughput, and the
+    latency of each message from its submission until the mock backend
+    has sent it are reported.  Latencies are recorded in an HDR style
+    histogram and reported as percentiles.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include <iotclient/iotclient.h>
+#include "batch.h"
+#include "headers.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "histogram.h"
+#include "mockiot.h"
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of nanoseconds in a second */
+#define NSEC_PER_SEC        ( 1000000000ull )
+
+/*! default number of records to send */
+#define DEFAULT_COUNT       ( 100000 )
+
+/*! default record size */
+#define DEFAULT_SIZE        ( 256 )
+
+/*! default number of message headers */
+#define DEFAULT_HEADERS     ( 4 )
+
+/*! maximum number of connections */
+#define MAX_CONNECTIONS     ( 64 )
+
+/*! long option identifiers */
+#define OPT_COUNT           ( 256 )
+#define OPT_SIZE            ( 257 )
+#define OPT_HEADERS         ( 258 )
+#define OPT_BATCH_BYTES     ( 259 )
+#define OPT_BATCH_COUNT     ( 260 )
+#define OPT_BATCH_FORMAT    ( 261 )
+#define OPT_CONNECTIONS     ( 262 )
+#define OPT_INFLIGHT        ( 263 )
+#define OPT_LATENCY_US      ( 264 )
+
+/*! benchmark state */
+typedef struct _BenchState
+{
+    /*! number of records to send */
+    size_t count;
+
+    /*! size of each record */
+    size_t size;
+
+    /*! number of message headers */
+    size_t headerCount;
+
+    /*! pack records into batches */
+    bool batching;
+
+    /*! batch framing format */
+    BatchFormat batchFormat;
+
+    /*! batch size which triggers a flush */
+    size_t batchBytes;
+
+    /*! number of records in a batch which triggers a flush */
+    size_t batchCount;
+
+    /*! number of connections */
+    size_t connections;
+
+    /*! number of messages in flight per connection (0 = synchronous) */
+    size_t inflight;
+
+    /*! simulated network latency of each send in microseconds */
+    size_t latencyUs;
+
+    /*! compiled message headers */
+    HeaderBlock headerBlock;
+
+    /*! record payload */
+    char *pRecord;
+
+    /*! record batch */
+    Batch batch;
+
+    /*! mock connections */
+    IOTCLIENT_HANDLE hIoTClient[MAX_CONNECTIONS];
+
+    /*! send pipeline of each connection */
+    Pipeline *pPipelines;
+
+    /*! submission time of each message of each connection */
+    uint64_t *pSubmitted[MAX_CONNECTIONS];
+
+    /*! number of messages submitted to each connection */
+    size_t submitted[MAX_CONNECTIONS];
+
+    /*! connection used for the next message */
+    size_t next;
+
+    /*! number of messages sent */
+    size_t messages;
+
+    /*! number of send errors */
+    size_t errors;
+
+    /*! message latency histogram */
+    Histogram latency;
+
+} BenchState;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! benchmark state */
+static BenchState state;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static int ProcessOptions( int argC, char *argV[], BenchState *pState );
+static void usage( char *cmdname );
+static int Setup( BenchState *pState );
+static void Run( BenchState *pState );
+static void Submit( BenchState *pState, char *pData, size_t len );
+static void Flush( BenchState *pState );
+static void Collect( BenchState *pState );
+static void Report( BenchState *pState, uint64_t elapsed );
+static void Teardown( BenchState *pState );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the iotsend-bench utility
+
+    @param[in]
+        argc
+            number of arguments on the command line
+            (including the command itself)
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EOK the benchmark was run
+    @retval other error setting up the benchmark
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    int result = EINVAL;
+    uint64_t start;
+
+    state.count = DEFAULT_COUNT;
+    state.size = DEFAULT_SIZE;
+    state.headerCount = DEFAULT_HEADERS;
+    state.connections = 1;
+    HISTOGRAM_Init( &state.latency );
+
+    if ( ProcessOptions( argc, argv, &state ) != EOK )
+    {
+        fprintf( stderr, "Invalid options\n" );
+    }
+    else if ( ( result = Setup( &state ) ) != EOK )
+    {
+        fprintf( stderr, "Cannot set up benchmark: %s\n", strerror( result ) );
+    }
+    else
+    {
+        start = UTIL_NowNs();
+        Run( &state );
+        Report( &state, UTIL_NowNs() - start );
+    }
+
+    Teardown( &state );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Setup                                                                     */
+/*!
+    Set up the benchmark
+
+    The Setup function compiles the message headers, builds the record
+    payload, and creates the mock connections with their send pipelines
+    and the batch if they are used.
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+    @retval EOK the benchmark is ready to run
+    @retval ENOMEM memory allocation failed
+    @retval other error from HEADERS_Compile, BATCH_Init or PIPELINE_Init
+
+==============================================================================*/
+static int Setup( BenchState *pState )
+{
+    int result = EOK;
+    char spec[HEADERS_MAX_COUNT * 32];
+    size_t len = 0;
+    size_t perConnection;
+    size_t i;
+
+    /* the completion times are matched with the submission times */
+    perConnection = ( pState->count / pState->connections ) + 1;
+    MOCKIOT_Configure( (uint64_t)pState->latencyUs * 1000,
+                       ( pState->inflight > 0 ) ? perConnection : 0 );
+
+    len = snprintf( spec, sizeof( spec ), "source:iotsend-bench" );
+    for ( i = 1; i < pState->headerCount; i++ )
+    {
+        len += snprintf( &spec[len],
+                         sizeof( spec ) - len,
+                         ";header%zu:value%zu",
+                         i,
+                         i );
+    }
+
+    result = HEADERS_Compile( &pState->headerBlock, spec, len );
+
+    if ( result == EOK )
+    {
+        pState->pRecord = POOL_Alloc( pState->size );
+        result = ( pState->pRecord != NULL ) ? EOK : ENOMEM;
+    }
+
+    if ( result == EOK )
+    {
+        memset( pState->pRecord, 'x', pState->size );
+        if ( pState->batching == true )
+        {
+            result = BATCH_Init( &pState->batch,
+                                 pState->batchFormat,
+                                 MAX_IOT_MSG_SIZE,
+                                 pState->batchBytes,
+                                 pState->batchCount,
+                                 0 );
+        }
+    }
+
+    for ( i = 0; ( i < pState->connections ) && ( result == EOK ); i++ )
+    {
+        pState->hIoTClient[i] = IOTCLIENT_Create();
+        result = ( pState->hIoTClient[i] != NULL ) ? EOK : ENOMEM;
+    }
+
+    if ( ( result == EOK ) && ( pState->inflight > 0 ) )
+    {
+        pState->pPipelines = calloc( pState->connections, sizeof( Pipeline ) );
+        result = ( pState->pPipelines != NULL ) ? EOK : ENOMEM;
+
+        for ( i = 0; ( i < pState->connections ) && ( result == EOK ); i++ )
+        {
+            pState->pSubmitted[i] = calloc( perConnection, sizeof( uint64_t ) );
+            result = ( pState->pSubmitted[i] != NULL ) ? EOK : ENOMEM;
+            if ( result == EOK )
+            {
+                result = PIPELINE_Init( &pState->pPipelines[i],
+                                        pState->hIoTClient[i],
+                                        pState->inflight,
+                                        1,
+                                        strlen( HEADERS_Get(
+                                            &pState->headerBlock ) ) + 1,
+                                        MAX_IOT_MSG_SIZE,
+                                        false,
+                                        NULL,
+                                        false );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Run                                                                       */
+/*!
+    Send the records
+
+    The Run function sends every record, either as a message of its own
+    or packed into batches, and waits for the messages in flight to be
+    sent.
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+==============================================================================*/
+static void Run( BenchState *pState )
+{
+    size_t i;
+    int rc;
+
+    for ( i = 0; i < pState->count; i++ )
+    {
+        if ( pState->batching == true )
+        {
+            rc = BATCH_Add( &pState->batch, pState->pRecord, pState->size );
+            if ( rc == ENOSPC )
+            {
+                Flush( pState );
+                rc = BATCH_Add( &pState->batch, pState->pRecord, pState->size );
+            }
+
+            if ( rc != EOK )
+            {
+                pState->errors++;
+            }
+
+            if ( BATCH_IsFull( &pState->batch ) == true )
+            {
+                Flush( pState );
+            }
+        }
+        else
+        {
+            Submit( pState, pState->pRecord, pState->size );
+        }
+    }
+
+    if ( pState->batching == true )
+    {
+        Flush( pState );
+    }
+
+    if ( pState->pPipelines != NULL )
+    {
+        for ( i = 0; i < pState->connections; i++ )
+        {
+            if ( PIPELINE_Drain( &pState->pPipelines[i] ) != EOK )
+            {
+                pState->errors++;
+            }
+        }
+
+        Collect( pState );
+    }
+}
+
+/*============================================================================*/
+/*  Submit                                                                    */
+/*!
+    Send a message
+
+    The Submit function sends a message over the next connection in
+    turn.  A message sent synchronously has its latency recorded
+    directly, while the submission time of a pipelined message is kept
+    so it can be matched with its completion time once it is sent.
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+    @param[in]
+        pData
+            message payload
+
+    @param[in]
+        len
+            length of the message payload
+
+==============================================================================*/
+static void Submit( BenchState *pState, char *pData, size_t len )
+{
+    char *pHeaders = HEADERS_Get( &pState->headerBlock );
+    size_t i = pState->next;
+    uint64_t start;
+    int rc;
+
+    pState->next = ( i + 1 ) % pState->connections;
+    start = UTIL_NowNs();
+
+    if ( pState->pPipelines != NULL )
+    {
+        pState->pSubmitted[i][pState->submitted[i]++] = start;
+        rc = PIPELINE_Submit( &pState->pPipelines[i],
+                              PIPELINE_LANE_NORMAL,
+                              pHeaders,
+                              pData,
+                              len );
+    }
+    else
+    {
+        rc = IOTCLIENT_Send( pState->hIoTClient[i], pHeaders, pData, len );
+        HISTOGRAM_Record( &pState->latency, UTIL_NowNs() - start );
+    }
+
+    if ( rc == EOK )
+    {
+        pState->messages++;
+    }
+    else
+    {
+        pState->errors++;
+    }
+}
+
+/*============================================================================*/
+/*  Flush                                                                     */
+/*!
+    Send the records in the batch as a message
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+==============================================================================*/
+static void Flush( BenchState *pState )
+{
+    char *pData;
+    size_t len;
+
+    pData = BATCH_GetData( &pState->batch, &len );
+    if ( pData != NULL )
+    {
+        Submit( pState, pData, len );
+        BATCH_Clear( &pState->batch );
+    }
+}
+
+/*============================================================================*/
+/*  Collect                                                                   */
+/*!
+    Record the latencies of the pipelined messages
+
+    The Collect function matches the completion time of each message
+    recorded by the mock backend with its submission time.  The messages
+    of each connection are sent in the order they were submitted.
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+==============================================================================*/
+static void Collect( BenchState *pState )
+{
+    const uint64_t *pCompleted;
+    size_t count;
+    size_t i;
+    size_t j;
+
+    for ( i = 0; i < pState->connections; i++ )
+    {
+        pCompleted = MOCKIOT_GetCompletions( pState->hIoTClient[i], &count );
+        if ( count > pState->submitted[i] )
+        {
+            count = pState->submitted[i];
+        }
+
+        for ( j = 0; ( pCompleted != NULL ) && ( j < count ); j++ )
+        {
+            HISTOGRAM_Record( &pState->latency,
+                              pCompleted[j] - pState->pSubmitted[i][j] );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Report                                                                    */
+/*!
+    Report the benchmark results
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+    @param[in]
+        elapsed
+            run time of the benchmark in nanoseconds
+
+==============================================================================*/
+static void Report( BenchState *pState, uint64_t elapsed )
+{
+    Histogram *pLatency = &pState->latency;
+    double seconds = (double)elapsed / NSEC_PER_SEC;
+
+    if ( seconds <= 0.0 )
+    {
+        seconds = 1.0 / NSEC_PER_SEC;
+    }
+
+    printf( "records      %zu x %zu bytes, %zu headers\n",
+            pState->count,
+            pState->size,
+            pState->headerCount );
+    printf( "messages     %zu over %zu connection(s), inflight %zu\n",
+            pState->messages,
+            pState->connections,
+            pState->inflight );
+    printf( "errors       %zu\n", pState->errors );
+    printf( "elapsed      %.3f s\n", seconds );
+    printf( "throughput   %.0f msgs/s, %.0f records/s, %.2f MB/s\n",
+            pState->messages / seconds,
+            pState->count / seconds,
+            ( (double)pState->count * pState->size ) / seconds / 1e6 );
+
+    if ( pLatency->total > 0 )
+    {
+        printf( "latency us   min %.1f  mean %.1f  p50 %.1f  p99 %.1f  "
+                "p999 %.1f  max %.1f\n",
+                pLatency->min / 1e3,
+                ( (double)pLatency->sum / pLatency->total ) / 1e3,
+                HISTOGRAM_Percentile( pLatency, 50.0 ) / 1e3,
+                HISTOGRAM_Percentile( pLatency, 99.0 ) / 1e3,
+                HISTOGRAM_Percentile( pLatency, 99.9 ) / 1e3,
+                pLatency->max / 1e3 );
+    }
+}
+
+/*============================================================================*/
+/*  Teardown                                                                  */
+/*!
+    Release the benchmark resources
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+==============================================================================*/
+static void Teardown( BenchState *pState )
+{
+    size_t i;
+
+    if ( pState->pPipelines != NULL )
+    {
+        for ( i = 0; i < pState->connections; i++ )
+        {
+            PIPELINE_Shutdown( &pState->pPipelines[i] );
+        }
+
+        free( pState->pPipelines );
+        pState->pPipelines = NULL;
+    }
+
+    for ( i = 0; i < pState->connections; i++ )
+    {
+        if ( pState->hIoTClient[i] != NULL )
+        {
+            IOTCLIENT_Close( pState->hIoTClient[i] );
+            pState->hIoTClient[i] = NULL;
+        }
+
+        free( pState->pSubmitted[i] );
+        pState->pSubmitted[i] = NULL;
+    }
+
+    BATCH_Free( &pState->batch );
+    HEADERS_Free( &pState->headerBlock );
+    POOL_Free( pState->pRecord, pState->size );
+    pState->pRecord = NULL;
+    POOL_Shutdown();
+}
+
+/*============================================================================*/
+/*  usage                                                                     */
+/*!
+    Display the application usage
+
+    @param[in]
+        cmdname
+            command line name of this application
+
+==============================================================================*/
+static void usage( char *cmdname )
+{
+    if( cmdname != NULL )
+    {
+        fprintf(stderr,
+                "usage: %s [-h] [options]\n"
+                " [-h] : display this help\n"
+                " [--count N] : number of records to send\n"
+                " [--size N] : size of each record\n"
+                " [--headers N] : number of message headers\n"
+                " [--batch-bytes N] : flush a batch when it reaches N bytes\n"
+                " [--batch-count N] : flush a batch when it has N records\n"
+                " [--batch-format json|lp] : batch framing format\n"
+                " [--connections N] : send over N connections\n"
+                " [--inflight N] : pipeline up to N messages in flight\n"
+                " [--latency-us N] : simulated latency of each send\n",
+                cmdname );
+    }
+}
+
+/*============================================================================*/
+/*  ProcessOptions                                                            */
+/*!
+    Process the command line options
+
+    @param[in]
+        argC
+            number of arguments
+            (including the command itself)
+
+    @param[in]
+        argV
+            array of pointers to the command line arguments
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+    @retval EOK the options are valid
+    @retval EINVAL an option is invalid, or help was requested
+
+==============================================================================*/
+static int ProcessOptions( int argC, char *argV[], BenchState *pState )
+{
+    int result = EOK;
+    int c;
+    const char *options = "h";
+    static const struct option longOptions[] =
+    {
+        { "help",         no_argument,       NULL, 'h' },
+        { "count",        required_argument, NULL, OPT_COUNT },
+        { "size",         required_argument, NULL, OPT_SIZE },
+        { "headers",      required_argument, NULL, OPT_HEADERS },
+        { "batch-bytes",  required_argument, NULL, OPT_BATCH_BYTES },
+        { "batch-count",  required_argument, NULL, OPT_BATCH_COUNT },
+        { "batch-format", required_argument, NULL, OPT_BATCH_FORMAT },
+        { "connections",  required_argument, NULL, OPT_CONNECTIONS },
+        { "inflight",     required_argument, NULL, OPT_INFLIGHT },
+        { "latency-us",   required_argument, NULL, OPT_LATENCY_US },
+        { NULL, 0, NULL, 0 }
+    };
+
+    while ( ( result == EOK ) &&
+            ( ( c = getopt_long( argC,
+                                 argV,
+                                 options,
+                                 longOptions,
+                                 NULL ) ) != -1 ) )
+    {
+        switch ( c )
+        {
+            case OPT_COUNT:
+                result = UTIL_ParseNumber( optarg, &pState->count );
+                break;
+
+            case OPT_SIZE:
+                result = UTIL_ParseNumber( optarg, &pState->size );
+                break;
+
+            case OPT_HEADERS:
+                result = UTIL_ParseNumber( optarg, &pState->headerCount );
+                break;
+
+            case OPT_BATCH_BYTES:
+                result = UTIL_ParseNumber( optarg, &pState->batchBytes );
+                pState->batching = true;
+                break;
+
+            case OPT_BATCH_COUNT:
+                result = UTIL_ParseNumber( optarg, &pState->batchCount );
+                pState->batching = true;
+                break;
+
+            case OPT_BATCH_FORMAT:
+                result = BATCH_ParseFormat( optarg, &pState->batchFormat );
+                pState->batching = true;
+                break;
+
+            case OPT_CONNECTIONS:
+                result = UTIL_ParseNumber( optarg, &pState->connections );
+                break;
+
+            case OPT_INFLIGHT:
+                result = UTIL_ParseNumber( optarg, &pState->inflight );
+                break;
+
+            case OPT_LATENCY_US:
+                result = UTIL_ParseNumber( optarg, &pState->latencyUs );
+                break;
+
+            default:
+                usage( argV[0] );
+                result = EINVAL;
+                break;
+        }
+    }
+
+    if ( ( pState->size == 0 ) ||
+         ( pState->size > MAX_IOT_MSG_SIZE - BATCH_OVERHEAD ) ||
+         ( pState->headerCount == 0 ) ||
+         ( pState->headerCount > HEADERS_MAX_COUNT ) ||
+         ( pState->connections == 0 ) ||
+         ( pState->connections > MAX_CONNECTIONS ) )
+    {
+        result = EINVAL;
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of bench group */
@@ -0,0 +1,234 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup histogram histogram
+ * @brief Latency histogram
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file histogram.c
+
+    Latency Histogram
+
+    The histogram module records latencies in the style of an HDR
+    histogram.  Each power of two range of values is split into 64
+    linear sub-buckets, so any value from a nanosecond to hours is
+    recorded in constant time and reported with a relative error below
+    1/64, using a fixed amount of memory.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdint.h>
+#include <string.h>
+#include "histogram.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static unsigned int Bucket( uint64_t value );
+static uint64_t Highest( unsigned int bucket );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  HISTOGRAM_Init                                                            */
+/*!
+    Initialize an empty histogram
+
+    @param[in]
+        pHistogram
+            pointer to the histogram to initialize
+
+==============================================================================*/
+void HISTOGRAM_Init( Histogram *pHistogram )
+{
+    if ( pHistogram != NULL )
+    {
+        memset( pHistogram, 0, sizeof( Histogram ) );
+        pHistogram->min = UINT64_MAX;
+    }
+}
+
+/*============================================================================*/
+/*  HISTOGRAM_Record                                                          */
+/*!
+    Record a value in a histogram
+
+    @param[in]
+        pHistogram
+            pointer to the histogram
+
+    @param[in]
+        value
+            value to record
+
+==============================================================================*/
+void HISTOGRAM_Record( Histogram *pHistogram, uint64_t value )
+{
+    if ( pHistogram != NULL )
+    {
+        pHistogram->counts[Bucket( value )]++;
+        pHistogram->total++;
+        pHistogram->sum += value;
+
+        if ( value < pHistogram->min )
+        {
+            pHistogram->min = value;
+        }
+
+        if ( value > pHistogram->max )
+        {
+            pHistogram->max = value;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  HISTOGRAM_Percentile                                                      */
+/*!
+    Get the value at a percentile of a histogram
+
+    The HISTOGRAM_Percentile function returns the highest value which
+    is equivalent, within the resolution of the histogram, to the value
+    below which the given percentage of the recorded values fall.
+
+    @param[in]
+        pHistogram
+            pointer to the histogram
+
+    @param[in]
+        percentile
+            percentage of the recorded values, from 0 to 100
+
+    @retval value at the percentile
+    @retval 0 no values have been recorded
+
+==============================================================================*/
+uint64_t HISTOGRAM_Percentile( Histogram *pHistogram, double percentile )
+{
+    uint64_t value = 0;
+    uint64_t target;
+    uint64_t count = 0;
+    unsigned int i;
+
+    if ( ( pHistogram != NULL ) && ( pHistogram->total > 0 ) )
+    {
+        target = (uint64_t)( ( percentile / 100.0 ) * pHistogram->total );
+        if ( target == 0 )
+        {
+            target = 1;
+        }
+
+        for ( i = 0; ( i < HISTOGRAM_BUCKETS ) && ( count < target ); i++ )
+        {
+            count += pHistogram->counts[i];
+            if ( count >= target )
+            {
+                value = Highest( i );
+            }
+        }
+
+        /* the bucket may extend beyond the largest recorded value */
+        if ( value > pHistogram->max )
+        {
+            value = pHistogram->max;
+        }
+    }
+
+    return value;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Bucket                                                                    */
+/*!
+    Get the bucket a value is recorded in
+
+    Values below twice the number of sub-buckets have a bucket each.
+    Larger values are shifted right until they fall in the upper half
+    of that range, and the shift selects the power of two range.
+
+    @param[in]
+        value
+            value to record
+
+    @retval index of the bucket
+
+==============================================================================*/
+static unsigned int Bucket( uint64_t value )
+{
+    unsigned int shift = 0;
+
+    if ( value >= 2 * HISTOGRAM_SUB_BUCKETS )
+    {
+        /* 6 is log2 of the number of sub-buckets */
+        shift = ( 63 - __builtin_clzll( value ) ) - 6;
+    }
+
+    return ( shift * HISTOGRAM_SUB_BUCKETS ) + (unsigned int)( value >> shift );
+}
+
+/*============================================================================*/
+/*  Highest                                                                   */
+/*!
+    Get the highest value recorded in a bucket
+
+    @param[in]
+        bucket
+            index of the bucket
+
+    @retval highest value which is recorded in the bucket
+
+==============================================================================*/
+static uint64_t Highest( unsigned int bucket )
+{
+    unsigned int shift = 0;
+    uint64_t mantissa;
+
+    if ( bucket >= 2 * HISTOGRAM_SUB_BUCKETS )
+    {
+        shift = ( bucket / HISTOGRAM_SUB_BUCKETS ) - 1;
+    }
+
+    mantissa = bucket - ( shift * HISTOGRAM_SUB_BUCKETS );
+
+    return ( ( mantissa + 1 ) << shift ) - 1;
+}
+
+/*! @}
+ * end of histogram group */
@@ -0,0 +1,73 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdint.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! number of linear sub-buckets in each power of two range */
+#define HISTOGRAM_SUB_BUCKETS   ( 64 )
+
+/*! number of buckets needed to cover every 64-bit value */
+#define HISTOGRAM_BUCKETS       ( ( 58 * HISTOGRAM_SUB_BUCKETS ) + \
+                                  HISTOGRAM_SUB_BUCKETS )
+
+/*! log-linear histogram of values with a relative error below 1/64 */
+typedef struct _Histogram
+{
+    /*! number of values recorded in each bucket */
+    uint64_t counts[HISTOGRAM_BUCKETS];
+
+    /*! number of values recorded */
+    uint64_t total;
+
+    /*! smallest value recorded */
+    uint64_t min;
+
+    /*! largest value recorded */
+    uint64_t max;
+
+    /*! sum of the values recorded */
+    uint64_t sum;
+
+} Histogram;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+void HISTOGRAM_Init( Histogram *pHistogram );
+void HISTOGRAM_Record( Histogram *pHistogram, uint64_t value );
+uint64_t HISTOGRAM_Percentile( Histogram *pHistogram, double percentile );
+
+#endif
@@ -0,0 +1,449 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup mockiot mockiot
+ * @brief Mock IOTClient backend
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file mockiot.c
+
+    Mock IOTClient Backend
+
+    The mockiot module implements the IOTClient library functions used
+    by iotsend without a connection to the IOTHub service, so the
+    overhead of iotsend itself can be benchmarked.
+
+    Each send reads every cache line of the headers and payload, as
+    the real library must to transmit them, then sleeps for a simulated
+    network latency.  The completion time of each send is recorded per
+    connection so the benchmark can measure the latency of each message
+    without synchronizing with the sender threads.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <iotclient/iotclient.h>
+#include "mockiot.h"
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of nanoseconds in a second */
+#define NSEC_PER_SEC    ( 1000000000ull )
+
+/*! size of the buffer a streamed input is read into */
+#define MOCKIOT_STREAM_BUF_SIZE ( 65536 )
+
+/*! mock connection */
+typedef struct _MockClient
+{
+    /*! monotonic time in nanoseconds when each send completed */
+    uint64_t *pCompletions;
+
+    /*! number of sends recorded */
+    size_t count;
+
+    /*! number of sends which can be recorded */
+    size_t maxSends;
+
+    /*! checksum of the data sent, so reading it is not optimized away */
+    uint64_t checksum;
+
+} MockClient;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! simulated network latency of each send in nanoseconds */
+static uint64_t latency;
+
+/*! number of sends recorded by each new connection */
+static size_t sends;
+
+/*! function called for every message sent, or NULL */
+static MockIotSendFn pfnSendHook;
+
+/*! argument passed to the send hook */
+static void *pSendHookArg;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void Touch( MockClient *pClient, const char *pData, size_t len );
+static void Complete( MockClient *pClient );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  MOCKIOT_Configure                                                         */
+/*!
+    Configure the mock connections
+
+    The MOCKIOT_Configure function sets the simulated latency of each
+    send, and the number of send completions recorded by each connection
+    created afterwards.
+
+    @param[in]
+        latencyNs
+            simulated network latency of each send in nanoseconds
+
+    @param[in]
+        maxSends
+            number of send completions recorded by each connection
+
+==============================================================================*/
+void MOCKIOT_Configure( uint64_t latencyNs, size_t maxSends )
+{
+    latency = latencyNs;
+    sends = maxSends;
+}
+
+/*============================================================================*/
+/*  MOCKIOT_SetSendHook                                                       */
+/*!
+    Intercept the messages sent over the mock connections
+
+    The MOCKIOT_SetSendHook function installs a function which is called
+    with every message sent with IOTCLIENT_Send, so a test can check the
+    messages and make sends fail.  The hook may be called from several
+    threads at once.
+
+    @param[in]
+        pfnSend
+            function called for every message, or NULL to remove it
+
+    @param[in]
+        pArg
+            argument passed to the function
+
+==============================================================================*/
+void MOCKIOT_SetSendHook( MockIotSendFn pfnSend, void *pArg )
+{
+    pSendHookArg = pArg;
+    __atomic_store_n( &pfnSendHook, pfnSend, __ATOMIC_RELEASE );
+}
+
+/*============================================================================*/
+/*  MOCKIOT_GetCompletions                                                    */
+/*!
+    Get the send completion times of a connection
+
+    The completion times may only be read once the messages submitted
+    to the connection have been sent.
+
+    @param[in]
+        hIoTClient
+            handle to the mock connection
+
+    @param[out]
+        pCount
+            pointer to a location to store the number of completions
+
+    @retval pointer to the monotonic completion time in nanoseconds of
+            each send, in the order they were sent
+    @retval NULL invalid arguments
+
+==============================================================================*/
+const uint64_t *MOCKIOT_GetCompletions( IOTCLIENT_HANDLE hIoTClient,
+                                        size_t *pCount )
+{
+    MockClient *pClient = (MockClient *)hIoTClient;
+    const uint64_t *pCompletions = NULL;
+
+    if ( ( pClient != NULL ) && ( pCount != NULL ) )
+    {
+        pCompletions = pClient->pCompletions;
+        *pCount = pClient->count;
+    }
+
+    return pCompletions;
+}
+
+/*============================================================================*/
+/*  IOTCLIENT_Create                                                          */
+/*!
+    Create a mock connection
+
+    @retval handle to the mock connection
+    @retval NULL memory allocation failed
+
+==============================================================================*/
+IOTCLIENT_HANDLE IOTCLIENT_Create( void )
+{
+    MockClient *pClient;
+
+    pClient = calloc( 1, sizeof( MockClient ) );
+    if ( ( pClient != NULL ) && ( sends > 0 ) )
+    {
+        pClient->pCompletions = calloc( sends, sizeof( uint64_t ) );
+        if ( pClient->pCompletions != NULL )
+        {
+            pClient->maxSends = sends;
+        }
+    }
+
+    return pClient;
+}
+
+/*============================================================================*/
+/*  IOTCLIENT_Close                                                           */
+/*!
+    Close a mock connection
+
+    @param[in]
+        hIoTClient
+            handle to the mock connection
+
+    @retval EOK the connection was closed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int IOTCLIENT_Close( IOTCLIENT_HANDLE hIoTClient )
+{
+    MockClient *pClient = (MockClient *)hIoTClient;
+    int result = EINVAL;
+
+    if ( pClient != NULL )
+    {
+        free( pClient->pCompletions );
+        free( pClient );
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  IOTCLIENT_SetVerbose                                                      */
+/*!
+    Set the verbosity of a mock connection
+
+    @param[in]
+        hIoTClient
+            handle to the mock connection
+
+    @param[in]
+        verbose
+            verbose flag (ignored)
+
+    @retval EOK the verbosity was set
+
+==============================================================================*/
+int IOTCLIENT_SetVerbose( IOTCLIENT_HANDLE hIoTClient, bool verbose )
+{
+    (void)hIoTClient;
+    (void)verbose;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*  IOTCLIENT_Send                                                            */
+/*!
+    Send a message over a mock connection
+
+    @param[in]
+        hIoTClient
+            handle to the mock connection
+
+    @param[in]
+        headers
+            message headers
+
+    @param[in]
+        body
+            message payload
+
+    @param[in]
+        len
+            length of the message payload
+
+    @retval EOK the message was sent
+    @retval EINVAL invalid arguments
+    @retval other error from the send hook
+
+==============================================================================*/
+int IOTCLIENT_Send( IOTCLIENT_HANDLE hIoTClient,
+                    char *headers,
+                    char *body,
+                    size_t len )
+{
+    MockClient *pClient = (MockClient *)hIoTClient;
+    MockIotSendFn pfnSend;
+    int result = EINVAL;
+
+    if ( ( pClient != NULL ) && ( headers != NULL ) )
+    {
+        Touch( pClient, headers, strlen( headers ) );
+        if ( body != NULL )
+        {
+            Touch( pClient, body, len );
+        }
+
+        Complete( pClient );
+        result = EOK;
+
+        pfnSend = __atomic_load_n( &pfnSendHook, __ATOMIC_ACQUIRE );
+        if ( pfnSend != NULL )
+        {
+            result = pfnSend( pSendHookArg, headers, body, len );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  IOTCLIENT_Stream                                                          */
+/*!
+    Stream a message over a mock connection
+
+    @param[in]
+        hIoTClient
+            handle to the mock connection
+
+    @param[in]
+        headers
+            message headers
+
+    @param[in]
+        fd
+            file descriptor to read the message payload from
+
+    @retval EOK the message was sent
+    @retval EINVAL invalid arguments
+    @retval other error from read()
+
+==============================================================================*/
+int IOTCLIENT_Stream( IOTCLIENT_HANDLE hIoTClient, char *headers, int fd )
+{
+    MockClient *pClient = (MockClient *)hIoTClient;
+    int result = EINVAL;
+    char buf[MOCKIOT_STREAM_BUF_SIZE];
+    ssize_t n;
+
+    if ( ( pClient != NULL ) && ( headers != NULL ) )
+    {
+        Touch( pClient, headers, strlen( headers ) );
+
+        while ( ( n = read( fd, buf, sizeof( buf ) ) ) > 0 )
+        {
+            Touch( pClient, buf, n );
+        }
+
+        result = ( n == 0 ) ? EOK : errno;
+        Complete( pClient );
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Touch                                                                     */
+/*!
+    Read data as if it were transmitted
+
+    The Touch function reads a byte from every cache line of the data,
+    which brings it into the cache as copying it to a socket would.
+
+    @param[in]
+        pClient
+            pointer to the mock connection
+
+    @param[in]
+        pData
+            pointer to the data
+
+    @param[in]
+        len
+            length of the data
+
+==============================================================================*/
+static void Touch( MockClient *pClient, const char *pData, size_t len )
+{
+    size_t i;
+
+    for ( i = 0; i < len; i += 64 )
+    {
+        pClient->checksum += (unsigned char)pData[i];
+    }
+}
+
+/*============================================================================*/
+/*  Complete                                                                  */
+/*!
+    Complete the transmission of a message
+
+    The Complete function waits for the simulated network latency and
+    records the completion time of the message.
+
+    @param[in]
+        pClient
+            pointer to the mock connection
+
+==============================================================================*/
+static void Complete( MockClient *pClient )
+{
+    struct timespec ts;
+
+    if ( latency > 0 )
+    {
+        ts.tv_sec = latency / NSEC_PER_SEC;
+        ts.tv_nsec = latency % NSEC_PER_SEC;
+        nanosleep( &ts, NULL );
+    }
+
+    if ( pClient->count < pClient->maxSends )
+    {
+        pClient->pCompletions[pClient->count++] = UTIL_NowNs();
+    }
+}
+
+/*! @}
+ * end of mockiot group */
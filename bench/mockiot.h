@@ -0,0 +1,56 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef MOCKIOT_H
+#define MOCKIOT_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <iotclient/iotclient.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! function called for every message sent over a mock connection.  It
+    returns the result of the send */
+typedef int (*MockIotSendFn)( void *pArg,
+                              const char *pHeaders,
+                              const char *pBody,
+                              size_t len );
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+void MOCKIOT_Configure( uint64_t latencyNs, size_t maxSends );
+void MOCKIOT_SetSendHook( MockIotSendFn pfnSend, void *pArg );
+const uint64_t *MOCKIOT_GetCompletions( IOTCLIENT_HANDLE hIoTClient,
+                                        size_t *pCount );
+
+#endif
@@ -0,0 +1,428 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup startup startup
+ * @brief Startup time benchmark
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file startup.c
+
+    iotsend Startup Benchmark
+
+    The iotsend-startup utility measures the wall time of one-shot
+    iotsend invocations, as made by hook scripts, from the time the
+    process is spawned until it has exited.  This includes loading and
+    dynamically linking the executable and its libraries, setting up,
+    connecting, and sending the message.
+
+    The command is run a number of times with a payload of a given
+    size written to its standard input, or with an empty input, which
+    must exit without connecting.  The run times are recorded in an
+    HDR style histogram and reported as percentiles.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include "histogram.h"
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/* the benchmark runs iotsend rather than linking the IOTClient library */
+#ifndef EOK
+#define EOK 0
+#endif
+
+/*! default number of invocations */
+#define DEFAULT_COUNT       ( 100 )
+
+/*! default command to run */
+#define DEFAULT_COMMAND     "iotsend"
+
+/*! long option identifiers */
+#define OPT_COUNT           ( 256 )
+#define OPT_SIZE            ( 257 )
+
+/*! benchmark state */
+typedef struct _StartupState
+{
+    /*! number of invocations */
+    size_t count;
+
+    /*! size of the payload written to each invocation (0 = empty) */
+    size_t size;
+
+    /*! command and arguments to run */
+    char **argv;
+
+    /*! payload written to the standard input of each invocation */
+    char *pPayload;
+
+    /*! number of invocations which failed */
+    size_t failures;
+
+    /*! invocation time histogram */
+    Histogram elapsed;
+
+} StartupState;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! benchmark state */
+static StartupState state;
+
+/*! command run when none is given */
+static char *defaultArgv[] = { DEFAULT_COMMAND, NULL };
+
+/*! environment passed to the command */
+extern char **environ;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static int ProcessOptions( int argC, char *argV[], StartupState *pState );
+static void usage( char *cmdname );
+static int Invoke( StartupState *pState );
+static void Report( StartupState *pState );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Main entry point for the iotsend-startup utility
+
+    @param[in]
+        argc
+            number of arguments on the command line
+            (including the command itself)
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EOK the benchmark was run
+    @retval other error setting up or running the benchmark
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    int result = EINVAL;
+    size_t i;
+
+    state.count = DEFAULT_COUNT;
+    state.argv = defaultArgv;
+    HISTOGRAM_Init( &state.elapsed );
+
+    /* a command which exits without reading its input is not an error */
+    signal( SIGPIPE, SIG_IGN );
+
+    if ( ProcessOptions( argc, argv, &state ) != EOK )
+    {
+        fprintf( stderr, "Invalid options\n" );
+    }
+    else if ( ( state.size > 0 ) &&
+              ( ( state.pPayload = malloc( state.size ) ) == NULL ) )
+    {
+        result = ENOMEM;
+    }
+    else
+    {
+        if ( state.pPayload != NULL )
+        {
+            memset( state.pPayload, 'x', state.size );
+        }
+
+        result = EOK;
+        for ( i = 0; ( i < state.count ) && ( result == EOK ); i++ )
+        {
+            result = Invoke( &state );
+        }
+
+        if ( result == EOK )
+        {
+            Report( &state );
+        }
+        else
+        {
+            fprintf( stderr,
+                     "Cannot run %s: %s\n",
+                     state.argv[0],
+                     strerror( result ) );
+        }
+    }
+
+    free( state.pPayload );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Invoke                                                                    */
+/*!
+    Run the command once
+
+    The Invoke function spawns the command with a pipe as its standard
+    input and its standard output discarded, writes the payload to the
+    pipe, closes it, and waits for the command to exit.  The time from
+    spawning the command until it has exited is recorded.
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+    @retval EOK the command was run
+    @retval other error spawning the command
+
+==============================================================================*/
+static int Invoke( StartupState *pState )
+{
+    int result;
+    posix_spawn_file_actions_t actions;
+    int fds[2];
+    pid_t pid;
+    int status = 0;
+    uint64_t start;
+    size_t done = 0;
+    ssize_t rc;
+
+    if ( pipe( fds ) != 0 )
+    {
+        result = errno;
+    }
+    else
+    {
+        posix_spawn_file_actions_init( &actions );
+        posix_spawn_file_actions_adddup2( &actions, fds[0], STDIN_FILENO );
+        posix_spawn_file_actions_addclose( &actions, fds[0] );
+        posix_spawn_file_actions_addclose( &actions, fds[1] );
+        posix_spawn_file_actions_addopen( &actions,
+                                          STDOUT_FILENO,
+                                          "/dev/null",
+                                          O_WRONLY,
+                                          0 );
+
+        start = UTIL_NowNs();
+        result = posix_spawnp( &pid,
+                               pState->argv[0],
+                               &actions,
+                               NULL,
+                               pState->argv,
+                               environ );
+        close( fds[0] );
+
+        while ( ( result == EOK ) && ( done < pState->size ) )
+        {
+            rc = write( fds[1], &pState->pPayload[done], pState->size - done );
+            if ( rc > 0 )
+            {
+                done += rc;
+            }
+            else if ( errno != EINTR )
+            {
+                /* the command has stopped reading its input */
+                break;
+            }
+        }
+
+        close( fds[1] );
+
+        if ( ( result == EOK ) && ( waitpid( pid, &status, 0 ) == pid ) )
+        {
+            HISTOGRAM_Record( &pState->elapsed, UTIL_NowNs() - start );
+            if ( ( WIFEXITED( status ) == 0 ) ||
+                 ( WEXITSTATUS( status ) != 0 ) )
+            {
+                pState->failures++;
+            }
+        }
+
+        posix_spawn_file_actions_destroy( &actions );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Report                                                                    */
+/*!
+    Report the benchmark results
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+==============================================================================*/
+static void Report( StartupState *pState )
+{
+    Histogram *pElapsed = &pState->elapsed;
+
+    printf( "command      %s, %zu byte input\n",
+            pState->argv[0],
+            pState->size );
+    printf( "invocations  %" PRIu64 "\n", pElapsed->total );
+    printf( "failures     %zu\n", pState->failures );
+
+    if ( pElapsed->total > 0 )
+    {
+        printf( "startup ms   min %.2f  mean %.2f  p50 %.2f  p99 %.2f  "
+                "max %.2f\n",
+                pElapsed->min / 1e6,
+                ( (double)pElapsed->sum / pElapsed->total ) / 1e6,
+                HISTOGRAM_Percentile( pElapsed, 50.0 ) / 1e6,
+                HISTOGRAM_Percentile( pElapsed, 99.0 ) / 1e6,
+                pElapsed->max / 1e6 );
+    }
+}
+
+/*============================================================================*/
+/*  usage                                                                     */
+/*!
+    Display the application usage
+
+    @param[in]
+        cmdname
+            command line name of this application
+
+==============================================================================*/
+static void usage( char *cmdname )
+{
+    if( cmdname != NULL )
+    {
+        fprintf(stderr,
+                "usage: %s [-h] [options] [-- command [args...]]\n"
+                " [-h] : display this help\n"
+                " [--count N] : number of invocations\n"
+                " [--size N] : size of the input of each invocation"
+                " (0 = empty)\n"
+                " [command] : command to run, " DEFAULT_COMMAND
+                " by default\n",
+                cmdname );
+    }
+}
+
+/*============================================================================*/
+/*  ProcessOptions                                                            */
+/*!
+    Process the command line options
+
+    @param[in]
+        argC
+            number of arguments
+            (including the command itself)
+
+    @param[in]
+        argV
+            array of pointers to the command line arguments
+
+    @param[in]
+        pState
+            pointer to the benchmark state
+
+    @retval EOK the options are valid
+    @retval EINVAL an option is invalid, or help was requested
+
+==============================================================================*/
+static int ProcessOptions( int argC, char *argV[], StartupState *pState )
+{
+    int result = EOK;
+    int c;
+    const char *options = "+h";
+    static const struct option longOptions[] =
+    {
+        { "help",         no_argument,       NULL, 'h' },
+        { "count",        required_argument, NULL, OPT_COUNT },
+        { "size",         required_argument, NULL, OPT_SIZE },
+        { NULL, 0, NULL, 0 }
+    };
+
+    while ( ( result == EOK ) &&
+            ( ( c = getopt_long( argC,
+                                 argV,
+                                 options,
+                                 longOptions,
+                                 NULL ) ) != -1 ) )
+    {
+        switch ( c )
+        {
+            case OPT_COUNT:
+                result = UTIL_ParseNumber( optarg, &pState->count );
+                break;
+
+            case OPT_SIZE:
+                result = UTIL_ParseNumber( optarg, &pState->size );
+                break;
+
+            default:
+                usage( argV[0] );
+                result = EINVAL;
+                break;
+        }
+    }
+
+    if ( optind < argC )
+    {
+        pState->argv = &argV[optind];
+    }
+
+    if ( pState->count == 0 )
+    {
+        result = EINVAL;
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of startup group */
@@ -0,0 +1,105 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! batch framing formats */
+typedef enum _BatchFormat
+{
+    /*! records are elements of a JSON array */
+    BATCH_FORMAT_JSON = 0,
+
+    /*! records are preceded by a 32-bit big-endian length */
+    BATCH_FORMAT_LP
+
+} BatchFormat;
+
+/*! worst case framing overhead of a batch containing a single record */
+#define BATCH_OVERHEAD      ( 4 )
+
+/*! message batch */
+typedef struct _Batch
+{
+    /*! batch framing format */
+    BatchFormat format;
+
+    /*! batch buffer */
+    char *pBuf;
+
+    /*! hard upper bound of the batch buffer size */
+    size_t size;
+
+    /*! number of bytes in the batch which triggers a flush */
+    size_t maxBytes;
+
+    /*! number of records in the batch which triggers a flush
+        (0 = unlimited) */
+    size_t maxCount;
+
+    /*! maximum time in milliseconds a record may wait in the batch */
+    int lingerMs;
+
+    /*! number of bytes in the batch */
+    size_t len;
+
+    /*! number of records in the batch */
+    size_t count;
+
+    /*! time at which the batch must be flushed */
+    struct timespec deadline;
+
+} Batch;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int BATCH_Init( Batch *pBatch,
+                BatchFormat format,
+                size_t size,
+                size_t maxBytes,
+                size_t maxCount,
+                int lingerMs );
+int BATCH_Add( Batch *pBatch, char *pRecord, size_t len );
+bool BATCH_IsFull( Batch *pBatch );
+int BATCH_GetTimeout( Batch *pBatch );
+char *BATCH_GetData( Batch *pBatch, size_t *pLen );
+void BATCH_Clear( Batch *pBatch );
+void BATCH_Free( Batch *pBatch );
+int BATCH_ParseFormat( char *name, BatchFormat *pFormat );
+
+#endif
@@ -0,0 +1,71 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include "chunk.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! progress of a chunked transfer of a regular file */
+typedef struct _Checkpoint
+{
+    /*! transfer identifier shared by all the chunks of the transfer */
+    char transferId[CHUNK_ID_LEN+1];
+
+    /*! index of the first chunk which has not been acknowledged */
+    size_t index;
+
+    /*! byte offset of the first chunk which has not been acknowledged */
+    uint64_t offset;
+
+    /*! maximum number of payload bytes in a chunk */
+    size_t chunkSize;
+
+    /*! size of the input file */
+    uint64_t size;
+
+    /*! modification time of the input file in nanoseconds */
+    uint64_t mtime;
+
+} Checkpoint;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int CHECKPOINT_Load( Checkpoint *pCheckpoint, const char *pPath );
+int CHECKPOINT_Save( const Checkpoint *pCheckpoint, const char *pPath );
+int CHECKPOINT_Remove( const char *pPath );
+
+#endif
@@ -0,0 +1,131 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef CHUNK_H
+#define CHUNK_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! length of a transfer identifier (128 bits as hexadecimal) */
+#define CHUNK_ID_LEN        ( 32 )
+
+/*! space reserved for the chunk sequence headers */
+#define CHUNK_HEADER_SIZE   ( 160 )
+
+/*! function used to read the input of a chunked transfer.  It fills
+    the buffer unless the end of the input is reached */
+typedef int (*ChunkReadFn)( void *pArg, char *pBuf, size_t size, size_t *pLen );
+
+/*! chunked transfer state */
+typedef struct _ChunkTransfer
+{
+    /*! transfer identifier shared by all the chunks of the transfer */
+    char transferId[CHUNK_ID_LEN+1];
+
+    /*! maximum number of payload bytes in a chunk */
+    size_t chunkSize;
+
+    /*! total number of chunks in the transfer, or 0 if unknown */
+    size_t chunkCount;
+
+    /*! index of the next chunk */
+    size_t index;
+
+    /*! byte offset of the next chunk in the input */
+    uint64_t offset;
+
+    /*! chunk buffers: the current chunk and the read-ahead chunk */
+    char *pBuf[2];
+
+    /*! number of bytes in each chunk buffer */
+    size_t len[2];
+
+    /*! index of the buffer holding the current chunk */
+    int current;
+
+    /*! end of the transfer has been reached */
+    bool done;
+
+    /*! memory mapped input, or NULL if the input is read from a file */
+    char *pMap;
+
+    /*! size of the memory mapped input */
+    uint64_t mapSize;
+
+    /*! function used to read the input, or NULL to read the input
+        file descriptor */
+    ChunkReadFn pfnRead;
+
+    /*! argument passed to the input read function */
+    void *pReadArg;
+
+    /*! message headers common to all chunks */
+    char *pBaseHeaders;
+
+    /*! length of the common message headers */
+    size_t baseLen;
+
+    /*! buffer for the headers of the current chunk */
+    char *pHeaders;
+
+    /*! size of the chunk header buffer */
+    size_t headerSize;
+
+} ChunkTransfer;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int CHUNK_Init( ChunkTransfer *pTransfer,
+                char *pHeaders,
+                size_t chunkSize,
+                uint64_t totalSize );
+int CHUNK_SetHeaders( ChunkTransfer *pTransfer, char *pHeaders );
+int CHUNK_Map( ChunkTransfer *pTransfer, char *pData, uint64_t size );
+int CHUNK_SetSource( ChunkTransfer *pTransfer,
+                     ChunkReadFn pfnRead,
+                     void *pArg );
+int CHUNK_Resume( ChunkTransfer *pTransfer,
+                  const char *pTransferId,
+                  size_t index,
+                  uint64_t offset );
+int CHUNK_Next( ChunkTransfer *pTransfer,
+                int fd,
+                char **ppData,
+                size_t *pLen,
+                char **ppHeaders );
+void CHUNK_Free( ChunkTransfer *pTransfer );
+
+#endif
@@ -0,0 +1,139 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! payload compression codecs */
+typedef enum _CompressCodec
+{
+    /*! no compression */
+    COMPRESS_NONE = 0,
+
+    /*! gzip (zlib deflate with a gzip wrapper) */
+    COMPRESS_GZIP,
+
+    /*! zstandard */
+    COMPRESS_ZSTD,
+
+    /*! lz4 frame format */
+    COMPRESS_LZ4
+
+} CompressCodec;
+
+/*! size of the input blocks fed to the compressor */
+#define COMPRESS_BLOCK_SIZE     ( 64 * 1024 )
+
+/*! default maximum size of a trained dictionary */
+#define COMPRESS_DICT_SIZE      ( 110 * 1024 )
+
+/*! payload compressor */
+typedef struct _Compressor
+{
+    /*! compression codec */
+    CompressCodec codec;
+
+    /*! codec specific compression context */
+    void *pContext;
+
+    /*! digested compression dictionary, or NULL if none is used */
+    void *pDictionary;
+
+    /*! identifier of the compression dictionary */
+    uint32_t dictId;
+
+    /*! input block buffer used when reading from a file descriptor */
+    char *pIn;
+
+    /*! compressed output of the current input block */
+    char *pPending;
+
+    /*! size of the pending output buffer */
+    size_t pendingSize;
+
+    /*! number of bytes in the pending output buffer */
+    size_t pendingLen;
+
+    /*! offset of the first unread byte in the pending output buffer */
+    size_t pendingOffset;
+
+    /*! input file descriptor, or -1 if compressing from memory */
+    int fd;
+
+    /*! input memory, if compressing from memory */
+    const char *pMem;
+
+    /*! size of the input memory */
+    uint64_t memLen;
+
+    /*! offset of the next unread byte of the input memory */
+    uint64_t memOffset;
+
+    /*! all of the input has been compressed */
+    bool finished;
+
+    /*! total number of input bytes */
+    uint64_t bytesIn;
+
+    /*! total number of output bytes */
+    uint64_t bytesOut;
+
+} Compressor;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int COMPRESS_Init( Compressor *pCompressor, CompressCodec codec );
+int COMPRESS_LoadDictionary( Compressor *pCompressor, const char *fileName );
+int COMPRESS_StartFd( Compressor *pCompressor, int fd );
+int COMPRESS_StartMem( Compressor *pCompressor,
+                       const char *pData,
+                       uint64_t len );
+int COMPRESS_Read( Compressor *pCompressor,
+                   char *pOut,
+                   size_t size,
+                   size_t *pLen );
+size_t COMPRESS_Bound( Compressor *pCompressor, size_t len );
+void COMPRESS_Free( Compressor *pCompressor );
+int COMPRESS_ParseCodec( const char *name, CompressCodec *pCodec );
+const char *COMPRESS_Encoding( CompressCodec codec );
+int COMPRESS_TrainDictionary( const char *dictName,
+                              char **sampleNames,
+                              size_t count,
+                              size_t dictSize );
+
+#endif
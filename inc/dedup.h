@@ -0,0 +1,90 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! number of streams whose last payload is remembered (power of two) */
+#define DEDUP_TABLE_SIZE    ( 1024 )
+
+/*! last payload sent on a stream */
+typedef struct _DedupEntry
+{
+    /*! hash of the stream key value */
+    uint64_t key;
+
+    /*! hash of the last payload sent on the stream */
+    uint64_t hash;
+
+    /*! length of the last payload sent on the stream */
+    size_t len;
+
+    /*! monotonic time in nanoseconds the last payload was sent */
+    uint64_t sent;
+
+    /*! the entry holds a payload */
+    bool used;
+
+} DedupEntry;
+
+/*! duplicate payload filter */
+typedef struct _Dedup
+{
+    /*! header key whose value identifies the stream, or NULL for one stream */
+    char *key;
+
+    /*! time in nanoseconds after which a duplicate is sent anyway
+        (0 = never) */
+    uint64_t heartbeat;
+
+    /*! last payload of each stream, indexed by the stream key hash */
+    DedupEntry *pEntries;
+
+} Dedup;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int DEDUP_Init( Dedup *pDedup, const char *key, unsigned int heartbeat );
+int DEDUP_Check( Dedup *pDedup,
+                 const char *pHeaders,
+                 const char *pPayload,
+                 size_t len );
+void DEDUP_Forget( Dedup *pDedup, const char *pHeaders );
+void DEDUP_Free( Dedup *pDedup );
+
+#endif
@@ -0,0 +1,62 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef FRAME_H
+#define FRAME_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! first byte of every frame */
+#define FRAME_MAGIC         ( 0xF5 )
+
+/*! version of the frame format */
+#define FRAME_VERSION       ( 1 )
+
+/*! size of the frame header preceding the header block and payload */
+#define FRAME_HEADER_SIZE   ( 8 )
+
+/*! maximum length of the header block of a frame */
+#define FRAME_MAX_HEADERS   ( 1024 )
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int FRAME_Encode( uint8_t *pFrame, size_t headersLen, size_t len );
+int FRAME_Decode( const uint8_t *pFrame, size_t *pHeadersLen, size_t *pLen );
+int FRAME_Write( int fd,
+                 const char *pHeaders,
+                 const void *pPayload,
+                 size_t len );
+
+#endif
@@ -0,0 +1,98 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef HEADERS_H
+#define HEADERS_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum number of headers in a header block */
+#define HEADERS_MAX_COUNT   ( 32 )
+
+/*! location of a header within a header block */
+typedef struct _HeaderEntry
+{
+    /*! offset of the header key in the header block */
+    size_t keyOffset;
+
+    /*! length of the header key */
+    size_t keyLen;
+
+    /*! offset of the header value in the header block */
+    size_t valueOffset;
+
+    /*! length of the header value */
+    size_t valueLen;
+
+} HeaderEntry;
+
+/*! compiled header block */
+typedef struct _HeaderBlock
+{
+    /*! rendered header block: key:value\n ... \n\n */
+    char *pBuf;
+
+    /*! size of the header block buffer */
+    size_t size;
+
+    /*! length of the rendered header block */
+    size_t len;
+
+    /*! number of headers in the block */
+    size_t count;
+
+    /*! location of each header in the block */
+    HeaderEntry entries[HEADERS_MAX_COUNT];
+
+} HeaderBlock;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int HEADERS_Compile( HeaderBlock *pBlock, const char *spec, size_t len );
+char *HEADERS_Get( HeaderBlock *pBlock );
+const char *HEADERS_Find( HeaderBlock *pBlock,
+                          const char *key,
+                          size_t *pLen );
+const char *HEADERS_Lookup( const char *pHeaders,
+                            const char *key,
+                            size_t *pLen );
+int HEADERS_Merge( const char *pHeaders,
+                   const char *spec,
+                   size_t len,
+                   char *pBuf,
+                   size_t size );
+size_t HEADERS_SectionLength( const char *pData, size_t len );
+void HEADERS_Free( HeaderBlock *pBlock );
+
+#endif
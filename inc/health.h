@@ -0,0 +1,125 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <varserver/varserver.h>
+#include "stats.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! default interval in milliseconds between health updates */
+#define HEALTH_DEFAULT_MS   ( 1000 )
+
+/*! health variables published to the variable server */
+typedef enum _HealthVar
+{
+    /*! messages sent per second over the last interval */
+    HEALTH_MSG_RATE,
+
+    /*! payload bytes sent per second over the last interval */
+    HEALTH_BYTE_RATE,
+
+    /*! number of messages sent */
+    HEALTH_SENT,
+
+    /*! number of send attempts which failed */
+    HEALTH_ERRORS,
+
+    /*! number of messages waiting in the spool */
+    HEALTH_SPOOL_DEPTH,
+
+    /*! number of messages queued in the send pipelines */
+    HEALTH_QUEUE_DEPTH,
+
+    /*! description of the most recent error */
+    HEALTH_LAST_ERROR,
+
+    /*! state of the link to the IOTHub service */
+    HEALTH_LINK,
+
+    /*! number of health variables */
+    HEALTH_VARS
+
+} HealthVar;
+
+/*! publisher of health variables */
+typedef struct _Health
+{
+    /*! variable server connection */
+    VARSERVER_HANDLE hVarServer;
+
+    /*! handle of each variable, or VAR_INVALID if it does not exist */
+    VAR_HANDLE vars[HEALTH_VARS];
+
+    /*! last value published for each variable */
+    uint32_t values[HEALTH_VARS];
+
+    /*! a value has been published for each variable */
+    bool published[HEALTH_VARS];
+
+    /*! interval in milliseconds between updates */
+    unsigned int intervalMs;
+
+    /*! statistics at the previous update */
+    StatsSnapshot last;
+
+    /*! monotonic time in milliseconds of the previous update */
+    uint64_t lastTime;
+
+    /*! report errors on stderr */
+    bool verbose;
+
+    /*! event used to stop the publisher thread */
+    int stopFd;
+
+    /*! publisher thread */
+    pthread_t thread;
+
+    /*! publisher thread has been started */
+    bool running;
+
+} Health;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int HEALTH_Start( Health *pHealth,
+                  const char *pPrefix,
+                  unsigned int intervalMs,
+                  bool verbose );
+void HEALTH_Stop( Health *pHealth );
+
+#endif
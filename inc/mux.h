@@ -0,0 +1,177 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef MUX_H
+#define MUX_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include "reader.h"
+#include "headers.h"
+#include "template.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum number of input buffers in use */
+#define MUX_MAX_BUFFERS     ( 32 )
+
+/*! type of an input source */
+typedef enum _MuxSourceType
+{
+    /*! named FIFO of delimited records */
+    MUX_SOURCE_FIFO,
+
+    /*! listening UNIX stream socket */
+    MUX_SOURCE_SOCKET,
+
+    /*! connection accepted on a UNIX stream socket */
+    MUX_SOURCE_CONNECTION,
+
+    /*! spool directory of files of delimited records */
+    MUX_SOURCE_DIR,
+
+    /*! UNIX datagram socket of one message per datagram */
+    MUX_SOURCE_DGRAM
+
+} MuxSourceType;
+
+/*! function called for each record read from a source.  The headers are
+    NULL if the source does not have headers of its own */
+typedef int (*MuxRecordFn)( void *pArg,
+                            char *pHeaders,
+                            char *pRecord,
+                            size_t len );
+
+/*! input source */
+typedef struct _MuxSource
+{
+    /*! source type */
+    MuxSourceType type;
+
+    /*! path of the FIFO, socket, or directory */
+    char *pPath;
+
+    /*! file descriptor (inotify descriptor of a directory) */
+    int fd;
+
+    /*! record reader of a FIFO or connection */
+    RecordReader reader;
+
+    /*! pooled input buffer of the record reader, or NULL */
+    char *pBuf;
+
+    /*! the source has headers of its own */
+    bool hasHeaders;
+
+    /*! headers of the source */
+    HeaderBlock headerBlock;
+
+    /*! header template for headers containing placeholders */
+    HeaderTemplate headerTemplate;
+
+    /*! datagram buffers of a datagram socket, or NULL */
+    char *pDgramBuf;
+
+    /*! buffer for the merged headers of a datagram, or NULL */
+    char *pMerged;
+
+    /*! size of the merged header buffer */
+    size_t mergedSize;
+
+    /*! files already in a directory have not been read yet */
+    bool scan;
+
+    /*! time in milliseconds when the directory is scanned again */
+    uint64_t scanDue;
+
+    /*! listening socket a connection was accepted on, or NULL */
+    struct _MuxSource *pParent;
+
+    /*! next source */
+    struct _MuxSource *pNext;
+
+} MuxSource;
+
+/*! input multiplexer */
+typedef struct _Mux
+{
+    /*! epoll descriptor */
+    int epfd;
+
+    /*! record delimiter */
+    char delimiter;
+
+    /*! size of each input buffer (the maximum record size) */
+    size_t bufferSize;
+
+    /*! compiled default message headers */
+    const char *pHeaders;
+
+    /*! input sources */
+    MuxSource *pSources;
+
+    /*! number of input buffers in use */
+    size_t bufferCount;
+
+    /*! function called for each record */
+    MuxRecordFn pfnRecord;
+
+    /*! argument passed to the record function */
+    void *pArg;
+
+    /*! size of the longest headers of a source */
+    size_t headerSize;
+
+    /*! a source has high priority headers */
+    bool highPriority;
+
+    /*! report source activity on stderr */
+    bool verbose;
+
+} Mux;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int MUX_Init( Mux *pMux,
+              char delimiter,
+              size_t bufferSize,
+              const char *pHeaders,
+              MuxRecordFn pfnRecord,
+              void *pArg,
+              bool verbose );
+int MUX_Add( Mux *pMux, const char *spec );
+int MUX_Wait( Mux *pMux, int timeoutMs, const sigset_t *pMask );
+void MUX_Free( Mux *pMux );
+
+#endif
@@ -0,0 +1,199 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <iotclient/iotclient.h>
+#include "ring.h"
+#include "spool.h"
+#include "retry.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! lane for high priority messages, which are always sent first */
+#define PIPELINE_LANE_HIGH      ( 0 )
+
+/*! lane for normal priority messages */
+#define PIPELINE_LANE_NORMAL    ( 1 )
+
+/*! maximum number of priority lanes */
+#define PIPELINE_MAX_LANES      ( 2 )
+
+/*! message slot in the send pipeline */
+typedef struct _PipelineSlot
+{
+    /*! message headers */
+    char *pHeaders;
+
+    /*! message payload */
+    char *pData;
+
+    /*! length of the message payload */
+    size_t len;
+
+} RING_ALIGNED PipelineSlot;
+
+/*! message set aside by the sender thread to be retried later */
+typedef struct _PipelineRetry
+{
+    /*! message headers */
+    char *pHeaders;
+
+    /*! message payload */
+    char *pData;
+
+    /*! length of the message payload */
+    size_t len;
+
+    /*! number of attempts made to send the message */
+    unsigned int attempts;
+
+    /*! monotonic time in milliseconds when the message is due to be retried */
+    uint64_t due;
+
+    /*! the entry holds a message */
+    bool inUse;
+
+} PipelineRetry;
+
+/*! send pipeline */
+typedef struct _Pipeline
+{
+    /*! IOTClient connection used by the sender thread */
+    IOTCLIENT_HANDLE hIoTClient;
+
+    /*! message slots of every lane */
+    PipelineSlot *pSlots;
+
+    /*! number of message slots of each lane */
+    size_t depth;
+
+    /*! number of priority lanes */
+    size_t laneCount;
+
+    /*! size of the header buffer of each slot */
+    size_t headerSize;
+
+    /*! size of the payload buffer of each slot */
+    size_t dataSize;
+
+    /*! cache line aligned storage for the slot buffers */
+    char *pStorage;
+
+    /*! ring of each lane coordinating the submitter and the sender thread */
+    Ring lanes[PIPELINE_MAX_LANES];
+
+    /*! mutex serializing the submitters of the high priority lane */
+    pthread_mutex_t highMutex;
+
+    /*! sender thread */
+    pthread_t thread;
+
+    /*! sender thread has been started */
+    bool running;
+
+    /*! report send errors */
+    bool verbose;
+
+    /*! number of messages which could not be sent */
+    size_t errors;
+
+    /*! last send error */
+    int lastError;
+
+    /*! number of messages which could not be sent as of the last drain */
+    size_t drainErrors;
+
+    /*! spool for messages which could not be sent, or NULL */
+    Spool *pSpool;
+
+    /*! retry policy for messages which could not be sent */
+    RetryPolicy retry;
+
+    /*! retry delay random number generator state */
+    uint64_t seed;
+
+    /*! messages are retried in place so they are sent in order */
+    bool ordered;
+
+    /*! messages waiting to be retried */
+    PipelineRetry *pRetries;
+
+    /*! storage for the buffers of the messages waiting to be retried */
+    char *pRetryStorage;
+
+    /*! mutex protecting the number of messages waiting to be retried */
+    pthread_mutex_t retryMutex;
+
+    /*! condition signalled when no messages are waiting to be retried */
+    pthread_cond_t retryCond;
+
+    /*! condition signalled when the deadline is set, to end a retry delay */
+    pthread_cond_t wakeCond;
+
+    /*! number of messages waiting to be retried */
+    size_t retrying;
+
+    /*! monotonic time in milliseconds after which queued messages are
+        spooled or given up on rather than sent (0 = none) */
+    uint64_t deadline;
+
+} Pipeline;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int PIPELINE_Init( Pipeline *pPipeline,
+                   IOTCLIENT_HANDLE hIoTClient,
+                   size_t depth,
+                   size_t lanes,
+                   size_t headerSize,
+                   size_t dataSize,
+                   bool verbose,
+                   const RetryPolicy *pRetry,
+                   bool ordered );
+int PIPELINE_Submit( Pipeline *pPipeline,
+                     size_t lane,
+                     char *pHeaders,
+                     char *pData,
+                     size_t len );
+void PIPELINE_SetSpool( Pipeline *pPipeline, Spool *pSpool );
+void PIPELINE_SetDeadline( Pipeline *pPipeline, uint64_t deadline );
+size_t PIPELINE_Pending( Pipeline *pPipeline );
+int PIPELINE_Drain( Pipeline *pPipeline );
+int PIPELINE_Shutdown( Pipeline *pPipeline );
+
+#endif
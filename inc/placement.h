@@ -0,0 +1,80 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdbool.h>
+#include <sched.h>
+#include <pthread.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum number of NUMA nodes which can be selected */
+#define PLACEMENT_MAX_NODES ( 1024 )
+
+/*! placement of the threads and buffers of iotsend */
+typedef struct _Placement
+{
+    /*! CPUs the reader and background threads may run on */
+    cpu_set_t readerCpus;
+
+    /*! the reader and background threads are pinned to readerCpus */
+    bool readerPinned;
+
+    /*! CPUs the sender threads may run on */
+    cpu_set_t senderCpus;
+
+    /*! the sender threads are pinned to senderCpus */
+    bool senderPinned;
+
+    /*! SCHED_FIFO priority of the sender threads (0 = SCHED_OTHER) */
+    int senderPriority;
+
+    /*! nice level of the process */
+    int nice;
+
+    /*! the nice level of the process is set */
+    bool niced;
+
+    /*! NUMA node buffers are allocated on (-1 = default policy) */
+    int numaNode;
+
+} Placement;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int PLACEMENT_ParseCpus( cpu_set_t *pCpus, const char *list );
+int PLACEMENT_Start( Placement *pPlacement );
+int PLACEMENT_Sender( Placement *pPlacement, pthread_t thread );
+
+#endif
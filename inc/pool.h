@@ -0,0 +1,58 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef POOL_H
+#define POOL_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <iotclient/iotclient.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! size of each buffer of the header slabs */
+#define POOL_HEADER_SIZE    ( 4096 )
+
+/*! size of each message buffer */
+#define POOL_MESSAGE_SIZE   ( MAX_IOT_MSG_SIZE )
+
+/*! alignment of every buffer */
+#define POOL_ALIGN          ( 64 )
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int POOL_Init( size_t cap );
+void *POOL_Alloc( size_t size );
+void POOL_Free( void *p, size_t size );
+size_t POOL_Used( void );
+void POOL_Shutdown( void );
+
+#endif
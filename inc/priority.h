@@ -0,0 +1,103 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef PRIORITY_H
+#define PRIORITY_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "headers.h"
+#include "template.h"
+#include "pipeline.h"
+#include "ratelimit.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! header added to urgent messages */
+#define PRIORITY_HEADER     "priority:high"
+
+/*! reader of urgent messages from a priority FIFO */
+typedef struct _PriorityReader
+{
+    /*! name of the priority FIFO */
+    char *pFifoName;
+
+    /*! record delimiter */
+    char delimiter;
+
+    /*! send pipelines the urgent messages are queued in */
+    Pipeline *pPipelines;
+
+    /*! number of send pipelines */
+    size_t count;
+
+    /*! pipeline selected for the previous urgent message */
+    size_t next;
+
+    /*! headers of the urgent messages */
+    HeaderBlock headerBlock;
+
+    /*! header template for headers containing placeholders */
+    HeaderTemplate headerTemplate;
+
+    /*! rate limiter, or NULL */
+    RateLimit *pRateLimit;
+
+    /*! report errors on stderr */
+    bool verbose;
+
+    /*! reader thread */
+    pthread_t thread;
+
+    /*! reader thread has been started */
+    bool running;
+
+    /*! the reader thread has been asked to stop */
+    int stopping;
+
+} PriorityReader;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int PRIORITY_Start( PriorityReader *pReader,
+                    const char *fifoName,
+                    char delimiter,
+                    const char *pHeaders,
+                    Pipeline *pPipelines,
+                    size_t count,
+                    RateLimit *pRateLimit,
+                    bool verbose );
+void PRIORITY_Stop( PriorityReader *pReader );
+bool PRIORITY_IsHigh( const char *pHeaders );
+
+#endif
@@ -0,0 +1,96 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <pthread.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! token bucket */
+typedef struct _TokenBucket
+{
+    /*! tokens added per second (0 = unlimited) */
+    uint64_t rate;
+
+    /*! time in nanoseconds to refill the bucket when it is empty */
+    uint64_t depth;
+
+    /*! monotonic time in nanoseconds when the bucket will be full again */
+    uint64_t full;
+
+} TokenBucket;
+
+/*! message and byte rate limiter */
+typedef struct _RateLimit
+{
+    /*! message rate bucket */
+    TokenBucket messages;
+
+    /*! byte rate bucket */
+    TokenBucket bytes;
+
+    /*! mutex protecting the buckets and the deadline */
+    pthread_mutex_t mutex;
+
+    /*! condition signalled when the deadline is set */
+    pthread_cond_t cond;
+
+    /*! monotonic time in milliseconds after which senders no longer wait
+        for their tokens (0 = none) */
+    uint64_t deadline;
+
+    /*! at least one of the rates is limited */
+    bool enabled;
+
+} RateLimit;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int RATELIMIT_Init( RateLimit *pRateLimit,
+                    uint64_t msgRate,
+                    uint64_t byteRate,
+                    uint64_t burst );
+int RATELIMIT_Acquire( RateLimit *pRateLimit, size_t len );
+uint64_t RATELIMIT_Reserve( RateLimit *pRateLimit, size_t len );
+int RATELIMIT_Wait( RateLimit *pRateLimit,
+                    uint64_t due,
+                    const sigset_t *pMask );
+void RATELIMIT_SetDeadline( RateLimit *pRateLimit, uint64_t deadline );
+void RATELIMIT_Free( RateLimit *pRateLimit );
+
+#endif
@@ -0,0 +1,103 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef READER_H
+#define READER_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <signal.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! record reader state */
+typedef struct _RecordReader
+{
+    /*! input file descriptor */
+    int fd;
+
+    /*! record delimiter character */
+    char delimiter;
+
+    /*! input buffer */
+    char *pBuf;
+
+    /*! size of the input buffer */
+    size_t size;
+
+    /*! offset of the first unconsumed byte in the input buffer */
+    size_t start;
+
+    /*! offset of the end of the valid data in the input buffer */
+    size_t end;
+
+    /*! end of file has been reached on the input file descriptor */
+    bool eof;
+
+    /*! maximum time in milliseconds to wait for input (-1 = forever) */
+    int timeout;
+
+    /*! a wait interrupted by a signal returns ETIMEDOUT */
+    bool interruptible;
+
+    /*! signal mask of the calling thread while it waits for input */
+    sigset_t sigmask;
+
+    /*! the input buffer was allocated by the reader */
+    bool ownsBuffer;
+
+    /*! number of bytes of an oversized frame still to be discarded */
+    size_t discard;
+
+} RecordReader;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int READER_Init( RecordReader *pReader, int fd, char delimiter, size_t size );
+int READER_InitBuffer( RecordReader *pReader,
+                       int fd,
+                       char delimiter,
+                       char *pBuf,
+                       size_t size );
+int READER_Reset( RecordReader *pReader, int fd );
+int READER_SetTimeout( RecordReader *pReader, int timeout );
+int READER_SetInterruptible( RecordReader *pReader, const sigset_t *pMask );
+int READER_Stop( RecordReader *pReader );
+int READER_Next( RecordReader *pReader, char **ppRecord, size_t *pLen );
+int READER_NextFrame( RecordReader *pReader,
+                      char **ppHeaders,
+                      size_t *pHeadersLen,
+                      char **ppRecord,
+                      size_t *pLen );
+void READER_Free( RecordReader *pReader );
+
+#endif
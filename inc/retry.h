@@ -0,0 +1,76 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef RETRY_H
+#define RETRY_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! default maximum number of attempts to send a message */
+#define RETRY_DEFAULT_ATTEMPTS  ( 4 )
+
+/*! default base retry delay in milliseconds */
+#define RETRY_DEFAULT_BASE_MS   ( 100 )
+
+/*! default maximum retry delay in milliseconds */
+#define RETRY_DEFAULT_CAP_MS    ( 5000 )
+
+/*! retry policy */
+typedef struct _RetryPolicy
+{
+    /*! maximum number of attempts, including the first (0 = unlimited) */
+    unsigned int maxAttempts;
+
+    /*! delay before the first retry in milliseconds */
+    unsigned int baseMs;
+
+    /*! maximum delay between retries in milliseconds */
+    unsigned int capMs;
+
+} RetryPolicy;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+void RETRY_Init( RetryPolicy *pPolicy );
+bool RETRY_IsRetryable( int err );
+bool RETRY_ShouldRetry( const RetryPolicy *pPolicy,
+                        int err,
+                        unsigned int attempts );
+unsigned int RETRY_Delay( const RetryPolicy *pPolicy,
+                          unsigned int attempts,
+                          uint64_t *pSeed );
+uint64_t RETRY_Seed( void );
+
+#endif
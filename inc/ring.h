@@ -0,0 +1,102 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef RING_H
+#define RING_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! size of a CPU cache line */
+#define RING_CACHE_LINE     ( 64 )
+
+/*! align a structure member to a cache line to avoid false sharing */
+#define RING_ALIGNED        __attribute__(( aligned( RING_CACHE_LINE ) ))
+
+/*! single producer / single consumer lock-free ring */
+typedef struct _Ring
+{
+    /*! number of slots in the ring */
+    size_t depth;
+
+    /*! event used to wake up the consumer when the ring becomes non-empty */
+    int notEmptyEvent;
+
+    /*! the consumer event is owned by another ring */
+    bool sharedEvent;
+
+    /*! event used to wake up the producer when a slot is released */
+    int notFullEvent;
+
+    /*! number of times the consumer polls an empty ring before sleeping */
+    int spinCount;
+
+    /*! number of slots published by the producer (written by producer) */
+    uint64_t head RING_ALIGNED;
+
+    /*! producer is waiting for a slot to be released */
+    int producerWaiting;
+
+    /*! number of slots released by the consumer (written by consumer) */
+    uint64_t tail RING_ALIGNED;
+
+    /*! consumer is waiting for a slot to be published */
+    int consumerWaiting;
+
+    /*! the producer has stopped publishing slots */
+    int stopped RING_ALIGNED;
+
+} Ring;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int RING_Init( Ring *pRing, size_t depth );
+size_t RING_Acquire( Ring *pRing );
+void RING_Publish( Ring *pRing );
+int RING_Peek( Ring *pRing, size_t *pIndex );
+int RING_PeekTimeout( Ring *pRing, size_t *pIndex, int timeoutMs );
+int RING_ShareEvent( Ring *pRing, Ring *pOwner );
+int RING_PeekFirst( Ring *pRings,
+                    size_t count,
+                    size_t *pRing,
+                    size_t *pIndex,
+                    int timeoutMs );
+void RING_Release( Ring *pRing );
+void RING_WaitEmpty( Ring *pRing );
+void RING_Stop( Ring *pRing );
+size_t RING_Count( Ring *pRing );
+void RING_Free( Ring *pRing );
+
+#endif
@@ -0,0 +1,161 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <iotclient/iotclient.h>
+#include "ratelimit.h"
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum size of a spool segment file */
+#ifndef SPOOL_SEGMENT_SIZE
+#define SPOOL_SEGMENT_SIZE  ( 16 * 1024 * 1024 )
+#endif
+
+/*! spool fsync policies */
+typedef enum _SpoolFsync
+{
+    /*! sync the spool at most once per second */
+    SPOOL_FSYNC_INTERVAL = 0,
+
+    /*! sync the spool after every message */
+    SPOOL_FSYNC_ALWAYS,
+
+    /*! leave syncing the spool to the operating system */
+    SPOOL_FSYNC_NEVER
+
+} SpoolFsync;
+
+/*! on-disk store-and-forward spool */
+typedef struct _Spool
+{
+    /*! spool directory */
+    char *pDir;
+
+    /*! fsync policy */
+    SpoolFsync fsyncPolicy;
+
+    /*! report spool activity on stderr */
+    bool verbose;
+
+    /*! mutex protecting the spool state */
+    pthread_mutex_t mutex;
+
+    /*! condition signalled when messages are spooled or the spool stops */
+    pthread_cond_t cond;
+
+    /*! drainer thread */
+    pthread_t thread;
+
+    /*! drainer thread has been started */
+    bool running;
+
+    /*! the spool is being closed */
+    bool stopping;
+
+    /*! file descriptor of the segment being written */
+    int segFd;
+
+    /*! file descriptor of the index of the segment being written */
+    int idxFd;
+
+    /*! file descriptor of the replay cursor file */
+    int cursorFd;
+
+    /*! number of the segment being written */
+    uint32_t writeSegment;
+
+    /*! number of messages in the segment being written */
+    uint32_t writeCount;
+
+    /*! size of the segment being written */
+    uint64_t writeSize;
+
+    /*! time of the last sync in milliseconds */
+    uint64_t lastSync;
+
+    /*! number of the segment being replayed */
+    uint32_t readSegment;
+
+    /*! index of the next message to replay in the segment */
+    uint32_t readRecord;
+
+    /*! offset of the next message to replay in the segment */
+    uint64_t readOffset;
+
+    /*! number of messages waiting to be replayed */
+    uint64_t pending;
+
+    /*! rate limiter for replayed messages, or NULL */
+    RateLimit *pRateLimit;
+
+    /*! IOTClient connection used by the drainer thread */
+    IOTCLIENT_HANDLE hIoTClient;
+
+    /*! memory mapped segment being replayed */
+    char *pMap;
+
+    /*! size of the memory mapped segment */
+    size_t mapSize;
+
+    /*! number of the memory mapped segment */
+    uint32_t mapSegment;
+
+    /*! monotonic time in milliseconds after which replay stops and the
+        remaining messages are kept for the next run (0 = none) */
+    uint64_t deadline;
+
+} Spool;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int SPOOL_Open( Spool *pSpool,
+                const char *dir,
+                SpoolFsync fsyncPolicy,
+                RateLimit *pRateLimit,
+                bool verbose );
+int SPOOL_Append( Spool *pSpool,
+                  const char *pHeaders,
+                  const char *pData,
+                  size_t len );
+uint64_t SPOOL_Pending( Spool *pSpool );
+void SPOOL_SetDeadline( Spool *pSpool, uint64_t deadline );
+void SPOOL_Close( Spool *pSpool );
+int SPOOL_ParseFsync( const char *name, SpoolFsync *pPolicy );
+
+#endif
@@ -0,0 +1,131 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef STATS_H
+#define STATS_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! counters recorded on the hot path */
+typedef enum _StatsCounter
+{
+    /*! number of input bytes read */
+    STATS_BYTES_READ,
+
+    /*! number of messages sent to the IOTHub service */
+    STATS_MESSAGES_SENT,
+
+    /*! number of payload bytes sent to the IOTHub service */
+    STATS_BYTES_SENT,
+
+    /*! number of send attempts which failed */
+    STATS_SEND_ERRORS,
+
+    /*! number of retries scheduled after a failure */
+    STATS_RETRIES,
+
+    /*! number of messages appended to the spool */
+    STATS_SPOOLED,
+
+    /*! number of spooled messages dropped after a fatal send error */
+    STATS_SPOOL_DROPPED,
+
+    /*! number of unchanged messages which were not sent */
+    STATS_DEDUPED,
+
+    /*! number of bytes passed to the compressor */
+    STATS_COMPRESS_IN,
+
+    /*! number of compressed bytes produced by the compressor */
+    STATS_COMPRESS_OUT,
+
+    /*! number of counters */
+    STATS_COUNTERS
+
+} StatsCounter;
+
+/*! gauges sampled when the statistics are reported */
+typedef enum _StatsGauge
+{
+    /*! number of messages waiting in the spool */
+    STATS_SPOOL_DEPTH,
+
+    /*! number of messages queued in the send pipelines */
+    STATS_QUEUE_DEPTH,
+
+    /*! number of gauges */
+    STATS_GAUGES
+
+} StatsGauge;
+
+/*! function which samples the gauges into an array of STATS_GAUGES values */
+typedef void (*StatsSampleFn)( void *pArg, uint64_t *pGauges );
+
+/*! totals of every thread at a point in time */
+typedef struct _StatsSnapshot
+{
+    /*! counters summed over every thread */
+    uint64_t counters[STATS_COUNTERS];
+
+    /*! sampled gauges */
+    uint64_t gauges[STATS_GAUGES];
+
+    /*! error of the most recent failure, or EOK if there has been none */
+    int lastError;
+
+    /*! the most recent operation on the link to the IOTHub succeeded */
+    bool linkUp;
+
+} StatsSnapshot;
+
+/*! maximum length of a formatted statistics line */
+#define STATS_LINE_SIZE     ( 512 )
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int STATS_Start( unsigned int interval, const char *pSocketPath );
+void STATS_Enable( void );
+void STATS_SetSampler( StatsSampleFn fn, void *pArg );
+void STATS_Add( StatsCounter counter, uint64_t n );
+uint64_t STATS_Clock( void );
+void STATS_Sent( uint64_t start, size_t len, int rc );
+void STATS_Link( int rc );
+void STATS_Snapshot( StatsSnapshot *pSnapshot );
+size_t STATS_Format( char *pBuf, size_t size );
+void STATS_Stop( void );
+void STATS_Shutdown( void );
+
+#endif
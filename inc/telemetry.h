@@ -0,0 +1,135 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <varserver/varserver.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! default time in milliseconds changes are coalesced into one message */
+#define TELEMETRY_DEFAULT_WINDOW_MS ( 100 )
+
+/*! maximum length of a string variable value */
+#define TELEMETRY_STR_SIZE          ( 256 )
+
+/*! function which sends a telemetry message */
+typedef int (*TelemetryFn)( void *pArg, char *pData, size_t len );
+
+/*! variable forwarded on change */
+typedef struct _TelemetryVar
+{
+    /*! variable name */
+    char *pName;
+
+    /*! variable handle */
+    VAR_HANDLE hVar;
+
+    /*! the variable has changed since it was last forwarded */
+    bool changed;
+
+    /*! the variable is in the message being built */
+    bool included;
+
+    /*! a value of the variable has been forwarded */
+    bool sent;
+
+    /*! numeric value of the variable in the message being built */
+    double value;
+
+    /*! numeric value last forwarded */
+    double lastValue;
+
+    /*! monotonic time in milliseconds the variable was last forwarded */
+    uint64_t lastSent;
+
+} TelemetryVar;
+
+/*! forwarder of variable changes */
+typedef struct _Telemetry
+{
+    /*! variable server connection */
+    VARSERVER_HANDLE hVarServer;
+
+    /*! variables forwarded on change */
+    TelemetryVar *pVars;
+
+    /*! number of variables */
+    size_t count;
+
+    /*! time in milliseconds changes are coalesced into one message */
+    unsigned int windowMs;
+
+    /*! minimum change of a numeric variable which is forwarded */
+    double deadband;
+
+    /*! minimum time in milliseconds between forwards of a variable */
+    unsigned int minIntervalMs;
+
+    /*! monotonic time in milliseconds the next message is due, or 0 */
+    uint64_t deadline;
+
+    /*! signalfd receiving the change notifications */
+    int fd;
+
+    /*! message buffer */
+    char *pBuf;
+
+    /*! size of the message buffer */
+    size_t size;
+
+    /*! report errors on stderr */
+    bool verbose;
+
+} Telemetry;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int TELEMETRY_Open( Telemetry *pTelemetry,
+                    const char *pNames,
+                    unsigned int windowMs,
+                    double deadband,
+                    unsigned int minIntervalMs,
+                    bool verbose );
+int TELEMETRY_Wait( Telemetry *pTelemetry,
+                    const sigset_t *pMask,
+                    TelemetryFn fn,
+                    void *pArg );
+int TELEMETRY_Flush( Telemetry *pTelemetry, TelemetryFn fn, void *pArg );
+void TELEMETRY_Close( Telemetry *pTelemetry );
+
+#endif
@@ -0,0 +1,129 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! maximum number of segments in a header template */
+#define TEMPLATE_MAX_SEGMENTS   ( 64 )
+
+/*! maximum length of the hostname substituted into a header template */
+#define TEMPLATE_MAX_HOSTNAME   ( 64 )
+
+/*! header template segment types */
+typedef enum _TemplateOp
+{
+    /*! literal text copied from the template */
+    TEMPLATE_LITERAL = 0,
+
+    /*! per-message sequence number */
+    TEMPLATE_SEQ,
+
+    /*! wall clock time in milliseconds since the epoch */
+    TEMPLATE_TS_MS,
+
+    /*! monotonic clock time in milliseconds */
+    TEMPLATE_MONO_MS,
+
+    /*! host name */
+    TEMPLATE_HOSTNAME,
+
+    /*! process identifier */
+    TEMPLATE_PID,
+
+    /*! chunk index of a chunked transfer */
+    TEMPLATE_CHUNK
+
+} TemplateOp;
+
+/*! header template segment */
+typedef struct _TemplateSegment
+{
+    /*! segment type */
+    TemplateOp op;
+
+    /*! offset of a literal segment in the template text */
+    size_t offset;
+
+    /*! length of a literal segment */
+    size_t len;
+
+} TemplateSegment;
+
+/*! compiled header template */
+typedef struct _HeaderTemplate
+{
+    /*! template text with the placeholders removed */
+    char *pText;
+
+    /*! template segments */
+    TemplateSegment segments[TEMPLATE_MAX_SEGMENTS];
+
+    /*! number of template segments */
+    size_t count;
+
+    /*! the template contains at least one placeholder */
+    bool dynamic;
+
+    /*! host name */
+    char hostname[TEMPLATE_MAX_HOSTNAME+1];
+
+    /*! length of the host name */
+    size_t hostnameLen;
+
+    /*! process identifier */
+    uint64_t pid;
+
+    /*! next sequence number */
+    uint64_t seq;
+
+    /*! render buffer sized for the longest possible rendering */
+    char *pBuf;
+
+    /*! size of the render buffer */
+    size_t size;
+
+} HeaderTemplate;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int TEMPLATE_Compile( HeaderTemplate *pTemplate, const char *text );
+char *TEMPLATE_Render( HeaderTemplate *pTemplate, uint64_t chunk );
+void TEMPLATE_Free( HeaderTemplate *pTemplate );
+
+#endif
@@ -0,0 +1,81 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+#ifndef WATCH_H
+#define WATCH_H
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+
+/*==============================================================================
+        Public definitions
+==============================================================================*/
+
+/*! function called for each file dropped into a watched directory */
+typedef int (*WatchFileFn)( void *pArg, const char *pPath );
+
+/*! watched drop directory */
+typedef struct _Watch
+{
+    /*! path of the watched directory */
+    char *pDir;
+
+    /*! directory delivered files are moved to, or NULL to delete them */
+    char *pDoneDir;
+
+    /*! inotify descriptor */
+    int fd;
+
+    /*! the files in the directory must be scanned */
+    bool scan;
+
+    /*! time in milliseconds when the directory may be scanned again */
+    uint64_t scanDue;
+
+    /*! report file activity on stderr */
+    bool verbose;
+
+} Watch;
+
+/*==============================================================================
+        Public function declarations
+==============================================================================*/
+
+int WATCH_Open( Watch *pWatch,
+                const char *pDir,
+                const char *pDoneDir,
+                bool verbose );
+int WATCH_Wait( Watch *pWatch,
+                int timeoutMs,
+                const sigset_t *pMask,
+                WatchFileFn pfnFile,
+                void *pArg );
+void WATCH_Close( Watch *pWatch );
+
+#endif
@@ -0,0 +1,472 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup batch batch
+ * @brief Client side message batching
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file batch.c
+
+    Message Batching
+
+    The batch module packs many small records into a single IOT
+    message to reduce the per-message overhead at the hub.  Records
+    are framed either as elements of a JSON array, or with a 32-bit
+    big-endian length prefix.
+
+    A batch should be flushed when BATCH_IsFull reports that its byte
+    or record count threshold has been reached, or when the linger time
+    reported by BATCH_GetTimeout has expired.  A batch never grows
+    beyond the hard upper bound specified when it was initialized, so
+    it is never truncated when it is sent.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <iotclient/iotclient.h>
+#include "pool.h"
+#include "batch.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static size_t Overhead( Batch *pBatch );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  BATCH_Init                                                                */
+/*!
+    Initialize a message batch
+
+    The BATCH_Init function allocates the batch buffer and sets up
+    the batch flush thresholds.
+
+    @param[in]
+        pBatch
+            pointer to the batch to initialize
+
+    @param[in]
+        format
+            batch framing format
+
+    @param[in]
+        size
+            hard upper bound of the batch size (eg MAX_IOT_MSG_SIZE)
+
+    @param[in]
+        maxBytes
+            batch size which triggers a flush.  Limited to size.
+
+    @param[in]
+        maxCount
+            number of records which triggers a flush (0 = unlimited)
+
+    @param[in]
+        lingerMs
+            maximum time a record may wait in the batch
+
+    @retval EOK the batch was initialized
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int BATCH_Init( Batch *pBatch,
+                BatchFormat format,
+                size_t size,
+                size_t maxBytes,
+                size_t maxCount,
+                int lingerMs )
+{
+    int result = EINVAL;
+
+    if ( ( pBatch != NULL ) && ( size > BATCH_OVERHEAD ) )
+    {
+        memset( pBatch, 0, sizeof( Batch ) );
+
+        pBatch->pBuf = POOL_Alloc( size );
+        if ( pBatch->pBuf != NULL )
+        {
+            pBatch->format = format;
+            pBatch->size = size;
+            pBatch->maxBytes = ( ( maxBytes > 0 ) && ( maxBytes < size ) )
+                                ? maxBytes
+                                : size;
+            pBatch->maxCount = maxCount;
+            pBatch->lingerMs = lingerMs;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  BATCH_Add                                                                 */
+/*!
+    Add a record to a batch
+
+    The BATCH_Add function appends a record to the batch.  If the
+    record would take the batch over its flush size, ENOSPC is returned
+    and the caller should flush the batch and add the record again.
+    A record which is larger than the flush size is accepted into an
+    empty batch as long as it does not exceed the hard upper bound.
+
+    @param[in]
+        pBatch
+            pointer to the batch
+
+    @param[in]
+        pRecord
+            pointer to the record to add
+
+    @param[in]
+        len
+            length of the record
+
+    @retval EOK the record was added to the batch
+    @retval ENOSPC the batch must be flushed before the record can be added
+    @retval E2BIG the record can never fit in a batch
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int BATCH_Add( Batch *pBatch, char *pRecord, size_t len )
+{
+    int result = EINVAL;
+    size_t need;
+    uint32_t n;
+    char *p;
+
+    if ( ( pBatch != NULL ) &&
+         ( pBatch->pBuf != NULL ) &&
+         ( pRecord != NULL ) )
+    {
+        need = len + Overhead( pBatch );
+
+        if ( ( pBatch->count == 0 ) && ( need > pBatch->size ) )
+        {
+            result = E2BIG;
+        }
+        else if ( ( pBatch->count > 0 ) &&
+                  ( pBatch->len + need > pBatch->maxBytes ) )
+        {
+            result = ENOSPC;
+        }
+        else
+        {
+            p = &pBatch->pBuf[pBatch->len];
+
+            if ( pBatch->format == BATCH_FORMAT_LP )
+            {
+                n = (uint32_t)len;
+                *p++ = ( n >> 24 ) & 0xFF;
+                *p++ = ( n >> 16 ) & 0xFF;
+                *p++ = ( n >> 8 ) & 0xFF;
+                *p++ = n & 0xFF;
+            }
+            else
+            {
+                /* open the array or separate from the previous element.
+                   Space for the closing bracket is always reserved */
+                *p++ = ( pBatch->count == 0 ) ? '[' : ',';
+            }
+
+            memcpy( p, pRecord, len );
+            pBatch->len = ( p - pBatch->pBuf ) + len;
+
+            if ( pBatch->count == 0 )
+            {
+                clock_gettime( CLOCK_MONOTONIC, &pBatch->deadline );
+                pBatch->deadline.tv_sec += pBatch->lingerMs / 1000;
+                pBatch->deadline.tv_nsec +=
+                            ( pBatch->lingerMs % 1000 ) * 1000000L;
+                if ( pBatch->deadline.tv_nsec >= 1000000000L )
+                {
+                    pBatch->deadline.tv_sec++;
+                    pBatch->deadline.tv_nsec -= 1000000000L;
+                }
+            }
+
+            pBatch->count++;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  BATCH_IsFull                                                              */
+/*!
+    Check if a batch has reached a flush threshold
+
+    The BATCH_IsFull function checks if the batch has reached its byte
+    or record count flush threshold.
+
+    @param[in]
+        pBatch
+            pointer to the batch
+
+    @retval true the batch should be flushed
+    @retval false the batch can accept more records
+
+==============================================================================*/
+bool BATCH_IsFull( Batch *pBatch )
+{
+    bool full = false;
+
+    if ( pBatch != NULL )
+    {
+        if ( ( pBatch->maxCount > 0 ) &&
+             ( pBatch->count >= pBatch->maxCount ) )
+        {
+            full = true;
+        }
+        else if ( pBatch->len + Overhead( pBatch ) >= pBatch->maxBytes )
+        {
+            full = true;
+        }
+    }
+
+    return full;
+}
+
+/*============================================================================*/
+/*  BATCH_GetTimeout                                                          */
+/*!
+    Get the time remaining until the batch must be flushed
+
+    The BATCH_GetTimeout function calculates the number of milliseconds
+    remaining until the linger time of the oldest record in the batch
+    expires.
+
+    @param[in]
+        pBatch
+            pointer to the batch
+
+    @retval -1 the batch is empty
+    @retval 0 the batch must be flushed now
+    @retval >0 number of milliseconds until the batch must be flushed
+
+==============================================================================*/
+int BATCH_GetTimeout( Batch *pBatch )
+{
+    int timeout = -1;
+    struct timespec now;
+    long long remaining;
+
+    if ( ( pBatch != NULL ) && ( pBatch->count > 0 ) )
+    {
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        remaining = ( pBatch->deadline.tv_sec - now.tv_sec ) * 1000LL +
+                    ( pBatch->deadline.tv_nsec - now.tv_nsec ) / 1000000L;
+
+        /* round up so the timeout never expires early */
+        timeout = ( remaining > 0 ) ? (int)remaining + 1 : 0;
+    }
+
+    return timeout;
+}
+
+/*============================================================================*/
+/*  BATCH_GetData                                                             */
+/*!
+    Get the framed batch data
+
+    The BATCH_GetData function completes the batch framing and returns
+    a pointer to the batch data ready to be sent.  The batch should be
+    cleared with BATCH_Clear once it has been sent.
+
+    @param[in]
+        pBatch
+            pointer to the batch
+
+    @param[out]
+        pLen
+            pointer to a location to store the batch length
+
+    @retval pointer to the batch data
+    @retval NULL the batch is empty
+
+==============================================================================*/
+char *BATCH_GetData( Batch *pBatch, size_t *pLen )
+{
+    char *pData = NULL;
+
+    if ( ( pBatch != NULL ) &&
+         ( pLen != NULL ) &&
+         ( pBatch->count > 0 ) )
+    {
+        *pLen = pBatch->len;
+
+        if ( pBatch->format == BATCH_FORMAT_JSON )
+        {
+            /* space for the closing bracket is reserved by BATCH_Add */
+            pBatch->pBuf[pBatch->len] = ']';
+            (*pLen)++;
+        }
+
+        pData = pBatch->pBuf;
+    }
+
+    return pData;
+}
+
+/*============================================================================*/
+/*  BATCH_Clear                                                               */
+/*!
+    Empty a batch
+
+    The BATCH_Clear function removes all the records from the batch.
+
+    @param[in]
+        pBatch
+            pointer to the batch
+
+==============================================================================*/
+void BATCH_Clear( Batch *pBatch )
+{
+    if ( pBatch != NULL )
+    {
+        pBatch->len = 0;
+        pBatch->count = 0;
+    }
+}
+
+/*============================================================================*/
+/*  BATCH_Free                                                                */
+/*!
+    Release the resources used by a batch
+
+    @param[in]
+        pBatch
+            pointer to the batch
+
+==============================================================================*/
+void BATCH_Free( Batch *pBatch )
+{
+    if ( pBatch != NULL )
+    {
+        if ( pBatch->pBuf != NULL )
+        {
+            POOL_Free( pBatch->pBuf, pBatch->size );
+            pBatch->pBuf = NULL;
+        }
+
+        pBatch->size = 0;
+        BATCH_Clear( pBatch );
+    }
+}
+
+/*============================================================================*/
+/*  BATCH_ParseFormat                                                         */
+/*!
+    Convert a batch format name to a batch format
+
+    @param[in]
+        name
+            batch format name: "json" or "lp"
+
+    @param[out]
+        pFormat
+            pointer to a location to store the batch format
+
+    @retval EOK the batch format was recognized
+    @retval ENOTSUP the batch format is not supported
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int BATCH_ParseFormat( char *name, BatchFormat *pFormat )
+{
+    int result = EINVAL;
+
+    if ( ( name != NULL ) && ( pFormat != NULL ) )
+    {
+        if ( strcmp( name, "json" ) == 0 )
+        {
+            *pFormat = BATCH_FORMAT_JSON;
+            result = EOK;
+        }
+        else if ( strcmp( name, "lp" ) == 0 )
+        {
+            *pFormat = BATCH_FORMAT_LP;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOTSUP;
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Overhead                                                                  */
+/*!
+    Get the framing overhead of the next record added to a batch
+
+    For JSON batches this is the opening bracket or separating comma
+    plus the reserved closing bracket.  For length prefixed batches
+    this is the size of the length prefix.
+
+    @param[in]
+        pBatch
+            pointer to the batch
+
+    @retval number of framing bytes needed for the next record
+
+==============================================================================*/
+static size_t Overhead( Batch *pBatch )
+{
+    return ( pBatch->format == BATCH_FORMAT_LP ) ? 4 : 2;
+}
+
+/*! @}
+ * end of batch group */
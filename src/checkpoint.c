@@ -0,0 +1,342 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup checkpoint checkpoint
+ * @brief Checkpoints of resumable chunked transfers
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file checkpoint.c
+
+    Transfer Checkpoints
+
+    The checkpoint module records the progress of a chunked transfer
+    of a regular file, so a transfer which is interrupted, for example
+    by a dropped cellular link, can be resumed from the first chunk
+    which was not acknowledged rather than from the start.
+
+    A checkpoint is a small text file in the same key:value format as
+    the message headers:
+
+    transferid:<32 hex digits identifying the transfer>\n
+    chunk:<index of the first chunk which was not acknowledged>\n
+    offset:<byte offset of that chunk in the input>\n
+    chunksize:<maximum number of payload bytes in a chunk>\n
+    size:<size of the input file>\n
+    mtime:<modification time of the input file in nanoseconds>\n
+
+    The size and modification time identify the input, so a checkpoint
+    is not applied to a file which has changed since it was written.
+    A checkpoint is written to a temporary file which is synced and
+    renamed over the previous checkpoint, so a crash leaves either the
+    old or the new checkpoint, never a torn one.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <iotclient/iotclient.h>
+#include "checkpoint.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! suffix of the temporary file a checkpoint is written to */
+#define CHECKPOINT_TMP_SUFFIX   ".tmp"
+
+/*! maximum size of a checkpoint file */
+#define CHECKPOINT_MAX_SIZE     ( 512 )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int WriteAll( int fd, const char *pBuf, size_t len );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  CHECKPOINT_Load                                                           */
+/*!
+    Load a transfer checkpoint
+
+    The CHECKPOINT_Load function reads the checkpoint of a chunked
+    transfer written by a previous run.
+
+    @param[out]
+        pCheckpoint
+            pointer to the checkpoint to load
+
+    @param[in]
+        pPath
+            path of the checkpoint file
+
+    @retval EOK the checkpoint was loaded
+    @retval ENOENT there is no checkpoint
+    @retval EBADMSG the checkpoint file is damaged
+    @retval EINVAL invalid arguments
+    @retval other error reading the checkpoint file
+
+==============================================================================*/
+int CHECKPOINT_Load( Checkpoint *pCheckpoint, const char *pPath )
+{
+    int result = EINVAL;
+    char buf[CHECKPOINT_MAX_SIZE];
+    ssize_t n;
+    int fd;
+
+    if ( ( pCheckpoint != NULL ) && ( pPath != NULL ) )
+    {
+        memset( pCheckpoint, 0, sizeof( Checkpoint ) );
+
+        fd = open( pPath, O_RDONLY );
+        if ( fd == -1 )
+        {
+            result = errno;
+        }
+        else
+        {
+            n = read( fd, buf, sizeof( buf ) - 1 );
+            if ( n == -1 )
+            {
+                result = errno;
+            }
+            else
+            {
+                buf[n] = '\0';
+                result = ( sscanf( buf,
+                                   "transferid:%32[0-9a-f]\n"
+                                   "chunk:%zu\n"
+                                   "offset:%" SCNu64 "\n"
+                                   "chunksize:%zu\n"
+                                   "size:%" SCNu64 "\n"
+                                   "mtime:%" SCNu64 "\n",
+                                   pCheckpoint->transferId,
+                                   &pCheckpoint->index,
+                                   &pCheckpoint->offset,
+                                   &pCheckpoint->chunkSize,
+                                   &pCheckpoint->size,
+                                   &pCheckpoint->mtime ) == 6 ) &&
+                         ( strlen( pCheckpoint->transferId ) ==
+                           CHUNK_ID_LEN ) &&
+                         ( pCheckpoint->offset <= pCheckpoint->size )
+                         ? EOK
+                         : EBADMSG;
+            }
+
+            close( fd );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CHECKPOINT_Save                                                           */
+/*!
+    Save a transfer checkpoint
+
+    The CHECKPOINT_Save function atomically replaces the checkpoint
+    file with the current progress of a chunked transfer.  The new
+    checkpoint is synced to storage before it replaces the old one.
+
+    @param[in]
+        pCheckpoint
+            pointer to the checkpoint to save
+
+    @param[in]
+        pPath
+            path of the checkpoint file
+
+    @retval EOK the checkpoint was saved
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+    @retval other error writing the checkpoint file
+
+==============================================================================*/
+int CHECKPOINT_Save( const Checkpoint *pCheckpoint, const char *pPath )
+{
+    int result = EINVAL;
+    char buf[CHECKPOINT_MAX_SIZE];
+    char *pTmp;
+    size_t size;
+    int len;
+    int fd;
+
+    if ( ( pCheckpoint != NULL ) && ( pPath != NULL ) )
+    {
+        size = strlen( pPath ) + sizeof( CHECKPOINT_TMP_SUFFIX );
+        pTmp = malloc( size );
+        if ( pTmp == NULL )
+        {
+            result = ENOMEM;
+        }
+        else
+        {
+            snprintf( pTmp, size, "%s" CHECKPOINT_TMP_SUFFIX, pPath );
+
+            len = snprintf( buf,
+                            sizeof( buf ),
+                            "transferid:%s\n"
+                            "chunk:%zu\n"
+                            "offset:%" PRIu64 "\n"
+                            "chunksize:%zu\n"
+                            "size:%" PRIu64 "\n"
+                            "mtime:%" PRIu64 "\n",
+                            pCheckpoint->transferId,
+                            pCheckpoint->index,
+                            pCheckpoint->offset,
+                            pCheckpoint->chunkSize,
+                            pCheckpoint->size,
+                            pCheckpoint->mtime );
+
+            fd = open( pTmp, O_WRONLY | O_CREAT | O_TRUNC, 0640 );
+            if ( fd == -1 )
+            {
+                result = errno;
+            }
+            else
+            {
+                result = WriteAll( fd, buf, (size_t)len );
+                if ( ( result == EOK ) && ( fsync( fd ) != 0 ) )
+                {
+                    result = errno;
+                }
+
+                close( fd );
+
+                if ( ( result == EOK ) && ( rename( pTmp, pPath ) != 0 ) )
+                {
+                    result = errno;
+                }
+
+                if ( result != EOK )
+                {
+                    unlink( pTmp );
+                }
+            }
+
+            free( pTmp );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CHECKPOINT_Remove                                                         */
+/*!
+    Remove a transfer checkpoint
+
+    The CHECKPOINT_Remove function removes the checkpoint of a transfer
+    which has completed, so it is not resumed again.
+
+    @param[in]
+        pPath
+            path of the checkpoint file
+
+    @retval EOK the checkpoint was removed, or there was none
+    @retval EINVAL invalid arguments
+    @retval other error removing the checkpoint file
+
+==============================================================================*/
+int CHECKPOINT_Remove( const char *pPath )
+{
+    int result = EINVAL;
+
+    if ( pPath != NULL )
+    {
+        result = ( ( unlink( pPath ) == 0 ) || ( errno == ENOENT ) )
+                 ? EOK
+                 : errno;
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  WriteAll                                                                  */
+/*!
+    Write a buffer to a file
+
+    @param[in]
+        fd
+            file descriptor to write to
+
+    @param[in]
+        pBuf
+            pointer to the data to write
+
+    @param[in]
+        len
+            number of bytes to write
+
+    @retval EOK all the data was written
+    @retval other error from write()
+
+==============================================================================*/
+static int WriteAll( int fd, const char *pBuf, size_t len )
+{
+    int result = EOK;
+    size_t done = 0;
+    ssize_t rc;
+
+    while ( ( result == EOK ) && ( done < len ) )
+    {
+        rc = write( fd, &pBuf[done], len - done );
+        if ( rc > 0 )
+        {
+            done += rc;
+        }
+        else if ( ( rc == -1 ) && ( errno != EINTR ) )
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of checkpoint group */
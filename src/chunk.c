@@ -0,0 +1,807 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup chunk chunk
+ * @brief Chunked transfer of oversized payloads
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file chunk.c
+
+    Chunked Transfer
+
+    The chunk module splits an input stream which is too big to be
+    sent as a single IOT message into a sequence of chunks.  Each chunk
+    carries the common message headers followed by sequence headers
+    which allow the cloud side to re-assemble the transfer:
+
+    transferid:<32 hex digits identifying the transfer>\n
+    chunk:<zero based chunk index>\n
+    chunks:<total number of chunks, if known>\n
+    offset:<byte offset of the chunk in the input>\n
+    lastchunk:true\n  (final chunk only)
+
+    The total number of chunks is only known when the size of the
+    input is known in advance.  The final chunk is always marked, so
+    streams of unknown length can be re-assembled as well.  One chunk
+    is read ahead so the final chunk can be identified.
+
+    When the input is memory mapped, chunks are returned as slices of
+    the mapped region and no chunk buffers are allocated.
+
+    A transfer may be resumed from a chunk sent by a previous run.  It
+    keeps the transfer identifier of that run so the receiver adds the
+    remaining chunks to the chunks it already has.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <inttypes.h>
+#include <iotclient/iotclient.h>
+#include "pool.h"
+#include "stats.h"
+#include "chunk.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void MakeTransferId( char *pTransferId );
+static int NextMapped( ChunkTransfer *pTransfer, char **ppData, bool *pLast );
+static int NextRead( ChunkTransfer *pTransfer,
+                     int fd,
+                     char **ppData,
+                     bool *pLast );
+static int ReadInput( ChunkTransfer *pTransfer,
+                      int fd,
+                      char *pBuf,
+                      size_t size,
+                      size_t *pLen );
+static int ReadChunk( int fd, char *pBuf, size_t size, size_t *pLen );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  CHUNK_Init                                                                */
+/*!
+    Initialize a chunked transfer
+
+    The CHUNK_Init function allocates the chunk header buffer and
+    generates a new transfer identifier.  The chunk buffers are
+    allocated when the first chunk is read from the input.
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer to initialize
+
+    @param[in]
+        pHeaders
+            message headers common to all the chunks
+
+    @param[in]
+        chunkSize
+            maximum number of payload bytes per chunk
+
+    @param[in]
+        totalSize
+            total size of the input, or 0 if unknown
+
+    @retval EOK the transfer was initialized
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int CHUNK_Init( ChunkTransfer *pTransfer,
+                char *pHeaders,
+                size_t chunkSize,
+                uint64_t totalSize )
+{
+    int result = EINVAL;
+
+    if ( ( pTransfer != NULL ) &&
+         ( pHeaders != NULL ) &&
+         ( chunkSize > 0 ) )
+    {
+        memset( pTransfer, 0, sizeof( ChunkTransfer ) );
+
+        pTransfer->chunkSize = chunkSize;
+        pTransfer->chunkCount = ( totalSize + chunkSize - 1 ) / chunkSize;
+
+        result = CHUNK_SetHeaders( pTransfer, pHeaders );
+        if ( result == EOK )
+        {
+            MakeTransferId( pTransfer->transferId );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CHUNK_SetHeaders                                                          */
+/*!
+    Set the message headers common to the chunks of a transfer
+
+    The CHUNK_SetHeaders function sets the message headers which precede
+    the sequence headers of the following chunks.  It is used when the
+    message headers change from one chunk to the next, for example when
+    they are rendered from a header template.  The chunk header buffer
+    is only re-allocated if the new headers are longer than any of the
+    previous headers.
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in]
+        pHeaders
+            message headers common to the following chunks
+
+    @retval EOK the headers were set
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int CHUNK_SetHeaders( ChunkTransfer *pTransfer, char *pHeaders )
+{
+    int result = EINVAL;
+    size_t len;
+    char *p;
+
+    if ( ( pTransfer != NULL ) && ( pHeaders != NULL ) )
+    {
+        /* the sequence headers are appended to the common headers
+           so strip their terminating newlines */
+        len = strlen( pHeaders );
+        while ( ( len > 0 ) && ( pHeaders[len-1] == '\n' ) )
+        {
+            len--;
+        }
+
+        result = EOK;
+
+        if ( len + CHUNK_HEADER_SIZE > pTransfer->headerSize )
+        {
+            /* the chunk headers are rendered from scratch for each
+               chunk so the old contents need not be copied */
+            p = POOL_Alloc( len + CHUNK_HEADER_SIZE );
+            if ( p != NULL )
+            {
+                POOL_Free( pTransfer->pHeaders, pTransfer->headerSize );
+                pTransfer->pHeaders = p;
+                pTransfer->headerSize = len + CHUNK_HEADER_SIZE;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+
+        if ( result == EOK )
+        {
+            pTransfer->pBaseHeaders = pHeaders;
+            pTransfer->baseLen = len;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CHUNK_Map                                                                 */
+/*!
+    Use a memory mapped input for a chunked transfer
+
+    The CHUNK_Map function sets up the chunked transfer to slice its
+    chunks out of a memory mapped input instead of reading them from
+    a file descriptor.  It must be called before the first call to
+    CHUNK_Next.
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in]
+        pData
+            pointer to the mapped input
+
+    @param[in]
+        size
+            size of the mapped input
+
+    @retval EOK the mapped input will be used
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int CHUNK_Map( ChunkTransfer *pTransfer, char *pData, uint64_t size )
+{
+    int result = EINVAL;
+
+    if ( ( pTransfer != NULL ) &&
+         ( pData != NULL ) &&
+         ( pTransfer->index == 0 ) )
+    {
+        pTransfer->pMap = pData;
+        pTransfer->mapSize = size;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CHUNK_SetSource                                                           */
+/*!
+    Read the input of a chunked transfer through a read function
+
+    The CHUNK_SetSource function installs a function which is used
+    instead of the input file descriptor to read the input, for
+    example to chunk the output of a compressor.  The total size of
+    such an input is not known in advance.
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in]
+        pfnRead
+            function used to read the input
+
+    @param[in]
+        pArg
+            argument passed to the read function
+
+    @retval EOK the read function will be used
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int CHUNK_SetSource( ChunkTransfer *pTransfer,
+                     ChunkReadFn pfnRead,
+                     void *pArg )
+{
+    int result = EINVAL;
+
+    if ( ( pTransfer != NULL ) &&
+         ( pfnRead != NULL ) &&
+         ( pTransfer->pMap == NULL ) &&
+         ( pTransfer->index == 0 ) )
+    {
+        pTransfer->pfnRead = pfnRead;
+        pTransfer->pReadArg = pArg;
+        pTransfer->chunkCount = 0;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CHUNK_Resume                                                              */
+/*!
+    Resume a chunked transfer
+
+    The CHUNK_Resume function continues a transfer started by a previous
+    run from one of its chunks.  The chunks are numbered and identified
+    as in the previous run.  It must be called after CHUNK_Map and
+    before the first call to CHUNK_Next.  An input which is not mapped
+    must already be positioned at the offset of the chunk.
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in]
+        pTransferId
+            identifier of the transfer to resume
+
+    @param[in]
+        index
+            index of the next chunk to send
+
+    @param[in]
+        offset
+            byte offset of the next chunk in the input
+
+    @retval EOK the transfer will be resumed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int CHUNK_Resume( ChunkTransfer *pTransfer,
+                  const char *pTransferId,
+                  size_t index,
+                  uint64_t offset )
+{
+    int result = EINVAL;
+
+    if ( ( pTransfer != NULL ) &&
+         ( pTransferId != NULL ) &&
+         ( strlen( pTransferId ) == CHUNK_ID_LEN ) &&
+         ( pTransfer->pfnRead == NULL ) &&
+         ( pTransfer->index == 0 ) )
+    {
+        memcpy( pTransfer->transferId, pTransferId, CHUNK_ID_LEN + 1 );
+        pTransfer->index = index;
+        pTransfer->offset = offset;
+
+        /* every chunk was sent but the transfer was not completed */
+        pTransfer->done = ( pTransfer->chunkCount > 0 ) &&
+                          ( index >= pTransfer->chunkCount );
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CHUNK_Next                                                                */
+/*!
+    Get the next chunk of a chunked transfer
+
+    The CHUNK_Next function gets the next chunk of the transfer from
+    the mapped input or the input file descriptor, and renders its
+    message headers.  The returned pointers remain valid until the
+    next call to CHUNK_Next.
+
+    An empty input is sent as a single empty chunk so the receiver
+    always sees a complete transfer.
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in]
+        fd
+            input file descriptor (unused for mapped inputs)
+
+    @param[out]
+        ppData
+            pointer to a location to store a pointer to the chunk data
+
+    @param[out]
+        pLen
+            pointer to a location to store the chunk length
+
+    @param[out]
+        ppHeaders
+            pointer to a location to store a pointer to the chunk headers
+
+    @retval EOK a chunk was returned
+    @retval ENODATA the transfer is complete
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+    @retval other error reading the input
+
+==============================================================================*/
+int CHUNK_Next( ChunkTransfer *pTransfer,
+                int fd,
+                char **ppData,
+                size_t *pLen,
+                char **ppHeaders )
+{
+    int result = EINVAL;
+    bool last = false;
+    size_t len = 0;
+    int n;
+
+    if ( ( pTransfer != NULL ) &&
+         ( ppData != NULL ) &&
+         ( pLen != NULL ) &&
+         ( ppHeaders != NULL ) )
+    {
+        if ( pTransfer->done == true )
+        {
+            result = ENODATA;
+        }
+        else if ( pTransfer->pMap != NULL )
+        {
+            result = NextMapped( pTransfer, ppData, &last );
+        }
+        else
+        {
+            result = NextRead( pTransfer, fd, ppData, &last );
+        }
+
+        if ( result == EOK )
+        {
+            len = pTransfer->len[pTransfer->current];
+
+            n = snprintf( pTransfer->pHeaders,
+                          pTransfer->headerSize,
+                          "%.*s%s"
+                          "transferid:%s\n"
+                          "chunk:%zu\n",
+                          (int)pTransfer->baseLen,
+                          pTransfer->pBaseHeaders,
+                          ( pTransfer->baseLen > 0 ) ? "\n" : "",
+                          pTransfer->transferId,
+                          pTransfer->index );
+
+            if ( pTransfer->chunkCount > 0 )
+            {
+                n += snprintf( &pTransfer->pHeaders[n],
+                               pTransfer->headerSize - n,
+                               "chunks:%zu\n",
+                               pTransfer->chunkCount );
+            }
+
+            snprintf( &pTransfer->pHeaders[n],
+                      pTransfer->headerSize - n,
+                      "offset:%" PRIu64 "\n%s\n",
+                      pTransfer->offset,
+                      last ? "lastchunk:true\n" : "" );
+
+            *pLen = len;
+            *ppHeaders = pTransfer->pHeaders;
+
+            pTransfer->index++;
+            pTransfer->offset += len;
+            pTransfer->done = last;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CHUNK_Free                                                                */
+/*!
+    Release the resources used by a chunked transfer
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+==============================================================================*/
+void CHUNK_Free( ChunkTransfer *pTransfer )
+{
+    int i;
+
+    if ( pTransfer != NULL )
+    {
+        for ( i = 0; i < 2; i++ )
+        {
+            if ( pTransfer->pBuf[i] != NULL )
+            {
+                POOL_Free( pTransfer->pBuf[i], pTransfer->chunkSize );
+                pTransfer->pBuf[i] = NULL;
+            }
+        }
+
+        if ( pTransfer->pHeaders != NULL )
+        {
+            POOL_Free( pTransfer->pHeaders, pTransfer->headerSize );
+            pTransfer->pHeaders = NULL;
+        }
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  MakeTransferId                                                            */
+/*!
+    Generate a random transfer identifier
+
+    The MakeTransferId function generates a 128-bit random transfer
+    identifier from /dev/urandom, formatted as 32 hexadecimal digits.
+    If /dev/urandom is not available, the identifier is derived from
+    the current time and the process id.
+
+    @param[out]
+        pTransferId
+            pointer to a buffer of at least CHUNK_ID_LEN+1 bytes
+
+==============================================================================*/
+static void MakeTransferId( char *pTransferId )
+{
+    unsigned char id[CHUNK_ID_LEN / 2];
+    struct timespec ts;
+    ssize_t n = 0;
+    int fd;
+    int i;
+
+    fd = open( "/dev/urandom", O_RDONLY );
+    if ( fd != -1 )
+    {
+        n = read( fd, id, sizeof( id ) );
+        close( fd );
+    }
+
+    if ( n != sizeof( id ) )
+    {
+        clock_gettime( CLOCK_REALTIME, &ts );
+        memset( id, 0, sizeof( id ) );
+        memcpy( id, &ts, ( sizeof( ts ) < sizeof( id ) ) ? sizeof( ts )
+                                                          : sizeof( id ) );
+        id[0] ^= getpid() & 0xFF;
+        id[1] ^= ( getpid() >> 8 ) & 0xFF;
+    }
+
+    for ( i = 0; i < (int)sizeof( id ); i++ )
+    {
+        sprintf( &pTransferId[i*2], "%02x", id[i] );
+    }
+}
+
+/*============================================================================*/
+/*  NextMapped                                                                */
+/*!
+    Get the next chunk from a memory mapped input
+
+    The NextMapped function returns the next chunk as a slice of the
+    mapped input, so the chunk data is never copied.
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[out]
+        ppData
+            pointer to a location to store a pointer to the chunk data
+
+    @param[out]
+        pLast
+            pointer to a location to store the last chunk indicator
+
+    @retval EOK the chunk was returned
+
+==============================================================================*/
+static int NextMapped( ChunkTransfer *pTransfer, char **ppData, bool *pLast )
+{
+    uint64_t remaining;
+    size_t len;
+
+    remaining = ( pTransfer->offset < pTransfer->mapSize )
+                ? pTransfer->mapSize - pTransfer->offset
+                : 0;
+
+    len = ( remaining > pTransfer->chunkSize ) ? pTransfer->chunkSize
+                                               : (size_t)remaining;
+
+    *ppData = &pTransfer->pMap[pTransfer->offset];
+    *pLast = ( len == remaining );
+    pTransfer->len[pTransfer->current] = len;
+
+    return EOK;
+}
+
+/*============================================================================*/
+/*  NextRead                                                                  */
+/*!
+    Get the next chunk from an input file descriptor
+
+    The NextRead function returns the chunk which was read ahead by
+    the previous call, or reads the first chunk, and then reads ahead
+    the following chunk to determine if the current chunk is the last.
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in]
+        fd
+            input file descriptor
+
+    @param[out]
+        ppData
+            pointer to a location to store a pointer to the chunk data
+
+    @param[out]
+        pLast
+            pointer to a location to store the last chunk indicator
+
+    @retval EOK the chunk was returned
+    @retval ENOMEM memory allocation failed
+    @retval other error from read()
+
+==============================================================================*/
+static int NextRead( ChunkTransfer *pTransfer,
+                     int fd,
+                     char **ppData,
+                     bool *pLast )
+{
+    int result = EOK;
+    int cur = pTransfer->current;
+    int next = cur ^ 1;
+
+    if ( pTransfer->pBuf[0] == NULL )
+    {
+        pTransfer->pBuf[0] = POOL_Alloc( pTransfer->chunkSize );
+        pTransfer->pBuf[1] = POOL_Alloc( pTransfer->chunkSize );
+        if ( ( pTransfer->pBuf[0] == NULL ) ||
+             ( pTransfer->pBuf[1] == NULL ) )
+        {
+            result = ENOMEM;
+        }
+        else
+        {
+            /* prime the current chunk */
+            result = ReadInput( pTransfer,
+                                fd,
+                                pTransfer->pBuf[cur],
+                                pTransfer->chunkSize,
+                                &pTransfer->len[cur] );
+        }
+    }
+    else
+    {
+        /* the read-ahead chunk becomes the current chunk */
+        cur = next;
+        next = cur ^ 1;
+        pTransfer->current = cur;
+    }
+
+    if ( result == EOK )
+    {
+        pTransfer->len[next] = 0;
+        if ( pTransfer->len[cur] == pTransfer->chunkSize )
+        {
+            /* read ahead to find out if this is the last chunk */
+            result = ReadInput( pTransfer,
+                                fd,
+                                pTransfer->pBuf[next],
+                                pTransfer->chunkSize,
+                                &pTransfer->len[next] );
+        }
+    }
+
+    if ( result == EOK )
+    {
+        *ppData = pTransfer->pBuf[cur];
+        *pLast = ( pTransfer->len[next] == 0 );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ReadInput                                                                 */
+/*!
+    Read a chunk of the input
+
+    The ReadInput function fills a chunk buffer using the installed
+    read function, or from the input file descriptor if there is none.
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in]
+        fd
+            input file descriptor
+
+    @param[in]
+        pBuf
+            pointer to the chunk buffer
+
+    @param[in]
+        size
+            size of the chunk buffer
+
+    @param[out]
+        pLen
+            pointer to a location to store the number of bytes read
+
+    @retval EOK the chunk was read
+    @retval other error from the read function or read()
+
+==============================================================================*/
+static int ReadInput( ChunkTransfer *pTransfer,
+                      int fd,
+                      char *pBuf,
+                      size_t size,
+                      size_t *pLen )
+{
+    int result;
+
+    if ( pTransfer->pfnRead != NULL )
+    {
+        result = pTransfer->pfnRead( pTransfer->pReadArg, pBuf, size, pLen );
+    }
+    else
+    {
+        result = ReadChunk( fd, pBuf, size, pLen );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ReadChunk                                                                 */
+/*!
+    Read a full chunk from the input
+
+    The ReadChunk function reads from the input until the chunk buffer
+    is full or the end of the input is reached.
+
+    @param[in]
+        fd
+            input file descriptor
+
+    @param[in]
+        pBuf
+            pointer to the chunk buffer
+
+    @param[in]
+        size
+            size of the chunk buffer
+
+    @param[out]
+        pLen
+            pointer to a location to store the number of bytes read
+
+    @retval EOK the chunk was read
+    @retval other error from read()
+
+==============================================================================*/
+static int ReadChunk( int fd, char *pBuf, size_t size, size_t *pLen )
+{
+    int result = EOK;
+    size_t len = 0;
+    ssize_t rc;
+
+    while ( len < size )
+    {
+        rc = read( fd, &pBuf[len], size - len );
+        if ( rc > 0 )
+        {
+            len += rc;
+            STATS_Add( STATS_BYTES_READ, rc );
+        }
+        else if ( rc == 0 )
+        {
+            break;
+        }
+        else if ( errno != EINTR )
+        {
+            result = errno;
+            break;
+        }
+    }
+
+    *pLen = len;
+
+    return result;
+}
+
+/*! @}
+ * end of chunk group */
@@ -0,0 +1,1255 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup compress compress
+ * @brief Payload compression
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file compress.c
+
+    Payload Compression
+
+    The compress module compresses message payloads using gzip, zstd,
+    or lz4.  Support for each codec is selected at build time with the
+    IOTSEND_WITH_ZLIB, IOTSEND_WITH_ZSTD, and IOTSEND_WITH_LZ4 options.
+
+    The input is compressed as a stream, one COMPRESS_BLOCK_SIZE block at
+    a time, from either a file descriptor or a memory region.  The
+    compressed output is read back with COMPRESS_Read into buffers of
+    any size, so an input of any length can be compressed using a fixed
+    amount of memory and the output split into messages of up to
+    MAX_IOT_MSG_SIZE bytes.
+
+    Small messages compress poorly on their own.  A zstd dictionary
+    trained from sample messages can be loaded once and is used for
+    every message compressed with the same context.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <iotclient/iotclient.h>
+#include "stats.h"
+#include "compress.h"
+
+#ifdef IOTSEND_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef IOTSEND_WITH_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#ifdef IOTSEND_WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! slack added to the pending buffer for stream headers and trailers */
+#define COMPRESS_SLACK      ( 1024 )
+
+/*! zstd compression level used with a dictionary */
+#define COMPRESS_ZSTD_LEVEL ( 3 )
+
+/*! initial size of the buffer used to read a dictionary or samples */
+#define COMPRESS_READ_SIZE  ( 64 * 1024 )
+
+/*! codec name to codec mapping */
+typedef struct _CodecName
+{
+    /*! codec name, also used as the content-encoding header value */
+    const char *name;
+
+    /*! codec */
+    CompressCodec codec;
+
+} CodecName;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! supported codec names */
+static const CodecName codecNames[] =
+{
+    { "gzip", COMPRESS_GZIP },
+    { "zstd", COMPRESS_ZSTD },
+    { "lz4",  COMPRESS_LZ4 }
+};
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int Start( Compressor *pCompressor );
+static int NextBlock( Compressor *pCompressor );
+static int CompressBlock( Compressor *pCompressor,
+                          const char *pIn,
+                          size_t len,
+                          bool last );
+#ifdef IOTSEND_WITH_ZSTD
+static int AppendFile( const char *fileName,
+                       char **ppBuf,
+                       size_t *pLen,
+                       size_t *pSize );
+static int WriteFile( const char *fileName, const char *pData, size_t len );
+#endif
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  COMPRESS_Init                                                             */
+/*!
+    Initialize a payload compressor
+
+    The COMPRESS_Init function allocates the compression context and
+    the buffers used to compress a stream.  The context is re-used for
+    every payload compressed.
+
+    @param[in]
+        pCompressor
+            pointer to the compressor to initialize
+
+    @param[in]
+        codec
+            compression codec
+
+    @retval EOK the compressor was initialized
+    @retval ENOTSUP the codec is not supported by this build
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int COMPRESS_Init( Compressor *pCompressor, CompressCodec codec )
+{
+    int result = EINVAL;
+
+    if ( pCompressor != NULL )
+    {
+        memset( pCompressor, 0, sizeof( Compressor ) );
+        pCompressor->codec = codec;
+        pCompressor->fd = -1;
+        result = ENOTSUP;
+
+        switch ( codec )
+        {
+#ifdef IOTSEND_WITH_ZLIB
+            case COMPRESS_GZIP:
+                pCompressor->pContext = calloc( 1, sizeof( z_stream ) );
+                if ( pCompressor->pContext != NULL )
+                {
+                    /* 15 window bits plus 16 selects the gzip wrapper */
+                    result = ( deflateInit2( pCompressor->pContext,
+                                             Z_DEFAULT_COMPRESSION,
+                                             Z_DEFLATED,
+                                             15 + 16,
+                                             8,
+                                             Z_DEFAULT_STRATEGY ) == Z_OK )
+                             ? EOK
+                             : ENOMEM;
+                }
+                else
+                {
+                    result = ENOMEM;
+                }
+                break;
+#endif
+
+#ifdef IOTSEND_WITH_ZSTD
+            case COMPRESS_ZSTD:
+                pCompressor->pContext = ZSTD_createCCtx();
+                result = ( pCompressor->pContext != NULL ) ? EOK : ENOMEM;
+                break;
+#endif
+
+#ifdef IOTSEND_WITH_LZ4
+            case COMPRESS_LZ4:
+                result = LZ4F_isError(
+                            LZ4F_createCompressionContext(
+                                (LZ4F_cctx **)&pCompressor->pContext,
+                                LZ4F_VERSION ) ) ? ENOMEM : EOK;
+                break;
+#endif
+
+            default:
+                break;
+        }
+
+        if ( result == EOK )
+        {
+            /* leave room for output held back from the previous block */
+            pCompressor->pendingSize = COMPRESS_Bound( pCompressor,
+                                                   2 * COMPRESS_BLOCK_SIZE );
+            pCompressor->pIn = malloc( COMPRESS_BLOCK_SIZE );
+            pCompressor->pPending = malloc( pCompressor->pendingSize );
+            if ( ( pCompressor->pIn == NULL ) ||
+                 ( pCompressor->pPending == NULL ) )
+            {
+                result = ENOMEM;
+            }
+        }
+
+        if ( result != EOK )
+        {
+            COMPRESS_Free( pCompressor );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  COMPRESS_LoadDictionary                                                   */
+/*!
+    Load a zstd compression dictionary
+
+    The COMPRESS_LoadDictionary function reads a dictionary file and
+    digests it once so it can be referenced by every subsequent
+    compression without any per-message setup cost.
+
+    @param[in]
+        pCompressor
+            pointer to an initialized zstd compressor
+
+    @param[in]
+        fileName
+            name of the dictionary file
+
+    @retval EOK the dictionary was loaded
+    @retval ENOTSUP dictionaries are only supported by zstd
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+    @retval other error reading the dictionary file
+
+==============================================================================*/
+int COMPRESS_LoadDictionary( Compressor *pCompressor, const char *fileName )
+{
+    int result = EINVAL;
+#ifdef IOTSEND_WITH_ZSTD
+    char *pBuf = NULL;
+    size_t len = 0;
+    size_t size = 0;
+#endif
+
+    if ( ( pCompressor != NULL ) && ( fileName != NULL ) )
+    {
+        result = ENOTSUP;
+
+#ifdef IOTSEND_WITH_ZSTD
+        if ( ( pCompressor->codec == COMPRESS_ZSTD ) &&
+             ( pCompressor->pDictionary == NULL ) )
+        {
+            result = AppendFile( fileName, &pBuf, &len, &size );
+        }
+
+        if ( ( result == EOK ) && ( len == 0 ) )
+        {
+            result = EINVAL;
+        }
+
+        if ( result == EOK )
+        {
+            pCompressor->pDictionary = ZSTD_createCDict( pBuf,
+                                                         len,
+                                                         COMPRESS_ZSTD_LEVEL );
+            if ( pCompressor->pDictionary == NULL )
+            {
+                result = ENOMEM;
+            }
+            else if ( ZSTD_isError(
+                        ZSTD_CCtx_refCDict( pCompressor->pContext,
+                                            pCompressor->pDictionary ) ) )
+            {
+                result = EINVAL;
+            }
+            else
+            {
+                /* a raw content dictionary has an id of 0 */
+                pCompressor->dictId = ZSTD_getDictID_fromDict( pBuf, len );
+            }
+        }
+
+        free( pBuf );
+#endif
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  COMPRESS_StartFd                                                          */
+/*!
+    Start compressing the data read from a file descriptor
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+    @param[in]
+        fd
+            input file descriptor
+
+    @retval EOK the compressor is ready
+    @retval EINVAL invalid arguments
+    @retval EIO the compression context could not be reset
+
+==============================================================================*/
+int COMPRESS_StartFd( Compressor *pCompressor, int fd )
+{
+    int result = EINVAL;
+
+    if ( ( pCompressor != NULL ) && ( fd != -1 ) )
+    {
+        pCompressor->fd = fd;
+        pCompressor->pMem = NULL;
+        result = Start( pCompressor );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  COMPRESS_StartMem                                                         */
+/*!
+    Start compressing the data in a memory region
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+    @param[in]
+        pData
+            pointer to the input data
+
+    @param[in]
+        len
+            length of the input data
+
+    @retval EOK the compressor is ready
+    @retval EINVAL invalid arguments
+    @retval EIO the compression context could not be reset
+
+==============================================================================*/
+int COMPRESS_StartMem( Compressor *pCompressor,
+                       const char *pData,
+                       uint64_t len )
+{
+    int result = EINVAL;
+
+    if ( ( pCompressor != NULL ) && ( ( pData != NULL ) || ( len == 0 ) ) )
+    {
+        pCompressor->fd = -1;
+        pCompressor->pMem = pData;
+        pCompressor->memLen = len;
+        pCompressor->memOffset = 0;
+        result = Start( pCompressor );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  COMPRESS_Read                                                             */
+/*!
+    Read compressed output
+
+    The COMPRESS_Read function compresses more of the input as required
+    and copies up to size bytes of compressed output into the output
+    buffer.  Fewer than size bytes are returned only when the end of the
+    compressed stream has been reached.
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+    @param[in]
+        pOut
+            pointer to the output buffer
+
+    @param[in]
+        size
+            size of the output buffer
+
+    @param[out]
+        pLen
+            pointer to a location to store the number of bytes returned
+
+    @retval EOK compressed output was returned
+    @retval EINVAL invalid arguments
+    @retval EIO a compression error occurred
+    @retval other error reading the input
+
+==============================================================================*/
+int COMPRESS_Read( Compressor *pCompressor,
+                   char *pOut,
+                   size_t size,
+                   size_t *pLen )
+{
+    int result = EINVAL;
+    size_t len = 0;
+    size_t n;
+
+    if ( ( pCompressor != NULL ) &&
+         ( pOut != NULL ) &&
+         ( pLen != NULL ) )
+    {
+        result = EOK;
+
+        while ( ( len < size ) && ( result == EOK ) )
+        {
+            n = pCompressor->pendingLen - pCompressor->pendingOffset;
+            if ( n > 0 )
+            {
+                if ( n > size - len )
+                {
+                    n = size - len;
+                }
+
+                memcpy( &pOut[len],
+                        &pCompressor->pPending[pCompressor->pendingOffset],
+                        n );
+                pCompressor->pendingOffset += n;
+                len += n;
+            }
+            else if ( pCompressor->finished == true )
+            {
+                break;
+            }
+            else
+            {
+                result = NextBlock( pCompressor );
+            }
+        }
+
+        *pLen = len;
+        STATS_Add( STATS_COMPRESS_OUT, len );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  COMPRESS_Bound                                                            */
+/*!
+    Get the maximum compressed size of an input
+
+    The COMPRESS_Bound function returns the maximum size of the complete
+    compressed stream for an input of the specified length.
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+    @param[in]
+        len
+            length of the input
+
+    @retval maximum compressed size
+
+==============================================================================*/
+size_t COMPRESS_Bound( Compressor *pCompressor, size_t len )
+{
+    size_t bound = len + COMPRESS_SLACK;
+
+    if ( pCompressor != NULL )
+    {
+        switch ( pCompressor->codec )
+        {
+#ifdef IOTSEND_WITH_ZLIB
+            case COMPRESS_GZIP:
+                bound = deflateBound( pCompressor->pContext, len ) +
+                        COMPRESS_SLACK;
+                break;
+#endif
+
+#ifdef IOTSEND_WITH_ZSTD
+            case COMPRESS_ZSTD:
+                bound = ZSTD_compressBound( len ) + COMPRESS_SLACK;
+                break;
+#endif
+
+#ifdef IOTSEND_WITH_LZ4
+            case COMPRESS_LZ4:
+                bound = LZ4F_compressBound( len, NULL ) + COMPRESS_SLACK;
+                break;
+#endif
+
+            default:
+                break;
+        }
+    }
+
+    return bound;
+}
+
+/*============================================================================*/
+/*  COMPRESS_Free                                                             */
+/*!
+    Release the resources used by a compressor
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+==============================================================================*/
+void COMPRESS_Free( Compressor *pCompressor )
+{
+    if ( pCompressor != NULL )
+    {
+        if ( pCompressor->pContext != NULL )
+        {
+            switch ( pCompressor->codec )
+            {
+#ifdef IOTSEND_WITH_ZLIB
+                case COMPRESS_GZIP:
+                    deflateEnd( pCompressor->pContext );
+                    free( pCompressor->pContext );
+                    break;
+#endif
+
+#ifdef IOTSEND_WITH_ZSTD
+                case COMPRESS_ZSTD:
+                    ZSTD_freeCCtx( pCompressor->pContext );
+                    ZSTD_freeCDict( pCompressor->pDictionary );
+                    pCompressor->pDictionary = NULL;
+                    break;
+#endif
+
+#ifdef IOTSEND_WITH_LZ4
+                case COMPRESS_LZ4:
+                    LZ4F_freeCompressionContext( pCompressor->pContext );
+                    break;
+#endif
+
+                default:
+                    break;
+            }
+
+            pCompressor->pContext = NULL;
+        }
+
+        free( pCompressor->pIn );
+        pCompressor->pIn = NULL;
+
+        free( pCompressor->pPending );
+        pCompressor->pPending = NULL;
+        pCompressor->pendingSize = 0;
+    }
+}
+
+/*============================================================================*/
+/*  COMPRESS_ParseCodec                                                       */
+/*!
+    Convert a codec name to a compression codec
+
+    @param[in]
+        name
+            codec name: gzip, zstd, or lz4
+
+    @param[out]
+        pCodec
+            pointer to a location to store the codec
+
+    @retval EOK the codec name was recognized
+    @retval ENOTSUP unknown codec name
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int COMPRESS_ParseCodec( const char *name, CompressCodec *pCodec )
+{
+    int result = EINVAL;
+    size_t i;
+
+    if ( ( name != NULL ) && ( pCodec != NULL ) )
+    {
+        result = ENOTSUP;
+
+        for ( i = 0; i < sizeof( codecNames ) / sizeof( codecNames[0] ); i++ )
+        {
+            if ( strcmp( codecNames[i].name, name ) == 0 )
+            {
+                *pCodec = codecNames[i].codec;
+                result = EOK;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  COMPRESS_Encoding                                                         */
+/*!
+    Get the content-encoding header value for a codec
+
+    @param[in]
+        codec
+            compression codec
+
+    @retval content encoding name
+    @retval NULL the codec does not compress
+
+==============================================================================*/
+const char *COMPRESS_Encoding( CompressCodec codec )
+{
+    const char *name = NULL;
+    size_t i;
+
+    for ( i = 0; i < sizeof( codecNames ) / sizeof( codecNames[0] ); i++ )
+    {
+        if ( codecNames[i].codec == codec )
+        {
+            name = codecNames[i].name;
+            break;
+        }
+    }
+
+    return name;
+}
+
+/*============================================================================*/
+/*  COMPRESS_TrainDictionary                                                  */
+/*!
+    Train a zstd dictionary from a sample corpus
+
+    The COMPRESS_TrainDictionary function reads the sample files, splits
+    each of them into newline delimited samples, and trains a zstd
+    dictionary which is written to the dictionary file.  A file with no
+    newlines is used as a single sample.
+
+    @param[in]
+        dictName
+            name of the dictionary file to create
+
+    @param[in]
+        sampleNames
+            array of sample file names
+
+    @param[in]
+        count
+            number of sample files
+
+    @param[in]
+        dictSize
+            maximum size of the dictionary
+
+    @retval EOK the dictionary was created
+    @retval ENOTSUP zstd is not supported by this build
+    @retval ENOMEM memory allocation failed
+    @retval ENODATA there are too few samples to train a dictionary
+    @retval EINVAL invalid arguments
+    @retval other error reading the samples or writing the dictionary
+
+==============================================================================*/
+int COMPRESS_TrainDictionary( const char *dictName,
+                              char **sampleNames,
+                              size_t count,
+                              size_t dictSize )
+{
+    int result = EINVAL;
+#ifdef IOTSEND_WITH_ZSTD
+    char *pSamples = NULL;
+    size_t len = 0;
+    size_t size = 0;
+    size_t *pSizes = NULL;
+    size_t nSamples = 0;
+    size_t maxSamples = 0;
+    size_t *p;
+    size_t start;
+    size_t end;
+    size_t i;
+    size_t j;
+    char *pDict = NULL;
+    size_t rc;
+#endif
+
+    if ( ( dictName != NULL ) &&
+         ( sampleNames != NULL ) &&
+         ( count > 0 ) &&
+         ( dictSize > 0 ) )
+    {
+        result = ENOTSUP;
+
+#ifdef IOTSEND_WITH_ZSTD
+        result = EOK;
+
+        for ( i = 0; ( i < count ) && ( result == EOK ); i++ )
+        {
+            start = len;
+            result = AppendFile( sampleNames[i], &pSamples, &len, &size );
+
+            /* each line of the sample file is a sample.  Records are
+               sent without their delimiter so the newlines are removed
+               as the samples are packed together */
+            end = start;
+            for ( j = start; ( j < len ) && ( result == EOK ); j++ )
+            {
+                if ( pSamples[j] != '\n' )
+                {
+                    pSamples[end++] = pSamples[j];
+                }
+
+                if ( ( ( pSamples[j] == '\n' ) || ( j + 1 == len ) ) &&
+                     ( end > start ) )
+                {
+                    if ( nSamples == maxSamples )
+                    {
+                        maxSamples = ( maxSamples > 0 ) ? maxSamples * 2
+                                                        : 1024;
+                        p = realloc( pSizes, maxSamples * sizeof( size_t ) );
+                        if ( p != NULL )
+                        {
+                            pSizes = p;
+                        }
+                        else
+                        {
+                            result = ENOMEM;
+                        }
+                    }
+
+                    if ( result == EOK )
+                    {
+                        pSizes[nSamples++] = end - start;
+                        start = end;
+                    }
+                }
+            }
+
+            len = end;
+        }
+
+        if ( ( result == EOK ) && ( nSamples == 0 ) )
+        {
+            result = ENODATA;
+        }
+
+        if ( result == EOK )
+        {
+            pDict = malloc( dictSize );
+            if ( pDict == NULL )
+            {
+                result = ENOMEM;
+            }
+        }
+
+        if ( result == EOK )
+        {
+            rc = ZDICT_trainFromBuffer( pDict,
+                                        dictSize,
+                                        pSamples,
+                                        pSizes,
+                                        (unsigned)nSamples );
+            if ( ZDICT_isError( rc ) )
+            {
+                fprintf( stderr,
+                         "Cannot train dictionary: %s\n",
+                         ZDICT_getErrorName( rc ) );
+                result = ENODATA;
+            }
+            else
+            {
+                result = WriteFile( dictName, pDict, rc );
+            }
+        }
+
+        free( pDict );
+        free( pSizes );
+        free( pSamples );
+#endif
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Start                                                                     */
+/*!
+    Reset the compressor to start a new stream
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+    @retval EOK the compressor was reset
+    @retval EIO the compression context could not be reset
+
+==============================================================================*/
+static int Start( Compressor *pCompressor )
+{
+    int result = EOK;
+#ifdef IOTSEND_WITH_LZ4
+    size_t rc;
+#endif
+
+    pCompressor->pendingLen = 0;
+    pCompressor->pendingOffset = 0;
+    pCompressor->finished = false;
+
+    switch ( pCompressor->codec )
+    {
+#ifdef IOTSEND_WITH_ZLIB
+        case COMPRESS_GZIP:
+            if ( deflateReset( pCompressor->pContext ) != Z_OK )
+            {
+                result = EIO;
+            }
+            break;
+#endif
+
+#ifdef IOTSEND_WITH_ZSTD
+        case COMPRESS_ZSTD:
+            if ( ZSTD_isError( ZSTD_CCtx_reset( pCompressor->pContext,
+                                                ZSTD_reset_session_only ) ) )
+            {
+                result = EIO;
+            }
+            break;
+#endif
+
+#ifdef IOTSEND_WITH_LZ4
+        case COMPRESS_LZ4:
+            /* the frame header is the first pending output */
+            rc = LZ4F_compressBegin( pCompressor->pContext,
+                                     pCompressor->pPending,
+                                     pCompressor->pendingSize,
+                                     NULL );
+            if ( LZ4F_isError( rc ) )
+            {
+                result = EIO;
+            }
+            else
+            {
+                pCompressor->pendingLen = rc;
+            }
+            break;
+#endif
+
+        default:
+            result = ENOTSUP;
+            break;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  NextBlock                                                                 */
+/*!
+    Compress the next block of the input
+
+    The NextBlock function gets the next block of input from the input
+    file descriptor or memory region and compresses it into the pending
+    output buffer.  The stream is finished when the input is exhausted.
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+    @retval EOK the block was compressed
+    @retval EIO a compression error occurred
+    @retval other error reading the input
+
+==============================================================================*/
+static int NextBlock( Compressor *pCompressor )
+{
+    int result = EOK;
+    const char *pIn = NULL;
+    size_t len = 0;
+    ssize_t rc;
+
+    if ( pCompressor->pMem != NULL )
+    {
+        pIn = &pCompressor->pMem[pCompressor->memOffset];
+        len = pCompressor->memLen - pCompressor->memOffset;
+        if ( len > COMPRESS_BLOCK_SIZE )
+        {
+            len = COMPRESS_BLOCK_SIZE;
+        }
+
+        pCompressor->memOffset += len;
+    }
+    else if ( pCompressor->fd != -1 )
+    {
+        pIn = pCompressor->pIn;
+        while ( len < COMPRESS_BLOCK_SIZE )
+        {
+            rc = read( pCompressor->fd,
+                       &pCompressor->pIn[len],
+                       COMPRESS_BLOCK_SIZE - len );
+            if ( rc > 0 )
+            {
+                len += rc;
+            }
+            else if ( rc == 0 )
+            {
+                break;
+            }
+            else if ( errno != EINTR )
+            {
+                result = errno;
+                break;
+            }
+        }
+
+        STATS_Add( STATS_BYTES_READ, len );
+    }
+
+    if ( result == EOK )
+    {
+        STATS_Add( STATS_COMPRESS_IN, len );
+
+        /* a short block means the end of the input has been reached */
+        result = CompressBlock( pCompressor,
+                                pIn,
+                                len,
+                                ( len < COMPRESS_BLOCK_SIZE ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CompressBlock                                                             */
+/*!
+    Compress a block of input into the pending output buffer
+
+    The pending output buffer is sized so the compressed output of a
+    full input block, plus any output held back by the codec from the
+    previous block and the stream trailer, always fits.
+
+    @param[in]
+        pCompressor
+            pointer to the compressor
+
+    @param[in]
+        pIn
+            pointer to the input block
+
+    @param[in]
+        len
+            length of the input block
+
+    @param[in]
+        last
+            this is the last block of the input
+
+    @retval EOK the block was compressed
+    @retval EIO a compression error occurred
+
+==============================================================================*/
+static int CompressBlock( Compressor *pCompressor,
+                          const char *pIn,
+                          size_t len,
+                          bool last )
+{
+    int result = EIO;
+    size_t outLen = 0;
+#ifdef IOTSEND_WITH_ZLIB
+    z_stream *pStream;
+    int rc;
+#endif
+#ifdef IOTSEND_WITH_ZSTD
+    ZSTD_inBuffer in;
+    ZSTD_outBuffer out;
+    size_t remaining;
+#endif
+#ifdef IOTSEND_WITH_LZ4
+    size_t n;
+#endif
+
+    switch ( pCompressor->codec )
+    {
+#ifdef IOTSEND_WITH_ZLIB
+        case COMPRESS_GZIP:
+            pStream = pCompressor->pContext;
+            pStream->next_in = (Bytef *)pIn;
+            pStream->avail_in = len;
+            pStream->next_out = (Bytef *)pCompressor->pPending;
+            pStream->avail_out = pCompressor->pendingSize;
+
+            rc = deflate( pStream, last ? Z_FINISH : Z_NO_FLUSH );
+            if ( ( pStream->avail_in == 0 ) &&
+                 ( ( rc == Z_STREAM_END ) ||
+                   ( ( rc == Z_OK ) && ( last == false ) ) ) )
+            {
+                outLen = pCompressor->pendingSize - pStream->avail_out;
+                result = EOK;
+            }
+            break;
+#endif
+
+#ifdef IOTSEND_WITH_ZSTD
+        case COMPRESS_ZSTD:
+            in.src = pIn;
+            in.size = len;
+            in.pos = 0;
+            out.dst = pCompressor->pPending;
+            out.size = pCompressor->pendingSize;
+            out.pos = 0;
+
+            do
+            {
+                remaining = ZSTD_compressStream2( pCompressor->pContext,
+                                                  &out,
+                                                  &in,
+                                                  last ? ZSTD_e_end
+                                                       : ZSTD_e_continue );
+            } while ( ( ZSTD_isError( remaining ) == 0 ) &&
+                      ( ( last ? remaining != 0 : in.pos < in.size ) ) &&
+                      ( out.pos < out.size ) );
+
+            if ( ( ZSTD_isError( remaining ) == 0 ) &&
+                 ( in.pos == in.size ) &&
+                 ( ( last == false ) || ( remaining == 0 ) ) )
+            {
+                outLen = out.pos;
+                result = EOK;
+            }
+            break;
+#endif
+
+#ifdef IOTSEND_WITH_LZ4
+        case COMPRESS_LZ4:
+            /* the frame header may still be pending */
+            outLen = pCompressor->pendingLen - pCompressor->pendingOffset;
+            memmove( pCompressor->pPending,
+                     &pCompressor->pPending[pCompressor->pendingOffset],
+                     outLen );
+
+            n = 0;
+            if ( len > 0 )
+            {
+                n = LZ4F_compressUpdate( pCompressor->pContext,
+                                         &pCompressor->pPending[outLen],
+                                         pCompressor->pendingSize - outLen,
+                                         pIn,
+                                         len,
+                                         NULL );
+            }
+
+            if ( ( LZ4F_isError( n ) == 0 ) && ( last == true ) )
+            {
+                outLen += n;
+                n = LZ4F_compressEnd( pCompressor->pContext,
+                                      &pCompressor->pPending[outLen],
+                                      pCompressor->pendingSize - outLen,
+                                      NULL );
+            }
+
+            if ( LZ4F_isError( n ) == 0 )
+            {
+                outLen += n;
+                result = EOK;
+            }
+            break;
+#endif
+
+        default:
+            (void)pIn;
+            (void)len;
+            (void)last;
+            break;
+    }
+
+    if ( result == EOK )
+    {
+        pCompressor->pendingLen = outLen;
+        pCompressor->pendingOffset = 0;
+        pCompressor->finished = last;
+        pCompressor->bytesIn += len;
+        pCompressor->bytesOut += outLen;
+    }
+
+    return result;
+}
+
+#ifdef IOTSEND_WITH_ZSTD
+/*============================================================================*/
+/*  AppendFile                                                                */
+/*!
+    Append the content of a file to a buffer
+
+    The AppendFile function reads a file to its end and appends its
+    content to a buffer, growing the buffer as required.
+
+    @param[in]
+        fileName
+            name of the file to read
+
+    @param[in,out]
+        ppBuf
+            pointer to the buffer pointer
+
+    @param[in,out]
+        pLen
+            pointer to the number of bytes in the buffer
+
+    @param[in,out]
+        pSize
+            pointer to the size of the buffer
+
+    @retval EOK the file was read
+    @retval ENOMEM memory allocation failed
+    @retval other error opening or reading the file
+
+==============================================================================*/
+static int AppendFile( const char *fileName,
+                       char **ppBuf,
+                       size_t *pLen,
+                       size_t *pSize )
+{
+    int result = EOK;
+    int fd;
+    ssize_t rc;
+    char *p;
+
+    fd = open( fileName, O_RDONLY );
+    if ( fd == -1 )
+    {
+        result = errno;
+    }
+
+    while ( result == EOK )
+    {
+        if ( *pLen == *pSize )
+        {
+            p = realloc( *ppBuf, ( *pSize > 0 ) ? *pSize * 2
+                                                : COMPRESS_READ_SIZE );
+            if ( p != NULL )
+            {
+                *ppBuf = p;
+                *pSize = ( *pSize > 0 ) ? *pSize * 2 : COMPRESS_READ_SIZE;
+            }
+            else
+            {
+                result = ENOMEM;
+                break;
+            }
+        }
+
+        rc = read( fd, &(*ppBuf)[*pLen], *pSize - *pLen );
+        if ( rc > 0 )
+        {
+            *pLen += rc;
+        }
+        else if ( rc == 0 )
+        {
+            break;
+        }
+        else if ( errno != EINTR )
+        {
+            result = errno;
+        }
+    }
+
+    if ( fd != -1 )
+    {
+        close( fd );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WriteFile                                                                 */
+/*!
+    Write a buffer to a new file
+
+    @param[in]
+        fileName
+            name of the file to create or replace
+
+    @param[in]
+        pData
+            pointer to the data to write
+
+    @param[in]
+        len
+            length of the data
+
+    @retval EOK the file was written
+    @retval other error creating or writing the file
+
+==============================================================================*/
+static int WriteFile( const char *fileName, const char *pData, size_t len )
+{
+    int result = EOK;
+    int fd;
+    size_t n = 0;
+    ssize_t rc;
+
+    fd = open( fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if ( fd == -1 )
+    {
+        result = errno;
+    }
+
+    while ( ( result == EOK ) && ( n < len ) )
+    {
+        rc = write( fd, &pData[n], len - n );
+        if ( rc > 0 )
+        {
+            n += rc;
+        }
+        else if ( ( rc == -1 ) && ( errno != EINTR ) )
+        {
+            result = errno;
+        }
+    }
+
+    if ( ( fd != -1 ) && ( close( fd ) != 0 ) && ( result == EOK ) )
+    {
+        result = errno;
+    }
+
+    return result;
+}
+#endif
+
+/*! @}
+ * end of compress group */
@@ -0,0 +1,518 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup dedup dedup
+ * @brief Duplicate payload filter
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file dedup.c
+
+    Duplicate Filter
+
+    The dedup module suppresses messages whose payload has not changed
+    since the last message of the same stream, so a sensor or status
+    file which is sent periodically only costs a message when its value
+    changes.  A stream is identified by the value of a message header,
+    or all messages belong to one stream if no key header is given.
+
+    The last payload of each stream is remembered as a 64-bit XXH64
+    hash and its length, so a payload is checked in a single pass at
+    several gigabytes per second and no copy of it is kept.  The
+    streams are held in a fixed table indexed by the hash of the key
+    value.  Two streams which share a slot replace each other, which
+    can only cause an unchanged payload to be sent again, never a
+    changed one to be dropped.
+
+    An unchanged payload is still sent once the heartbeat interval has
+    elapsed since the stream was last sent, so the receiver can tell a
+    quiet stream from a dead one.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <iotclient/iotclient.h>
+#include "headers.h"
+#include "dedup.h"
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of nanoseconds in a second */
+#define NSEC_PER_SEC    ( 1000000000ull )
+
+/*! XXH64 primes */
+#define PRIME64_1       ( 0x9E3779B185EBCA87ull )
+#define PRIME64_2       ( 0xC2B2AE3D27D4EB4Full )
+#define PRIME64_3       ( 0x165667B19E3779F9ull )
+#define PRIME64_4       ( 0x85EBCA77C2B2AE63ull )
+#define PRIME64_5       ( 0x27D4EB2F165667C5ull )
+
+/*! rotate a 64-bit value left */
+#define ROTL64( x, r )  ( ( (x) << (r) ) | ( (x) >> ( 64 - (r) ) ) )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static DedupEntry *Lookup( Dedup *pDedup,
+                           const char *pHeaders,
+                           uint64_t *pKey );
+static uint64_t Hash( const void *pData, size_t len, uint64_t seed );
+static uint64_t Round( uint64_t acc, uint64_t input );
+static uint64_t Merge( uint64_t acc, uint64_t val );
+static uint64_t Read64( const uint8_t *p );
+static uint32_t Read32( const uint8_t *p );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  DEDUP_Init                                                                */
+/*!
+    Initialize a duplicate filter
+
+    The DEDUP_Init function initializes a duplicate filter which
+    identifies the stream of a message by the value of the key header.
+
+    @param[in]
+        pDedup
+            pointer to the duplicate filter to initialize
+
+    @param[in]
+        key
+            header key whose value identifies the stream of a message,
+            or NULL if all messages belong to one stream
+
+    @param[in]
+        heartbeat
+            number of seconds after which an unchanged payload is sent
+            anyway (0 = never)
+
+    @retval EOK the duplicate filter was initialized
+    @retval EINVAL invalid arguments
+    @retval ENOMEM memory allocation failed
+
+==============================================================================*/
+int DEDUP_Init( Dedup *pDedup, const char *key, unsigned int heartbeat )
+{
+    int result = EINVAL;
+
+    if ( pDedup != NULL )
+    {
+        memset( pDedup, 0, sizeof( Dedup ) );
+
+        pDedup->heartbeat = (uint64_t)heartbeat * NSEC_PER_SEC;
+        pDedup->pEntries = calloc( DEDUP_TABLE_SIZE, sizeof( DedupEntry ) );
+        if ( key != NULL )
+        {
+            pDedup->key = strdup( key );
+        }
+
+        if ( ( pDedup->pEntries == NULL ) ||
+             ( ( key != NULL ) && ( pDedup->key == NULL ) ) )
+        {
+            DEDUP_Free( pDedup );
+            result = ENOMEM;
+        }
+        else
+        {
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DEDUP_Check                                                               */
+/*!
+    Check whether a payload repeats the last payload of its stream
+
+    The DEDUP_Check function compares a payload with the last payload
+    sent on its stream.  A payload which differs, or which is unchanged
+    but is due for a heartbeat, is recorded as the last payload of the
+    stream and should be sent.
+
+    @param[in]
+        pDedup
+            pointer to the duplicate filter
+
+    @param[in]
+        pHeaders
+            headers of the message
+
+    @param[in]
+        pPayload
+            pointer to the payload data
+
+    @param[in]
+        len
+            length of the payload data
+
+    @retval EOK the payload should be sent
+    @retval EALREADY the payload is unchanged and should not be sent
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int DEDUP_Check( Dedup *pDedup,
+                 const char *pHeaders,
+                 const char *pPayload,
+                 size_t len )
+{
+    int result = EINVAL;
+    DedupEntry *pEntry;
+    uint64_t key;
+    uint64_t hash;
+    uint64_t now;
+
+    if ( ( pDedup != NULL ) &&
+         ( pDedup->pEntries != NULL ) &&
+         ( pPayload != NULL ) )
+    {
+        pEntry = Lookup( pDedup, pHeaders, &key );
+        hash = Hash( pPayload, len, 0 );
+        now = UTIL_NowNs();
+
+        if ( ( pEntry->used == true ) &&
+             ( pEntry->key == key ) &&
+             ( pEntry->hash == hash ) &&
+             ( pEntry->len == len ) &&
+             ( ( pDedup->heartbeat == 0 ) ||
+               ( now - pEntry->sent < pDedup->heartbeat ) ) )
+        {
+            result = EALREADY;
+        }
+        else
+        {
+            pEntry->key = key;
+            pEntry->hash = hash;
+            pEntry->len = len;
+            pEntry->sent = now;
+            pEntry->used = true;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DEDUP_Forget                                                              */
+/*!
+    Forget the last payload of a stream
+
+    The DEDUP_Forget function forgets the last payload recorded for the
+    stream of a message, so the next payload of the stream is sent even
+    if it is unchanged.  It is called when a message which passed the
+    check could not be sent.
+
+    @param[in]
+        pDedup
+            pointer to the duplicate filter
+
+    @param[in]
+        pHeaders
+            headers of the message
+
+==============================================================================*/
+void DEDUP_Forget( Dedup *pDedup, const char *pHeaders )
+{
+    DedupEntry *pEntry;
+    uint64_t key;
+
+    if ( ( pDedup != NULL ) && ( pDedup->pEntries != NULL ) )
+    {
+        pEntry = Lookup( pDedup, pHeaders, &key );
+        if ( pEntry->key == key )
+        {
+            pEntry->used = false;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  DEDUP_Free                                                                */
+/*!
+    Release the resources used by a duplicate filter
+
+    @param[in]
+        pDedup
+            pointer to the duplicate filter
+
+==============================================================================*/
+void DEDUP_Free( Dedup *pDedup )
+{
+    if ( pDedup != NULL )
+    {
+        free( pDedup->pEntries );
+        pDedup->pEntries = NULL;
+
+        free( pDedup->key );
+        pDedup->key = NULL;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Lookup                                                                    */
+/*!
+    Find the table entry of the stream of a message
+
+    The Lookup function hashes the value of the key header of a message
+    and returns the table entry for it.  A message without the key
+    header belongs to the same stream as other messages without it.
+
+    @param[in]
+        pDedup
+            pointer to the duplicate filter
+
+    @param[in]
+        pHeaders
+            headers of the message, or NULL
+
+    @param[out]
+        pKey
+            pointer to a location to store the hash of the key value
+
+    @retval pointer to the table entry of the stream
+
+==============================================================================*/
+static DedupEntry *Lookup( Dedup *pDedup, const char *pHeaders, uint64_t *pKey )
+{
+    const char *pValue = NULL;
+    size_t len = 0;
+
+    if ( ( pDedup->key != NULL ) && ( pHeaders != NULL ) )
+    {
+        pValue = HEADERS_Lookup( pHeaders, pDedup->key, &len );
+    }
+
+    *pKey = ( pValue != NULL ) ? Hash( pValue, len, 0 ) : 0;
+
+    return &pDedup->pEntries[*pKey & ( DEDUP_TABLE_SIZE - 1 )];
+}
+
+/*============================================================================*/
+/*  Hash                                                                      */
+/*!
+    Calculate the XXH64 hash of a block of data
+
+    @param[in]
+        pData
+            pointer to the data to hash
+
+    @param[in]
+        len
+            length of the data
+
+    @param[in]
+        seed
+            hash seed
+
+    @retval the 64-bit hash of the data
+
+==============================================================================*/
+static uint64_t Hash( const void *pData, size_t len, uint64_t seed )
+{
+    const uint8_t *p = pData;
+    const uint8_t *pEnd = p + len;
+    uint64_t v1;
+    uint64_t v2;
+    uint64_t v3;
+    uint64_t v4;
+    uint64_t h;
+
+    if ( len >= 32 )
+    {
+        v1 = seed + PRIME64_1 + PRIME64_2;
+        v2 = seed + PRIME64_2;
+        v3 = seed;
+        v4 = seed - PRIME64_1;
+
+        /* four independent lanes of 8 bytes per 32 byte stripe */
+        while ( pEnd - p >= 32 )
+        {
+            v1 = Round( v1, Read64( p ) );
+            v2 = Round( v2, Read64( p + 8 ) );
+            v3 = Round( v3, Read64( p + 16 ) );
+            v4 = Round( v4, Read64( p + 24 ) );
+            p += 32;
+        }
+
+        h = ROTL64( v1, 1 ) + ROTL64( v2, 7 ) +
+            ROTL64( v3, 12 ) + ROTL64( v4, 18 );
+        h = Merge( h, v1 );
+        h = Merge( h, v2 );
+        h = Merge( h, v3 );
+        h = Merge( h, v4 );
+    }
+    else
+    {
+        h = seed + PRIME64_5;
+    }
+
+    h += (uint64_t)len;
+
+    while ( pEnd - p >= 8 )
+    {
+        h ^= Round( 0, Read64( p ) );
+        h = ROTL64( h, 27 ) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+
+    if ( pEnd - p >= 4 )
+    {
+        h ^= (uint64_t)Read32( p ) * PRIME64_1;
+        h = ROTL64( h, 23 ) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+
+    while ( p < pEnd )
+    {
+        h ^= (uint64_t)*p * PRIME64_5;
+        h = ROTL64( h, 11 ) * PRIME64_1;
+        p++;
+    }
+
+    /* avalanche */
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+/*============================================================================*/
+/*  Round                                                                     */
+/*!
+    Mix 8 bytes of input into an XXH64 lane
+
+    @param[in]
+        acc
+            lane accumulator
+
+    @param[in]
+        input
+            8 bytes of input
+
+    @retval the updated lane accumulator
+
+==============================================================================*/
+static uint64_t Round( uint64_t acc, uint64_t input )
+{
+    acc += input * PRIME64_2;
+    acc = ROTL64( acc, 31 );
+
+    return acc * PRIME64_1;
+}
+
+/*============================================================================*/
+/*  Merge                                                                     */
+/*!
+    Merge an XXH64 lane into the hash
+
+    @param[in]
+        acc
+            hash accumulator
+
+    @param[in]
+        val
+            lane accumulator
+
+    @retval the updated hash accumulator
+
+==============================================================================*/
+static uint64_t Merge( uint64_t acc, uint64_t val )
+{
+    acc ^= Round( 0, val );
+
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+/*============================================================================*/
+/*  Read64                                                                    */
+/*!
+    Read an unaligned 64-bit value
+
+    @param[in]
+        p
+            pointer to the value
+
+    @retval the value
+
+==============================================================================*/
+static uint64_t Read64( const uint8_t *p )
+{
+    uint64_t val;
+
+    memcpy( &val, p, sizeof( val ) );
+
+    return val;
+}
+
+/*============================================================================*/
+/*  Read32                                                                    */
+/*!
+    Read an unaligned 32-bit value
+
+    @param[in]
+        p
+            pointer to the value
+
+    @retval the value
+
+==============================================================================*/
+static uint32_t Read32( const uint8_t *p )
+{
+    uint32_t val;
+
+    memcpy( &val, p, sizeof( val ) );
+
+    return val;
+}
+
+/*! @}
+ * end of dedup group */
@@ -0,0 +1,337 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup frame frame
+ * @brief Length prefixed record framing
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file frame.c
+
+    Record Framing
+
+    The frame module defines the length prefixed framing read by
+    iotsend in framed mode, and is also built as a small static library
+    so producers can write frames without depending on the IOTClient
+    library.  Framing lets records carry any bytes, including newlines
+    and NULs, and lets the reader slice records out of its input buffer
+    without scanning them for a delimiter.
+
+    Each frame is an 8 byte header followed by an optional header block
+    and the payload:
+
+    offset  size  contents
+    0       1     magic (0xF5)
+    1       1     version (1)
+    2       2     header block length, big endian
+    4       4     payload length, big endian
+
+    The header block is a list of key:value pairs separated by newlines
+    or semicolons, which are added to the message headers of the frame.
+    The magic and version bytes let the reader detect a producer which
+    has lost synchronization with the stream.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "frame.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/* the producer library is built without the IOTClient library */
+#ifndef EOK
+#define EOK 0
+#endif
+
+/*! maximum payload length which can be encoded in a frame header */
+#define FRAME_MAX_LENGTH    ( 0xFFFFFFFFu )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int WriteAll( int fd, struct iovec *pIov, int count );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  FRAME_Encode                                                              */
+/*!
+    Encode a frame header
+
+    The FRAME_Encode function writes the frame header for a header
+    block and payload of the given lengths.
+
+    @param[out]
+        pFrame
+            pointer to a buffer of FRAME_HEADER_SIZE bytes to store the
+            frame header
+
+    @param[in]
+        headersLen
+            length of the header block (0 = no headers)
+
+    @param[in]
+        len
+            length of the payload
+
+    @retval EOK the frame header was encoded
+    @retval E2BIG the header block or the payload is too long
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int FRAME_Encode( uint8_t *pFrame, size_t headersLen, size_t len )
+{
+    int result = EINVAL;
+
+    if ( pFrame != NULL )
+    {
+        if ( ( headersLen > FRAME_MAX_HEADERS ) ||
+             ( len > FRAME_MAX_LENGTH ) )
+        {
+            result = E2BIG;
+        }
+        else
+        {
+            pFrame[0] = FRAME_MAGIC;
+            pFrame[1] = FRAME_VERSION;
+            pFrame[2] = (uint8_t)( headersLen >> 8 );
+            pFrame[3] = (uint8_t)headersLen;
+            pFrame[4] = (uint8_t)( len >> 24 );
+            pFrame[5] = (uint8_t)( len >> 16 );
+            pFrame[6] = (uint8_t)( len >> 8 );
+            pFrame[7] = (uint8_t)len;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FRAME_Decode                                                              */
+/*!
+    Decode a frame header
+
+    The FRAME_Decode function checks a frame header and gets the
+    lengths of the header block and payload which follow it.
+
+    @param[in]
+        pFrame
+            pointer to the FRAME_HEADER_SIZE bytes of the frame header
+
+    @param[out]
+        pHeadersLen
+            pointer to a location to store the header block length
+
+    @param[out]
+        pLen
+            pointer to a location to store the payload length
+
+    @retval EOK the frame header was decoded
+    @retval EBADMSG the data is not a frame header
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int FRAME_Decode( const uint8_t *pFrame, size_t *pHeadersLen, size_t *pLen )
+{
+    int result = EINVAL;
+    size_t headersLen;
+
+    if ( ( pFrame != NULL ) && ( pHeadersLen != NULL ) && ( pLen != NULL ) )
+    {
+        headersLen = ( (size_t)pFrame[2] << 8 ) | pFrame[3];
+
+        if ( ( pFrame[0] != FRAME_MAGIC ) ||
+             ( pFrame[1] != FRAME_VERSION ) ||
+             ( headersLen > FRAME_MAX_HEADERS ) )
+        {
+            result = EBADMSG;
+        }
+        else
+        {
+            *pHeadersLen = headersLen;
+            *pLen = ( (size_t)pFrame[4] << 24 ) |
+                    ( (size_t)pFrame[5] << 16 ) |
+                    ( (size_t)pFrame[6] << 8 ) |
+                    (size_t)pFrame[7];
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FRAME_Write                                                               */
+/*!
+    Write a frame
+
+    The FRAME_Write function writes a frame holding a payload and an
+    optional header block to a file descriptor, such as a pipe to the
+    standard input of iotsend.  The frame header, headers and payload
+    are written with a single writev() call, so a frame smaller than
+    PIPE_BUF is written atomically to a pipe shared by several
+    producers.
+
+    @param[in]
+        fd
+            output file descriptor
+
+    @param[in]
+        pHeaders
+            NUL terminated header block of key:value pairs separated by
+            newlines or semicolons, or NULL for no headers
+
+    @param[in]
+        pPayload
+            pointer to the payload data
+
+    @param[in]
+        len
+            length of the payload data
+
+    @retval EOK the frame was written
+    @retval E2BIG the header block or the payload is too long
+    @retval EINVAL invalid arguments
+    @retval other error from writev()
+
+==============================================================================*/
+int FRAME_Write( int fd,
+                 const char *pHeaders,
+                 const void *pPayload,
+                 size_t len )
+{
+    int result = EINVAL;
+    uint8_t frame[FRAME_HEADER_SIZE];
+    struct iovec iov[3];
+    size_t headersLen = 0;
+
+    if ( ( fd != -1 ) && ( ( pPayload != NULL ) || ( len == 0 ) ) )
+    {
+        if ( pHeaders != NULL )
+        {
+            headersLen = strlen( pHeaders );
+        }
+
+        result = FRAME_Encode( frame, headersLen, len );
+        if ( result == EOK )
+        {
+            iov[0].iov_base = frame;
+            iov[0].iov_len = sizeof( frame );
+            iov[1].iov_base = (void *)pHeaders;
+            iov[1].iov_len = headersLen;
+            iov[2].iov_base = (void *)pPayload;
+            iov[2].iov_len = len;
+
+            result = WriteAll( fd, iov, 3 );
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  WriteAll                                                                  */
+/*!
+    Write a list of buffers completely
+
+    The WriteAll function writes a list of buffers, continuing after
+    a partial write or an interrupted call until every byte has been
+    written.
+
+    @param[in]
+        fd
+            output file descriptor
+
+    @param[in,out]
+        pIov
+            list of buffers to write, which is updated as it is written
+
+    @param[in]
+        count
+            number of buffers in the list
+
+    @retval EOK the buffers were written
+    @retval other error from writev()
+
+==============================================================================*/
+static int WriteAll( int fd, struct iovec *pIov, int count )
+{
+    int result = EOK;
+    ssize_t rc;
+    size_t n;
+
+    while ( ( count > 0 ) && ( result == EOK ) )
+    {
+        rc = writev( fd, pIov, count );
+        if ( rc >= 0 )
+        {
+            /* skip the buffers which have been written */
+            n = (size_t)rc;
+            while ( ( count > 0 ) && ( n >= pIov->iov_len ) )
+            {
+                n -= pIov->iov_len;
+                pIov++;
+                count--;
+            }
+
+            if ( count > 0 )
+            {
+                pIov->iov_base = (uint8_t *)pIov->iov_base + n;
+                pIov->iov_len -= n;
+            }
+        }
+        else if ( errno != EINTR )
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of frame group */
@@ -0,0 +1,754 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup headers headers
+ * @brief Compiled message header blocks
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file headers.c
+
+    Compiled Message Headers
+
+    The headers module parses a header specification such as
+    "key1:value1;key2:value2" once into a compiled header block which
+    can be passed unchanged to the IOTClient library for every message.
+
+    Headers may be separated by semicolons or newlines.  Leading and
+    trailing white space is removed from keys and values, empty entries
+    are ignored, and if a key is specified more than once the last
+    value is used.  The compiled block is rendered as one key:value
+    pair per line followed by the blank line which terminates the
+    header section of a message.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <iotclient/iotclient.h>
+#include "headers.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void Trim( const char **ppStart, const char **ppEnd );
+static int Parse( const char *spec,
+                  size_t len,
+                  const char **pKeys,
+                  size_t *pKeyLens,
+                  const char **pValues,
+                  size_t *pValueLens,
+                  size_t *pCount );
+static int FindEntry( HeaderBlock *pBlock, const char *key, size_t len );
+static int Render( HeaderBlock *pBlock,
+                   const char **pKeys,
+                   size_t *pKeyLens,
+                   const char **pValues,
+                   size_t *pValueLens );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  HEADERS_Compile                                                           */
+/*!
+    Compile a header specification into a header block
+
+    The HEADERS_Compile function validates and de-duplicates the
+    headers in the header specification, and renders them into a
+    header block buffer which is allocated once.
+
+    @param[in]
+        pBlock
+            pointer to the header block to compile into
+
+    @param[in]
+        spec
+            semicolon or newline separated list of key:value pairs
+
+    @param[in]
+        len
+            length of the header specification
+
+    @retval EOK the header block was compiled
+    @retval EINVAL a header is malformed or invalid arguments
+    @retval E2BIG too many headers were specified
+    @retval ENOMEM memory allocation failed
+
+==============================================================================*/
+int HEADERS_Compile( HeaderBlock *pBlock, const char *spec, size_t len )
+{
+    int result = EINVAL;
+    const char *keys[HEADERS_MAX_COUNT];
+    const char *values[HEADERS_MAX_COUNT];
+    size_t keyLens[HEADERS_MAX_COUNT];
+    size_t valueLens[HEADERS_MAX_COUNT];
+    size_t count = 0;
+
+    if ( ( pBlock != NULL ) && ( spec != NULL ) )
+    {
+        memset( pBlock, 0, sizeof( HeaderBlock ) );
+
+        result = Parse( spec, len, keys, keyLens, values, valueLens, &count );
+        if ( result == EOK )
+        {
+            pBlock->count = count;
+            result = Render( pBlock, keys, keyLens, values, valueLens );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HEADERS_Merge                                                             */
+/*!
+    Merge headers into a rendered header block
+
+    The HEADERS_Merge function renders a header block into a caller
+    supplied buffer, consisting of the headers of a rendered header
+    block with the headers of a header specification added.  A header
+    in the specification replaces a header of the block with the same
+    key.  No memory is allocated.
+
+    @param[in]
+        pHeaders
+            rendered header block
+
+    @param[in]
+        spec
+            semicolon or newline separated list of key:value pairs
+
+    @param[in]
+        len
+            length of the header specification
+
+    @param[out]
+        pBuf
+            buffer to render the merged header block into
+
+    @param[in]
+        size
+            size of the buffer
+
+    @retval EOK the headers were merged
+    @retval EINVAL a header is malformed or invalid arguments
+    @retval E2BIG too many headers, or the buffer is too small
+
+==============================================================================*/
+int HEADERS_Merge( const char *pHeaders,
+                   const char *spec,
+                   size_t len,
+                   char *pBuf,
+                   size_t size )
+{
+    int result = EINVAL;
+    const char *keys[HEADERS_MAX_COUNT];
+    const char *values[HEADERS_MAX_COUNT];
+    size_t keyLens[HEADERS_MAX_COUNT];
+    size_t valueLens[HEADERS_MAX_COUNT];
+    size_t count = 0;
+    size_t n = 2;
+    size_t i;
+    char *p = pBuf;
+
+    if ( ( pHeaders != NULL ) && ( spec != NULL ) && ( pBuf != NULL ) )
+    {
+        result = Parse( pHeaders,
+                        strlen( pHeaders ),
+                        keys,
+                        keyLens,
+                        values,
+                        valueLens,
+                        &count );
+    }
+
+    if ( result == EOK )
+    {
+        result = Parse( spec, len, keys, keyLens, values, valueLens, &count );
+    }
+
+    if ( result == EOK )
+    {
+        for ( i = 0; i < count; i++ )
+        {
+            n += keyLens[i] + valueLens[i] + 2;
+        }
+
+        result = ( n <= size ) ? EOK : E2BIG;
+    }
+
+    if ( result == EOK )
+    {
+        for ( i = 0; i < count; i++ )
+        {
+            memcpy( p, keys[i], keyLens[i] );
+            p += keyLens[i];
+            *p++ = ':';
+            memcpy( p, values[i], valueLens[i] );
+            p += valueLens[i];
+            *p++ = '\n';
+        }
+
+        *p++ = '\n';
+        *p = '\0';
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HEADERS_SectionLength                                                     */
+/*!
+    Find the header section at the start of a message
+
+    The HEADERS_SectionLength function checks if a message starts with
+    a header section: one or more key:value lines terminated by a blank
+    line.  A key may only contain letters, digits, and the characters
+    '-', '_' and '.', so a payload such as a JSON object is not mistaken
+    for headers.
+
+    @param[in]
+        pData
+            pointer to the message
+
+    @param[in]
+        len
+            length of the message
+
+    @retval length of the header section including the blank line
+    @retval 0 the message does not start with a header section
+
+==============================================================================*/
+size_t HEADERS_SectionLength( const char *pData, size_t len )
+{
+    size_t section = 0;
+    size_t i = 0;
+    size_t lineStart = 0;
+    bool inKey = true;
+    bool valid = true;
+
+    while ( ( valid == true ) && ( section == 0 ) && ( i < len ) )
+    {
+        if ( pData[i] == '\n' )
+        {
+            if ( i == lineStart )
+            {
+                /* a blank line ends the header section */
+                section = ( i > 0 ) ? i + 1 : 0;
+                valid = ( i > 0 );
+            }
+            else
+            {
+                valid = ( inKey == false );
+            }
+
+            lineStart = i + 1;
+            inKey = true;
+        }
+        else if ( inKey == true )
+        {
+            if ( ( pData[i] == ':' ) && ( i > lineStart ) )
+            {
+                inKey = false;
+            }
+            else if ( !isalnum( (unsigned char)pData[i] ) &&
+                      ( pData[i] != '-' ) &&
+                      ( pData[i] != '_' ) &&
+                      ( pData[i] != '.' ) )
+            {
+                valid = false;
+            }
+        }
+
+        i++;
+    }
+
+    return section;
+}
+
+/*============================================================================*/
+/*  HEADERS_Get                                                               */
+/*!
+    Get the rendered header block
+
+    @param[in]
+        pBlock
+            pointer to the compiled header block
+
+    @retval pointer to the NUL terminated header block
+    @retval NULL the header block has not been compiled
+
+==============================================================================*/
+char *HEADERS_Get( HeaderBlock *pBlock )
+{
+    return ( pBlock != NULL ) ? pBlock->pBuf : NULL;
+}
+
+/*============================================================================*/
+/*  HEADERS_Find                                                              */
+/*!
+    Look up a header value by key
+
+    The HEADERS_Find function searches the compiled header block for
+    the specified key and returns a pointer to its value.  The value is
+    not NUL terminated.
+
+    @param[in]
+        pBlock
+            pointer to the compiled header block
+
+    @param[in]
+        key
+            NUL terminated header key
+
+    @param[out]
+        pLen
+            pointer to a location to store the length of the value
+
+    @retval pointer to the header value
+    @retval NULL the header was not found
+
+==============================================================================*/
+const char *HEADERS_Find( HeaderBlock *pBlock,
+                          const char *key,
+                          size_t *pLen )
+{
+    const char *pValue = NULL;
+    int i;
+
+    if ( ( pBlock != NULL ) &&
+         ( pBlock->pBuf != NULL ) &&
+         ( key != NULL ) &&
+         ( pLen != NULL ) )
+    {
+        i = FindEntry( pBlock, key, strlen( key ) );
+        if ( i >= 0 )
+        {
+            pValue = &pBlock->pBuf[pBlock->entries[i].valueOffset];
+            *pLen = pBlock->entries[i].valueLen;
+        }
+    }
+
+    return pValue;
+}
+
+/*============================================================================*/
+/*  HEADERS_Lookup                                                            */
+/*!
+    Look up a header value in a rendered header block
+
+    The HEADERS_Lookup function searches a rendered header block, such
+    as the output of a header template or the headers of a chunk, for
+    the specified key and returns a pointer to its value.  The value is
+    not NUL terminated.  The search stops at the blank line which
+    terminates the header section.
+
+    @param[in]
+        pHeaders
+            NUL terminated rendered header block
+
+    @param[in]
+        key
+            NUL terminated header key
+
+    @param[out]
+        pLen
+            pointer to a location to store the length of the value
+
+    @retval pointer to the header value
+    @retval NULL the header was not found
+
+==============================================================================*/
+const char *HEADERS_Lookup( const char *pHeaders,
+                            const char *key,
+                            size_t *pLen )
+{
+    const char *pValue = NULL;
+    const char *p = pHeaders;
+    const char *pEnd;
+    size_t keyLen;
+
+    if ( ( pHeaders != NULL ) && ( key != NULL ) && ( pLen != NULL ) )
+    {
+        keyLen = strlen( key );
+
+        while ( ( *p != '\0' ) && ( *p != '\n' ) )
+        {
+            pEnd = strchr( p, '\n' );
+            if ( pEnd == NULL )
+            {
+                pEnd = p + strlen( p );
+            }
+
+            if ( ( (size_t)( pEnd - p ) > keyLen ) &&
+                 ( p[keyLen] == ':' ) &&
+                 ( strncmp( p, key, keyLen ) == 0 ) )
+            {
+                pValue = &p[keyLen + 1];
+                *pLen = pEnd - pValue;
+                break;
+            }
+
+            p = ( *pEnd == '\n' ) ? pEnd + 1 : pEnd;
+        }
+    }
+
+    return pValue;
+}
+
+/*============================================================================*/
+/*  HEADERS_Free                                                              */
+/*!
+    Release the resources used by a header block
+
+    @param[in]
+        pBlock
+            pointer to the compiled header block
+
+==============================================================================*/
+void HEADERS_Free( HeaderBlock *pBlock )
+{
+    if ( pBlock != NULL )
+    {
+        if ( pBlock->pBuf != NULL )
+        {
+            free( pBlock->pBuf );
+            pBlock->pBuf = NULL;
+        }
+
+        pBlock->size = 0;
+        pBlock->len = 0;
+        pBlock->count = 0;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Trim                                                                      */
+/*!
+    Remove leading and trailing white space from a string slice
+
+    @param[in,out]
+        ppStart
+            pointer to the start of the slice
+
+    @param[in,out]
+        ppEnd
+            pointer to the end of the slice
+
+==============================================================================*/
+static void Trim( const char **ppStart, const char **ppEnd )
+{
+    while ( ( *ppStart < *ppEnd ) && isspace( (unsigned char)**ppStart ) )
+    {
+        (*ppStart)++;
+    }
+
+    while ( ( *ppEnd > *ppStart ) &&
+            isspace( (unsigned char)(*ppEnd)[-1] ) )
+    {
+        (*ppEnd)--;
+    }
+}
+
+/*============================================================================*/
+/*  FindEntry                                                                 */
+/*!
+    Find the index of a header in a compiled header block
+
+    @param[in]
+        pBlock
+            pointer to the compiled header block
+
+    @param[in]
+        key
+            pointer to the header key
+
+    @param[in]
+        len
+            length of the header key
+
+    @retval index of the header entry
+    @retval -1 the header was not found
+
+==============================================================================*/
+static int FindEntry( HeaderBlock *pBlock, const char *key, size_t len )
+{
+    int idx = -1;
+    size_t i;
+    HeaderEntry *pEntry;
+
+    for ( i = 0; i < pBlock->count; i++ )
+    {
+        pEntry = &pBlock->entries[i];
+        if ( ( pEntry->keyLen == len ) &&
+             ( memcmp( &pBlock->pBuf[pEntry->keyOffset], key, len ) == 0 ) )
+        {
+            idx = (int)i;
+            break;
+        }
+    }
+
+    return idx;
+}
+
+/*============================================================================*/
+/*  Parse                                                                     */
+/*!
+    Parse a header specification
+
+    The Parse function adds the headers of a header specification to
+    arrays of header keys and values.  A header with the same key as a
+    header already in the arrays replaces it.
+
+    @param[in]
+        spec
+            semicolon or newline separated list of key:value pairs
+
+    @param[in]
+        len
+            length of the header specification
+
+    @param[in,out]
+        pKeys
+            array of header keys
+
+    @param[in,out]
+        pKeyLens
+            array of header key lengths
+
+    @param[in,out]
+        pValues
+            array of header values
+
+    @param[in,out]
+        pValueLens
+            array of header value lengths
+
+    @param[in,out]
+        pCount
+            number of headers in the arrays
+
+    @retval EOK the header specification was parsed
+    @retval EINVAL a header is malformed
+    @retval E2BIG too many headers were specified
+
+==============================================================================*/
+static int Parse( const char *spec,
+                  size_t len,
+                  const char **pKeys,
+                  size_t *pKeyLens,
+                  const char **pValues,
+                  size_t *pValueLens,
+                  size_t *pCount )
+{
+    int result = EOK;
+    const char *p = spec;
+    const char *pEnd = &spec[len];
+    const char *pEntryEnd;
+    const char *pKey;
+    const char *pKeyEnd;
+    const char *pValue;
+    const char *pValueEnd;
+    size_t i;
+
+    while ( ( p < pEnd ) && ( result == EOK ) )
+    {
+        /* find the end of this entry */
+        pEntryEnd = p;
+        while ( ( pEntryEnd < pEnd ) &&
+                ( *pEntryEnd != ';' ) &&
+                ( *pEntryEnd != '\n' ) )
+        {
+            pEntryEnd++;
+        }
+
+        pKey = p;
+        pKeyEnd = memchr( p, ':', pEntryEnd - p );
+        if ( pKeyEnd == NULL )
+        {
+            /* allow empty entries such as a trailing separator */
+            pValue = pEntryEnd;
+            Trim( &pKey, &pValue );
+            if ( pKey != pValue )
+            {
+                fprintf( stderr,
+                         "Invalid header: %.*s\n",
+                         (int)( pEntryEnd - p ),
+                         p );
+                result = EINVAL;
+            }
+        }
+        else
+        {
+            pValue = pKeyEnd + 1;
+            pValueEnd = pEntryEnd;
+            Trim( &pKey, &pKeyEnd );
+            Trim( &pValue, &pValueEnd );
+
+            if ( pKey == pKeyEnd )
+            {
+                fprintf( stderr,
+                         "Missing header key: %.*s\n",
+                         (int)( pEntryEnd - p ),
+                         p );
+                result = EINVAL;
+            }
+            else
+            {
+                /* a repeated key replaces the earlier value */
+                for ( i = 0; i < *pCount; i++ )
+                {
+                    if ( ( pKeyLens[i] == (size_t)( pKeyEnd - pKey ) ) &&
+                         ( memcmp( pKeys[i], pKey, pKeyLens[i] ) == 0 ) )
+                    {
+                        break;
+                    }
+                }
+
+                if ( i == HEADERS_MAX_COUNT )
+                {
+                    result = E2BIG;
+                }
+                else
+                {
+                    pKeys[i] = pKey;
+                    pKeyLens[i] = pKeyEnd - pKey;
+                    pValues[i] = pValue;
+                    pValueLens[i] = pValueEnd - pValue;
+                    if ( i == *pCount )
+                    {
+                        (*pCount)++;
+                    }
+                }
+            }
+        }
+
+        p = pEntryEnd + 1;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Render                                                                    */
+/*!
+    Render the parsed headers into the header block buffer
+
+    The Render function allocates the header block buffer and writes
+    the headers into it, one key:value pair per line, followed by the
+    terminating blank line.
+
+    @param[in]
+        pBlock
+            pointer to the header block
+
+    @param[in]
+        pKeys
+            array of pointers to the header keys
+
+    @param[in]
+        pKeyLens
+            array of header key lengths
+
+    @param[in]
+        pValues
+            array of pointers to the header values
+
+    @param[in]
+        pValueLens
+            array of header value lengths
+
+    @retval EOK the header block was rendered
+    @retval ENOMEM memory allocation failed
+
+==============================================================================*/
+static int Render( HeaderBlock *pBlock,
+                   const char **pKeys,
+                   size_t *pKeyLens,
+                   const char **pValues,
+                   size_t *pValueLens )
+{
+    int result = ENOMEM;
+    size_t size = 2;
+    size_t i;
+    char *p;
+
+    for ( i = 0; i < pBlock->count; i++ )
+    {
+        size += pKeyLens[i] + pValueLens[i] + 2;
+    }
+
+    pBlock->pBuf = malloc( size + 1 );
+    if ( pBlock->pBuf != NULL )
+    {
+        pBlock->size = size + 1;
+        p = pBlock->pBuf;
+
+        for ( i = 0; i < pBlock->count; i++ )
+        {
+            pBlock->entries[i].keyOffset = p - pBlock->pBuf;
+            pBlock->entries[i].keyLen = pKeyLens[i];
+            memcpy( p, pKeys[i], pKeyLens[i] );
+            p += pKeyLens[i];
+            *p++ = ':';
+
+            pBlock->entries[i].valueOffset = p - pBlock->pBuf;
+            pBlock->entries[i].valueLen = pValueLens[i];
+            memcpy( p, pValues[i], pValueLens[i] );
+            p += pValueLens[i];
+            *p++ = '\n';
+        }
+
+        /* blank line terminates the header section */
+        *p++ = '\n';
+        *p = '\0';
+
+        pBlock->len = p - pBlock->pBuf;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of headers group */
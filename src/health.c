@@ -0,0 +1,459 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup health health
+ * @brief Health variables
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file health.c
+
+    Health Variables
+
+    The health module publishes the throughput, backlog, last error and
+    link state of iotsend as variables of the variable server, so local
+    dashboards can read them with a variable lookup rather than parsing
+    log output.  The variables are named after a prefix, for example
+    /sys/iotsend/msg_rate, and must have been created in the variable
+    server.  A variable which does not exist is not published.
+
+    A publisher thread takes a snapshot of the statistics every
+    interval and sets only the variables whose value has changed, so
+    an idle daemon makes no variable server calls.  The senders only
+    record statistics, so a slow variable server never blocks them.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <iotclient/iotclient.h>
+#include <varserver/varserver.h>
+#include "stats.h"
+#include "health.h"
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! maximum length of a variable name */
+#define HEALTH_NAME_SIZE    ( 128 )
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! name of each health variable below the prefix */
+static const char * const varNames[HEALTH_VARS] =
+{
+    "msg_rate",
+    "byte_rate",
+    "sent",
+    "errors",
+    "spool_depth",
+    "queue_depth",
+    "last_error",
+    "link"
+};
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void *PublisherThread( void *arg );
+static void Update( Health *pHealth );
+static void Publish( Health *pHealth, HealthVar var, uint32_t value );
+static uint32_t Rate( uint64_t count, uint64_t elapsedMs );
+static uint32_t Clamp( uint64_t value );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  HEALTH_Start                                                              */
+/*!
+    Start publishing health variables
+
+    The HEALTH_Start function connects to the variable server, looks up
+    the health variables below the prefix, enables statistics recording
+    and starts the publisher thread.  It should be called before the
+    threads which record statistics are started.
+
+    @param[in]
+        pHealth
+            pointer to the health publisher
+
+    @param[in]
+        pPrefix
+            prefix of the variable names, or NULL to publish nothing
+
+    @param[in]
+        intervalMs
+            interval in milliseconds between updates
+
+    @param[in]
+        verbose
+            report missing variables on stderr
+
+    @retval EOK the publisher was started, or is not required
+    @retval EINVAL invalid arguments
+    @retval ENOTCONN cannot connect to the variable server
+    @retval ENOENT none of the health variables exist
+    @retval other error creating the publisher thread
+
+==============================================================================*/
+int HEALTH_Start( Health *pHealth,
+                  const char *pPrefix,
+                  unsigned int intervalMs,
+                  bool verbose )
+{
+    int result = EINVAL;
+    char name[HEALTH_NAME_SIZE];
+    size_t found = 0;
+    size_t i;
+
+    if ( ( pHealth != NULL ) && ( pPrefix == NULL ) )
+    {
+        result = EOK;
+    }
+    else if ( ( pHealth != NULL ) && ( intervalMs > 0 ) )
+    {
+        memset( pHealth, 0, sizeof( Health ) );
+        pHealth->intervalMs = intervalMs;
+        pHealth->verbose = verbose;
+        pHealth->stopFd = -1;
+
+        pHealth->hVarServer = VARSERVER_Open();
+        result = ( pHealth->hVarServer != NULL ) ? EOK : ENOTCONN;
+
+        for ( i = 0; ( result == EOK ) && ( i < HEALTH_VARS ); i++ )
+        {
+            pHealth->vars[i] = VAR_INVALID;
+            if ( snprintf( name,
+                           sizeof( name ),
+                           "%s/%s",
+                           pPrefix,
+                           varNames[i] ) < (int)sizeof( name ) )
+            {
+                pHealth->vars[i] = VAR_FindByName( pHealth->hVarServer, name );
+            }
+
+            if ( pHealth->vars[i] != VAR_INVALID )
+            {
+                found++;
+            }
+            else if ( verbose == true )
+            {
+                fprintf( stderr, "Health: %s/%s not found\n",
+                         pPrefix,
+                         varNames[i] );
+            }
+        }
+
+        if ( ( result == EOK ) && ( found == 0 ) )
+        {
+            result = ENOENT;
+        }
+
+        if ( result == EOK )
+        {
+            pHealth->stopFd = eventfd( 0, EFD_CLOEXEC );
+            result = ( pHealth->stopFd != -1 ) ? EOK : errno;
+        }
+
+        if ( result == EOK )
+        {
+            STATS_Enable();
+            STATS_Snapshot( &pHealth->last );
+            pHealth->lastTime = UTIL_NowMs();
+
+            result = pthread_create( &pHealth->thread,
+                                     NULL,
+                                     PublisherThread,
+                                     pHealth );
+        }
+
+        if ( result == EOK )
+        {
+            pHealth->running = true;
+        }
+        else
+        {
+            HEALTH_Stop( pHealth );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  HEALTH_Stop                                                               */
+/*!
+    Stop publishing health variables
+
+    The HEALTH_Stop function publishes the final values of the health
+    variables, stops the publisher thread and disconnects from the
+    variable server.
+
+    @param[in]
+        pHealth
+            pointer to the health publisher
+
+==============================================================================*/
+void HEALTH_Stop( Health *pHealth )
+{
+    uint64_t value = 1;
+
+    if ( ( pHealth != NULL ) && ( pHealth->hVarServer != NULL ) )
+    {
+        if ( ( pHealth->running == true ) &&
+             ( write( pHealth->stopFd, &value, sizeof( value ) ) ==
+               sizeof( value ) ) )
+        {
+            pthread_join( pHealth->thread, NULL );
+        }
+
+        pHealth->running = false;
+
+        if ( pHealth->stopFd != -1 )
+        {
+            close( pHealth->stopFd );
+            pHealth->stopFd = -1;
+        }
+
+        VARSERVER_Close( pHealth->hVarServer );
+        pHealth->hVarServer = NULL;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  PublisherThread                                                           */
+/*!
+    Health variable publisher thread
+
+    The PublisherThread updates the health variables every interval
+    until it is stopped, and once more when it is stopped.
+
+    @param[in]
+        arg
+            pointer to the health publisher
+
+    @retval NULL
+
+==============================================================================*/
+static void *PublisherThread( void *arg )
+{
+    Health *pHealth = (Health *)arg;
+    struct pollfd pfd;
+    bool stopping = false;
+
+    pfd.fd = pHealth->stopFd;
+    pfd.events = POLLIN;
+
+    while ( stopping == false )
+    {
+        if ( ( poll( &pfd, 1, pHealth->intervalMs ) > 0 ) &&
+             ( pfd.revents != 0 ) )
+        {
+            stopping = true;
+        }
+
+        Update( pHealth );
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  Update                                                                    */
+/*!
+    Update the health variables
+
+    The Update function takes a snapshot of the statistics, derives the
+    rates over the time since the previous update, and publishes the
+    variables whose value has changed.
+
+    @param[in]
+        pHealth
+            pointer to the health publisher
+
+==============================================================================*/
+static void Update( Health *pHealth )
+{
+    StatsSnapshot snapshot;
+    uint32_t values[HEALTH_VARS];
+    uint64_t now = UTIL_NowMs();
+    uint64_t elapsed = now - pHealth->lastTime;
+    size_t i;
+
+    STATS_Snapshot( &snapshot );
+
+    values[HEALTH_MSG_RATE] =
+        Rate( snapshot.counters[STATS_MESSAGES_SENT] -
+              pHealth->last.counters[STATS_MESSAGES_SENT],
+              elapsed );
+    values[HEALTH_BYTE_RATE] =
+        Rate( snapshot.counters[STATS_BYTES_SENT] -
+              pHealth->last.counters[STATS_BYTES_SENT],
+              elapsed );
+    values[HEALTH_SENT] = Clamp( snapshot.counters[STATS_MESSAGES_SENT] );
+    values[HEALTH_ERRORS] = Clamp( snapshot.counters[STATS_SEND_ERRORS] );
+    values[HEALTH_SPOOL_DEPTH] = Clamp( snapshot.gauges[STATS_SPOOL_DEPTH] );
+    values[HEALTH_QUEUE_DEPTH] = Clamp( snapshot.gauges[STATS_QUEUE_DEPTH] );
+    values[HEALTH_LAST_ERROR] = (uint32_t)snapshot.lastError;
+    values[HEALTH_LINK] = ( snapshot.linkUp == true ) ? 1 : 0;
+
+    for ( i = 0; i < HEALTH_VARS; i++ )
+    {
+        if ( ( pHealth->vars[i] != VAR_INVALID ) &&
+             ( ( pHealth->published[i] == false ) ||
+               ( pHealth->values[i] != values[i] ) ) )
+        {
+            Publish( pHealth, (HealthVar)i, values[i] );
+        }
+    }
+
+    pHealth->last = snapshot;
+    pHealth->lastTime = now;
+}
+
+/*============================================================================*/
+/*  Publish                                                                   */
+/*!
+    Set a health variable
+
+    The Publish function sets a health variable in the variable server.
+    The last error and the link state are published as strings, and the
+    other variables as unsigned 32 bit integers.  A value which cannot
+    be set is tried again at the next update.
+
+    @param[in]
+        pHealth
+            pointer to the health publisher
+
+    @param[in]
+        var
+            variable to set
+
+    @param[in]
+        value
+            value of the variable
+
+==============================================================================*/
+static void Publish( Health *pHealth, HealthVar var, uint32_t value )
+{
+    VarObject obj;
+    char *pStr = NULL;
+
+    memset( &obj, 0, sizeof( obj ) );
+
+    if ( var == HEALTH_LAST_ERROR )
+    {
+        pStr = ( value == EOK ) ? "none" : strerror( (int)value );
+    }
+    else if ( var == HEALTH_LINK )
+    {
+        pStr = ( value != 0 ) ? "up" : "down";
+    }
+
+    if ( pStr != NULL )
+    {
+        obj.type = VARTYPE_STR;
+        obj.val.str = pStr;
+        obj.len = strlen( pStr ) + 1;
+    }
+    else
+    {
+        obj.type = VARTYPE_UINT32;
+        obj.val.ul = value;
+        obj.len = sizeof( uint32_t );
+    }
+
+    if ( VAR_Set( pHealth->hVarServer, pHealth->vars[var], &obj ) == EOK )
+    {
+        pHealth->values[var] = value;
+        pHealth->published[var] = true;
+    }
+}
+
+/*============================================================================*/
+/*  Rate                                                                      */
+/*!
+    Get a rate per second
+
+    @param[in]
+        count
+            number of events
+
+    @param[in]
+        elapsedMs
+            number of milliseconds over which they occurred
+
+    @retval number of events per second
+
+==============================================================================*/
+static uint32_t Rate( uint64_t count, uint64_t elapsedMs )
+{
+    return ( elapsedMs > 0 ) ? Clamp( ( count * 1000 ) / elapsedMs ) : 0;
+}
+
+/*============================================================================*/
+/*  Clamp                                                                     */
+/*!
+    Clamp a value to an unsigned 32 bit variable
+
+    @param[in]
+        value
+            value to clamp
+
+    @retval value, or UINT32_MAX if it does not fit
+
+==============================================================================*/
+static uint32_t Clamp( uint64_t value )
+{
+    return ( value > UINT32_MAX ) ? UINT32_MAX : (uint32_t)value;
+}
+
+/*! @}
+ * end of health group */
@@ -48,6 +48,63 @@ SOFTWARE.
 
     The message data immediately follows the message properties
 
+    By default a single message is read from the standard input or
+    from the file specified on the command line.  Nothing is set up and
+    no connection is made until the input has data, so an empty input
+    costs as little as possible.  Inputs which are too
+    big to be sent as a single message are split into a chunked
+    transfer.  Each chunk carries sequence headers so the original
+    input can be re-assembled in the cloud.  The progress of a chunked
+    transfer of a file may be recorded in a checkpoint file, so an
+    interrupted transfer is resumed where it stopped.
+
+    In record mode the input is split into newline or NUL delimited
+    records and each record is sent as its own message as soon as it
+    arrives.  Records may be packed into batches which are flushed
+    when a size, count, or latency threshold is reached.
+
+    In daemon mode the connection to the IOTHub service is kept open
+    and a message is sent for each delimited frame read from the
+    standard input or from a named FIFO.  When the writer closes the
+    FIFO, any unterminated frame is sent and the FIFO is re-opened to
+    wait for the next writer.
+
+    Messages may be sent through a send pipeline so reading the input
+    and sending messages overlap, with a bounded number of messages
+    in flight.  Messages may be spread across several connections,
+    each with its own sender thread.
+
+    Payloads may be compressed with gzip, zstd, or lz4.  The codec is
+    identified by a content-encoding header.  Inputs are compressed as
+    a stream so the memory used is bounded, and an input whose
+    compressed size exceeds the maximum message size is sent as a
+    chunked transfer of the compressed stream.
+
+    Small messages may be compressed with a zstd dictionary trained
+    from sample messages using the train command:
+
+    iotsend train <dictionary> <sample file> [<sample file>...]
+
+    In spool mode, messages which cannot be delivered because the
+    IOTHub service or the cloud link is down are stored in an on-disk
+    spool and forwarded once connectivity returns.
+
+    In framed mode the input is read as length prefixed frames, each
+    with an optional block of headers, so records may hold any bytes.
+
+    Messages whose payload is unchanged since the last message of the
+    same stream may be suppressed, with a periodic heartbeat send.
+
+    The reader and sender threads may be pinned to their own CPUs, the
+    senders may run under a real-time policy, and the buffers may be
+    allocated on a chosen NUMA node.
+
+    On SIGTERM or SIGINT iotsend stops reading its input, sends the
+    records it has already read and the partial batch, and waits for
+    the messages in flight until the drain deadline.  The messages which
+    are not sent by then are spooled.  A transfer which has started is
+    completed.
+
 */
 /*============================================================================*/
 
@@ -55,6 +112,9 @@ SOFTWARE.
         Includes
 ==============================================================================*/
 
+/* for the cpu_set_t of the thread placement */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
@@ -64,13 +124,112 @@ SOFTWARE.
 #include <stdbool.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <poll.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
 #include <iotclient/iotclient.h>
+#include "reader.h"
+#include "batch.h"
+#include "chunk.h"
+#include "headers.h"
+#include "template.h"
+#include "pipeline.h"
+#include "compress.h"
+#include "spool.h"
+#include "retry.h"
+#include "ratelimit.h"
+#include "priority.h"
+#include "mux.h"
+#include "watch.h"
+#include "pool.h"
+#include "stats.h"
+#include "health.h"
+#include "telemetry.h"
+#include "dedup.h"
+#include "frame.h"
+#include "placement.h"
+#include "checkpoint.h"
+#include "util.h"
 
 /*==============================================================================
         Private definitions
 ==============================================================================*/
 
+/*! default record delimiter used in daemon mode (ASCII record separator) */
+#define DEFAULT_FRAME_DELIMITER '\x1e'
+
+/*! default maximum time a record waits in a batch */
+#define DEFAULT_LINGER_MS   ( 1000 )
+
+/*! default time in milliseconds to drain the messages in flight on stop */
+#define DEFAULT_DRAIN_MS    ( 5000 )
+
+/*! interval at which a shutdown checks whether the pipelines are empty */
+#define DRAIN_POLL_MS       ( 10 )
+
+/*! long option identifiers for options without a short form */
+#define OPT_BATCH_BYTES     ( 256 )
+#define OPT_BATCH_COUNT     ( 257 )
+#define OPT_LINGER_MS       ( 258 )
+#define OPT_BATCH_FORMAT    ( 259 )
+#define OPT_CHUNK_SIZE      ( 260 )
+#define OPT_NO_MMAP         ( 261 )
+#define OPT_INFLIGHT        ( 262 )
+#define OPT_CONNECTIONS     ( 263 )
+#define OPT_SHARD_KEY       ( 264 )
+#define OPT_ZDICT           ( 265 )
+#define OPT_SPOOL           ( 266 )
+#define OPT_SPOOL_FSYNC     ( 267 )
+#define OPT_MAX_ATTEMPTS    ( 268 )
+#define OPT_RETRY_BASE_MS   ( 269 )
+#define OPT_RETRY_CAP_MS    ( 270 )
+#define OPT_RATE            ( 271 )
+#define OPT_BYTE_RATE       ( 272 )
+#define OPT_BURST           ( 273 )
+#define OPT_PRIORITY_FIFO   ( 274 )
+#define OPT_SOURCE          ( 275 )
+#define OPT_WATCH           ( 276 )
+#define OPT_WATCH_DONE      ( 277 )
+#define OPT_MEMORY_CAP      ( 278 )
+#define OPT_STATS_INTERVAL  ( 279 )
+#define OPT_STATS_SOCKET    ( 280 )
+#define OPT_HEALTH          ( 281 )
+#define OPT_HEALTH_MS       ( 282 )
+#define OPT_TELEMETRY       ( 283 )
+#define OPT_WINDOW_MS       ( 284 )
+#define OPT_DEADBAND        ( 285 )
+#define OPT_MIN_INTERVAL_MS ( 286 )
+#define OPT_DEDUP           ( 287 )
+#define OPT_DEDUP_KEY       ( 288 )
+#define OPT_HEARTBEAT       ( 289 )
+#define OPT_FRAMED          ( 290 )
+#define OPT_READER_CPUS     ( 291 )
+#define OPT_SENDER_CPUS     ( 292 )
+#define OPT_SENDER_PRIORITY ( 293 )
+#define OPT_NICE            ( 294 )
+#define OPT_NUMA_NODE       ( 295 )
+#define OPT_DRAIN_MS        ( 296 )
+#define OPT_CHECKPOINT      ( 297 )
+#define OPT_RESUME          ( 298 )
+
+/*! maximum number of input sources */
+#define MAX_SOURCES         ( 16 )
+
+/*! default number of messages in flight per connection when fanning out */
+#define DEFAULT_INFLIGHT    ( 8 )
+
+/*! number of pipelined chunks between checkpoints */
+#define CHECKPOINT_INTERVAL ( 8 )
+
+/*! suffix of the default checkpoint file of an input file */
+#define CHECKPOINT_SUFFIX   ".checkpoint"
+
 /*! iotsend state */
 typedef struct iotsendState
 {
@@ -86,8 +245,222 @@ typedef struct iotsendState
     /*! headers to send */
     char *headers;
 
+    /*! headers compiled from the command line */
+    HeaderBlock headerBlock;
+
+    /*! header block passed to the IOTClient library */
+    char *pHeaders;
+
+    /*! header template for headers containing placeholders */
+    HeaderTemplate headerTemplate;
+
+    /*! daemon mode: send one message per frame over a single connection */
+    bool daemon;
+
+    /*! name of the FIFO to read frames from in daemon mode */
+    char *fifoName;
+
+    /*! record mode: send one message per delimited input record */
+    bool records;
+
+    /*! record delimiter used in daemon and record modes */
+    char delimiter;
+
+    /*! read length prefixed frames rather than delimited records */
+    bool framed;
+
+    /*! buffer for the message headers of a frame with a header block */
+    char *pFrameHeaders;
+
+    /*! size of the frame message header buffer */
+    size_t frameHeadersSize;
+
+    /*! pack records into batches in daemon and record modes */
+    bool batching;
+
+    /*! batch framing format */
+    BatchFormat batchFormat;
+
+    /*! batch size which triggers a flush */
+    size_t batchBytes;
+
+    /*! number of records in a batch which triggers a flush */
+    size_t batchCount;
+
+    /*! maximum time in milliseconds a record waits in a batch */
+    int lingerMs;
+
+    /*! record batch */
+    Batch batch;
+
+    /*! send the input as a chunked transfer */
+    bool chunked;
+
+    /*! maximum payload size of each chunk in a chunked transfer */
+    size_t chunkSize;
+
+    /*! file recording the progress of a chunked transfer, or NULL */
+    char *checkpointFile;
+
+    /*! resume the chunked transfer recorded in the checkpoint file */
+    bool resume;
+
+    /*! memory map regular input files */
+    bool mmap;
+
+    /*! maximum number of messages in flight in the send pipeline
+        (0 = send synchronously) */
+    size_t inflight;
+
+    /*! number of connections to the IOTHub service */
+    size_t connections;
+
+    /*! send pipeline of each connection */
+    Pipeline *pPipelines;
+
+    /*! header key whose value selects the connection for a message */
+    char *shardKey;
+
+    /*! connection selected for the previous round-robin message */
+    size_t nextConnection;
+
+    /*! payload compression codec */
+    CompressCodec codec;
+
+    /*! payload compressor */
+    Compressor compressor;
+
+    /*! buffer for a compressed message payload */
+    char *pCompressed;
+
+    /*! name of the zstd dictionary file */
+    char *dictName;
+
+    /*! store-and-forward spool directory */
+    char *spoolDir;
+
+    /*! fsync policy of the spool */
+    SpoolFsync spoolFsync;
+
+    /*! store-and-forward spool */
+    Spool spool;
+
+    /*! pointer to the spool if spool mode is enabled, or NULL */
+    Spool *pSpool;
+
+    /*! retry policy for connections and messages */
+    RetryPolicy retry;
+
+    /*! retry delay random number generator state */
+    uint64_t retrySeed;
+
+    /*! maximum messages per second (0 = unlimited) */
+    size_t msgRate;
+
+    /*! maximum payload bytes per second (0 = unlimited) */
+    size_t byteRate;
+
+    /*! maximum number of messages sent back to back */
+    size_t burst;
+
+    /*! message and byte rate limiter */
+    RateLimit rateLimit;
+
+    /*! name of the FIFO to read urgent messages from */
+    char *priorityFifo;
+
+    /*! number of priority lanes of each send pipeline */
+    size_t lanes;
+
+    /*! reader of urgent messages from the priority FIFO */
+    PriorityReader priority;
+
+    /*! input source specifications */
+    char *sources[MAX_SOURCES];
+
+    /*! number of input sources */
+    size_t sourceCount;
+
+    /*! input multiplexer */
+    Mux mux;
+
+    /*! drop directory whose files are each sent as a message */
+    char *watchDir;
+
+    /*! directory delivered files are moved to, or NULL to delete them */
+    char *watchDone;
+
+    /*! maximum number of bytes held by the buffer pool (0 = unlimited) */
+    size_t memoryCap;
+
+    /*! number of seconds between statistics lines on stderr (0 = none) */
+    unsigned int statsInterval;
+
+    /*! path of the UNIX socket serving the statistics, or NULL */
+    char *statsSocket;
+
+    /*! prefix of the health variables, or NULL to publish none */
+    char *healthPrefix;
+
+    /*! interval in milliseconds between health variable updates */
+    unsigned int healthMs;
+
+    /*! health variable publisher */
+    Health health;
+
+    /*! comma separated variables forwarded on change, or NULL */
+    char *telemetryVars;
+
+    /*! time in milliseconds variable changes are coalesced */
+    unsigned int windowMs;
+
+    /*! minimum change of a numeric variable which is forwarded */
+    double deadband;
+
+    /*! minimum time in milliseconds between forwards of a variable */
+    unsigned int minIntervalMs;
+
+    /*! forwarder of variable changes */
+    Telemetry telemetry;
+
+    /*! suppress messages whose payload is unchanged */
+    bool dedup;
+
+    /*! header key whose value identifies a deduplicated stream, or NULL */
+    char *dedupKey;
+
+    /*! number of seconds after which an unchanged payload is sent anyway
+        (0 = never) */
+    unsigned int heartbeat;
+
+    /*! duplicate payload filter */
+    Dedup dedupFilter;
+
+    /*! CPU, scheduling and NUMA placement of the threads and buffers */
+    Placement placement;
+
+    /*! maximum time in milliseconds to drain the messages on stop */
+    unsigned int drainMs;
+
+    /*! set by the termination handler when iotsend must stop */
+    int stopping;
+
+    /*! monotonic time in milliseconds by which the drain must end */
+    uint64_t drainDeadline;
+
 } IOTSendState;
 
+/*! input stream of a single message read into chunks */
+typedef struct _StreamInput
+{
+    /*! pointer to the IOTSendState */
+    IOTSendState *pState;
+
+    /*! input file descriptor */
+    int fd;
+
+} StreamInput;
+
 /*==============================================================================
         Private file scoped variables
 ==============================================================================*/
@@ -95,6 +468,9 @@ typedef struct iotsendState
 /*! iotsend application State object */
 IOTSendState state;
 
+/*! default message headers */
+static const char defaultHeaders[] = "source:iotsend";
+
 /*==============================================================================
         Private function declarations
 ==============================================================================*/
@@ -103,8 +479,86 @@ int main(int argc, char **argv);
 static int ProcessOptions( int argC, char *argV[], IOTSendState *pState );
 static void usage( char *cmdname );
 static int SendMessage(IOTSendState *pState);
+static bool HasInput( IOTSendState *pState );
+static int PrepareHeaders( IOTSendState *pState );
+static char *GetHeaders( IOTSendState *pState, uint64_t chunk );
+static int StartSpool( IOTSendState *pState );
+static IOTCLIENT_HANDLE Connect( IOTSendState *pState );
+static int SendDirect( IOTSendState *pState,
+                       char *pHeaders,
+                       char *pPayload,
+                       size_t len );
+static int StreamDirect( IOTSendState *pState, char *pHeaders, int fd );
+static int StartPipelines( IOTSendState *pState );
+static int DrainPipelines( IOTSendState *pState );
+static int StopPipelines( IOTSendState *pState );
+static void SampleStats( void *pArg, uint64_t *pGauges );
+static int StartPriority( IOTSendState *pState );
+static Pipeline *SelectPipeline( IOTSendState *pState, char *pHeaders );
+static int SendRecords( IOTSendState *pState );
+static int NextRecord( IOTSendState *pState,
+                       RecordReader *pReader,
+                       char **ppHeaders,
+                       char **ppRecord,
+                       size_t *pLen );
+static int StartSources( IOTSendState *pState );
+static int SendSources( IOTSendState *pState );
+static int SourceRecord( void *pArg,
+                         char *pHeaders,
+                         char *pRecord,
+                         size_t len );
+static int StartTelemetry( IOTSendState *pState );
+static int SendTelemetry( IOTSendState *pState );
+static int TelemetryMessage( void *pArg, char *pData, size_t len );
+static int SendWatched( IOTSendState *pState );
+static int WatchedFile( void *pArg, const char *pPath );
+static int SendRecord( IOTSendState *pState,
+                       char *pHeaders,
+                       char *pRecord,
+                       size_t len );
+static bool IsDuplicate( IOTSendState *pState,
+                         char *pHeaders,
+                         char *pPayload,
+                         size_t len );
+static int BatchRecord( IOTSendState *pState, char *pRecord, size_t len );
+static int FlushBatch( IOTSendState *pState );
+static char *MapFile( int fd, uint64_t size );
+static int SendChunks( IOTSendState *pState,
+                       char *pMessageHeaders,
+                       int fd,
+                       uint64_t size,
+                       char *pMap,
+                       Compressor *pCompressor );
+static int StartCheckpoint( IOTSendState *pState,
+                            ChunkTransfer *pTransfer,
+                            int fd,
+                            char *pMap,
+                            Checkpoint *pCheckpoint );
+static int SaveCheckpoint( IOTSendState *pState,
+                           ChunkTransfer *pTransfer,
+                           Checkpoint *pCheckpoint );
+static int StartCompression( IOTSendState *pState );
+static void StopCompression( IOTSendState *pState );
+static int SendContent( IOTSendState *pState,
+                        char *pHeaders,
+                        char *pPayload,
+                        size_t len );
+static int TrainDictionary( int argc, char **argv );
+static int ReadCompressed( void *pArg, char *pBuf, size_t size, size_t *pLen );
+static int ReadStream( void *pArg, char *pBuf, size_t size, size_t *pLen );
+static int SendPayload( IOTSendState *pState,
+                        char *pHeaders,
+                        char *pPayload,
+                        size_t len );
+static int OpenFIFO( IOTSendState *pState, char *fifoName );
 static void SetupTerminationHandler( void );
 static void TerminationHandler( int signum, siginfo_t *info, void *ptr );
+static void MaskTermination( int how, sigset_t *pPrevious );
+static void UnmaskedTermination( sigset_t *pMask );
+static void Backoff( IOTSendState *pState, unsigned int attempts );
+static int Pace( IOTSendState *pState, size_t len );
+static bool Stopping( IOTSendState *pState );
+static bool Expired( IOTSendState *pState );
 
 /*==============================================================================
         Private function definitions
@@ -130,20 +584,184 @@ static void TerminationHandler( int signum, siginfo_t *info, void *ptr );
 int main(int argc, char **argv)
 {
     int result = EINVAL;
+    int rc;
 
-    /* process the command line options */
-    ProcessOptions( argc, argv, &state );
+    state.delimiter = DEFAULT_FRAME_DELIMITER;
+    state.lingerMs = DEFAULT_LINGER_MS;
+    state.chunkSize = MAX_IOT_MSG_SIZE;
+    state.mmap = true;
+    state.connections = 1;
+    state.lanes = 1;
+    state.healthMs = HEALTH_DEFAULT_MS;
+    state.windowMs = TELEMETRY_DEFAULT_WINDOW_MS;
+    state.placement.numaNode = -1;
+    state.drainMs = DEFAULT_DRAIN_MS;
+    RETRY_Init( &state.retry );
+    state.retrySeed = RETRY_Seed();
+
+    /* every thread inherits the blocked termination signals */
+    SetupTerminationHandler();
 
-    state.hIoTClient = IOTCLIENT_Create();
-    if ( state.hIoTClient != NULL )
+    if ( ( argc > 1 ) && ( strcmp( argv[1], "train" ) == 0 ) )
     {
-        IOTCLIENT_SetVerbose( state.hIoTClient, state.verbose );
-        SendMessage( &state );
-        IOTCLIENT_Close( state.hIoTClient );
+        /* train a compression dictionary instead of sending */
+        result = TrainDictionary( argc - 2, &argv[2] );
+    }
+    /* process the command line options */
+    else if ( ( rc = ProcessOptions( argc, argv, &state ) ) != EOK )
+    {
+        fprintf( stderr, "Invalid options\n" );
+        result = rc;
+    }
+    /* don't set anything up or connect for an empty input */
+    else if ( HasInput( &state ) == false )
+    {
+        if ( state.verbose == true )
+        {
+            fprintf( stderr, "Empty input: nothing to send\n" );
+        }
+
         result = EOK;
     }
+    /* place the threads and buffers before any are created */
+    else if ( ( rc = PLACEMENT_Start( &state.placement ) ) != EOK )
+    {
+        fprintf( stderr, "Cannot place threads: %s\n", strerror( rc ) );
+    }
+    /* bound the memory used for buffers before any are allocated */
+    else if ( POOL_Init( state.memoryCap ) != EOK )
+    {
+        fprintf( stderr, "Invalid memory cap\n" );
+    }
+    /* block the change notifications before any thread is created */
+    else if ( StartTelemetry( &state ) != EOK )
+    {
+        fprintf( stderr, "Cannot subscribe to variables\n" );
+    }
+    /* record statistics from the start, before any thread is created */
+    else if ( STATS_Start( state.statsInterval, state.statsSocket ) != EOK )
+    {
+        fprintf( stderr, "Cannot start statistics\n" );
+    }
+    else if ( HEALTH_Start( &state.health,
+                            state.healthPrefix,
+                            state.healthMs,
+                            state.verbose ) != EOK )
+    {
+        fprintf( stderr, "Cannot publish health variables\n" );
+    }
+    else if ( StartCompression( &state ) != EOK )
+    {
+        fprintf( stderr,
+                 "Cannot start %s compression\n",
+                 COMPRESS_Encoding( state.codec ) );
+    }
+    /* compile the headers once so they can be re-used for every message */
+    else if ( PrepareHeaders( &state ) != EOK )
+    {
+        fprintf( stderr, "Invalid headers\n" );
+    }
+    else if ( RATELIMIT_Init( &state.rateLimit,
+                              state.msgRate,
+                              state.byteRate,
+                              state.burst ) != EOK )
+    {
+        fprintf( stderr, "Invalid rate limit\n" );
+    }
+    else if ( ( state.dedup == true ) &&
+              ( DEDUP_Init( &state.dedupFilter,
+                            state.dedupKey,
+                            state.heartbeat ) != EOK ) )
+    {
+        fprintf( stderr, "Cannot start duplicate filter\n" );
+    }
+    else if ( StartSources( &state ) != EOK )
+    {
+        fprintf( stderr, "Cannot open input sources\n" );
+    }
+    else if ( StartSpool( &state ) != EOK )
+    {
+        fprintf( stderr, "Cannot open spool %s\n", state.spoolDir );
+    }
+    else if ( ( ( state.hIoTClient = Connect( &state ) ) != NULL ) ||
+              ( state.pSpool != NULL ) )
+    {
+        /* without a connection, every message is spooled */
+        if ( state.hIoTClient != NULL )
+        {
+            IOTCLIENT_SetVerbose( state.hIoTClient, state.verbose );
+        }
+
+        result = StartPipelines( &state );
+        if ( result != EOK )
+        {
+            fprintf( stderr,
+                     "Cannot start send pipeline: %s\n",
+                     strerror( result ) );
+        }
+        else if ( ( result = StartPriority( &state ) ) != EOK )
+        {
+            fprintf( stderr,
+                     "Cannot open %s: %s\n",
+                     state.priorityFifo,
+                     strerror( result ) );
+        }
+        else if ( state.sourceCount > 0 )
+        {
+            result = SendSources( &state );
+        }
+        else if ( state.telemetryVars != NULL )
+        {
+            result = SendTelemetry( &state );
+        }
+        else if ( state.watchDir != NULL )
+        {
+            result = SendWatched( &state );
+        }
+        else if ( ( state.daemon == true ) || ( state.records == true ) )
+        {
+            result = SendRecords( &state );
+        }
+        else
+        {
+            result = SendMessage( &state );
+        }
+
+        /* wait for the messages in flight to be sent */
+        PRIORITY_Stop( &state.priority );
+        rc = StopPipelines( &state );
+        if ( result == EOK )
+        {
+            /* report a message the pipelines could not send */
+            result = rc;
+        }
+
+        if ( state.hIoTClient != NULL )
+        {
+            IOTCLIENT_Close( state.hIoTClient );
+        }
+    }
+
+    /* forward what can be forwarded and keep the rest for the next run */
+    if ( Stopping( &state ) == true )
+    {
+        SPOOL_SetDeadline( state.pSpool, state.drainDeadline );
+    }
+
+    SPOOL_Close( state.pSpool );
+
+    /* report the final statistics once every sender has stopped */
+    HEALTH_Stop( &state.health );
+    STATS_Shutdown();
 
     /* clean up allocated memory */
+    MUX_Free( &state.mux );
+    HEADERS_Free( &state.headerBlock );
+    TEMPLATE_Free( &state.headerTemplate );
+    StopCompression( &state );
+    RATELIMIT_Free( &state.rateLimit );
+    DEDUP_Free( &state.dedupFilter );
+
     if ( state.headers != NULL )
     {
         free( state.headers );
@@ -156,6 +774,86 @@ int main(int argc, char **argv)
         state.fileName = NULL;
     }
 
+    if ( state.fifoName != NULL )
+    {
+        free( state.fifoName );
+        state.fifoName = NULL;
+    }
+
+    if ( state.shardKey != NULL )
+    {
+        free( state.shardKey );
+        state.shardKey = NULL;
+    }
+
+    if ( state.dedupKey != NULL )
+    {
+        free( state.dedupKey );
+        state.dedupKey = NULL;
+    }
+
+    if ( state.checkpointFile != NULL )
+    {
+        free( state.checkpointFile );
+        state.checkpointFile = NULL;
+    }
+
+    if ( state.dictName != NULL )
+    {
+        free( state.dictName );
+        state.dictName = NULL;
+    }
+
+    if ( state.spoolDir != NULL )
+    {
+        free( state.spoolDir );
+        state.spoolDir = NULL;
+    }
+
+    if ( state.priorityFifo != NULL )
+    {
+        free( state.priorityFifo );
+        state.priorityFifo = NULL;
+    }
+
+    while ( state.sourceCount > 0 )
+    {
+        free( state.sources[--state.sourceCount] );
+    }
+
+    if ( state.watchDir != NULL )
+    {
+        free( state.watchDir );
+        state.watchDir = NULL;
+    }
+
+    if ( state.watchDone != NULL )
+    {
+        free( state.watchDone );
+        state.watchDone = NULL;
+    }
+
+    if ( state.statsSocket != NULL )
+    {
+        free( state.statsSocket );
+        state.statsSocket = NULL;
+    }
+
+    if ( state.healthPrefix != NULL )
+    {
+        free( state.healthPrefix );
+        state.healthPrefix = NULL;
+    }
+
+    if ( state.telemetryVars != NULL )
+    {
+        TELEMETRY_Close( &state.telemetry );
+        free( state.telemetryVars );
+        state.telemetryVars = NULL;
+    }
+
+    POOL_Shutdown();
+
     return result;
 }
 
@@ -164,7 +862,25 @@ int main(int argc, char **argv)
 /*!
     Send an IOTHub Message
 
-    The SendMessage function sends a sample message to the IOTHUB.
+    The SendMessage function sends the input file or the standard input
+    to the IOTHUB.  An input file which is bigger than the maximum
+    message size, or any input if chunked mode was requested, is sent
+    as a chunked transfer.
+
+    Regular files are memory mapped and the mapped region is passed
+    directly to the IOTClient library so the file data is not copied
+    through intermediate read buffers.  Regular files which are not
+    mapped are streamed.  Pipes and the standard input are read into
+    chunks, so a stop ends the wait for more input and what has been
+    read is sent.
+
+    If compression is enabled, the input is compressed as a stream and
+    the decision to use a chunked transfer is based on the compressed
+    size rather than the size of the input.
+
+    In spool mode, and when the byte rate is limited, a regular file is
+    also read into chunks rather than being streamed by the IOTClient
+    library, so it can be spooled if it cannot be sent.
 
     @param[in]
         pState
@@ -174,52 +890,104 @@ int main(int argc, char **argv)
 static int SendMessage(IOTSendState *pState)
 {
     int fd = STDIN_FILENO;
-    char *headers = "source:iotsend\n\n";
     int result = EINVAL;
     struct stat st;
-    int i;
+    uint64_t size = 0;
+    bool chunked;
+    bool regular = false;
+    char *pMap = NULL;
+    char *pHeaders;
 
     if( pState != NULL )
     {
-        if (pState->headers != NULL )
+        chunked = pState->chunked;
+
+        if ( pState->fileName != NULL )
+        {
+            /* open the input file */
+            fd = open( pState->fileName, O_RDONLY );
+        }
+
+        if ( ( fd != -1 ) && ( fstat( fd, &st ) == 0 ) )
         {
-            headers = pState->headers;
-            /* replace ; with '\n' in headers */
-            for ( i=0; i<strlen(headers); i++ )
+            if ( S_ISREG( st.st_mode ) )
             {
-                if ( headers[i] == ';' )
+                regular = true;
+                size = st.st_size;
+                if ( size > pState->chunkSize )
                 {
-                    headers[i] = '\n';
+                    /* split the file rather than truncating it */
+                    chunked = true;
+                }
+
+                if ( ( pState->mmap == true ) && ( size > 0 ) )
+                {
+                    pMap = MapFile( fd, size );
                 }
             }
         }
 
-        if ( pState->fileName != NULL )
+        if ( ( fd != -1 ) && ( pState->codec != COMPRESS_NONE ) )
+        {
+            result = ( pMap != NULL )
+                     ? COMPRESS_StartMem( &pState->compressor, pMap, size )
+                     : COMPRESS_StartFd( &pState->compressor, fd );
+            if ( result == EOK )
+            {
+                result = SendChunks( pState,
+                                     NULL,
+                                     fd,
+                                     0,
+                                     NULL,
+                                     &pState->compressor );
+            }
+        }
+        else if ( ( fd != -1 ) && ( chunked == true ) )
         {
-            if ( stat( pState->fileName, &st ) == 0 )
+            result = SendChunks( pState, NULL, fd, size, pMap, NULL );
+        }
+        else if ( pMap != NULL )
+        {
+            /* send the mapped file directly unless it is unchanged */
+            pHeaders = GetHeaders( pState, 0 );
+            result = EOK;
+            if ( IsDuplicate( pState, pHeaders, pMap, size ) == false )
             {
-                if ( st.st_size > MAX_IOT_MSG_SIZE )
+                result = SendContent( pState, pHeaders, pMap, size );
+                if ( result != EOK )
                 {
-                    fprintf( stderr,
-                             "Warning: Max file size exceeded\n"
-                             "File will be truncated!\n" );
+                    DEDUP_Forget( &pState->dedupFilter, pHeaders );
                 }
             }
-
-            /* open the input file */
-            fd = open( pState->fileName, O_RDONLY );
         }
-
-        if ( fd != -1 )
+        else if ( ( fd != -1 ) &&
+                  ( ( pState->pSpool != NULL ) ||
+                    ( pState->byteRate > 0 ) ||
+                    ( regular == false ) ) )
+        {
+            /* read the stream so it can be spooled if it is not sent,
+               so its size is known to the byte rate limiter, and so a
+               stop ends the wait for more of a pipe */
+            result = SendChunks( pState, NULL, fd, 0, NULL, NULL );
+        }
+        else if ( fd != -1 )
         {
+            /* keep the messages in order */
+            DrainPipelines( pState );
+
             /* stream data to the cloud */
-            result = IOTCLIENT_Stream( pState->hIoTClient, headers, fd );
+            result = StreamDirect( pState, GetHeaders( pState, 0 ), fd );
         }
         else
         {
             fprintf(stderr, "File not found\n" );
         }
 
+        if ( pMap != NULL )
+        {
+            munmap( pMap, size );
+        }
+
         if( ( pState->fileName != NULL ) &&
             ( fd != -1 ) )
         {
@@ -231,40 +999,2964 @@ static int SendMessage(IOTSendState *pState)
 }
 
 /*============================================================================*/
-/*  usage                                                                     */
+/*  HasInput                                                                  */
 /*!
-    Display the application usage
+    Wait for the input of a single message
 
-    The usage function dumps the application usage message
-    to stderr.
+    The HasInput function checks if the input of a single message has
+    any data, so an empty input exits before anything is set up and
+    before connecting to the IOTHub service.  It waits for the first
+    byte of a pipe or socket on the standard input to arrive, or for
+    its writer to close it, without reading it.  A standard input
+    redirected from /dev/null is empty.  Other character devices, such
+    as a terminal, cannot be checked without consuming their input, so
+    they are assumed to have data.
+
+    In the other modes, when a spool is configured so its backlog is
+    forwarded, and for inputs whose size cannot be determined, the
+    input is assumed to have data.  A stop requested while waiting is
+    treated as an empty input.
 
     @param[in]
-       cmdname
-            pointer to the invoked command name
+        pState
+            pointer to the IOTSendState
 
-    @return none
+    @retval true the input has data, or is not a single message input
+    @retval false the input is empty
 
 ==============================================================================*/
-static void usage( char *cmdname )
+static bool HasInput( IOTSendState *pState )
 {
-    if( cmdname != NULL )
-    {
-        fprintf(stderr,
-                "usage: %s [-v] [-h] [<filename>]\n"
-                " [-h] : display this help\n"
-                " [-H headers]\n"
-                " [-v] : verbose output\n",
-                cmdname );
-    }
-}
+    bool hasInput = true;
+    struct pollfd pfd;
+    struct stat st;
+    struct stat null;
+    sigset_t mask;
+    int available;
+    int rc;
 
-/*============================================================================*/
-/*  ProcessOptions                                                            */
-/*!
-    Process the command line options
+    if ( ( pState->daemon == false ) &&
+         ( pState->spoolDir == NULL ) &&
+         ( pState->records == false ) &&
+         ( pState->sourceCount == 0 ) &&
+         ( pState->telemetryVars == NULL ) &&
+         ( pState->watchDir == NULL ) )
+    {
+        /* a missing file is reported when the message is sent */
+        rc = ( pState->fileName != NULL )
+             ? stat( pState->fileName, &st )
+             : fstat( STDIN_FILENO, &st );
 
-    The ProcessOptions function processes the command line options and
-    populates the iotsend state object
+        if ( ( rc == 0 ) && ( S_ISREG( st.st_mode ) ) )
+        {
+            hasInput = ( st.st_size > 0 );
+        }
+        else if ( ( rc == 0 ) &&
+                  ( S_ISCHR( st.st_mode ) ) &&
+                  ( stat( "/dev/null", &null ) == 0 ) &&
+                  ( S_ISCHR( null.st_mode ) ) )
+        {
+            hasInput = ( st.st_rdev != null.st_rdev );
+        }
+        else if ( ( rc == 0 ) &&
+                  ( pState->fileName == NULL ) &&
+                  ( ( S_ISFIFO( st.st_mode ) ) || ( S_ISSOCK( st.st_mode ) ) ) )
+        {
+            pfd.fd = STDIN_FILENO;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+
+            /* wait for data, for the writer to close the input, or
+               for a stop */
+            UnmaskedTermination( &mask );
+            rc = ppoll( &pfd, 1, NULL, &mask );
+            if ( ( rc == 1 ) &&
+                 ( ioctl( STDIN_FILENO, FIONREAD, &available ) == 0 ) )
+            {
+                hasInput = ( available > 0 );
+            }
+            else if ( Stopping( pState ) == true )
+            {
+                hasInput = false;
+            }
+        }
+    }
+
+    return hasInput;
+}
+
+/*============================================================================*/
+/*  MapFile                                                                   */
+/*!
+    Memory map an input file
+
+    The MapFile function maps a regular file into memory for reading
+    and advises the kernel that it will be read sequentially so pages
+    are read ahead.
+
+    @param[in]
+        fd
+            file descriptor of the file to map
+
+    @param[in]
+        size
+            size of the file
+
+    @retval pointer to the mapped file
+    @retval NULL the file could not be mapped
+
+==============================================================================*/
+static char *MapFile( int fd, uint64_t size )
+{
+    void *p = NULL;
+
+    if ( size <= SIZE_MAX )
+    {
+        p = mmap( NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( p == MAP_FAILED )
+        {
+            p = NULL;
+        }
+        else
+        {
+            (void)madvise( p, (size_t)size, MADV_SEQUENTIAL );
+            STATS_Add( STATS_BYTES_READ, size );
+        }
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*  PrepareHeaders                                                            */
+/*!
+    Prepare the message headers
+
+    The PrepareHeaders function compiles the semicolon separated
+    headers specified on the command line into the header block
+    passed to the IOTClient library for every message.  If no headers
+    were specified, the default headers are used.
+
+    If compression is enabled, a content-encoding header identifying
+    the codec is added to the headers, and a zstd-dict-id header if a
+    compression dictionary is used.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK the headers were compiled
+    @retval EINVAL the headers are invalid
+    @retval ENOMEM memory allocation failed
+    @retval other error from HEADERS_Compile
+
+==============================================================================*/
+static int PrepareHeaders( IOTSendState *pState )
+{
+    int result = EINVAL;
+    const char *spec = defaultHeaders;
+    const char *encoding;
+    char *pSpec = NULL;
+    size_t len;
+
+    if ( pState != NULL )
+    {
+        if ( pState->headers != NULL )
+        {
+            spec = pState->headers;
+        }
+
+        len = strlen( spec );
+        result = EOK;
+
+        encoding = COMPRESS_Encoding( pState->codec );
+        if ( encoding != NULL )
+        {
+            /* added last so they replace any user specified headers */
+            len += strlen( encoding ) +
+                   sizeof( "\ncontent-encoding:\nzstd-dict-id:4294967295" );
+            pSpec = malloc( len );
+            if ( pSpec != NULL )
+            {
+                len = snprintf( pSpec,
+                                len,
+                                "%s\ncontent-encoding:%s",
+                                spec,
+                                encoding );
+                if ( pState->compressor.dictId != 0 )
+                {
+                    len += sprintf( &pSpec[len],
+                                    "\nzstd-dict-id:%" PRIu32,
+                                    pState->compressor.dictId );
+                }
+
+                spec = pSpec;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+
+        if ( result == EOK )
+        {
+            result = HEADERS_Compile( &pState->headerBlock, spec, len );
+        }
+
+        free( pSpec );
+
+        if ( result == EOK )
+        {
+            pState->pHeaders = HEADERS_Get( &pState->headerBlock );
+
+            /* compile any placeholders in the headers */
+            result = TEMPLATE_Compile( &pState->headerTemplate,
+                                       pState->pHeaders );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GetHeaders                                                                */
+/*!
+    Get the headers for the next message
+
+    The GetHeaders function returns the compiled header block, or if
+    the headers contain placeholders, renders the header template for
+    the next message.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        chunk
+            chunk index substituted into the ${chunk} placeholder
+
+    @retval pointer to the message headers
+
+==============================================================================*/
+static char *GetHeaders( IOTSendState *pState, uint64_t chunk )
+{
+    char *pHeaders = pState->pHeaders;
+
+    if ( pState->headerTemplate.dynamic == true )
+    {
+        pHeaders = TEMPLATE_Render( &pState->headerTemplate, chunk );
+    }
+
+    return pHeaders;
+}
+
+/*============================================================================*/
+/*  StartSpool                                                                */
+/*!
+    Open the store-and-forward spool
+
+    The StartSpool function opens the spool if spool mode is enabled.
+    Any messages spooled by a previous run are forwarded by the spool's
+    drainer thread, and new messages are spooled behind them until the
+    spool is empty so the messages are delivered in order.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK the spool was opened or is not required
+    @retval other error from SPOOL_Open
+
+==============================================================================*/
+static int StartSpool( IOTSendState *pState )
+{
+    int result = EOK;
+
+    if ( pState->spoolDir != NULL )
+    {
+        result = SPOOL_Open( &pState->spool,
+                             pState->spoolDir,
+                             pState->spoolFsync,
+                             &pState->rateLimit,
+                             pState->verbose );
+        if ( result == EOK )
+        {
+            pState->pSpool = &pState->spool;
+
+            /* the drainer forwards messages like a sender thread */
+            result = PLACEMENT_Sender( &pState->placement,
+                                       pState->spool.thread );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Connect                                                                   */
+/*!
+    Connect to the IOTHub service
+
+    The Connect function creates a connection to the IOTHub service,
+    retrying with backoff according to the retry policy if it cannot
+    be created.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval handle to the IOTClient connection
+    @retval NULL the connection could not be created
+
+==============================================================================*/
+static IOTCLIENT_HANDLE Connect( IOTSendState *pState )
+{
+    IOTCLIENT_HANDLE hIoTClient;
+    unsigned int attempts = 1;
+
+    hIoTClient = IOTCLIENT_Create();
+    while ( ( hIoTClient == NULL ) &&
+            ( RETRY_ShouldRetry( &pState->retry,
+                                 ECONNREFUSED,
+                                 attempts ) == true ) &&
+            ( Stopping( pState ) == false ) )
+    {
+        /* a stop may be requested while waiting to reconnect */
+        Backoff( pState, attempts );
+        hIoTClient = IOTCLIENT_Create();
+        attempts++;
+    }
+
+    STATS_Link( ( hIoTClient != NULL ) ? EOK : ECONNREFUSED );
+
+    if ( ( hIoTClient == NULL ) && ( pState->verbose == true ) )
+    {
+        fprintf( stderr,
+                 "Cannot connect after %u attempts\n",
+                 attempts );
+    }
+
+    return hIoTClient;
+}
+
+/*============================================================================*/
+/*  SendDirect                                                                */
+/*!
+    Send a message on the main connection
+
+    The SendDirect function sends a message on the main IOTClient
+    connection, retrying with backoff according to the retry policy
+    while it fails with a retryable error, until the drain deadline
+    once iotsend is stopping.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pHeaders
+            pointer to the message headers
+
+    @param[in]
+        pPayload
+            pointer to the payload data
+
+    @param[in]
+        len
+            length of the payload data
+
+    @retval EOK the message was sent
+    @retval other error from IOTCLIENT_Send
+
+==============================================================================*/
+static int SendDirect( IOTSendState *pState,
+                       char *pHeaders,
+                       char *pPayload,
+                       size_t len )
+{
+    int result;
+    unsigned int attempts = 1;
+    uint64_t begin;
+
+    begin = STATS_Clock();
+    result = IOTCLIENT_Send( pState->hIoTClient, pHeaders, pPayload, len );
+    STATS_Sent( begin, len, result );
+    while ( ( RETRY_ShouldRetry( &pState->retry, result, attempts ) ) &&
+            ( Expired( pState ) == false ) )
+    {
+        /* a stop may be requested while waiting to send again */
+        Backoff( pState, attempts );
+        begin = STATS_Clock();
+        result = IOTCLIENT_Send( pState->hIoTClient,
+                                 pHeaders,
+                                 pPayload,
+                                 len );
+        STATS_Sent( begin, len, result );
+        attempts++;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StreamDirect                                                              */
+/*!
+    Stream an input on the main connection
+
+    The StreamDirect function streams a regular file on the main
+    IOTClient connection.  The file is rewound and streamed again with
+    backoff according to the retry policy while it fails with a
+    retryable error.  Pipes are not streamed since the IOTClient
+    library would wait for their input with no way to stop it.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pHeaders
+            pointer to the message headers
+
+    @param[in]
+        fd
+            input file descriptor
+
+    @retval EOK the input was sent
+    @retval ETIMEDOUT iotsend stopped while waiting for the rate limiter
+    @retval other error from IOTCLIENT_Stream
+
+==============================================================================*/
+static int StreamDirect( IOTSendState *pState, char *pHeaders, int fd )
+{
+    int result;
+    unsigned int attempts = 1;
+    off_t start;
+    uint64_t begin;
+
+    start = lseek( fd, 0, SEEK_CUR );
+
+    result = Pace( pState, 0 );
+    if ( result == EOK )
+    {
+        begin = STATS_Clock();
+        result = IOTCLIENT_Stream( pState->hIoTClient, pHeaders, fd );
+        STATS_Sent( begin, 0, result );
+    }
+
+    while ( ( start != (off_t)-1 ) &&
+            ( RETRY_ShouldRetry( &pState->retry, result, attempts ) == true ) &&
+            ( Expired( pState ) == false ) &&
+            ( lseek( fd, start, SEEK_SET ) == start ) )
+    {
+        Backoff( pState, attempts );
+        begin = STATS_Clock();
+        result = IOTCLIENT_Stream( pState->hIoTClient, pHeaders, fd );
+        STATS_Sent( begin, 0, result );
+        attempts++;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StartPipelines                                                            */
+/*!
+    Start the send pipelines
+
+    The StartPipelines function starts a send pipeline for each
+    connection if a maximum number of messages in flight or more than
+    one connection was specified.  The first pipeline uses the main
+    IOTClient connection and a new connection is created for each of
+    the others, each with its own sender thread.
+
+    The pipeline slots are sized for the longest possible message
+    headers, including the sequence headers of a chunked transfer.
+
+    With a priority FIFO or an input source with high priority headers,
+    each pipeline has a high priority lane.  With a priority FIFO, each
+    pipeline also has its own connection, so the main connection is only
+    used by the main thread while urgent messages are sent at any time.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK the pipelines were started or are not required
+    @retval ENOMEM memory allocation failed
+    @retval ECONNREFUSED a connection could not be created
+    @retval other error from PIPELINE_Init
+
+==============================================================================*/
+static int StartPipelines( IOTSendState *pState )
+{
+    int result = EOK;
+    size_t headerSize;
+    size_t i;
+    IOTCLIENT_HANDLE hIoTClient;
+
+    if ( ( pState->priorityFifo != NULL ) ||
+         ( pState->mux.highPriority == true ) )
+    {
+        pState->lanes = PIPELINE_MAX_LANES;
+    }
+
+    if ( ( ( pState->connections > 1 ) || ( pState->lanes > 1 ) ) &&
+         ( pState->inflight == 0 ) )
+    {
+        pState->inflight = DEFAULT_INFLIGHT;
+    }
+
+    if ( ( pState->inflight > 0 ) && ( pState->hIoTClient != NULL ) )
+    {
+        headerSize = strlen( pState->pHeaders ) + 1;
+        if ( pState->headerTemplate.size > headerSize )
+        {
+            headerSize = pState->headerTemplate.size;
+        }
+
+        if ( pState->mux.headerSize > headerSize )
+        {
+            headerSize = pState->mux.headerSize;
+        }
+
+        if ( pState->framed == true )
+        {
+            /* leave space for the headers added by a frame */
+            headerSize += FRAME_MAX_HEADERS + 2;
+        }
+
+        if ( pState->lanes > 1 )
+        {
+            headerSize += sizeof( "\n" PRIORITY_HEADER );
+        }
+
+        pState->pPipelines = calloc( pState->connections, sizeof( Pipeline ) );
+        if ( pState->pPipelines == NULL )
+        {
+            result = ENOMEM;
+        }
+
+        for ( i = 0; ( i < pState->connections ) && ( result == EOK ); i++ )
+        {
+            hIoTClient = pState->hIoTClient;
+            if ( ( i > 0 ) || ( pState->priorityFifo != NULL ) )
+            {
+                hIoTClient = Connect( pState );
+                if ( hIoTClient == NULL )
+                {
+                    result = ECONNREFUSED;
+                    break;
+                }
+
+                IOTCLIENT_SetVerbose( hIoTClient, pState->verbose );
+            }
+
+            /* a retry must not overtake the messages of its shard */
+            result = PIPELINE_Init( &pState->pPipelines[i],
+                                    hIoTClient,
+                                    pState->inflight,
+                                    pState->lanes,
+                                    headerSize + CHUNK_HEADER_SIZE,
+                                    MAX_IOT_MSG_SIZE,
+                                    pState->verbose,
+                                    &pState->retry,
+                                    ( pState->shardKey != NULL ) );
+            if ( result == EOK )
+            {
+                PIPELINE_SetSpool( &pState->pPipelines[i], pState->pSpool );
+                result = PLACEMENT_Sender( &pState->placement,
+                                           pState->pPipelines[i].thread );
+            }
+            else if ( hIoTClient != pState->hIoTClient )
+            {
+                IOTCLIENT_Close( hIoTClient );
+            }
+        }
+
+        if ( result != EOK )
+        {
+            StopPipelines( pState );
+        }
+    }
+
+    if ( result == EOK )
+    {
+        STATS_SetSampler( SampleStats, pState );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StartPriority                                                             */
+/*!
+    Start reading urgent messages from the priority FIFO
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK the priority reader was started or is not required
+    @retval ENOTCONN there is no connection to send urgent messages on
+    @retval other error from PRIORITY_Start
+
+==============================================================================*/
+static int StartPriority( IOTSendState *pState )
+{
+    int result = EOK;
+
+    if ( pState->priorityFifo != NULL )
+    {
+        result = ( pState->pPipelines != NULL )
+                 ? PRIORITY_Start( &pState->priority,
+                                   pState->priorityFifo,
+                                   pState->delimiter,
+                                   pState->pHeaders,
+                                   pState->pPipelines,
+                                   pState->connections,
+                                   &pState->rateLimit,
+                                   pState->verbose )
+                 : ENOTCONN;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  DrainPipelines                                                            */
+/*!
+    Wait for the messages in all the send pipelines to be sent
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK every message was sent or spooled
+    @retval other error of a message which was given up on since the
+            pipelines were last drained
+
+==============================================================================*/
+static int DrainPipelines( IOTSendState *pState )
+{
+    int result = EOK;
+    size_t i;
+    int rc;
+
+    if ( pState->pPipelines != NULL )
+    {
+        for ( i = 0; i < pState->connections; i++ )
+        {
+            rc = PIPELINE_Drain( &pState->pPipelines[i] );
+            if ( result == EOK )
+            {
+                result = rc;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StopPipelines                                                             */
+/*!
+    Shut down the send pipelines
+
+    The StopPipelines function waits for the messages in flight to be
+    sent, stops the sender threads, and closes the additional
+    connections.  When iotsend is stopping, the messages which are not
+    sent by the drain deadline are spooled, or reported as lost.  A stop
+    requested while waiting for the messages in flight sets the drain
+    deadline, so a message which keeps failing does not hold up the
+    exit.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK every message was sent or spooled
+    @retval ECANCELED messages in flight were lost at the drain deadline
+    @retval other the last error reported by a pipeline
+
+==============================================================================*/
+static int StopPipelines( IOTSendState *pState )
+{
+    int result = EOK;
+    int rc;
+    size_t i;
+    size_t pending;
+    Pipeline *pPipeline;
+    bool stopping;
+    sigset_t mask;
+    struct timespec ts;
+
+    if ( pState->pPipelines != NULL )
+    {
+        /* a stop is only requested while waiting for the pipelines */
+        UnmaskedTermination( &mask );
+        ts.tv_sec = 0;
+        ts.tv_nsec = DRAIN_POLL_MS * 1000000L;
+
+        do
+        {
+            pending = 0;
+            for ( i = 0; i < pState->connections; i++ )
+            {
+                pending += PIPELINE_Pending( &pState->pPipelines[i] );
+            }
+
+            stopping = Stopping( pState );
+        } while ( ( pending > 0 ) &&
+                  ( stopping == false ) &&
+                  ( ( ppoll( NULL, 0, &ts, &mask ) >= 0 ) ||
+                    ( errno == EINTR ) ) );
+
+        /* stop sampling the queues before they are released */
+        STATS_SetSampler( NULL, NULL );
+
+        for ( i = 0; i < pState->connections; i++ )
+        {
+            pPipeline = &pState->pPipelines[i];
+            if ( pPipeline->running == true )
+            {
+                if ( stopping == true )
+                {
+                    PIPELINE_SetDeadline( pPipeline, pState->drainDeadline );
+                }
+
+                rc = PIPELINE_Shutdown( pPipeline );
+                if ( ( rc == ECANCELED ) && ( pState->pSpool == NULL ) )
+                {
+                    fprintf( stderr,
+                             "Drain deadline expired: "
+                             "messages in flight were not sent\n" );
+                }
+
+                if ( ( rc != EOK ) &&
+                     ( ( rc != ECANCELED ) || ( pState->pSpool == NULL ) ) )
+                {
+                    result = rc;
+                }
+
+                if ( pPipeline->hIoTClient != pState->hIoTClient )
+                {
+                    IOTCLIENT_Close( pPipeline->hIoTClient );
+                }
+            }
+        }
+
+        free( pState->pPipelines );
+        pState->pPipelines = NULL;
+
+        /* keep sampling the spool */
+        STATS_SetSampler( SampleStats, pState );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SampleStats                                                               */
+/*!
+    Sample the statistics gauges
+
+    The SampleStats function is called by the statistics reporter thread
+    to sample the number of messages waiting in the spool and queued in
+    the send pipelines.
+
+    @param[in]
+        pArg
+            pointer to the IOTSendState
+
+    @param[out]
+        pGauges
+            pointer to the array of STATS_GAUGES gauges to fill in
+
+==============================================================================*/
+static void SampleStats( void *pArg, uint64_t *pGauges )
+{
+    IOTSendState *pState = (IOTSendState *)pArg;
+    Pipeline *pPipeline;
+    size_t i;
+    size_t lane;
+
+    pGauges[STATS_SPOOL_DEPTH] = SPOOL_Pending( pState->pSpool );
+
+    if ( pState->pPipelines != NULL )
+    {
+        for ( i = 0; i < pState->connections; i++ )
+        {
+            pPipeline = &pState->pPipelines[i];
+            if ( pPipeline->running == true )
+            {
+                for ( lane = 0; lane < pPipeline->laneCount; lane++ )
+                {
+                    pGauges[STATS_QUEUE_DEPTH] +=
+                        RING_Count( &pPipeline->lanes[lane] );
+                }
+            }
+        }
+    }
+}
+
+/*============================================================================*/
+/*  SelectPipeline                                                            */
+/*!
+    Select the send pipeline for a message
+
+    The SelectPipeline function selects the connection used to send a
+    message.  If a shard key was specified and the message headers
+    contain it, the connection is selected by a hash of the key's
+    value so all the messages with the same value are sent in order
+    over the same connection.  Otherwise the connections are used in
+    turn.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pHeaders
+            headers of the message
+
+    @retval pointer to the selected pipeline
+
+==============================================================================*/
+static Pipeline *SelectPipeline( IOTSendState *pState, char *pHeaders )
+{
+    size_t idx = 0;
+    const char *pValue = NULL;
+    size_t len = 0;
+    uint32_t hash = 2166136261u;
+
+    if ( pState->connections > 1 )
+    {
+        if ( pState->shardKey != NULL )
+        {
+            pValue = HEADERS_Lookup( pHeaders, pState->shardKey, &len );
+        }
+
+        if ( pValue != NULL )
+        {
+            /* FNV-1a hash of the shard key value */
+            while ( len-- > 0 )
+            {
+                hash = ( hash ^ (unsigned char)*pValue++ ) * 16777619u;
+            }
+
+            idx = hash % pState->connections;
+        }
+        else
+        {
+            idx = pState->nextConnection;
+            pState->nextConnection = ( idx + 1 ) % pState->connections;
+        }
+    }
+
+    return &pState->pPipelines[idx];
+}
+
+/*============================================================================*/
+/*  SendRecords                                                               */
+/*!
+    Send a message for each record read from the input
+
+    The SendRecords function keeps the IOTClient connection open and
+    sends one message for each delimited record read from the standard
+    input, from the input file, or from the named FIFO if one was
+    specified.  Each record is sent as soon as its delimiter has been
+    received using the headers prepared from the command line.
+    Empty records are ignored.  In framed mode the input is read as
+    length prefixed frames rather than delimited records.
+
+    In daemon mode, when the writer closes the FIFO, the FIFO is
+    re-opened and the daemon waits for the next writer.  Otherwise
+    the function returns when the input reaches end of file.
+
+    A record which cannot be sent does not stop the input.  The error
+    of the last record which could not be sent is returned once the
+    input has been processed.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK the input was processed until end of file and every
+            record was sent
+    @retval EINVAL invalid arguments
+    @retval other error reading the input or sending a record
+
+==============================================================================*/
+static int SendRecords( IOTSendState *pState )
+{
+    int result = EINVAL;
+    int rc;
+    int err = EOK;
+    int fd = STDIN_FILENO;
+    char *name = "stdin";
+    RecordReader reader;
+    char *pHeaders;
+    char *pRecord;
+    size_t len;
+    size_t size = MAX_IOT_MSG_SIZE;
+    sigset_t mask;
+
+    memset( &reader, 0, sizeof( RecordReader ) );
+
+    if ( pState != NULL )
+    {
+        if ( pState->fifoName != NULL )
+        {
+            name = pState->fifoName;
+            fd = OpenFIFO( pState, name );
+        }
+        else if ( pState->fileName != NULL )
+        {
+            name = pState->fileName;
+            fd = open( name, O_RDONLY );
+        }
+
+        if ( ( fd == -1 ) && ( Stopping( pState ) == true ) )
+        {
+            /* stopped before a writer opened the FIFO, so the reader
+               has nothing to return */
+            result = EOK;
+        }
+        else if ( fd == -1 )
+        {
+            result = errno;
+            fprintf( stderr, "Cannot open %s: %s\n", name, strerror( result ) );
+        }
+        else if ( pState->batching == true )
+        {
+            /* leave space for the batch framing so any record fits */
+            size -= BATCH_OVERHEAD;
+            result = BATCH_Init( &pState->batch,
+                                 pState->batchFormat,
+                                 MAX_IOT_MSG_SIZE,
+                                 pState->batchBytes,
+                                 pState->batchCount,
+                                 pState->lingerMs );
+        }
+        else
+        {
+            result = EOK;
+        }
+
+        if ( ( result == EOK ) && ( pState->framed == true ) )
+        {
+            /* a frame holds its header and header block as well as
+               the largest record */
+            size += FRAME_HEADER_SIZE + FRAME_MAX_HEADERS;
+
+            pState->frameHeadersSize = strlen( pState->pHeaders ) + 1;
+            if ( pState->headerTemplate.size > pState->frameHeadersSize )
+            {
+                pState->frameHeadersSize = pState->headerTemplate.size;
+            }
+
+            pState->frameHeadersSize += FRAME_MAX_HEADERS + 2;
+            pState->pFrameHeaders = POOL_Alloc( pState->frameHeadersSize );
+            if ( pState->pFrameHeaders == NULL )
+            {
+                result = ENOMEM;
+            }
+        }
+
+        if ( result == EOK )
+        {
+            /* a stop is only requested while waiting for input */
+            UnmaskedTermination( &mask );
+            result = READER_Init( &reader, fd, pState->delimiter, size );
+            READER_SetInterruptible( &reader, &mask );
+        }
+
+        while ( result == EOK )
+        {
+            if ( pState->batching == true )
+            {
+                /* wake up when the oldest batched record must be sent */
+                READER_SetTimeout( &reader,
+                                   BATCH_GetTimeout( &pState->batch ) );
+            }
+
+            if ( Stopping( pState ) == true )
+            {
+                /* stop accepting input but send what was already read */
+                READER_Stop( &reader );
+            }
+
+            rc = NextRecord( pState, &reader, &pHeaders, &pRecord, &len );
+            if ( ( rc == EOK ) || ( rc == E2BIG ) )
+            {
+                if ( rc == E2BIG )
+                {
+                    fprintf( stderr,
+                             "Warning: Max message size exceeded\n"
+                             "Record will be split!\n" );
+                }
+
+                rc = SendRecord( pState, pHeaders, pRecord, len );
+                if ( rc != EOK )
+                {
+                    /* carry on with the input but report the failure */
+                    err = rc;
+                }
+            }
+            else if ( rc == EMSGSIZE )
+            {
+                fprintf( stderr,
+                         "Warning: Max message size exceeded\n"
+                         "Frame discarded!\n" );
+            }
+            else if ( rc == EBADMSG )
+            {
+                fprintf( stderr, "Invalid frame on %s\n", name );
+                result = rc;
+            }
+            else if ( rc == ETIMEDOUT )
+            {
+                /* the linger time of the batch has expired, or the
+                   wait was interrupted by a stop */
+                rc = FlushBatch( pState );
+                if ( rc != EOK )
+                {
+                    err = rc;
+                }
+            }
+            else if ( ( rc == ENODATA ) &&
+                      ( pState->daemon == true ) &&
+                      ( pState->fifoName != NULL ) &&
+                      ( Stopping( pState ) == false ) )
+            {
+                /* don't hold the batch while waiting for the next writer */
+                rc = FlushBatch( pState );
+                if ( rc != EOK )
+                {
+                    err = rc;
+                }
+
+                /* the writer has closed the FIFO, wait for the next one */
+                close( fd );
+                fd = OpenFIFO( pState, pState->fifoName );
+                if ( fd != -1 )
+                {
+                    READER_Reset( &reader, fd );
+                    READER_SetInterruptible( &reader, &mask );
+                }
+                else if ( Stopping( pState ) == true )
+                {
+                    /* stopped while waiting for the next writer */
+                    break;
+                }
+                else
+                {
+                    result = errno;
+                }
+            }
+            else if ( rc == ENODATA )
+            {
+                /* end of the input */
+                break;
+            }
+            else
+            {
+                result = rc;
+            }
+        }
+
+        rc = FlushBatch( pState );
+        if ( rc != EOK )
+        {
+            err = rc;
+        }
+
+        if ( result == EOK )
+        {
+            /* report the last message which could not be sent */
+            result = err;
+        }
+
+        if ( ( fd != STDIN_FILENO ) && ( fd != -1 ) )
+        {
+            close( fd );
+        }
+
+        READER_Free( &reader );
+        BATCH_Free( &pState->batch );
+
+        POOL_Free( pState->pFrameHeaders, pState->frameHeadersSize );
+        pState->pFrameHeaders = NULL;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  NextRecord                                                                */
+/*!
+    Get the next record from the input
+
+    The NextRecord function gets the next delimited record, or in
+    framed mode the next frame, from the input.  The header block of
+    a frame is merged with the prepared headers to give the headers
+    of the record.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pReader
+            pointer to the record reader of the input
+
+    @param[out]
+        ppHeaders
+            pointer to a location to store the headers of the record,
+            or NULL if the record uses the prepared headers
+
+    @param[out]
+        ppRecord
+            pointer to a location to store a pointer to the record data
+
+    @param[out]
+        pLen
+            pointer to a location to store the record length
+
+    @retval EOK a record was returned
+    @retval other error from READER_Next or READER_NextFrame
+
+==============================================================================*/
+static int NextRecord( IOTSendState *pState,
+                       RecordReader *pReader,
+                       char **ppHeaders,
+                       char **ppRecord,
+                       size_t *pLen )
+{
+    int result;
+    char *pFrameHeaders = NULL;
+    size_t headersLen = 0;
+
+    *ppHeaders = NULL;
+
+    if ( pState->framed == true )
+    {
+        result = READER_NextFrame( pReader,
+                                   &pFrameHeaders,
+                                   &headersLen,
+                                   ppRecord,
+                                   pLen );
+        if ( ( result == EOK ) && ( headersLen > 0 ) )
+        {
+            if ( HEADERS_Merge( GetHeaders( pState, 0 ),
+                                pFrameHeaders,
+                                headersLen,
+                                pState->pFrameHeaders,
+                                pState->frameHeadersSize ) == EOK )
+            {
+                *ppHeaders = pState->pFrameHeaders;
+            }
+            else if ( pState->verbose == true )
+            {
+                fprintf( stderr, "Cannot merge frame headers\n" );
+            }
+        }
+    }
+    else
+    {
+        result = READER_Next( pReader, ppRecord, pLen );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StartSources                                                              */
+/*!
+    Open the input sources
+
+    The StartSources function opens the input sources given on the
+    command line, before the send pipelines are started so they can be
+    sized for the headers of the sources.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK the input sources were opened or are not required
+    @retval other error from MUX_Init or MUX_Add
+
+==============================================================================*/
+static int StartSources( IOTSendState *pState )
+{
+    int result = EOK;
+    size_t i;
+
+    pState->mux.epfd = -1;
+
+    if ( pState->sourceCount > 0 )
+    {
+        result = MUX_Init( &pState->mux,
+                           pState->delimiter,
+                           MAX_IOT_MSG_SIZE,
+                           pState->pHeaders,
+                           SourceRecord,
+                           pState,
+                           pState->verbose );
+    }
+
+    for ( i = 0; ( i < pState->sourceCount ) && ( result == EOK ); i++ )
+    {
+        result = MUX_Add( &pState->mux, pState->sources[i] );
+        if ( result != EOK )
+        {
+            fprintf( stderr,
+                     "Cannot open %s: %s\n",
+                     pState->sources[i],
+                     strerror( result ) );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SendSources                                                               */
+/*!
+    Send a message for each record read from the input sources
+
+    The SendSources function runs the event loop which reads records
+    from every input source and sends them, flushing the batch when
+    its linger time expires.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EINVAL invalid arguments
+    @retval other error from MUX_Wait or BATCH_Init
+
+==============================================================================*/
+static int SendSources( IOTSendState *pState )
+{
+    int result = EOK;
+    int timeout = -1;
+    sigset_t mask;
+
+    if ( pState->batching == true )
+    {
+        result = BATCH_Init( &pState->batch,
+                             pState->batchFormat,
+                             MAX_IOT_MSG_SIZE,
+                             pState->batchBytes,
+                             pState->batchCount,
+                             pState->lingerMs );
+    }
+
+    /* a stop is only requested while waiting for input */
+    UnmaskedTermination( &mask );
+
+    while ( ( ( result == EOK ) || ( result == ETIMEDOUT ) ) &&
+            ( Stopping( pState ) == false ) )
+    {
+        if ( pState->batching == true )
+        {
+            /* wake up when the oldest batched record must be sent */
+            timeout = BATCH_GetTimeout( &pState->batch );
+        }
+
+        result = MUX_Wait( &pState->mux, timeout, &mask );
+        if ( result == ETIMEDOUT )
+        {
+            FlushBatch( pState );
+        }
+    }
+
+    if ( result == ETIMEDOUT )
+    {
+        /* stopped while waiting for input */
+        result = EOK;
+    }
+
+    FlushBatch( pState );
+    BATCH_Free( &pState->batch );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SourceRecord                                                              */
+/*!
+    Send a record read from an input source
+
+    @param[in]
+        pArg
+            pointer to the IOTSendState
+
+    @param[in]
+        pHeaders
+            headers of the source, or NULL for the prepared headers
+
+    @param[in]
+        pRecord
+            pointer to the record data
+
+    @param[in]
+        len
+            length of the record data
+
+    @retval EOK the record was sent, batched, or ignored
+    @retval other error from SendRecord
+
+==============================================================================*/
+static int SourceRecord( void *pArg,
+                         char *pHeaders,
+                         char *pRecord,
+                         size_t len )
+{
+    return SendRecord( (IOTSendState *)pArg, pHeaders, pRecord, len );
+}
+
+/*============================================================================*/
+/*  StartTelemetry                                                            */
+/*!
+    Subscribe to the variables forwarded on change
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK the variables were subscribed to, or none were specified
+    @retval other error from TELEMETRY_Open
+
+==============================================================================*/
+static int StartTelemetry( IOTSendState *pState )
+{
+    int result = EOK;
+
+    if ( pState->telemetryVars != NULL )
+    {
+        result = TELEMETRY_Open( &pState->telemetry,
+                                 pState->telemetryVars,
+                                 pState->windowMs,
+                                 pState->deadband,
+                                 pState->minIntervalMs,
+                                 pState->verbose );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SendTelemetry                                                             */
+/*!
+    Forward variable changes
+
+    The SendTelemetry function sends a message holding the variables
+    which have changed at the end of each coalescing window, over the
+    persistent connection.  When iotsend is stopping, the pending
+    changes are sent without waiting for the end of the window.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval other error waiting for change notifications
+
+==============================================================================*/
+static int SendTelemetry( IOTSendState *pState )
+{
+    int result = EOK;
+    sigset_t mask;
+
+    /* a stop is only requested while waiting for changes */
+    UnmaskedTermination( &mask );
+
+    while ( ( result == EOK ) && ( Stopping( pState ) == false ) )
+    {
+        result = TELEMETRY_Wait( &pState->telemetry,
+                                 &mask,
+                                 TelemetryMessage,
+                                 pState );
+    }
+
+    if ( result == EOK )
+    {
+        result = TELEMETRY_Flush( &pState->telemetry,
+                                  TelemetryMessage,
+                                  pState );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  TelemetryMessage                                                          */
+/*!
+    Send a message holding changed variables
+
+    @param[in]
+        pArg
+            pointer to the IOTSendState
+
+    @param[in]
+        pData
+            pointer to the JSON object holding the changed variables
+
+    @param[in]
+        len
+            length of the message
+
+    @retval EOK the message was sent, batched, or spooled
+    @retval other error from SendRecord
+
+==============================================================================*/
+static int TelemetryMessage( void *pArg, char *pData, size_t len )
+{
+    return SendRecord( (IOTSendState *)pArg, NULL, pData, len );
+}
+
+/*============================================================================*/
+/*  SendWatched                                                               */
+/*!
+    Send the files dropped into the watched directory
+
+    The SendWatched function sends each file which is dropped into the
+    watch directory as a message over the persistent connection, and
+    deletes it, or moves it into the done directory, once it has been
+    delivered.  If a file cannot be delivered, the directory is scanned
+    again after a retry delay.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EINVAL the directory watcher failed
+    @retval other error opening the watch directory
+
+==============================================================================*/
+static int SendWatched( IOTSendState *pState )
+{
+    int result;
+    Watch watch;
+    unsigned int failures = 0;
+    int rc;
+    sigset_t mask;
+
+    result = WATCH_Open( &watch,
+                         pState->watchDir,
+                         pState->watchDone,
+                         pState->verbose );
+    if ( result != EOK )
+    {
+        fprintf( stderr,
+                 "Cannot watch %s: %s\n",
+                 pState->watchDir,
+                 strerror( result ) );
+    }
+
+    /* a stop is only requested while waiting for files */
+    UnmaskedTermination( &mask );
+
+    while ( ( result == EOK ) && ( Stopping( pState ) == false ) )
+    {
+        rc = WATCH_Wait( &watch, -1, &mask, WatchedFile, pState );
+        if ( rc == EINVAL )
+        {
+            result = rc;
+        }
+        else if ( ( rc == EOK ) || ( rc == ETIMEDOUT ) )
+        {
+            failures = 0;
+        }
+        else
+        {
+            /* back off before offering the waiting files again */
+            failures++;
+            Backoff( pState, failures );
+        }
+    }
+
+    WATCH_Close( &watch );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WatchedFile                                                               */
+/*!
+    Send a file dropped into the watched directory
+
+    The WatchedFile function sends a file the same way as a file given
+    on the command line, and waits for it to leave the send pipelines
+    so it is only completed once it has been delivered or spooled.
+
+    @param[in]
+        pArg
+            pointer to the IOTSendState
+
+    @param[in]
+        pPath
+            path of the file
+
+    @retval EOK the file was delivered or spooled
+    @retval other error sending the file
+
+==============================================================================*/
+static int WatchedFile( void *pArg, const char *pPath )
+{
+    IOTSendState *pState = (IOTSendState *)pArg;
+    char *fileName = pState->fileName;
+    int result;
+
+    pState->fileName = (char *)pPath;
+    result = SendMessage( pState );
+    pState->fileName = fileName;
+
+    if ( result == EOK )
+    {
+        result = DrainPipelines( pState );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SendRecord                                                                */
+/*!
+    Send a single record
+
+    The SendRecord function sends a record as an IOTHub message using
+    the prepared message headers, or adds it to the current batch if
+    batching is enabled.  A record with headers of its own is sent on
+    its own since the records of a batch share their headers.  In
+    newline delimited mode a trailing carriage return is removed from
+    the record.  Empty records are not sent, and neither are records
+    which repeat the last record of their stream when duplicates are
+    suppressed.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pHeaders
+            headers of the record, or NULL for the prepared headers
+
+    @param[in]
+        pRecord
+            pointer to the record data
+
+    @param[in]
+        len
+            length of the record data
+
+    @retval EOK the record was sent, batched, or ignored
+    @retval EINVAL invalid arguments
+    @retval other error from IOTCLIENT_Send
+
+==============================================================================*/
+static int SendRecord( IOTSendState *pState,
+                       char *pHeaders,
+                       char *pRecord,
+                       size_t len )
+{
+    int result = EINVAL;
+    char *pKeyHeaders;
+
+    if ( ( pState != NULL ) && ( pRecord != NULL ) )
+    {
+        if ( ( pState->delimiter == '\n' ) &&
+             ( pState->framed == false ) &&
+             ( len > 0 ) &&
+             ( pRecord[len-1] == '\r' ) )
+        {
+            len--;
+        }
+
+        result = EOK;
+
+        /* the stream of a record without headers is identified by
+           the prepared headers */
+        pKeyHeaders = ( pHeaders != NULL ) ? pHeaders : pState->pHeaders;
+
+        if ( ( len > 0 ) &&
+             ( IsDuplicate( pState, pKeyHeaders, pRecord, len ) == false ) )
+        {
+            if ( pHeaders != NULL )
+            {
+                result = SendContent( pState, pHeaders, pRecord, len );
+            }
+            else if ( pState->batching == true )
+            {
+                result = BatchRecord( pState, pRecord, len );
+            }
+            else
+            {
+                result = SendContent( pState,
+                                      GetHeaders( pState, 0 ),
+                                      pRecord,
+                                      len );
+            }
+
+            if ( result != EOK )
+            {
+                /* send the record again if it is repeated */
+                DEDUP_Forget( &pState->dedupFilter, pKeyHeaders );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  IsDuplicate                                                               */
+/*!
+    Check whether a payload repeats the last payload of its stream
+
+    The IsDuplicate function checks a payload against the duplicate
+    filter if duplicates are suppressed, and counts the payloads which
+    are not sent.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pHeaders
+            headers which identify the stream of the payload
+
+    @param[in]
+        pPayload
+            pointer to the payload data
+
+    @param[in]
+        len
+            length of the payload data
+
+    @retval true the payload is unchanged and should not be sent
+    @retval false the payload should be sent
+
+==============================================================================*/
+static bool IsDuplicate( IOTSendState *pState,
+                         char *pHeaders,
+                         char *pPayload,
+                         size_t len )
+{
+    bool duplicate = false;
+
+    if ( ( pState->dedup == true ) &&
+         ( DEDUP_Check( &pState->dedupFilter,
+                        pHeaders,
+                        pPayload,
+                        len ) == EALREADY ) )
+    {
+        STATS_Add( STATS_DEDUPED, 1 );
+        duplicate = true;
+    }
+
+    return duplicate;
+}
+
+/*============================================================================*/
+/*  BatchRecord                                                               */
+/*!
+    Add a record to the current batch
+
+    The BatchRecord function adds a record to the current batch.
+    If the record does not fit, the batch is flushed first.  The
+    batch is flushed after the record is added if it has reached
+    its size or count threshold.  A record which can never fit in a
+    batch is sent as a message of its own after the current batch.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pRecord
+            pointer to the record data
+
+    @param[in]
+        len
+            length of the record data
+
+    @retval EOK the record was batched or sent
+    @retval other error sending the batch or the record
+
+==============================================================================*/
+static int BatchRecord( IOTSendState *pState, char *pRecord, size_t len )
+{
+    int result;
+    int rc = EOK;
+
+    result = BATCH_Add( &pState->batch, pRecord, len );
+    if ( result == ENOSPC )
+    {
+        /* keep the record even if the full batch could not be sent */
+        rc = FlushBatch( pState );
+        result = BATCH_Add( &pState->batch, pRecord, len );
+    }
+
+    if ( result == E2BIG )
+    {
+        /* send the batched records first to keep them in order */
+        rc = FlushBatch( pState );
+        result = SendContent( pState, GetHeaders( pState, 0 ), pRecord, len );
+    }
+    else if ( ( result == EOK ) &&
+              ( BATCH_IsFull( &pState->batch ) == true ) )
+    {
+        result = FlushBatch( pState );
+    }
+
+    if ( result == EOK )
+    {
+        /* report a batch which was flushed to make room */
+        result = rc;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FlushBatch                                                                */
+/*!
+    Send the current batch
+
+    The FlushBatch function sends the records in the current batch
+    as a single IOTHub message and empties the batch.  Nothing is
+    sent if the batch is empty.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK the batch was sent or was empty
+    @retval other error from IOTCLIENT_Send
+
+==============================================================================*/
+static int FlushBatch( IOTSendState *pState )
+{
+    int result = EOK;
+    char *pData;
+    size_t len;
+
+    pData = BATCH_GetData( &pState->batch, &len );
+    if ( pData != NULL )
+    {
+        result = SendContent( pState, GetHeaders( pState, 0 ), pData, len );
+        BATCH_Clear( &pState->batch );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SendChunks                                                                */
+/*!
+    Send the input as a chunked transfer
+
+    The SendChunks function splits the input into chunks of up to
+    the configured chunk size and sends them back-to-back over the
+    IOTClient connection.  Each chunk carries sequence headers which
+    identify its position in the transfer.
+
+    If a compressor is specified, its compressed output is chunked
+    instead of the input.  Unless chunked mode was requested, an input
+    which turns out to fit in a single chunk is sent as an ordinary
+    message.
+
+    If a checkpoint file is specified, the progress of the transfer of
+    a regular file is saved as its chunks are acknowledged, and the
+    transfer stops at the first chunk which cannot be sent so it can be
+    resumed from that chunk.  The checkpoint is removed once the
+    transfer is complete.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pMessageHeaders
+            pointer to the headers of the message being split, or NULL
+            to render the configured headers for every chunk
+
+    @param[in]
+        fd
+            input file descriptor
+
+    @param[in]
+        size
+            size of the input, or 0 if unknown
+
+    @param[in]
+        pMap
+            pointer to the memory mapped input, or NULL to read the input
+            from the file descriptor
+
+    @param[in]
+        pCompressor
+            pointer to a started compressor to read the compressed input
+            from, or NULL to send the input uncompressed
+
+    @retval EOK all the chunks were sent
+    @retval other error reading the input or sending a chunk
+
+==============================================================================*/
+static int SendChunks( IOTSendState *pState,
+                       char *pMessageHeaders,
+                       int fd,
+                       uint64_t size,
+                       char *pMap,
+                       Compressor *pCompressor )
+{
+    int result;
+    int rc;
+    int sendResult;
+    ChunkTransfer transfer;
+    Checkpoint checkpoint;
+    StreamInput input;
+    bool checkpointed = false;
+    char *pBaseHeaders;
+    char *pHeaders;
+    char *pData;
+    size_t len;
+
+    result = CHUNK_Init( &transfer,
+                         ( pMessageHeaders != NULL ) ? pMessageHeaders
+                                                     : pState->pHeaders,
+                         pState->chunkSize,
+                         size );
+    if ( ( result == EOK ) && ( pMap != NULL ) )
+    {
+        result = CHUNK_Map( &transfer, pMap, size );
+    }
+
+    if ( ( result == EOK ) && ( pCompressor != NULL ) )
+    {
+        result = CHUNK_SetSource( &transfer, ReadCompressed, pCompressor );
+    }
+    else if ( ( result == EOK ) && ( pMap == NULL ) && ( size == 0 ) )
+    {
+        /* wait for the input of a stream so a stop can end the wait */
+        input.pState = pState;
+        input.fd = fd;
+        result = CHUNK_SetSource( &transfer, ReadStream, &input );
+    }
+    else if ( ( result == EOK ) &&
+              ( pState->checkpointFile != NULL ) &&
+              ( size > 0 ) )
+    {
+        /* only a regular file can be resumed */
+        result = StartCheckpoint( pState, &transfer, fd, pMap, &checkpoint );
+        checkpointed = ( result == EOK );
+    }
+
+    if ( result == EOK )
+    {
+        do
+        {
+            if ( pMessageHeaders != NULL )
+            {
+                /* every chunk carries the headers of its message */
+                pBaseHeaders = pMessageHeaders;
+                rc = EOK;
+            }
+            else if ( pState->headerTemplate.dynamic == true )
+            {
+                /* render the headers for this chunk */
+                pBaseHeaders = GetHeaders( pState, transfer.index );
+                rc = CHUNK_SetHeaders( &transfer, pBaseHeaders );
+            }
+            else
+            {
+                pBaseHeaders = GetHeaders( pState, transfer.index );
+                rc = EOK;
+            }
+
+            if ( rc == EOK )
+            {
+                rc = CHUNK_Next( &transfer, fd, &pData, &len, &pHeaders );
+            }
+
+            if ( ( rc == EOK ) &&
+                 ( pState->chunked == false ) &&
+                 ( transfer.index == 1 ) &&
+                 ( transfer.done == true ) )
+            {
+                /* the input fits in a single message */
+                pHeaders = pBaseHeaders;
+            }
+            else if ( ( rc == EOK ) &&
+                      ( transfer.index == 1 ) &&
+                      ( pState->verbose == true ) )
+            {
+                fprintf( stderr, "Transfer id: %s\n", transfer.transferId );
+            }
+
+            if ( rc == EOK )
+            {
+                sendResult = SendPayload( pState, pHeaders, pData, len );
+                if ( ( sendResult == EOK ) && ( checkpointed == true ) )
+                {
+                    sendResult = SaveCheckpoint( pState,
+                                                 &transfer,
+                                                 &checkpoint );
+                }
+
+                if ( sendResult != EOK )
+                {
+                    result = sendResult;
+                }
+
+                if ( ( sendResult != EOK ) && ( checkpointed == true ) )
+                {
+                    /* stop so the transfer resumes from this chunk */
+                    rc = sendResult;
+                }
+            }
+        } while ( rc == EOK );
+
+        if ( rc != ENODATA )
+        {
+            result = rc;
+        }
+
+        if ( ( result == EOK ) && ( checkpointed == true ) )
+        {
+            /* the transfer is complete */
+            CHECKPOINT_Remove( pState->checkpointFile );
+        }
+
+        CHUNK_Free( &transfer );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StartCheckpoint                                                           */
+/*!
+    Start recording the progress of a chunked transfer
+
+    The StartCheckpoint function resumes the transfer recorded in the
+    checkpoint file if resuming was requested and the checkpoint was
+    written for the same input file, chunk size, and file contents, as
+    identified by its size and modification time.  Otherwise a new
+    transfer is started.
+
+    A memory mapped input is resumed by slicing the mapping from the
+    checkpoint offset, and an input which is read is positioned at the
+    offset, so the bytes which were already sent are not read again.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in]
+        fd
+            input file descriptor
+
+    @param[in]
+        pMap
+            pointer to the memory mapped input, or NULL if the input is
+            read from the file descriptor
+
+    @param[out]
+        pCheckpoint
+            pointer to the checkpoint of the transfer
+
+    @retval EOK the transfer progress will be recorded
+    @retval other error positioning the input or resuming the transfer
+
+==============================================================================*/
+static int StartCheckpoint( IOTSendState *pState,
+                            ChunkTransfer *pTransfer,
+                            int fd,
+                            char *pMap,
+                            Checkpoint *pCheckpoint )
+{
+    int result = EOK;
+    Checkpoint previous;
+    struct stat st;
+    int rc = ENOENT;
+
+    if ( fstat( fd, &st ) != 0 )
+    {
+        result = errno;
+    }
+    else
+    {
+        memset( pCheckpoint, 0, sizeof( Checkpoint ) );
+        pCheckpoint->chunkSize = pState->chunkSize;
+        pCheckpoint->size = st.st_size;
+        pCheckpoint->mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ull +
+                             st.st_mtim.tv_nsec;
+
+        if ( pState->resume == true )
+        {
+            rc = CHECKPOINT_Load( &previous, pState->checkpointFile );
+        }
+
+        if ( ( rc == EOK ) &&
+             ( ( previous.chunkSize != pCheckpoint->chunkSize ) ||
+               ( previous.size != pCheckpoint->size ) ||
+               ( previous.mtime != pCheckpoint->mtime ) ) )
+        {
+            fprintf( stderr,
+                     "Checkpoint %s does not match the input: "
+                     "starting a new transfer\n",
+                     pState->checkpointFile );
+        }
+        else if ( rc == EOK )
+        {
+            if ( ( pMap == NULL ) &&
+                 ( lseek( fd, (off_t)previous.offset, SEEK_SET ) == -1 ) )
+            {
+                result = errno;
+            }
+            else
+            {
+                result = CHUNK_Resume( pTransfer,
+                                       previous.transferId,
+                                       previous.index,
+                                       previous.offset );
+            }
+
+            if ( ( result == EOK ) && ( pState->verbose == true ) )
+            {
+                fprintf( stderr,
+                         "Resuming transfer %s at chunk %zu\n",
+                         previous.transferId,
+                         previous.index );
+            }
+        }
+        else if ( rc == EBADMSG )
+        {
+            fprintf( stderr,
+                     "Checkpoint %s is damaged: starting a new transfer\n",
+                     pState->checkpointFile );
+        }
+    }
+
+    if ( result == EOK )
+    {
+        memcpy( pCheckpoint->transferId,
+                pTransfer->transferId,
+                sizeof( pCheckpoint->transferId ) );
+        pCheckpoint->index = pTransfer->index;
+        pCheckpoint->offset = pTransfer->offset;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SaveCheckpoint                                                            */
+/*!
+    Record the progress of a chunked transfer
+
+    The SaveCheckpoint function saves the checkpoint of a chunked
+    transfer once the chunks returned so far have been acknowledged.
+    Chunks which are sent directly are acknowledged when they are sent
+    or spooled.  Pipelined chunks are only acknowledged once the send
+    pipelines are drained, which is done every CHECKPOINT_INTERVAL
+    chunks and at the last chunk so the chunks stay pipelined.
+
+    A checkpoint which cannot be saved is reported, and the transfer
+    continues without it.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in,out]
+        pCheckpoint
+            pointer to the checkpoint of the transfer
+
+    @retval EOK the chunks were acknowledged
+    @retval other error sending one of the pipelined chunks
+
+==============================================================================*/
+static int SaveCheckpoint( IOTSendState *pState,
+                           ChunkTransfer *pTransfer,
+                           Checkpoint *pCheckpoint )
+{
+    int result = EOK;
+    int rc;
+
+    if ( ( pState->pPipelines == NULL ) ||
+         ( pTransfer->index % CHECKPOINT_INTERVAL == 0 ) ||
+         ( pTransfer->done == true ) )
+    {
+        result = DrainPipelines( pState );
+        if ( ( result == EOK ) && ( pTransfer->done == false ) )
+        {
+            pCheckpoint->index = pTransfer->index;
+            pCheckpoint->offset = pTransfer->offset;
+
+            rc = CHECKPOINT_Save( pCheckpoint, pState->checkpointFile );
+            if ( rc != EOK )
+            {
+                fprintf( stderr,
+                         "Cannot save checkpoint %s: %s\n",
+                         pState->checkpointFile,
+                         strerror( rc ) );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StartCompression                                                          */
+/*!
+    Start the payload compressor
+
+    The StartCompression function creates the payload compressor and
+    allocates the buffer used to compress a single message payload if
+    compression is enabled.  The compression dictionary, if any, is
+    loaded once here and used for every message.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval EOK the compressor was started or is not required
+    @retval ENOTSUP the codec is not supported by this build
+    @retval ENOMEM memory allocation failed
+    @retval other error loading the dictionary
+
+==============================================================================*/
+static int StartCompression( IOTSendState *pState )
+{
+    int result = EOK;
+
+    if ( pState->codec != COMPRESS_NONE )
+    {
+        result = COMPRESS_Init( &pState->compressor, pState->codec );
+        if ( ( result == EOK ) && ( pState->dictName != NULL ) )
+        {
+            result = COMPRESS_LoadDictionary( &pState->compressor,
+                                              pState->dictName );
+            if ( result != EOK )
+            {
+                fprintf( stderr,
+                         "Cannot load dictionary %s: %s\n",
+                         pState->dictName,
+                         strerror( result ) );
+            }
+        }
+
+        if ( result == EOK )
+        {
+            pState->pCompressed = POOL_Alloc( MAX_IOT_MSG_SIZE );
+            if ( pState->pCompressed == NULL )
+            {
+                result = ENOMEM;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  StopCompression                                                           */
+/*!
+    Release the payload compressor
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+==============================================================================*/
+static void StopCompression( IOTSendState *pState )
+{
+    if ( pState->codec != COMPRESS_NONE )
+    {
+        COMPRESS_Free( &pState->compressor );
+    }
+
+    if ( pState->pCompressed != NULL )
+    {
+        POOL_Free( pState->pCompressed, MAX_IOT_MSG_SIZE );
+        pState->pCompressed = NULL;
+    }
+}
+
+/*============================================================================*/
+/*  SendContent                                                               */
+/*!
+    Send a message payload, compressing it if required
+
+    The SendContent function sends a record, batch, or mapped file as
+    a message payload.  If compression is enabled, the payload is
+    compressed and the compressed size is checked against the maximum
+    message size.  A payload which does not compress enough to fit is
+    compressed again as a stream and sent as a chunked transfer whose
+    chunks carry the headers of the message.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pHeaders
+            pointer to the message headers
+
+    @param[in]
+        pPayload
+            pointer to the payload data
+
+    @param[in]
+        len
+            length of the payload data
+
+    @retval EOK the payload was sent
+    @retval EIO a compression error occurred
+    @retval other error from SendPayload or SendChunks
+
+==============================================================================*/
+static int SendContent( IOTSendState *pState,
+                        char *pHeaders,
+                        char *pPayload,
+                        size_t len )
+{
+    int result;
+    size_t n = 0;
+
+    if ( pState->codec == COMPRESS_NONE )
+    {
+        result = SendPayload( pState, pHeaders, pPayload, len );
+    }
+    else
+    {
+        result = COMPRESS_StartMem( &pState->compressor, pPayload, len );
+        if ( result == EOK )
+        {
+            result = COMPRESS_Read( &pState->compressor,
+                                    pState->pCompressed,
+                                    MAX_IOT_MSG_SIZE,
+                                    &n );
+        }
+
+        if ( ( result == EOK ) && ( n < MAX_IOT_MSG_SIZE ) )
+        {
+            result = SendPayload( pState, pHeaders, pState->pCompressed, n );
+        }
+        else if ( result == EOK )
+        {
+            result = COMPRESS_StartMem( &pState->compressor, pPayload, len );
+            if ( result == EOK )
+            {
+                result = SendChunks( pState,
+                                     pHeaders,
+                                     -1,
+                                     0,
+                                     NULL,
+                                     &pState->compressor );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  TrainDictionary                                                           */
+/*!
+    Train a zstd compression dictionary
+
+    The TrainDictionary function implements the train command.  It
+    trains a zstd dictionary from the newline delimited sample
+    messages in the sample files and writes it to the dictionary file
+    for use with the --zdict option.
+
+    @param[in]
+        argc
+            number of train command arguments
+
+    @param[in]
+        argv
+            train command arguments: the dictionary file name followed by
+            the sample file names
+
+    @retval EOK the dictionary was created
+    @retval EINVAL invalid arguments
+    @retval other error from COMPRESS_TrainDictionary
+
+==============================================================================*/
+static int TrainDictionary( int argc, char **argv )
+{
+    int result = EINVAL;
+
+    if ( argc >= 2 )
+    {
+        result = COMPRESS_TrainDictionary( argv[0],
+                                           &argv[1],
+                                           argc - 1,
+                                           COMPRESS_DICT_SIZE );
+        if ( result != EOK )
+        {
+            fprintf( stderr,
+                     "Cannot create dictionary %s: %s\n",
+                     argv[0],
+                     strerror( result ) );
+        }
+    }
+    else
+    {
+        fprintf( stderr,
+                 "usage: iotsend train <dictionary> <sample>"
+                 " [<sample>...]\n" );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ReadCompressed                                                            */
+/*!
+    Read the compressed input of a chunked transfer
+
+    The ReadCompressed function is the chunked transfer read function
+    used to chunk the output of the payload compressor.
+
+    @param[in]
+        pArg
+            pointer to the Compressor
+
+    @param[in]
+        pBuf
+            pointer to the chunk buffer
+
+    @param[in]
+        size
+            size of the chunk buffer
+
+    @param[out]
+        pLen
+            pointer to a location to store the number of bytes read
+
+    @retval EOK compressed data was read
+    @retval other error from COMPRESS_Read
+
+==============================================================================*/
+static int ReadCompressed( void *pArg, char *pBuf, size_t size, size_t *pLen )
+{
+    return COMPRESS_Read( (Compressor *)pArg, pBuf, size, pLen );
+}
+
+/*============================================================================*/
+/*  ReadStream                                                                */
+/*!
+    Read the input of a stream into a chunk
+
+    The ReadStream function is the chunked transfer read function of a
+    stream such as a pipe.  It reads until the chunk buffer is full or
+    the end of the input is reached.  It waits for the input with the
+    termination signals unblocked and checks for a stop between reads,
+    so a stop ends the input and the data already read is sent.
+
+    @param[in]
+        pArg
+            pointer to the StreamInput
+
+    @param[in]
+        pBuf
+            pointer to the chunk buffer
+
+    @param[in]
+        size
+            size of the chunk buffer
+
+    @param[out]
+        pLen
+            pointer to a location to store the number of bytes read
+
+    @retval EOK the chunk was read, or the input ended
+    @retval other error from ppoll() or read()
+
+==============================================================================*/
+static int ReadStream( void *pArg, char *pBuf, size_t size, size_t *pLen )
+{
+    StreamInput *pInput = (StreamInput *)pArg;
+    int result = EOK;
+    size_t len = 0;
+    ssize_t rc = 1;
+    struct pollfd pfd;
+    sigset_t mask;
+
+    pfd.fd = pInput->fd;
+    pfd.events = POLLIN;
+
+    UnmaskedTermination( &mask );
+
+    while ( ( len < size ) &&
+            ( rc != 0 ) &&
+            ( result == EOK ) &&
+            ( Stopping( pInput->pState ) == false ) )
+    {
+        pfd.revents = 0;
+        rc = ppoll( &pfd, 1, NULL, &mask );
+        if ( rc > 0 )
+        {
+            rc = read( pInput->fd, &pBuf[len], size - len );
+        }
+
+        if ( rc > 0 )
+        {
+            len += rc;
+            STATS_Add( STATS_BYTES_READ, rc );
+        }
+        else if ( ( rc == -1 ) && ( errno != EINTR ) && ( errno != EAGAIN ) )
+        {
+            result = errno;
+        }
+    }
+
+    *pLen = len;
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SendPayload                                                               */
+/*!
+    Send a message payload
+
+    The SendPayload function sends a message payload to the IOTHub
+    service.  If the send pipelines are enabled, the message is queued
+    to be sent by the sender thread of the selected connection and an
+    error sending it is reported when the pipeline is shut down.
+
+    A message with a priority:high header is queued in the high priority
+    lane of the pipeline when priority lanes are enabled.
+
+    Messages sent to the hub are paced by the rate limiter.  A message
+    still waiting for the rate limiter at the drain deadline is spooled
+    in spool mode, and otherwise not sent.  A message sent directly
+    which fails with a retryable error is retried according to the
+    retry policy.
+
+    In spool mode, a message which fails with a retryable error is
+    spooled, and one which fails with a fatal error is not.  While
+    there is no connection, or spooled messages are waiting to be
+    forwarded, new messages are spooled directly to keep them in order.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        pHeaders
+            pointer to the message headers
+
+    @param[in]
+        pPayload
+            pointer to the payload data
+
+    @param[in]
+        len
+            length of the payload data
+
+    @retval EOK the payload was sent
+    @retval other error from IOTCLIENT_Send
+
+==============================================================================*/
+static int SendPayload( IOTSendState *pState,
+                        char *pHeaders,
+                        char *pPayload,
+                        size_t len )
+{
+    int result = E2BIG;
+    int rc;
+
+    if ( ( pState->pSpool != NULL ) &&
+         ( ( pState->hIoTClient == NULL ) ||
+           ( SPOOL_Pending( pState->pSpool ) > 0 ) ) )
+    {
+        result = SPOOL_Append( pState->pSpool, pHeaders, pPayload, len );
+    }
+    else
+    {
+        /* pace the messages to stay within the hub quotas */
+        rc = Pace( pState, len );
+        if ( rc != EOK )
+        {
+            /* out of time to send it: forward it on the next run */
+            result = ( pState->pSpool != NULL )
+                     ? SPOOL_Append( pState->pSpool, pHeaders, pPayload, len )
+                     : rc;
+        }
+        else if ( pState->pPipelines != NULL )
+        {
+            result = PIPELINE_Submit( SelectPipeline( pState, pHeaders ),
+                                      ( ( pState->lanes > 1 ) &&
+                                        ( PRIORITY_IsHigh( pHeaders ) ) )
+                                      ? PIPELINE_LANE_HIGH
+                                      : PIPELINE_LANE_NORMAL,
+                                      pHeaders,
+                                      pPayload,
+                                      len );
+            if ( result == E2BIG )
+            {
+                /* too big for a pipeline slot: send it in order directly */
+                DrainPipelines( pState );
+            }
+        }
+    }
+
+    if ( result == E2BIG )
+    {
+        result = SendDirect( pState, pHeaders, pPayload, len );
+        if ( ( result != EOK ) &&
+             ( pState->pSpool != NULL ) &&
+             ( RETRY_IsRetryable( result ) == true ) )
+        {
+            /* store the message to forward it later */
+            result = SPOOL_Append( pState->pSpool, pHeaders, pPayload, len );
+        }
+    }
+
+    if ( ( result != EOK ) && ( pState->verbose == true ) )
+    {
+        fprintf( stderr, "Failed to send message: %s\n", strerror( result ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OpenFIFO                                                                  */
+/*!
+    Open the daemon input FIFO
+
+    The OpenFIFO function opens the named FIFO for reading, creating
+    it if it does not already exist.  The call blocks until a writer
+    has written to the FIFO or closed it, or a stop is requested.  The
+    termination signals are only unblocked while it waits, so a stop
+    requested before the wait starts ends it straight away.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        fifoName
+            name of the FIFO to open
+
+    @retval file descriptor of the opened FIFO
+    @retval -1 the FIFO could not be opened, or a stop was requested
+
+==============================================================================*/
+static int OpenFIFO( IOTSendState *pState, char *fifoName )
+{
+    int fd = -1;
+    int flags = -1;
+    int rc = -1;
+    int err;
+    struct pollfd pfd;
+    sigset_t mask;
+
+    if ( fifoName != NULL )
+    {
+        if ( ( mkfifo( fifoName, 0660 ) == 0 ) || ( errno == EEXIST ) )
+        {
+            /* opening without blocking does not wait for a writer, and
+               the FIFO only becomes readable once a writer has written
+               to it or closed it */
+            fd = open( fifoName, O_RDONLY | O_NONBLOCK );
+        }
+    }
+
+    if ( fd != -1 )
+    {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+
+        /* a stop is only requested while waiting for a writer */
+        UnmaskedTermination( &mask );
+        do
+        {
+            pfd.revents = 0;
+            rc = ppoll( &pfd, 1, NULL, &mask );
+        } while ( ( rc == -1 ) &&
+                  ( errno == EINTR ) &&
+                  ( Stopping( pState ) == false ) );
+
+        if ( rc != -1 )
+        {
+            flags = fcntl( fd, F_GETFL );
+        }
+
+        if ( ( flags == -1 ) ||
+             ( fcntl( fd, F_SETFL, flags & ~O_NONBLOCK ) == -1 ) )
+        {
+            err = errno;
+            close( fd );
+            fd = -1;
+            errno = err;
+        }
+    }
+
+    return fd;
+}
+
+/*============================================================================*/
+/*  SetupTerminationHandler                                                   */
+/*!
+    Set up the termination handler
+
+    The SetupTerminationHandler function installs the handler of the
+    SIGTERM and SIGINT signals, and blocks them.  The threads created
+    afterwards inherit the blocked signals, so they are only delivered
+    to the main thread, and only while it waits for input.  A transfer
+    which has started is therefore never interrupted.
+
+    The handler is installed without SA_RESTART so the wait for input
+    is interrupted by the signal.
+
+==============================================================================*/
+static void SetupTerminationHandler( void )
+{
+    struct sigaction sa;
+    sigset_t mask;
+
+    memset( &sa, 0, sizeof( struct sigaction ) );
+    sa.sa_sigaction = TerminationHandler;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset( &sa.sa_mask );
+
+    sigaction( SIGTERM, &sa, NULL );
+    sigaction( SIGINT, &sa, NULL );
+
+    MaskTermination( SIG_BLOCK, &mask );
+}
+
+/*============================================================================*/
+/*  TerminationHandler                                                        */
+/*!
+    Handle a termination signal
+
+    The TerminationHandler function requests a graceful stop.  The
+    main loop stops reading its input, and the messages which have
+    already been read are sent or spooled before iotsend exits.
+
+    @param[in]
+        signum
+            the signal number which triggered the handler
+
+    @param[in]
+        info
+            pointer to information about the signal
+
+    @param[in]
+        ptr
+            pointer to the signal context (unused)
+
+==============================================================================*/
+static void TerminationHandler( int signum, siginfo_t *info, void *ptr )
+{
+    (void)signum;
+    (void)info;
+    (void)ptr;
+
+    __atomic_store_n( &state.stopping, 1, __ATOMIC_RELEASE );
+}
+
+/*============================================================================*/
+/*  MaskTermination                                                           */
+/*!
+    Block or unblock the termination signals
+
+    @param[in]
+        how
+            SIG_BLOCK or SIG_UNBLOCK
+
+    @param[out]
+        pPrevious
+            pointer to a location to store the previous signal mask,
+            which is restored with pthread_sigmask( SIG_SETMASK, ... )
+
+==============================================================================*/
+static void MaskTermination( int how, sigset_t *pPrevious )
+{
+    sigset_t mask;
+
+    sigemptyset( &mask );
+    sigaddset( &mask, SIGTERM );
+    sigaddset( &mask, SIGINT );
+
+    pthread_sigmask( how, &mask, pPrevious );
+}
+
+/*============================================================================*/
+/*  UnmaskedTermination                                                       */
+/*!
+    Get the signal mask of the calling thread without the termination
+    signals
+
+    The mask is given to ppoll so the termination signals are only
+    unblocked while it waits.  A signal which arrived beforehand is
+    left pending and cuts the wait short as soon as it starts.
+
+    @param[out]
+        pMask
+            pointer to a location to store the signal mask
+
+==============================================================================*/
+static void UnmaskedTermination( sigset_t *pMask )
+{
+    pthread_sigmask( SIG_SETMASK, NULL, pMask );
+    sigdelset( pMask, SIGTERM );
+    sigdelset( pMask, SIGINT );
+}
+
+/*============================================================================*/
+/*  Backoff                                                                   */
+/*!
+    Wait before the next attempt of a failed operation
+
+    The Backoff function waits for the retry delay of an attempt.  The
+    wait ends early when a stop is requested, and once iotsend is
+    stopping it does not wait beyond the drain deadline.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        attempts
+            number of attempts made so far
+
+==============================================================================*/
+static void Backoff( IOTSendState *pState, unsigned int attempts )
+{
+    uint64_t delay;
+    uint64_t now;
+    struct timespec ts;
+    sigset_t mask;
+
+    delay = RETRY_Delay( &pState->retry, attempts, &pState->retrySeed );
+    if ( Stopping( pState ) == true )
+    {
+        now = UTIL_NowMs();
+        if ( now >= pState->drainDeadline )
+        {
+            delay = 0;
+        }
+        else if ( delay > pState->drainDeadline - now )
+        {
+            delay = pState->drainDeadline - now;
+        }
+    }
+
+    ts.tv_sec = delay / 1000;
+    ts.tv_nsec = ( delay % 1000 ) * 1000000L;
+
+    UnmaskedTermination( &mask );
+    (void)ppoll( NULL, 0, &ts, &mask );
+}
+
+/*============================================================================*/
+/*  Pace                                                                      */
+/*!
+    Wait until the rate limiter lets a message be sent
+
+    The Pace function reserves the rate limiter tokens for a message and
+    waits until they are available.  The wait ends early when a stop is
+    requested and the tokens are not due before the drain deadline.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @param[in]
+        len
+            length of the message payload
+
+    @retval EOK the message may be sent
+    @retval ETIMEDOUT iotsend is stopping and the drain deadline passed
+
+==============================================================================*/
+static int Pace( IOTSendState *pState, size_t len )
+{
+    int result;
+    uint64_t due;
+    sigset_t mask;
+
+    due = RATELIMIT_Reserve( &pState->rateLimit, len );
+
+    UnmaskedTermination( &mask );
+    while ( ( result = RATELIMIT_Wait( &pState->rateLimit,
+                                       due,
+                                       &mask ) ) == EINTR )
+    {
+        /* start the drain deadline if this signal requests a stop */
+        (void)Stopping( pState );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Stopping                                                                  */
+/*!
+    Check if a stop has been requested
+
+    The Stopping function checks if a termination signal has been
+    received.  The drain deadline starts when the stop is first seen,
+    and also bounds the rate limiter waits of the other threads.
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval true iotsend must stop
+    @retval false iotsend keeps running
+
+==============================================================================*/
+static bool Stopping( IOTSendState *pState )
+{
+    bool stopping;
+
+    stopping = ( __atomic_load_n( &pState->stopping, __ATOMIC_ACQUIRE ) != 0 );
+    if ( ( stopping == true ) && ( pState->drainDeadline == 0 ) )
+    {
+        pState->drainDeadline = UTIL_NowMs() + pState->drainMs;
+        RATELIMIT_SetDeadline( &pState->rateLimit, pState->drainDeadline );
+    }
+
+    return stopping;
+}
+
+/*============================================================================*/
+/*  Expired                                                                   */
+/*!
+    Check if the drain deadline has passed
+
+    @param[in]
+        pState
+            pointer to the IOTSendState
+
+    @retval true iotsend is stopping and the drain deadline has passed
+    @retval false iotsend keeps running or is still draining
+
+==============================================================================*/
+static bool Expired( IOTSendState *pState )
+{
+    return ( Stopping( pState ) == true ) &&
+           ( UTIL_NowMs() >= pState->drainDeadline );
+}
+
+/*============================================================================*/
+/*  usage                                                                     */
+/*!
+    Display the application usage
+
+    The usage function dumps the application usage message
+    to stderr.
+
+    @param[in]
+       cmdname
+            pointer to the invoked command name
+
+    @return none
+
+==============================================================================*/
+static void usage( char *cmdname )
+{
+    if( cmdname != NULL )
+    {
+        fprintf(stderr,
+                "usage: %s [-v] [-h] [-d] [-l] [-0] [-c] [-f fifo] [-z codec]"
+                " [<filename>]\n"
+                " [-h] : display this help\n"
+                " [-H headers]\n"
+                " [-v] : verbose output\n"
+                " [-d] : daemon mode: send one message per frame\n"
+                " [-f fifo] : read frames from a FIFO in daemon mode\n"
+                " [-l] : send one message per newline delimited record\n"
+                " [-0] : send one message per NUL delimited record\n"
+                " [--framed] : send one message per length prefixed frame\n"
+                " [--batch-bytes N] : flush a batch when it reaches N bytes\n"
+                " [--batch-count N] : flush a batch when it has N records\n"
+                " [--linger-ms N] : flush a batch after N milliseconds\n"
+                " [--batch-format json|lp] : batch framing format\n"
+                " [-c] : send the input as a chunked transfer\n"
+                " [--chunk-size N] : maximum chunk payload size\n"
+                " [--no-mmap] : read input files instead of mapping them\n"
+                " [--inflight N] : pipeline up to N messages in flight\n"
+                " [--connections N] : send over N connections\n"
+                " [--shard-key key] : select connection by header value\n"
+                " [-z gzip|zstd|lz4] : compress message payloads\n"
+                " [--zdict file] : compress with a zstd dictionary\n"
+                " [--spool dir] : spool undeliverable messages in dir\n"
+                " [--spool-fsync interval|always|never] : spool fsync policy\n"
+                " [--max-attempts N] : attempts per message (0 = no limit)\n"
+                " [--retry-base-ms N] : initial retry delay\n"
+                " [--retry-cap-ms N] : maximum retry delay\n"
+                " [--rate N] : send at most N messages per second\n"
+                " [--byte-rate N] : send at most N payload bytes per second\n"
+                " [--burst N] : send at most N messages back to back\n"
+                " [--priority-fifo fifo] : read urgent frames from a FIFO\n"
+                " [--source fifo|unix|dir|dgram:path[=headers]] :"
+                " add an input\n"
+                " [--watch dir] : send each file dropped into dir\n"
+                " [--watch-done dir] : move sent files into dir\n"
+                " [--memory-cap N] : hold at most N bytes of buffers\n"
+                " [--stats-interval N] : write statistics every N seconds\n"
+                " [--stats-socket path] : serve statistics on a socket\n"
+                " [--health prefix] : publish health variables\n"
+                " [--health-ms N] : health variable update interval\n"
+                " [--telemetry var,...] : forward variables on change\n"
+                " [--window-ms N] : coalesce changes for N milliseconds\n"
+                " [--deadband X] : ignore numeric changes smaller than X\n"
+                " [--min-interval-ms N] : forward a variable at most every"
+                " N milliseconds\n"
+                " [--dedup] : skip messages whose payload is unchanged\n"
+                " [--dedup-key key] : header which identifies a stream\n"
+                " [--heartbeat N] : send an unchanged payload every"
+                " N seconds\n"
+                " [--reader-cpus list] : run the reader on CPUs list\n"
+                " [--sender-cpus list] : run the senders on CPUs list\n"
+                " [--sender-priority N] : run the senders under SCHED_FIFO"
+                " priority N\n"
+                " [--nice N] : run iotsend at nice level N\n"
+                " [--numa-node N] : allocate buffers on NUMA node N\n"
+                " [--drain-ms N] : drain the messages for up to"
+                " N milliseconds on stop\n"
+                " [--checkpoint file] : record the progress of a chunked"
+                " transfer in file\n"
+                " [--resume] : resume the chunked transfer in the"
+                " checkpoint\n"
+                "\n"
+                "usage: %s train <dictionary> <sample> [<sample>...]\n",
+                cmdname,
+                cmdname );
+    }
+}
+
+/*============================================================================*/
+/*  ProcessOptions                                                            */
+/*!
+    Process the command line options
+
+    The ProcessOptions function processes the command line options and
+    populates the iotsend state object
 
     @param[in]
         argC
@@ -279,19 +3971,86 @@ static void usage( char *cmdname )
         pState
             pointer to the iotsend state object
 
-    @return none
+    @retval EOK the options were processed
+    @retval EINVAL an option was not recognized or had an invalid value
 
 ==============================================================================*/
 static int ProcessOptions( int argC, char *argV[], IOTSendState *pState )
 {
-    int c;
     int result = EINVAL;
-    const char *options = "hvH:";
+    int c;
+    size_t value;
+    size_t size;
+    long level;
+    char *pEnd;
+    const char *options = "hvH:df:l0cz:";
+    static const struct option longOptions[] =
+    {
+        { "help",    no_argument,       NULL, 'h' },
+        { "verbose", no_argument,       NULL, 'v' },
+        { "headers", required_argument, NULL, 'H' },
+        { "daemon",  no_argument,       NULL, 'd' },
+        { "fifo",    required_argument, NULL, 'f' },
+        { "lines",   no_argument,       NULL, 'l' },
+        { "null",    no_argument,       NULL, '0' },
+        { "batch-bytes",  required_argument, NULL, OPT_BATCH_BYTES },
+        { "batch-count",  required_argument, NULL, OPT_BATCH_COUNT },
+        { "linger-ms",    required_argument, NULL, OPT_LINGER_MS },
+        { "batch-format", required_argument, NULL, OPT_BATCH_FORMAT },
+        { "chunked",      no_argument,       NULL, 'c' },
+        { "chunk-size",   required_argument, NULL, OPT_CHUNK_SIZE },
+        { "no-mmap",      no_argument,       NULL, OPT_NO_MMAP },
+        { "inflight",     required_argument, NULL, OPT_INFLIGHT },
+        { "connections",  required_argument, NULL, OPT_CONNECTIONS },
+        { "shard-key",    required_argument, NULL, OPT_SHARD_KEY },
+        { "compress",     required_argument, NULL, 'z' },
+        { "zdict",        required_argument, NULL, OPT_ZDICT },
+        { "spool",        required_argument, NULL, OPT_SPOOL },
+        { "spool-fsync",  required_argument, NULL, OPT_SPOOL_FSYNC },
+        { "max-attempts", required_argument, NULL, OPT_MAX_ATTEMPTS },
+        { "retry-base-ms", required_argument, NULL, OPT_RETRY_BASE_MS },
+        { "retry-cap-ms", required_argument, NULL, OPT_RETRY_CAP_MS },
+        { "rate",         required_argument, NULL, OPT_RATE },
+        { "byte-rate",    required_argument, NULL, OPT_BYTE_RATE },
+        { "burst",        required_argument, NULL, OPT_BURST },
+        { "priority-fifo", required_argument, NULL, OPT_PRIORITY_FIFO },
+        { "source",       required_argument, NULL, OPT_SOURCE },
+        { "watch",        required_argument, NULL, OPT_WATCH },
+        { "watch-done",   required_argument, NULL, OPT_WATCH_DONE },
+        { "memory-cap",   required_argument, NULL, OPT_MEMORY_CAP },
+        { "stats-interval", required_argument, NULL, OPT_STATS_INTERVAL },
+        { "stats-socket", required_argument, NULL, OPT_STATS_SOCKET },
+        { "health",       required_argument, NULL, OPT_HEALTH },
+        { "health-ms",    required_argument, NULL, OPT_HEALTH_MS },
+        { "telemetry",    required_argument, NULL, OPT_TELEMETRY },
+        { "window-ms",    required_argument, NULL, OPT_WINDOW_MS },
+        { "deadband",     required_argument, NULL, OPT_DEADBAND },
+        { "min-interval-ms", required_argument, NULL, OPT_MIN_INTERVAL_MS },
+        { "dedup",        no_argument,       NULL, OPT_DEDUP },
+        { "dedup-key",    required_argument, NULL, OPT_DEDUP_KEY },
+        { "heartbeat",    required_argument, NULL, OPT_HEARTBEAT },
+        { "framed",       no_argument,       NULL, OPT_FRAMED },
+        { "reader-cpus",  required_argument, NULL, OPT_READER_CPUS },
+        { "sender-cpus",  required_argument, NULL, OPT_SENDER_CPUS },
+        { "sender-priority", required_argument, NULL, OPT_SENDER_PRIORITY },
+        { "nice",         required_argument, NULL, OPT_NICE },
+        { "numa-node",    required_argument, NULL, OPT_NUMA_NODE },
+        { "drain-ms",     required_argument, NULL, OPT_DRAIN_MS },
+        { "checkpoint",   required_argument, NULL, OPT_CHECKPOINT },
+        { "resume",       no_argument,       NULL, OPT_RESUME },
+        { NULL,      0,                 NULL, 0 }
+    };
 
     if( ( pState != NULL ) &&
         ( argV != NULL ) )
     {
-        while( ( c = getopt( argC, argV, options ) ) != -1 )
+        result = EOK;
+
+        while( ( c = getopt_long( argC,
+                                  argV,
+                                  options,
+                                  longOptions,
+                                  NULL ) ) != -1 )
         {
             switch( c )
             {
@@ -303,11 +4062,452 @@ static int ProcessOptions( int argC, char *argV[], IOTSendState *pState )
                     pState->headers = strdup(optarg);
                     break;
 
+                case 'd':
+                    pState->daemon = true;
+                    break;
+
+                case 'f':
+                    pState->fifoName = strdup(optarg);
+                    break;
+
+                case 'l':
+                    pState->records = true;
+                    pState->delimiter = '\n';
+                    break;
+
+                case '0':
+                    pState->records = true;
+                    pState->delimiter = '\0';
+                    break;
+
+                case OPT_BATCH_BYTES:
+                    pState->batching = true;
+                    if ( UTIL_ParseNumber( optarg,
+                                           &pState->batchBytes ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid batch size: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_BATCH_COUNT:
+                    pState->batching = true;
+                    if ( UTIL_ParseNumber( optarg,
+                                           &pState->batchCount ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid batch count: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_LINGER_MS:
+                    pState->batching = true;
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value > INT_MAX ) )
+                    {
+                        fprintf( stderr, "Invalid linger time: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->lingerMs = (int)value;
+                    }
+                    break;
+
+                case OPT_BATCH_FORMAT:
+                    pState->batching = true;
+                    if ( BATCH_ParseFormat( optarg,
+                                            &pState->batchFormat ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid batch format: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case 'c':
+                    pState->chunked = true;
+                    break;
+
+                case OPT_CHUNK_SIZE:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value == 0 ) ||
+                         ( value > MAX_IOT_MSG_SIZE ) )
+                    {
+                        fprintf( stderr, "Invalid chunk size: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->chunkSize = value;
+                    }
+                    break;
+
+                case OPT_NO_MMAP:
+                    pState->mmap = false;
+                    break;
+
+                case OPT_INFLIGHT:
+                    if ( UTIL_ParseNumber( optarg, &pState->inflight ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid inflight: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_CONNECTIONS:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value == 0 ) )
+                    {
+                        fprintf( stderr, "Invalid connections: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->connections = value;
+                    }
+                    break;
+
+                case OPT_SHARD_KEY:
+                    pState->shardKey = strdup(optarg);
+                    break;
+
+                case 'z':
+                    if ( COMPRESS_ParseCodec( optarg,
+                                              &pState->codec ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid codec: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_ZDICT:
+                    /* a dictionary implies zstd compression */
+                    pState->codec = COMPRESS_ZSTD;
+                    pState->dictName = strdup(optarg);
+                    break;
+
+                case OPT_SPOOL:
+                    pState->spoolDir = strdup(optarg);
+                    break;
+
+                case OPT_SPOOL_FSYNC:
+                    if ( SPOOL_ParseFsync( optarg,
+                                           &pState->spoolFsync ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid fsync policy: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_MAX_ATTEMPTS:
+                    if ( UTIL_ParseNumber( optarg, &value ) == EOK )
+                    {
+                        pState->retry.maxAttempts = value;
+                    }
+                    else
+                    {
+                        fprintf( stderr, "Invalid max attempts: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_RETRY_BASE_MS:
+                    if ( UTIL_ParseNumber( optarg, &value ) == EOK )
+                    {
+                        pState->retry.baseMs = value;
+                    }
+                    else
+                    {
+                        fprintf( stderr, "Invalid retry base: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_RETRY_CAP_MS:
+                    if ( UTIL_ParseNumber( optarg, &value ) == EOK )
+                    {
+                        pState->retry.capMs = value;
+                    }
+                    else
+                    {
+                        fprintf( stderr, "Invalid retry cap: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_RATE:
+                    if ( UTIL_ParseNumber( optarg, &pState->msgRate ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid rate: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_BYTE_RATE:
+                    if ( UTIL_ParseNumber( optarg, &pState->byteRate ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid byte rate: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_BURST:
+                    if ( UTIL_ParseNumber( optarg, &pState->burst ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid burst: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_PRIORITY_FIFO:
+                    pState->priorityFifo = strdup(optarg);
+                    break;
+
+                case OPT_SOURCE:
+                    if ( pState->sourceCount < MAX_SOURCES )
+                    {
+                        pState->sources[pState->sourceCount++] = strdup(optarg);
+                    }
+                    else
+                    {
+                        fprintf( stderr, "Too many sources: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_WATCH:
+                    pState->watchDir = strdup(optarg);
+                    break;
+
+                case OPT_WATCH_DONE:
+                    pState->watchDone = strdup(optarg);
+                    break;
+
+                case OPT_MEMORY_CAP:
+                    if ( UTIL_ParseNumber( optarg, &pState->memoryCap ) != EOK )
+                    {
+                        fprintf( stderr, "Invalid memory cap: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_STATS_INTERVAL:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value > UINT_MAX ) )
+                    {
+                        fprintf( stderr,
+                                 "Invalid statistics interval: %s\n",
+                                 optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->statsInterval = (unsigned int)value;
+                    }
+                    break;
+
+                case OPT_STATS_SOCKET:
+                    pState->statsSocket = strdup(optarg);
+                    break;
+
+                case OPT_HEALTH:
+                    pState->healthPrefix = strdup(optarg);
+                    break;
+
+                case OPT_HEALTH_MS:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value == 0 ) ||
+                         ( value > INT_MAX ) )
+                    {
+                        fprintf( stderr,
+                                 "Invalid health interval: %s\n",
+                                 optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->healthMs = (unsigned int)value;
+                    }
+                    break;
+
+                case OPT_TELEMETRY:
+                    pState->telemetryVars = strdup(optarg);
+                    break;
+
+                case OPT_WINDOW_MS:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value > INT_MAX ) )
+                    {
+                        fprintf( stderr,
+                                 "Invalid coalescing window: %s\n",
+                                 optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->windowMs = (unsigned int)value;
+                    }
+                    break;
+
+                case OPT_DEADBAND:
+                    pState->deadband = strtod( optarg, &pEnd );
+                    if ( ( pEnd == optarg ) ||
+                         ( *pEnd != '\0' ) ||
+                         ( pState->deadband < 0.0 ) )
+                    {
+                        fprintf( stderr, "Invalid deadband: %s\n", optarg );
+                        result = EINVAL;
+                        pState->deadband = 0.0;
+                    }
+                    break;
+
+                case OPT_MIN_INTERVAL_MS:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value > UINT_MAX ) )
+                    {
+                        fprintf( stderr,
+                                 "Invalid minimum interval: %s\n",
+                                 optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->minIntervalMs = (unsigned int)value;
+                    }
+                    break;
+
+                case OPT_DEDUP:
+                    pState->dedup = true;
+                    break;
+
+                case OPT_DEDUP_KEY:
+                    pState->dedup = true;
+                    pState->dedupKey = strdup(optarg);
+                    break;
+
+                case OPT_READER_CPUS:
+                    if ( PLACEMENT_ParseCpus( &pState->placement.readerCpus,
+                                              optarg ) == EOK )
+                    {
+                        pState->placement.readerPinned = true;
+                    }
+                    else
+                    {
+                        fprintf( stderr, "Invalid reader CPUs: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_SENDER_CPUS:
+                    if ( PLACEMENT_ParseCpus( &pState->placement.senderCpus,
+                                              optarg ) == EOK )
+                    {
+                        pState->placement.senderPinned = true;
+                    }
+                    else
+                    {
+                        fprintf( stderr, "Invalid sender CPUs: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    break;
+
+                case OPT_SENDER_PRIORITY:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value > INT_MAX ) ||
+                         ( (int)value <
+                           sched_get_priority_min( SCHED_FIFO ) ) ||
+                         ( (int)value >
+                           sched_get_priority_max( SCHED_FIFO ) ) )
+                    {
+                        fprintf( stderr,
+                                 "Invalid sender priority: %s\n",
+                                 optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->placement.senderPriority = (int)value;
+                    }
+                    break;
+
+                case OPT_NICE:
+                    level = strtol( optarg, &pEnd, 10 );
+                    if ( ( pEnd == optarg ) ||
+                         ( *pEnd != '\0' ) ||
+                         ( level < -20 ) ||
+                         ( level > 19 ) )
+                    {
+                        fprintf( stderr, "Invalid nice level: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->placement.nice = (int)level;
+                        pState->placement.niced = true;
+                    }
+                    break;
+
+                case OPT_NUMA_NODE:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value >= PLACEMENT_MAX_NODES ) )
+                    {
+                        fprintf( stderr, "Invalid NUMA node: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->placement.numaNode = (int)value;
+                    }
+                    break;
+
+                case OPT_DRAIN_MS:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value > UINT_MAX ) )
+                    {
+                        fprintf( stderr, "Invalid drain time: %s\n", optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->drainMs = (unsigned int)value;
+                    }
+                    break;
+
+                case OPT_CHECKPOINT:
+                    pState->checkpointFile = strdup(optarg);
+                    break;
+
+                case OPT_RESUME:
+                    pState->resume = true;
+                    break;
+
+                case OPT_FRAMED:
+                    pState->records = true;
+                    pState->framed = true;
+                    break;
+
+                case OPT_HEARTBEAT:
+                    if ( ( UTIL_ParseNumber( optarg, &value ) != EOK ) ||
+                         ( value > UINT_MAX ) )
+                    {
+                        fprintf( stderr,
+                                 "Invalid heartbeat interval: %s\n",
+                                 optarg );
+                        result = EINVAL;
+                    }
+                    else
+                    {
+                        pState->heartbeat = (unsigned int)value;
+                    }
+                    break;
+
                 case 'h':
                     usage( argV[0] );
                     break;
 
                 default:
+                    /* getopt_long has reported the unknown option */
+                    result = EINVAL;
                     break;
 
             }
@@ -317,9 +4517,25 @@ static int ProcessOptions( int argC, char *argV[], IOTSendState *pState )
         {
             pState->fileName = strdup(argV[optind]);
         }
+
+        if ( ( pState->resume == true ) &&
+             ( pState->checkpointFile == NULL ) &&
+             ( pState->fileName != NULL ) )
+        {
+            /* keep the checkpoint next to the input file */
+            size = strlen( pState->fileName ) + sizeof( CHECKPOINT_SUFFIX );
+            pState->checkpointFile = malloc( size );
+            if ( pState->checkpointFile != NULL )
+            {
+                snprintf( pState->checkpointFile,
+                          size,
+                          "%s" CHECKPOINT_SUFFIX,
+                          pState->fileName );
+            }
+        }
     }
 
-    return 0;
+    return result;
 }
 
 /*! @}
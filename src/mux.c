@@ -0,0 +1,1442 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup mux mux
+ * @brief Multiple input source multiplexer
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file mux.c
+
+    Input Multiplexer
+
+    The mux module lets a single daemon serve every producer on a
+    device.  It reads delimited records from several input sources at
+    once using one epoll event loop on the calling thread:
+
+    fifo:<path>     a named FIFO, created if it does not exist
+    unix:<path>     a UNIX stream socket accepting any number of writers
+    dir:<path>      a spool directory of files of delimited records
+    dgram:<path>    a UNIX datagram socket of one message per datagram
+
+    A source may be followed by =<headers> giving headers which are
+    added to the default message headers for its records, for example
+    fifo:/run/alarms=priority:high;type:alarm
+
+    All inputs are non-blocking and are read into input buffers taken
+    from a pool, so a slow producer never stalls the others and the
+    memory used is bounded by the size of the pool.  At most a fixed
+    number of records is read from a source for each event so a busy
+    source does not starve the others.
+
+    The files in a spool directory are read as soon as they are closed
+    by their writer or moved into the directory, and are deleted once
+    their records have been queued.  Files whose names start with a dot
+    are ignored so they can be written under a temporary name.
+
+    Each datagram received on a datagram socket is one message, so a
+    syslog style producer can send a message with a single sendto()
+    without framing it.  A datagram may start with a header section of
+    key:value lines ended by a blank line, which is merged into the
+    headers of the source.  Datagrams are received in batches with
+    recvmmsg() into buffers owned by the source.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+/* for accept4() */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <iotclient/iotclient.h>
+#include "reader.h"
+#include "headers.h"
+#include "template.h"
+#include "priority.h"
+#include "pool.h"
+#include "stats.h"
+#include "retry.h"
+#include "util.h"
+#include "mux.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! maximum number of events handled for each epoll_pwait */
+#define MUX_MAX_EVENTS          ( 16 )
+
+/*! maximum number of records read from a source for each event */
+#define MUX_RECORDS_PER_EVENT   ( 64 )
+
+/*! size of the inotify event buffer */
+#define MUX_INOTIFY_BUF_SIZE    ( 4096 )
+
+/*! number of datagrams received by each recvmmsg() call */
+#define MUX_DGRAM_BATCH         ( 8 )
+
+/*! space reserved for the header section of a datagram */
+#define MUX_DGRAM_HEADER_SIZE   ( 1024 )
+
+/*! delay before a directory with an unsent file is scanned again */
+#define MUX_RESCAN_MS           ( 1000 )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static MuxSource *NewSource( Mux *pMux,
+                             MuxSourceType type,
+                             const char *path,
+                             const char *headers );
+static int OpenFifo( Mux *pMux, MuxSource *pSource );
+static int OpenSocket( Mux *pMux, MuxSource *pSource );
+static int OpenDir( Mux *pMux, MuxSource *pSource );
+static int OpenDgram( Mux *pMux, MuxSource *pSource );
+static int Watch( Mux *pMux, MuxSource *pSource );
+static int StartReader( Mux *pMux, MuxSource *pSource );
+static void ReadRecords( Mux *pMux, MuxSource *pSource );
+static void Accept( Mux *pMux, MuxSource *pSource );
+static void ReadDatagrams( Mux *pMux, MuxSource *pSource );
+static void ReadEvents( Mux *pMux, MuxSource *pSource );
+static void ScanDir( Mux *pMux, MuxSource *pSource );
+static void ReadFile( Mux *pMux, MuxSource *pSource, const char *name );
+static int Deliver( Mux *pMux,
+                    MuxSource *pSource,
+                    char *pRecord,
+                    size_t len );
+static void CloseSource( Mux *pMux, MuxSource *pSource );
+static void FreeSource( Mux *pMux, MuxSource *pSource );
+static char *GetBuffer( Mux *pMux );
+static void PutBuffer( Mux *pMux, char *pBuf );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  MUX_Init                                                                  */
+/*!
+    Initialize an input multiplexer
+
+    @param[in]
+        pMux
+            pointer to the multiplexer to initialize
+
+    @param[in]
+        delimiter
+            record delimiter
+
+    @param[in]
+        bufferSize
+            size of each input buffer (the maximum record size)
+
+    @param[in]
+        pHeaders
+            compiled default message headers, which the headers of each
+            source are added to
+
+    @param[in]
+        pfnRecord
+            function called for each record
+
+    @param[in]
+        pArg
+            argument passed to the record function
+
+    @param[in]
+        verbose
+            report source activity on stderr
+
+    @retval EOK the multiplexer was initialized
+    @retval EINVAL invalid arguments
+    @retval other error from epoll_create1()
+
+==============================================================================*/
+int MUX_Init( Mux *pMux,
+              char delimiter,
+              size_t bufferSize,
+              const char *pHeaders,
+              MuxRecordFn pfnRecord,
+              void *pArg,
+              bool verbose )
+{
+    int result = EINVAL;
+
+    if ( ( pMux != NULL ) &&
+         ( bufferSize > 0 ) &&
+         ( pHeaders != NULL ) &&
+         ( pfnRecord != NULL ) )
+    {
+        memset( pMux, 0, sizeof( Mux ) );
+        pMux->delimiter = delimiter;
+        pMux->bufferSize = bufferSize;
+        pMux->pHeaders = pHeaders;
+        pMux->pfnRecord = pfnRecord;
+        pMux->pArg = pArg;
+        pMux->verbose = verbose;
+
+        pMux->epfd = epoll_create1( EPOLL_CLOEXEC );
+        result = ( pMux->epfd != -1 ) ? EOK : errno;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  MUX_Add                                                                   */
+/*!
+    Add an input source
+
+    The MUX_Add function opens an input source described by a source
+    specification of the form <type>:<path>[=<headers>].
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        spec
+            source specification
+
+    @retval EOK the source was added
+    @retval ENOMEM memory allocation failed
+    @retval ENOBUFS no input buffer is available for the source
+    @retval EINVAL invalid source specification
+    @retval other error opening the source
+
+==============================================================================*/
+int MUX_Add( Mux *pMux, const char *spec )
+{
+    int result = EINVAL;
+    MuxSource *pSource = NULL;
+    MuxSourceType type = MUX_SOURCE_FIFO;
+    const char *pPath = NULL;
+    const char *pHeaders;
+    char *pCopy = NULL;
+
+    if ( ( pMux != NULL ) && ( spec != NULL ) )
+    {
+        if ( strncmp( spec, "fifo:", 5 ) == 0 )
+        {
+            type = MUX_SOURCE_FIFO;
+            pPath = &spec[5];
+        }
+        else if ( strncmp( spec, "unix:", 5 ) == 0 )
+        {
+            type = MUX_SOURCE_SOCKET;
+            pPath = &spec[5];
+        }
+        else if ( strncmp( spec, "dir:", 4 ) == 0 )
+        {
+            type = MUX_SOURCE_DIR;
+            pPath = &spec[4];
+        }
+        else if ( strncmp( spec, "dgram:", 6 ) == 0 )
+        {
+            type = MUX_SOURCE_DGRAM;
+            pPath = &spec[6];
+        }
+
+        if ( pPath != NULL )
+        {
+            pCopy = strdup( pPath );
+            result = ( pCopy != NULL ) ? EOK : ENOMEM;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        /* split off the headers of the source */
+        pHeaders = NULL;
+        if ( ( pPath = strchr( pCopy, '=' ) ) != NULL )
+        {
+            pCopy[pPath - pCopy] = '\0';
+            pHeaders = pPath + 1;
+        }
+
+        pSource = NewSource( pMux, type, pCopy, pHeaders );
+        result = ( pSource != NULL ) ? EOK : ENOMEM;
+    }
+
+    if ( result == EOK )
+    {
+        switch ( type )
+        {
+            case MUX_SOURCE_SOCKET:
+                result = OpenSocket( pMux, pSource );
+                break;
+
+            case MUX_SOURCE_DIR:
+                result = OpenDir( pMux, pSource );
+                break;
+
+            case MUX_SOURCE_DGRAM:
+                result = OpenDgram( pMux, pSource );
+                break;
+
+            default:
+                result = OpenFifo( pMux, pSource );
+                break;
+        }
+
+        if ( result == EOK )
+        {
+            pSource->pNext = pMux->pSources;
+            pMux->pSources = pSource;
+        }
+        else
+        {
+            FreeSource( pMux, pSource );
+        }
+    }
+
+    free( pCopy );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  MUX_Wait                                                                  */
+/*!
+    Wait for input and read it
+
+    The MUX_Wait function waits for input on any of the sources and
+    calls the record function for each record read.  A spool directory
+    holding a file which could not be sent is scanned again after
+    MUX_RESCAN_MS, so the wait may end early.  The signal mask
+    is only installed while waiting, so a signal received while the
+    records are handled ends the next wait as soon as it starts.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or -1 to wait forever
+
+    @param[in]
+        pMask
+            signal mask installed while waiting, or NULL to wait with
+            the signal mask of the calling thread
+
+    @retval EOK input was handled
+    @retval ETIMEDOUT no input was received before the timeout, or the
+            wait was interrupted by a signal
+    @retval EINVAL invalid arguments
+    @retval other error from epoll_pwait()
+
+==============================================================================*/
+int MUX_Wait( Mux *pMux, int timeoutMs, const sigset_t *pMask )
+{
+    int result = EINVAL;
+    struct epoll_event events[MUX_MAX_EVENTS];
+    MuxSource *pSource;
+    uint64_t now;
+    int n;
+    int i;
+
+    if ( pMux != NULL )
+    {
+        /* read the files left in the spool directories by the last run,
+           or which could not be sent by the last scan */
+        now = UTIL_NowMs();
+        for ( pSource = pMux->pSources;
+              pSource != NULL;
+              pSource = pSource->pNext )
+        {
+            if ( ( pSource->scan == true ) && ( pSource->scanDue <= now ) )
+            {
+                pSource->scan = false;
+                ScanDir( pMux, pSource );
+            }
+
+            if ( ( pSource->scan == true ) &&
+                 ( ( timeoutMs < 0 ) ||
+                   ( pSource->scanDue < now + (uint64_t)timeoutMs ) ) )
+            {
+                /* wake up for the next scan */
+                timeoutMs = ( pSource->scanDue > now )
+                            ? (int)( pSource->scanDue - now )
+                            : 0;
+            }
+        }
+
+        n = epoll_pwait( pMux->epfd,
+                         events,
+                         MUX_MAX_EVENTS,
+                         timeoutMs,
+                         pMask );
+        if ( n > 0 )
+        {
+            result = EOK;
+        }
+        else if ( ( n == 0 ) || ( errno == EINTR ) )
+        {
+            /* report an interrupted wait as a timeout so the caller
+               can re-evaluate its state */
+            result = ETIMEDOUT;
+        }
+        else
+        {
+            result = errno;
+        }
+
+        for ( i = 0; i < n; i++ )
+        {
+            pSource = (MuxSource *)events[i].data.ptr;
+            switch ( pSource->type )
+            {
+                case MUX_SOURCE_SOCKET:
+                    Accept( pMux, pSource );
+                    break;
+
+                case MUX_SOURCE_DIR:
+                    ReadEvents( pMux, pSource );
+                    break;
+
+                case MUX_SOURCE_DGRAM:
+                    ReadDatagrams( pMux, pSource );
+                    break;
+
+                default:
+                    ReadRecords( pMux, pSource );
+                    break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  MUX_Free                                                                  */
+/*!
+    Close every source and free the multiplexer
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+==============================================================================*/
+void MUX_Free( Mux *pMux )
+{
+    MuxSource *pSource;
+
+    if ( pMux != NULL )
+    {
+        while ( ( pSource = pMux->pSources ) != NULL )
+        {
+            pMux->pSources = pSource->pNext;
+            FreeSource( pMux, pSource );
+        }
+
+        if ( pMux->epfd != -1 )
+        {
+            close( pMux->epfd );
+            pMux->epfd = -1;
+        }
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  NewSource                                                                 */
+/*!
+    Allocate an input source
+
+    The NewSource function allocates an input source and compiles its
+    headers by adding them to the default message headers.  The headers
+    of a datagram socket are always compiled since the header section
+    of each datagram is merged into them.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        type
+            source type
+
+    @param[in]
+        path
+            path of the source
+
+    @param[in]
+        headers
+            header specification of the source, or NULL
+
+    @retval pointer to the new source
+    @retval NULL memory allocation failed or the headers are invalid
+
+==============================================================================*/
+static MuxSource *NewSource( Mux *pMux,
+                             MuxSourceType type,
+                             const char *path,
+                             const char *headers )
+{
+    MuxSource *pSource;
+    char *pSpec;
+    size_t len;
+    size_t size;
+    int rc = ENOMEM;
+
+    pSource = calloc( 1, sizeof( MuxSource ) );
+    if ( pSource != NULL )
+    {
+        pSource->type = type;
+        pSource->fd = -1;
+        pSource->pPath = strdup( path );
+        rc = ( pSource->pPath != NULL ) ? EOK : ENOMEM;
+    }
+
+    if ( ( type == MUX_SOURCE_DGRAM ) && ( headers == NULL ) )
+    {
+        headers = "";
+    }
+
+    if ( ( rc == EOK ) &&
+         ( headers != NULL ) &&
+         ( ( *headers != '\0' ) || ( type == MUX_SOURCE_DGRAM ) ) )
+    {
+        len = strlen( pMux->pHeaders ) + strlen( headers ) + 2;
+        pSpec = malloc( len );
+        rc = ENOMEM;
+        if ( pSpec != NULL )
+        {
+            len = snprintf( pSpec, len, "%s\n%s", pMux->pHeaders, headers );
+            rc = HEADERS_Compile( &pSource->headerBlock, pSpec, len );
+            free( pSpec );
+        }
+
+        if ( rc == EOK )
+        {
+            rc = TEMPLATE_Compile( &pSource->headerTemplate,
+                                   HEADERS_Get( &pSource->headerBlock ) );
+        }
+
+        if ( rc == EOK )
+        {
+            pSource->hasHeaders = true;
+
+            size = strlen( HEADERS_Get( &pSource->headerBlock ) ) + 1;
+            if ( pSource->headerTemplate.size > size )
+            {
+                size = pSource->headerTemplate.size;
+            }
+
+            if ( size > pMux->headerSize )
+            {
+                pMux->headerSize = size;
+            }
+
+            if ( PRIORITY_IsHigh( HEADERS_Get( &pSource->headerBlock ) ) )
+            {
+                pMux->highPriority = true;
+            }
+        }
+    }
+
+    if ( ( rc != EOK ) && ( pSource != NULL ) )
+    {
+        FreeSource( pMux, pSource );
+        pSource = NULL;
+    }
+
+    return pSource;
+}
+
+/*============================================================================*/
+/*  OpenFifo                                                                  */
+/*!
+    Open a FIFO source
+
+    The FIFO is opened for reading and writing so it does not reach the
+    end of file when its writers close it.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+    @retval EOK the FIFO was opened
+    @retval other error opening the FIFO
+
+==============================================================================*/
+static int OpenFifo( Mux *pMux, MuxSource *pSource )
+{
+    int result = EOK;
+
+    if ( ( mkfifo( pSource->pPath, 0660 ) != 0 ) && ( errno != EEXIST ) )
+    {
+        result = errno;
+    }
+    else
+    {
+        pSource->fd = open( pSource->pPath, O_RDWR | O_NONBLOCK | O_CLOEXEC );
+        result = ( pSource->fd != -1 ) ? EOK : errno;
+    }
+
+    if ( result == EOK )
+    {
+        result = StartReader( pMux, pSource );
+    }
+
+    if ( result == EOK )
+    {
+        result = Watch( pMux, pSource );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OpenSocket                                                                */
+/*!
+    Open a UNIX socket source
+
+    The OpenSocket function binds a listening stream socket, or a
+    datagram socket for a datagram source.  Any stale socket left at
+    the path by a previous run is removed.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+    @retval EOK the socket is bound
+    @retval ENAMETOOLONG the socket path is too long
+    @retval other error creating the socket
+
+==============================================================================*/
+static int OpenSocket( Mux *pMux, MuxSource *pSource )
+{
+    int result = EOK;
+    struct sockaddr_un addr;
+    int type;
+
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+
+    if ( strlen( pSource->pPath ) >= sizeof( addr.sun_path ) )
+    {
+        result = ENAMETOOLONG;
+    }
+    else
+    {
+        strcpy( addr.sun_path, pSource->pPath );
+        unlink( pSource->pPath );
+
+        type = ( pSource->type == MUX_SOURCE_DGRAM ) ? SOCK_DGRAM
+                                                     : SOCK_STREAM;
+
+        pSource->fd = socket( AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+        if ( ( pSource->fd == -1 ) ||
+             ( bind( pSource->fd,
+                     (struct sockaddr *)&addr,
+                     sizeof( addr ) ) != 0 ) ||
+             ( ( type == SOCK_STREAM ) &&
+               ( listen( pSource->fd, SOMAXCONN ) != 0 ) ) )
+        {
+            result = errno;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        result = Watch( pMux, pSource );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OpenDir                                                                   */
+/*!
+    Open a spool directory source
+
+    The directory is created if it does not exist and is watched for
+    files which are closed after writing or moved into it.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+    @retval EOK the directory is watched
+    @retval other error creating or watching the directory
+
+==============================================================================*/
+static int OpenDir( Mux *pMux, MuxSource *pSource )
+{
+    int result = EOK;
+
+    if ( ( mkdir( pSource->pPath, 0750 ) != 0 ) && ( errno != EEXIST ) )
+    {
+        result = errno;
+    }
+    else
+    {
+        pSource->fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+        if ( ( pSource->fd == -1 ) ||
+             ( inotify_add_watch( pSource->fd,
+                                  pSource->pPath,
+                                  IN_CLOSE_WRITE | IN_MOVED_TO ) == -1 ) )
+        {
+            result = errno;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        pSource->scan = true;
+        result = Watch( pMux, pSource );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OpenDgram                                                                 */
+/*!
+    Open a UNIX datagram socket source
+
+    The OpenDgram function allocates the datagram buffers of the source
+    and a buffer for merging the header section of a datagram into the
+    headers of the source, then binds the socket.  Space is reserved in
+    the message headers for header sections, and since a datagram may
+    ask for high priority the high priority lane is enabled.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+    @retval EOK the socket is bound
+    @retval ENOMEM memory allocation failed
+    @retval other error from OpenSocket()
+
+==============================================================================*/
+static int OpenDgram( Mux *pMux, MuxSource *pSource )
+{
+    int result = ENOMEM;
+    size_t size;
+
+    size = strlen( HEADERS_Get( &pSource->headerBlock ) ) + 1;
+    if ( pSource->headerTemplate.size > size )
+    {
+        size = pSource->headerTemplate.size;
+    }
+
+    pSource->mergedSize = size + MUX_DGRAM_HEADER_SIZE;
+    pSource->pMerged = POOL_Alloc( pSource->mergedSize );
+    pSource->pDgramBuf = POOL_Alloc( MUX_DGRAM_BATCH * pMux->bufferSize );
+    if ( ( pSource->pMerged != NULL ) && ( pSource->pDgramBuf != NULL ) )
+    {
+        if ( pSource->mergedSize > pMux->headerSize )
+        {
+            pMux->headerSize = pSource->mergedSize;
+        }
+
+        pMux->highPriority = true;
+
+        result = OpenSocket( pMux, pSource );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Watch                                                                     */
+/*!
+    Add a source to the epoll set
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+    @retval EOK the source is watched
+    @retval other error from epoll_ctl()
+
+==============================================================================*/
+static int Watch( Mux *pMux, MuxSource *pSource )
+{
+    struct epoll_event event;
+
+    memset( &event, 0, sizeof( event ) );
+    event.events = EPOLLIN;
+    event.data.ptr = pSource;
+
+    return ( epoll_ctl( pMux->epfd, EPOLL_CTL_ADD, pSource->fd, &event ) == 0 )
+           ? EOK
+           : errno;
+}
+
+/*============================================================================*/
+/*  StartReader                                                               */
+/*!
+    Attach a pooled input buffer and a record reader to a source
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+    @retval EOK the record reader was started
+    @retval ENOBUFS every pooled input buffer is in use
+
+==============================================================================*/
+static int StartReader( Mux *pMux, MuxSource *pSource )
+{
+    int result = ENOBUFS;
+
+    pSource->pBuf = GetBuffer( pMux );
+    if ( pSource->pBuf != NULL )
+    {
+        result = READER_InitBuffer( &pSource->reader,
+                                    pSource->fd,
+                                    pMux->delimiter,
+                                    pSource->pBuf,
+                                    pMux->bufferSize );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ReadRecords                                                               */
+/*!
+    Read the records available on a FIFO or connection
+
+    A connection is closed when its writer closes it, after its final
+    unterminated record has been delivered.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+==============================================================================*/
+static void ReadRecords( Mux *pMux, MuxSource *pSource )
+{
+    char *pRecord;
+    size_t len;
+    size_t count = 0;
+    int rc = EOK;
+
+    while ( ( ( rc == EOK ) || ( rc == E2BIG ) ) &&
+            ( count++ < MUX_RECORDS_PER_EVENT ) )
+    {
+        rc = READER_Next( &pSource->reader, &pRecord, &len );
+        if ( ( rc == EOK ) || ( rc == E2BIG ) )
+        {
+            Deliver( pMux, pSource, pRecord, len );
+        }
+    }
+
+    if ( ( rc != EOK ) && ( rc != E2BIG ) && ( rc != EAGAIN ) )
+    {
+        if ( ( rc != ENODATA ) && ( pMux->verbose == true ) )
+        {
+            fprintf( stderr,
+                     "Cannot read %s: %s\n",
+                     pSource->pPath,
+                     strerror( rc ) );
+        }
+
+        if ( pSource->type == MUX_SOURCE_CONNECTION )
+        {
+            CloseSource( pMux, pSource );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Accept                                                                    */
+/*!
+    Accept the pending connections on a UNIX stream socket
+
+    A connection is refused if every pooled input buffer is in use.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the listening socket source
+
+==============================================================================*/
+static void Accept( Mux *pMux, MuxSource *pSource )
+{
+    MuxSource *pConn;
+    int fd;
+    int rc;
+
+    while ( ( fd = accept4( pSource->fd,
+                            NULL,
+                            NULL,
+                            SOCK_NONBLOCK | SOCK_CLOEXEC ) ) != -1 )
+    {
+        rc = ENOMEM;
+        pConn = NewSource( pMux, MUX_SOURCE_CONNECTION, pSource->pPath, NULL );
+        if ( pConn != NULL )
+        {
+            pConn->fd = fd;
+            pConn->pParent = pSource;
+            rc = StartReader( pMux, pConn );
+            if ( rc == EOK )
+            {
+                rc = Watch( pMux, pConn );
+            }
+
+            if ( rc == EOK )
+            {
+                pConn->pNext = pMux->pSources;
+                pMux->pSources = pConn;
+            }
+            else
+            {
+                FreeSource( pMux, pConn );
+            }
+        }
+        else
+        {
+            close( fd );
+        }
+
+        if ( ( rc != EOK ) && ( pMux->verbose == true ) )
+        {
+            fprintf( stderr,
+                     "Refused connection on %s: %s\n",
+                     pSource->pPath,
+                     strerror( rc ) );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  ReadDatagrams                                                             */
+/*!
+    Read the datagrams available on a datagram socket
+
+    The ReadDatagrams function receives datagrams in batches and
+    delivers each one as a message.  The header section at the start
+    of a datagram is merged into the headers of the source.  If it
+    cannot be merged the whole datagram is delivered as the payload.
+    A datagram larger than an input buffer is truncated by the kernel
+    and is dropped.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+==============================================================================*/
+static void ReadDatagrams( Mux *pMux, MuxSource *pSource )
+{
+    struct mmsghdr msgs[MUX_DGRAM_BATCH];
+    struct iovec iov[MUX_DGRAM_BATCH];
+    char *pHeaders;
+    char *pData;
+    size_t section;
+    size_t len;
+    size_t count = 0;
+    int n = MUX_DGRAM_BATCH;
+    int i;
+
+    memset( msgs, 0, sizeof( msgs ) );
+    for ( i = 0; i < MUX_DGRAM_BATCH; i++ )
+    {
+        iov[i].iov_base = &pSource->pDgramBuf[i * pMux->bufferSize];
+        iov[i].iov_len = pMux->bufferSize;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while ( ( n == MUX_DGRAM_BATCH ) && ( count < MUX_RECORDS_PER_EVENT ) )
+    {
+        n = recvmmsg( pSource->fd, msgs, MUX_DGRAM_BATCH, MSG_DONTWAIT, NULL );
+        if ( ( n == -1 ) &&
+             ( errno != EAGAIN ) &&
+             ( errno != EINTR ) &&
+             ( pMux->verbose == true ) )
+        {
+            fprintf( stderr,
+                     "Cannot read %s: %s\n",
+                     pSource->pPath,
+                     strerror( errno ) );
+        }
+
+        for ( i = 0; i < n; i++ )
+        {
+            pData = iov[i].iov_base;
+            len = msgs[i].msg_len;
+            STATS_Add( STATS_BYTES_READ, len );
+
+            if ( msgs[i].msg_hdr.msg_flags & MSG_TRUNC )
+            {
+                fprintf( stderr,
+                         "Warning: Max message size exceeded\n"
+                         "Datagram on %s dropped!\n",
+                         pSource->pPath );
+            }
+            else
+            {
+                pHeaders = ( pSource->headerTemplate.dynamic == true )
+                           ? TEMPLATE_Render( &pSource->headerTemplate, 0 )
+                           : HEADERS_Get( &pSource->headerBlock );
+
+                section = HEADERS_SectionLength( pData, len );
+                if ( ( section > 0 ) &&
+                     ( HEADERS_Merge( pHeaders,
+                                      pData,
+                                      section,
+                                      pSource->pMerged,
+                                      pSource->mergedSize ) == EOK ) )
+                {
+                    pHeaders = pSource->pMerged;
+                    pData += section;
+                    len -= section;
+                }
+                else if ( ( section > 0 ) && ( pMux->verbose == true ) )
+                {
+                    fprintf( stderr,
+                             "Cannot merge datagram headers on %s\n",
+                             pSource->pPath );
+                }
+
+                pMux->pfnRecord( pMux->pArg, pHeaders, pData, len );
+            }
+        }
+
+        count += MUX_DGRAM_BATCH;
+    }
+}
+
+/*============================================================================*/
+/*  ReadEvents                                                                */
+/*!
+    Read the files reported by the inotify watch of a spool directory
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the spool directory source
+
+==============================================================================*/
+static void ReadEvents( Mux *pMux, MuxSource *pSource )
+{
+    char buf[MUX_INOTIFY_BUF_SIZE]
+        __attribute__(( aligned( __alignof__( struct inotify_event ) ) ));
+    struct inotify_event *pEvent;
+    ssize_t n;
+    ssize_t offset;
+
+    while ( ( n = read( pSource->fd, buf, sizeof( buf ) ) ) > 0 )
+    {
+        for ( offset = 0;
+              offset < n;
+              offset += sizeof( *pEvent ) + pEvent->len )
+        {
+            pEvent = (struct inotify_event *)&buf[offset];
+            if ( pEvent->len > 0 )
+            {
+                ReadFile( pMux, pSource, pEvent->name );
+            }
+        }
+    }
+}
+
+/*============================================================================*/
+/*  ScanDir                                                                   */
+/*!
+    Read the files already in a spool directory
+
+    The ScanDir function stops at the first file which cannot be sent,
+    since the files behind it would most likely fail as well, and leaves
+    the rest for the next scan.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the spool directory source
+
+==============================================================================*/
+static void ScanDir( Mux *pMux, MuxSource *pSource )
+{
+    DIR *pDir;
+    struct dirent *pEntry;
+
+    pDir = opendir( pSource->pPath );
+    if ( pDir != NULL )
+    {
+        while ( ( pSource->scan == false ) &&
+                ( ( pEntry = readdir( pDir ) ) != NULL ) )
+        {
+            ReadFile( pMux, pSource, pEntry->d_name );
+        }
+
+        closedir( pDir );
+    }
+}
+
+/*============================================================================*/
+/*  ReadFile                                                                  */
+/*!
+    Read the records of a file in a spool directory
+
+    The ReadFile function delivers every record of a regular file in a
+    spool directory and deletes the file.  Hidden files are ignored.  If
+    a record fails with a retryable error, the file is kept and the
+    directory is scanned again later, so its records are delivered at
+    least once.  A record which fails with a fatal error is skipped.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the spool directory source
+
+    @param[in]
+        name
+            name of the file in the directory
+
+==============================================================================*/
+static void ReadFile( Mux *pMux, MuxSource *pSource, const char *name )
+{
+    char path[PATH_MAX];
+    RecordReader reader;
+    struct stat st;
+    char *pBuf = NULL;
+    char *pRecord;
+    size_t len;
+    int fd = -1;
+    int rc = EOK;
+    int err;
+    bool kept = false;
+
+    if ( ( name[0] == '.' ) ||
+         ( snprintf( path,
+                     sizeof( path ),
+                     "%s/%s",
+                     pSource->pPath,
+                     name ) >= (int)sizeof( path ) ) )
+    {
+        rc = EINVAL;
+    }
+    else if ( ( ( fd = open( path, O_RDONLY | O_CLOEXEC ) ) == -1 ) ||
+              ( fstat( fd, &st ) != 0 ) )
+    {
+        rc = errno;
+    }
+    else if ( !S_ISREG( st.st_mode ) )
+    {
+        rc = EINVAL;
+    }
+    else if ( ( pBuf = GetBuffer( pMux ) ) == NULL )
+    {
+        rc = ENOBUFS;
+    }
+    else
+    {
+        READER_InitBuffer( &reader,
+                           fd,
+                           pMux->delimiter,
+                           pBuf,
+                           pMux->bufferSize );
+
+        while ( ( ( rc = READER_Next( &reader, &pRecord, &len ) ) == EOK ) ||
+                ( rc == E2BIG ) )
+        {
+            err = Deliver( pMux, pSource, pRecord, len );
+            if ( ( err != EOK ) && ( RETRY_IsRetryable( err ) == true ) )
+            {
+                /* keep the file to send it again */
+                rc = err;
+                kept = true;
+                pSource->scan = true;
+                pSource->scanDue = UTIL_NowMs() + MUX_RESCAN_MS;
+                break;
+            }
+        }
+
+        READER_Free( &reader );
+
+        if ( rc == ENODATA )
+        {
+            rc = ( unlink( path ) == 0 ) ? EOK : errno;
+        }
+    }
+
+    if ( fd != -1 )
+    {
+        close( fd );
+    }
+
+    PutBuffer( pMux, pBuf );
+
+    if ( ( rc != EOK ) && ( rc != EINVAL ) && ( pMux->verbose == true ) )
+    {
+        fprintf( stderr,
+                 "Cannot %s %s: %s\n",
+                 ( kept == true ) ? "send" : "read",
+                 path,
+                 strerror( rc ) );
+    }
+}
+
+/*============================================================================*/
+/*  Deliver                                                                   */
+/*!
+    Pass a record to the record function
+
+    A connection uses the headers of the socket it was accepted on.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source the record was read from
+
+    @param[in]
+        pRecord
+            pointer to the record
+
+    @param[in]
+        len
+            length of the record
+
+    @retval EOK the record was delivered
+    @retval other error from the record function
+
+==============================================================================*/
+static int Deliver( Mux *pMux,
+                    MuxSource *pSource,
+                    char *pRecord,
+                    size_t len )
+{
+    char *pHeaders = NULL;
+
+    if ( pSource->pParent != NULL )
+    {
+        pSource = pSource->pParent;
+    }
+
+    if ( pSource->hasHeaders == true )
+    {
+        pHeaders = ( pSource->headerTemplate.dynamic == true )
+                   ? TEMPLATE_Render( &pSource->headerTemplate, 0 )
+                   : HEADERS_Get( &pSource->headerBlock );
+    }
+
+    return pMux->pfnRecord( pMux->pArg, pHeaders, pRecord, len );
+}
+
+/*============================================================================*/
+/*  CloseSource                                                               */
+/*!
+    Remove a source from the multiplexer and free it
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+==============================================================================*/
+static void CloseSource( Mux *pMux, MuxSource *pSource )
+{
+    MuxSource **ppSource = &pMux->pSources;
+
+    while ( ( *ppSource != NULL ) && ( *ppSource != pSource ) )
+    {
+        ppSource = &(*ppSource)->pNext;
+    }
+
+    if ( *ppSource != NULL )
+    {
+        *ppSource = pSource->pNext;
+    }
+
+    FreeSource( pMux, pSource );
+}
+
+/*============================================================================*/
+/*  FreeSource                                                                */
+/*!
+    Free a source
+
+    The FreeSource function closes the source, returns its input buffer
+    to the pool, and frees it.  Closing the descriptor removes it from
+    the epoll set.
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pSource
+            pointer to the source
+
+==============================================================================*/
+static void FreeSource( Mux *pMux, MuxSource *pSource )
+{
+    if ( ( ( pSource->type == MUX_SOURCE_SOCKET ) ||
+           ( pSource->type == MUX_SOURCE_DGRAM ) ) &&
+         ( pSource->fd != -1 ) )
+    {
+        unlink( pSource->pPath );
+    }
+
+    if ( pSource->fd != -1 )
+    {
+        close( pSource->fd );
+    }
+
+    READER_Free( &pSource->reader );
+    PutBuffer( pMux, pSource->pBuf );
+    POOL_Free( pSource->pDgramBuf, MUX_DGRAM_BATCH * pMux->bufferSize );
+    POOL_Free( pSource->pMerged, pSource->mergedSize );
+    HEADERS_Free( &pSource->headerBlock );
+    TEMPLATE_Free( &pSource->headerTemplate );
+    free( pSource->pPath );
+    free( pSource );
+}
+
+/*============================================================================*/
+/*  GetBuffer                                                                 */
+/*!
+    Take an input buffer from the pool
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @retval pointer to the input buffer
+    @retval NULL too many input buffers are in use, or the memory cap of
+            the buffer pool has been reached
+
+==============================================================================*/
+static char *GetBuffer( Mux *pMux )
+{
+    char *pBuf = NULL;
+
+    if ( pMux->bufferCount < MUX_MAX_BUFFERS )
+    {
+        pBuf = POOL_Alloc( pMux->bufferSize );
+        if ( pBuf != NULL )
+        {
+            pMux->bufferCount++;
+        }
+    }
+
+    return pBuf;
+}
+
+/*============================================================================*/
+/*  PutBuffer                                                                 */
+/*!
+    Return an input buffer to the pool
+
+    @param[in]
+        pMux
+            pointer to the multiplexer
+
+    @param[in]
+        pBuf
+            pointer to the input buffer, or NULL
+
+==============================================================================*/
+static void PutBuffer( Mux *pMux, char *pBuf )
+{
+    if ( pBuf != NULL )
+    {
+        POOL_Free( pBuf, pMux->bufferSize );
+        pMux->bufferCount--;
+    }
+}
+
+/*! @}
+ * end of mux group */
@@ -0,0 +1,1174 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup pipeline pipeline
+ * @brief Pipelined message sending
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file pipeline.c
+
+    Send Pipeline
+
+    The send pipeline decouples reading the input from sending messages.
+    The reader copies each message into a free slot of a ring of
+    preallocated message buffers, while a sender thread drains the ring
+    by sending each message over the IOTClient connection.
+
+    The number of slots bounds the number of messages in flight: the
+    reader blocks when every slot is queued or being sent, so memory
+    use stays bounded and the reader cannot run arbitrarily far ahead
+    of the hub.  Messages are sent in the order they were submitted.
+
+    The slots are passed between the reader and the sender thread
+    through a lock-free single producer / single consumer ring, so
+    the threads only synchronize through the kernel when the ring is
+    empty or full.  Each slot buffer starts on its own cache line.
+
+    A pipeline may have a high priority lane in front of the normal
+    lane, each with its own ring and slots.  The sender thread always
+    takes the next message from the high priority lane first, so an
+    urgent message waits for at most the message being sent, however
+    many normal messages are queued.  A large transfer is sent as a
+    sequence of chunk messages, so it is preempted at the next chunk
+    boundary.  The normal lane has a single submitter, while the
+    submitters of the high priority lane are serialized by a mutex so
+    urgent messages may come from several threads.
+
+    A message which fails with a retryable error is set aside with its
+    retry time, and the sender thread carries on with the messages
+    queued behind it, so one failing message does not stall the
+    pipeline.  The message buffers are swapped with a spare set, so
+    setting a message aside does not copy it.  Retried messages may be
+    delivered out of order.  Only when every spare buffer is in use
+    does the sender thread retry in place, which applies backpressure.
+
+    If a spool is attached, messages which the sender thread cannot
+    send are appended to the spool instead of being discarded.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <iotclient/iotclient.h>
+#include "ring.h"
+#include "spool.h"
+#include "retry.h"
+#include "pool.h"
+#include "stats.h"
+#include "pipeline.h"
+#include "util.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void *SenderThread( void *arg );
+static size_t Lane( Pipeline *pPipeline, size_t lane );
+static void SendSlot( Pipeline *pPipeline, PipelineSlot *pSlot );
+static void SendRetry( Pipeline *pPipeline, PipelineRetry *pRetry );
+static void Failed( Pipeline *pPipeline,
+                    char *pHeaders,
+                    char *pData,
+                    size_t len,
+                    int err );
+static PipelineRetry *NextRetry( Pipeline *pPipeline, int *pTimeout );
+static int InitRetries( Pipeline *pPipeline, size_t stride );
+static void SetRetrying( Pipeline *pPipeline, int delta );
+static bool Expired( Pipeline *pPipeline );
+static void Wait( Pipeline *pPipeline, unsigned int ms );
+static void FreeSlots( Pipeline *pPipeline );
+static size_t Align( size_t size );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  PIPELINE_Init                                                             */
+/*!
+    Initialize a send pipeline
+
+    The PIPELINE_Init function allocates the message slots of the
+    pipeline and starts its sender thread.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline to initialize
+
+    @param[in]
+        hIoTClient
+            IOTClient connection used to send the messages
+
+    @param[in]
+        depth
+            number of message slots of each lane
+
+    @param[in]
+        lanes
+            number of priority lanes, 1 for the normal lane only or
+            PIPELINE_MAX_LANES for a high priority lane as well
+
+    @param[in]
+        headerSize
+            maximum size of the message headers including the terminator
+
+    @param[in]
+        dataSize
+            maximum size of a message payload
+
+    @param[in]
+        verbose
+            report send errors on stderr
+
+    @param[in]
+        pRetry
+            retry policy for failed messages, or NULL to not retry
+
+    @param[in]
+        ordered
+            true to retry a failed message in place, so the messages
+            queued behind it wait until it has been sent or given up
+            on, false to send them while it waits to be retried
+
+    @retval EOK the pipeline was started
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+    @retval other error from pthread_create
+
+==============================================================================*/
+int PIPELINE_Init( Pipeline *pPipeline,
+                   IOTCLIENT_HANDLE hIoTClient,
+                   size_t depth,
+                   size_t lanes,
+                   size_t headerSize,
+                   size_t dataSize,
+                   bool verbose,
+                   const RetryPolicy *pRetry,
+                   bool ordered )
+{
+    int result = EINVAL;
+    size_t stride;
+    size_t i;
+    void *p = NULL;
+
+    if ( ( pPipeline != NULL ) &&
+         ( depth > 0 ) &&
+         ( lanes > 0 ) &&
+         ( lanes <= PIPELINE_MAX_LANES ) &&
+         ( headerSize > 0 ) )
+    {
+        memset( pPipeline, 0, sizeof( Pipeline ) );
+
+        pPipeline->hIoTClient = hIoTClient;
+        pPipeline->depth = depth;
+        pPipeline->laneCount = lanes;
+        pPipeline->headerSize = Align( headerSize );
+        pPipeline->dataSize = dataSize;
+        pPipeline->verbose = verbose;
+        pPipeline->ordered = ordered;
+        pPipeline->retry.maxAttempts = 1;
+        if ( pRetry != NULL )
+        {
+            pPipeline->retry = *pRetry;
+        }
+
+        /* each slot's headers and payload start on a cache line */
+        stride = pPipeline->headerSize + Align( dataSize );
+
+        /* the pool aligns its buffers to a cache line */
+        p = POOL_Alloc( lanes * depth * stride );
+        result = ( p != NULL ) ? EOK : ENOMEM;
+        if ( result == EOK )
+        {
+            pPipeline->pStorage = p;
+            result = posix_memalign( &p,
+                                     RING_CACHE_LINE,
+                                     lanes * depth * sizeof( PipelineSlot ) );
+        }
+
+        if ( result == EOK )
+        {
+            pPipeline->pSlots = p;
+            for ( i = 0; i < lanes * depth; i++ )
+            {
+                pPipeline->pSlots[i].pHeaders = &pPipeline->pStorage[i*stride];
+                pPipeline->pSlots[i].pData = pPipeline->pSlots[i].pHeaders +
+                                             pPipeline->headerSize;
+                pPipeline->pSlots[i].len = 0;
+            }
+
+            result = InitRetries( pPipeline, stride );
+        }
+
+        for ( i = 0; ( i < lanes ) && ( result == EOK ); i++ )
+        {
+            result = RING_Init( &pPipeline->lanes[i], depth );
+            if ( ( result == EOK ) && ( i > 0 ) )
+            {
+                /* the sender thread waits for a message in any lane */
+                result = RING_ShareEvent( &pPipeline->lanes[i],
+                                          &pPipeline->lanes[0] );
+            }
+        }
+
+        if ( result == EOK )
+        {
+            pthread_mutex_init( &pPipeline->highMutex, NULL );
+        }
+
+        if ( result == EOK )
+        {
+            result = pthread_create( &pPipeline->thread,
+                                     NULL,
+                                     SenderThread,
+                                     pPipeline );
+            if ( result == EOK )
+            {
+                pPipeline->running = true;
+            }
+        }
+
+        if ( result != EOK )
+        {
+            for ( i = 0; i < lanes; i++ )
+            {
+                RING_Free( &pPipeline->lanes[i] );
+            }
+        }
+
+        if ( result != EOK )
+        {
+            FreeSlots( pPipeline );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  PIPELINE_Submit                                                           */
+/*!
+    Submit a message to the send pipeline
+
+    The PIPELINE_Submit function copies a message into the next free
+    slot of a lane of the pipeline and queues it to be sent.  It blocks
+    while every slot of the lane is in flight.  Only one thread may
+    submit to the normal lane.  A message for a lane the pipeline does
+    not have is queued in its normal lane.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        lane
+            PIPELINE_LANE_HIGH or PIPELINE_LANE_NORMAL
+
+    @param[in]
+        pHeaders
+            NUL terminated message headers
+
+    @param[in]
+        pData
+            pointer to the message payload
+
+    @param[in]
+        len
+            length of the message payload
+
+    @retval EOK the message was queued
+    @retval E2BIG the message does not fit in a pipeline slot
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int PIPELINE_Submit( Pipeline *pPipeline,
+                     size_t lane,
+                     char *pHeaders,
+                     char *pData,
+                     size_t len )
+{
+    int result = EINVAL;
+    PipelineSlot *pSlot;
+    size_t headerLen;
+    size_t idx;
+
+    if ( ( pPipeline != NULL ) &&
+         ( pPipeline->running == true ) &&
+         ( pHeaders != NULL ) &&
+         ( ( pData != NULL ) || ( len == 0 ) ) )
+    {
+        headerLen = strlen( pHeaders );
+        if ( ( headerLen >= pPipeline->headerSize ) ||
+             ( len > pPipeline->dataSize ) )
+        {
+            result = E2BIG;
+        }
+        else
+        {
+            lane = Lane( pPipeline, lane );
+            if ( ( pPipeline->laneCount > 1 ) &&
+                 ( lane == PIPELINE_LANE_HIGH ) )
+            {
+                pthread_mutex_lock( &pPipeline->highMutex );
+            }
+
+            idx = RING_Acquire( &pPipeline->lanes[lane] );
+            pSlot = &pPipeline->pSlots[lane * pPipeline->depth + idx];
+
+            memcpy( pSlot->pHeaders, pHeaders, headerLen + 1 );
+            if ( len > 0 )
+            {
+                memcpy( pSlot->pData, pData, len );
+            }
+            pSlot->len = len;
+
+            RING_Publish( &pPipeline->lanes[lane] );
+
+            if ( ( pPipeline->laneCount > 1 ) &&
+                 ( lane == PIPELINE_LANE_HIGH ) )
+            {
+                pthread_mutex_unlock( &pPipeline->highMutex );
+            }
+
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  PIPELINE_SetSpool                                                         */
+/*!
+    Attach a spool to a send pipeline
+
+    The PIPELINE_SetSpool function attaches a spool which is used to
+    store the messages the sender thread fails to send.  It must be
+    called before any message is submitted.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        pSpool
+            pointer to the spool, or NULL to discard failed messages
+
+==============================================================================*/
+void PIPELINE_SetSpool( Pipeline *pPipeline, Spool *pSpool )
+{
+    if ( pPipeline != NULL )
+    {
+        pPipeline->pSpool = pSpool;
+    }
+}
+
+/*============================================================================*/
+/*  PIPELINE_SetDeadline                                                      */
+/*!
+    Set the deadline for sending the queued messages
+
+    The PIPELINE_SetDeadline function sets the time after which the
+    sender thread stops sending and retrying messages.  The messages
+    still queued or waiting to be retried at the deadline are appended
+    to the spool, if one is attached, or given up on with ECANCELED.
+    It is used to bound the time taken to shut down, so it wakes the
+    sender thread if it is waiting to retry a message.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        deadline
+            monotonic time in milliseconds, as from CLOCK_MONOTONIC
+
+==============================================================================*/
+void PIPELINE_SetDeadline( Pipeline *pPipeline, uint64_t deadline )
+{
+    if ( pPipeline != NULL )
+    {
+        pthread_mutex_lock( &pPipeline->retryMutex );
+        __atomic_store_n( &pPipeline->deadline, deadline, __ATOMIC_RELEASE );
+        pthread_cond_broadcast( &pPipeline->wakeCond );
+        pthread_mutex_unlock( &pPipeline->retryMutex );
+    }
+}
+
+/*============================================================================*/
+/*  PIPELINE_Pending                                                          */
+/*!
+    Get the number of messages which have not been sent yet
+
+    The PIPELINE_Pending function counts the messages queued in the
+    lanes of the pipeline, including the one being sent, and those set
+    aside to be retried.  It lets a caller wait for the pipeline to
+    drain without blocking.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @retval number of messages which have not been sent yet
+
+==============================================================================*/
+size_t PIPELINE_Pending( Pipeline *pPipeline )
+{
+    size_t pending = 0;
+    size_t i;
+
+    if ( ( pPipeline != NULL ) && ( pPipeline->running == true ) )
+    {
+        for ( i = 0; i < pPipeline->laneCount; i++ )
+        {
+            pending += RING_Count( &pPipeline->lanes[i] );
+        }
+
+        pthread_mutex_lock( &pPipeline->retryMutex );
+        pending += pPipeline->retrying;
+        pthread_mutex_unlock( &pPipeline->retryMutex );
+    }
+
+    return pending;
+}
+
+/*============================================================================*/
+/*  PIPELINE_Drain                                                            */
+/*!
+    Wait for all the queued messages to be sent
+
+    The PIPELINE_Drain function returns once every queued message has
+    been sent, spooled, or given up on, and reports whether any message
+    was given up on since the previous drain.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @retval EOK the pipeline is empty and every message was sent
+    @retval EINVAL invalid arguments
+    @retval other error of the last message given up on
+
+==============================================================================*/
+int PIPELINE_Drain( Pipeline *pPipeline )
+{
+    int result = EINVAL;
+    size_t i;
+
+    if ( ( pPipeline != NULL ) && ( pPipeline->running == true ) )
+    {
+        for ( i = 0; i < pPipeline->laneCount; i++ )
+        {
+            if ( ( pPipeline->laneCount > 1 ) &&
+                 ( i == PIPELINE_LANE_HIGH ) )
+            {
+                pthread_mutex_lock( &pPipeline->highMutex );
+                RING_WaitEmpty( &pPipeline->lanes[i] );
+                pthread_mutex_unlock( &pPipeline->highMutex );
+            }
+            else
+            {
+                RING_WaitEmpty( &pPipeline->lanes[i] );
+            }
+        }
+
+        /* wait for the messages set aside to be retried */
+        pthread_mutex_lock( &pPipeline->retryMutex );
+        while ( pPipeline->retrying > 0 )
+        {
+            pthread_cond_wait( &pPipeline->retryCond,
+                               &pPipeline->retryMutex );
+        }
+        pthread_mutex_unlock( &pPipeline->retryMutex );
+
+        result = ( pPipeline->errors == pPipeline->drainErrors )
+                 ? EOK
+                 : pPipeline->lastError;
+        pPipeline->drainErrors = pPipeline->errors;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  PIPELINE_Shutdown                                                         */
+/*!
+    Shut down a send pipeline
+
+    The PIPELINE_Shutdown function waits for all the queued messages to
+    be sent, stops the sender thread and frees the message slots.  Every
+    submitter must have stopped submitting messages.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @retval EOK all the messages were sent
+    @retval EINVAL invalid arguments
+    @retval other the last error reported while sending a message
+
+==============================================================================*/
+int PIPELINE_Shutdown( Pipeline *pPipeline )
+{
+    int result = EINVAL;
+    size_t i;
+
+    if ( ( pPipeline != NULL ) && ( pPipeline->running == true ) )
+    {
+        /* let the sender take every queued message before it is told
+           to stop */
+        for ( i = 0; i < pPipeline->laneCount; i++ )
+        {
+            RING_WaitEmpty( &pPipeline->lanes[i] );
+        }
+
+        for ( i = 0; i < pPipeline->laneCount; i++ )
+        {
+            RING_Stop( &pPipeline->lanes[i] );
+        }
+
+        pthread_join( pPipeline->thread, NULL );
+        pPipeline->running = false;
+
+        for ( i = 0; i < pPipeline->laneCount; i++ )
+        {
+            RING_Free( &pPipeline->lanes[i] );
+        }
+
+        pthread_mutex_destroy( &pPipeline->highMutex );
+        FreeSlots( pPipeline );
+
+        result = ( pPipeline->errors == 0 ) ? EOK : pPipeline->lastError;
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  SenderThread                                                              */
+/*!
+    Send the messages queued in the pipeline
+
+    The SenderThread function waits for messages to be queued and sends
+    them in order, taking the messages of the high priority lane first.
+    A slot is only released back to the submitter once its message has
+    been sent.  Once the deadline has passed, the queued messages are
+    spooled or given up on rather than sent.  The thread exits when the
+    pipeline has been stopped and the ring is empty.
+
+    @param[in]
+        arg
+            pointer to the pipeline
+
+    @retval NULL
+
+==============================================================================*/
+static void *SenderThread( void *arg )
+{
+    Pipeline *pPipeline = (Pipeline *)arg;
+    PipelineRetry *pRetry;
+    size_t lane;
+    size_t idx;
+    int timeout;
+    int rc = EOK;
+
+    while ( ( rc != ENODATA ) || ( pPipeline->retrying > 0 ) )
+    {
+        pRetry = NextRetry( pPipeline, &timeout );
+        if ( ( pRetry != NULL ) && ( timeout == 0 ) )
+        {
+            SendRetry( pPipeline, pRetry );
+        }
+        else if ( rc == ENODATA )
+        {
+            /* no more messages: wait for the next retry */
+            Wait( pPipeline, (unsigned int)timeout );
+        }
+        else
+        {
+            rc = RING_PeekFirst( pPipeline->lanes,
+                                 pPipeline->laneCount,
+                                 &lane,
+                                 &idx,
+                                 timeout );
+            if ( rc == EOK )
+            {
+                idx += lane * pPipeline->depth;
+                SendSlot( pPipeline, &pPipeline->pSlots[idx] );
+                RING_Release( &pPipeline->lanes[lane] );
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  Lane                                                                      */
+/*!
+    Map a priority lane to the lane of the pipeline
+
+    A pipeline with a single lane queues every message in that lane.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        lane
+            PIPELINE_LANE_HIGH or PIPELINE_LANE_NORMAL
+
+    @retval index of the pipeline lane
+
+==============================================================================*/
+static size_t Lane( Pipeline *pPipeline, size_t lane )
+{
+    return ( pPipeline->laneCount > 1 ) ? lane : 0;
+}
+
+/*============================================================================*/
+/*  SendSlot                                                                  */
+/*!
+    Send the message in a pipeline slot
+
+    The SendSlot function sends the message in a slot.  If it fails with
+    a retryable error, its buffers are swapped with those of a free retry
+    entry so the slot can be released straight away and the message is
+    retried later.  If the pipeline is ordered or there is no free
+    retry entry, the message is retried in place.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        pSlot
+            pointer to the slot holding the message
+
+==============================================================================*/
+static void SendSlot( Pipeline *pPipeline, PipelineSlot *pSlot )
+{
+    PipelineRetry *pRetry = NULL;
+    unsigned int attempts = 1;
+    uint64_t begin;
+    char *p;
+    size_t i;
+    int rc;
+
+    if ( Expired( pPipeline ) == true )
+    {
+        /* out of time: keep the message without sending it */
+        rc = ECANCELED;
+    }
+    else
+    {
+        begin = STATS_Clock();
+        rc = IOTCLIENT_Send( pPipeline->hIoTClient,
+                             pSlot->pHeaders,
+                             pSlot->pData,
+                             pSlot->len );
+        STATS_Sent( begin, pSlot->len, rc );
+    }
+
+    if ( ( pPipeline->ordered == false ) &&
+         ( RETRY_ShouldRetry( &pPipeline->retry, rc, attempts ) == true ) )
+    {
+        for ( i = 0; i < pPipeline->depth; i++ )
+        {
+            if ( ( pPipeline->pRetries != NULL ) &&
+                 ( pPipeline->pRetries[i].inUse == false ) )
+            {
+                pRetry = &pPipeline->pRetries[i];
+                break;
+            }
+        }
+    }
+
+    if ( pRetry != NULL )
+    {
+        /* set the message aside without copying it */
+        p = pRetry->pHeaders;
+        pRetry->pHeaders = pSlot->pHeaders;
+        pSlot->pHeaders = p;
+
+        p = pRetry->pData;
+        pRetry->pData = pSlot->pData;
+        pSlot->pData = p;
+
+        pRetry->len = pSlot->len;
+        pRetry->attempts = attempts;
+        pRetry->due = UTIL_NowMs() + RETRY_Delay( &pPipeline->retry,
+                                           attempts,
+                                           &pPipeline->seed );
+        pRetry->inUse = true;
+
+        SetRetrying( pPipeline, 1 );
+    }
+    else
+    {
+        /* the order must be kept, or every retry entry is in use:
+           retry in place */
+        while ( ( RETRY_ShouldRetry( &pPipeline->retry, rc, attempts ) ) &&
+                ( Expired( pPipeline ) == false ) )
+        {
+            Wait( pPipeline,
+                  RETRY_Delay( &pPipeline->retry,
+                               attempts,
+                               &pPipeline->seed ) );
+            if ( Expired( pPipeline ) == true )
+            {
+                /* out of time: keep the message without sending it */
+                rc = ECANCELED;
+                break;
+            }
+
+            begin = STATS_Clock();
+            rc = IOTCLIENT_Send( pPipeline->hIoTClient,
+                                 pSlot->pHeaders,
+                                 pSlot->pData,
+                                 pSlot->len );
+            STATS_Sent( begin, pSlot->len, rc );
+            attempts++;
+        }
+
+        if ( rc != EOK )
+        {
+            Failed( pPipeline, pSlot->pHeaders, pSlot->pData, pSlot->len, rc );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  SendRetry                                                                 */
+/*!
+    Retry a message which was set aside
+
+    The SendRetry function retries a message.  If it fails again with a
+    retryable error and has attempts left, it is rescheduled.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        pRetry
+            pointer to the retry entry holding the message
+
+==============================================================================*/
+static void SendRetry( Pipeline *pPipeline, PipelineRetry *pRetry )
+{
+    uint64_t begin;
+    int rc;
+
+    if ( Expired( pPipeline ) == true )
+    {
+        /* out of time: keep the message without sending it */
+        rc = ECANCELED;
+    }
+    else
+    {
+        begin = STATS_Clock();
+        rc = IOTCLIENT_Send( pPipeline->hIoTClient,
+                             pRetry->pHeaders,
+                             pRetry->pData,
+                             pRetry->len );
+        STATS_Sent( begin, pRetry->len, rc );
+        pRetry->attempts++;
+    }
+
+    if ( ( RETRY_ShouldRetry( &pPipeline->retry, rc, pRetry->attempts ) ) &&
+         ( Expired( pPipeline ) == false ) )
+    {
+        pRetry->due = UTIL_NowMs() + RETRY_Delay( &pPipeline->retry,
+                                           pRetry->attempts,
+                                           &pPipeline->seed );
+    }
+    else
+    {
+        if ( rc != EOK )
+        {
+            Failed( pPipeline,
+                    pRetry->pHeaders,
+                    pRetry->pData,
+                    pRetry->len,
+                    rc );
+        }
+
+        pRetry->inUse = false;
+        SetRetrying( pPipeline, -1 );
+    }
+}
+
+/*============================================================================*/
+/*  Failed                                                                    */
+/*!
+    Handle a message which could not be sent
+
+    The Failed function appends a message which failed with a retryable
+    error, or which was not sent by the drain deadline, to the spool if
+    one is attached, or records the error.  A message which failed with
+    a fatal error is never spooled since it would fail again when it is
+    forwarded.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        pHeaders
+            message headers
+
+    @param[in]
+        pData
+            message payload
+
+    @param[in]
+        len
+            length of the message payload
+
+    @param[in]
+        err
+            error from the last attempt to send the message
+
+==============================================================================*/
+static void Failed( Pipeline *pPipeline,
+                    char *pHeaders,
+                    char *pData,
+                    size_t len,
+                    int err )
+{
+    if ( ( pPipeline->pSpool != NULL ) &&
+         ( ( RETRY_IsRetryable( err ) == true ) || ( err == ECANCELED ) ) )
+    {
+        /* store the message to forward it later */
+        err = SPOOL_Append( pPipeline->pSpool, pHeaders, pData, len );
+    }
+
+    if ( err != EOK )
+    {
+        pPipeline->errors++;
+        pPipeline->lastError = err;
+        if ( pPipeline->verbose == true )
+        {
+            fprintf( stderr,
+                     "Failed to send message: %s\n",
+                     strerror( err ) );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  NextRetry                                                                 */
+/*!
+    Find the message which is due to be retried first
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[out]
+        pTimeout
+            pointer to a location to store the time in milliseconds until
+            the message is due, or -1 if there is none
+
+    @retval pointer to the retry entry of the message due first
+    @retval NULL no message is waiting to be retried
+
+==============================================================================*/
+static PipelineRetry *NextRetry( Pipeline *pPipeline, int *pTimeout )
+{
+    PipelineRetry *pNext = NULL;
+    uint64_t now;
+    uint64_t due;
+    uint64_t deadline;
+    size_t i;
+
+    *pTimeout = -1;
+
+    if ( pPipeline->retrying > 0 )
+    {
+        for ( i = 0; i < pPipeline->depth; i++ )
+        {
+            if ( ( pPipeline->pRetries[i].inUse == true ) &&
+                 ( ( pNext == NULL ) ||
+                   ( pPipeline->pRetries[i].due < pNext->due ) ) )
+            {
+                pNext = &pPipeline->pRetries[i];
+            }
+        }
+
+        /* wake up at the deadline to give up on the message */
+        due = pNext->due;
+        deadline = __atomic_load_n( &pPipeline->deadline, __ATOMIC_ACQUIRE );
+        if ( ( deadline != 0 ) && ( deadline < due ) )
+        {
+            due = deadline;
+        }
+
+        now = UTIL_NowMs();
+        *pTimeout = ( due > now ) ? (int)( due - now ) : 0;
+    }
+
+    return pNext;
+}
+
+/*============================================================================*/
+/*  InitRetries                                                               */
+/*!
+    Allocate the retry entries
+
+    The InitRetries function allocates a spare set of message buffers,
+    one for each slot, if the retry policy allows retries.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        stride
+            size of the buffers of one message
+
+    @retval EOK the retry entries were allocated or are not required
+    @retval ENOMEM memory allocation failed
+
+==============================================================================*/
+static int InitRetries( Pipeline *pPipeline, size_t stride )
+{
+    int result = EOK;
+    void *p = NULL;
+    size_t i;
+    pthread_condattr_t attr;
+
+    pthread_mutex_init( &pPipeline->retryMutex, NULL );
+    pthread_cond_init( &pPipeline->retryCond, NULL );
+
+    /* a retry delay is timed on the monotonic clock */
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    pthread_cond_init( &pPipeline->wakeCond, &attr );
+    pthread_condattr_destroy( &attr );
+    pPipeline->seed = RETRY_Seed() ^ (uintptr_t)pPipeline;
+
+    /* an ordered pipeline never sets a message aside */
+    if ( ( pPipeline->retry.maxAttempts != 1 ) &&
+         ( pPipeline->ordered == false ) )
+    {
+        pPipeline->pRetries = calloc( pPipeline->depth,
+                                      sizeof( PipelineRetry ) );
+        p = POOL_Alloc( pPipeline->depth * stride );
+        if ( ( p != NULL ) && ( pPipeline->pRetries != NULL ) )
+        {
+            pPipeline->pRetryStorage = p;
+            for ( i = 0; i < pPipeline->depth; i++ )
+            {
+                p = &pPipeline->pRetryStorage[i*stride];
+                pPipeline->pRetries[i].pHeaders = p;
+                pPipeline->pRetries[i].pData = (char *)p +
+                                               pPipeline->headerSize;
+            }
+        }
+        else
+        {
+            POOL_Free( p, pPipeline->depth * stride );
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SetRetrying                                                               */
+/*!
+    Update the number of messages waiting to be retried
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        delta
+            change in the number of messages waiting to be retried
+
+==============================================================================*/
+static void SetRetrying( Pipeline *pPipeline, int delta )
+{
+    pthread_mutex_lock( &pPipeline->retryMutex );
+
+    pPipeline->retrying += delta;
+    if ( pPipeline->retrying == 0 )
+    {
+        pthread_cond_broadcast( &pPipeline->retryCond );
+    }
+
+    pthread_mutex_unlock( &pPipeline->retryMutex );
+}
+
+/*============================================================================*/
+/*  Expired                                                                   */
+/*!
+    Check if the deadline for sending the queued messages has passed
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @retval true the deadline has passed
+    @retval false there is no deadline or it has not passed
+
+==============================================================================*/
+static bool Expired( Pipeline *pPipeline )
+{
+    uint64_t deadline;
+
+    deadline = __atomic_load_n( &pPipeline->deadline, __ATOMIC_ACQUIRE );
+
+    return ( deadline != 0 ) && ( UTIL_NowMs() >= deadline );
+}
+
+/*============================================================================*/
+/*  Wait                                                                      */
+/*!
+    Wait for a retry delay
+
+    The Wait function waits for a retry delay to pass.  The wait ends at
+    the deadline if it is sooner, or as soon as the deadline is set or
+    changed, so a stop does not wait for the delay.
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        ms
+            retry delay in milliseconds
+
+==============================================================================*/
+static void Wait( Pipeline *pPipeline, unsigned int ms )
+{
+    struct timespec ts;
+    uint64_t deadline;
+    uint64_t now;
+    int rc = EOK;
+
+    pthread_mutex_lock( &pPipeline->retryMutex );
+
+    deadline = __atomic_load_n( &pPipeline->deadline, __ATOMIC_ACQUIRE );
+    now = UTIL_NowMs();
+    if ( ( deadline != 0 ) && ( deadline < now + ms ) )
+    {
+        ms = ( deadline > now ) ? (unsigned int)( deadline - now ) : 0;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += ( ms % 1000 ) * 1000000L;
+    if ( ts.tv_nsec >= 1000000000L )
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    while ( ( rc != ETIMEDOUT ) &&
+            ( __atomic_load_n( &pPipeline->deadline, __ATOMIC_ACQUIRE )
+                == deadline ) )
+    {
+        rc = pthread_cond_timedwait( &pPipeline->wakeCond,
+                                     &pPipeline->retryMutex,
+                                     &ts );
+    }
+
+    pthread_mutex_unlock( &pPipeline->retryMutex );
+}
+
+/*============================================================================*/
+/*  FreeSlots                                                                 */
+/*!
+    Free the message slots of a pipeline
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+==============================================================================*/
+static void FreeSlots( Pipeline *pPipeline )
+{
+    size_t stride = pPipeline->headerSize + Align( pPipeline->dataSize );
+
+    if ( pPipeline->pSlots != NULL )
+    {
+        free( pPipeline->pSlots );
+        pPipeline->pSlots = NULL;
+    }
+
+    if ( pPipeline->pStorage != NULL )
+    {
+        POOL_Free( pPipeline->pStorage,
+                   pPipeline->laneCount * pPipeline->depth * stride );
+        pPipeline->pStorage = NULL;
+    }
+
+    free( pPipeline->pRetries );
+    pPipeline->pRetries = NULL;
+
+    POOL_Free( pPipeline->pRetryStorage, pPipeline->depth * stride );
+    pPipeline->pRetryStorage = NULL;
+}
+
+/*============================================================================*/
+/*  Align                                                                     */
+/*!
+    Round a size up to a whole number of cache lines
+
+    @param[in]
+        size
+            size to round up
+
+    @retval rounded up size
+
+==============================================================================*/
+static size_t Align( size_t size )
+{
+    return ( size + RING_CACHE_LINE - 1 ) & ~( (size_t)RING_CACHE_LINE - 1 );
+}
+
+/*! @}
+ * end of pipeline group */
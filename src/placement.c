@@ -0,0 +1,277 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup placement placement
+ * @brief Thread and buffer placement
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file placement.c
+
+    Thread and Buffer Placement
+
+    The placement module keeps iotsend out of the way of latency
+    critical workloads sharing the gateway, and keeps its own send
+    latency predictable.  The reader, which is the main thread, can be
+    pinned to a set of CPUs, and the sender threads to another set, so
+    neither runs on the cores reserved for control loops.  The sender
+    threads can run under SCHED_FIFO so a message is sent as soon as it
+    is queued, and the process can be given a nice level so the rest
+    of iotsend yields to other work.
+
+    On multi-socket servers the buffers can be allocated on a chosen
+    NUMA node, normally the node of the sender CPUs, so the senders do
+    not read their messages across the interconnect.
+
+    PLACEMENT_Start is called before any thread or buffer is created.
+    Threads inherit the CPU affinity, nice level and memory policy of
+    the thread which creates them, so every thread and buffer created
+    afterwards is placed with the reader, and PLACEMENT_Sender moves
+    each sender thread to the sender CPUs once it has been created.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+/* for pthread_setaffinity_np() and the CPU set macros */
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <iotclient/iotclient.h>
+#include "placement.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of bits in each word of a NUMA node mask */
+#define NODE_WORD_BITS  ( 8 * sizeof( unsigned long ) )
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  PLACEMENT_ParseCpus                                                       */
+/*!
+    Parse a list of CPUs
+
+    The PLACEMENT_ParseCpus function parses a comma separated list of
+    CPU numbers and ranges, such as 0-3,6, into a CPU set.
+
+    @param[out]
+        pCpus
+            pointer to the CPU set to store the CPUs in
+
+    @param[in]
+        list
+            CPU list to parse
+
+    @retval EOK the CPU list was parsed
+    @retval EINVAL the CPU list is malformed or invalid arguments
+
+==============================================================================*/
+int PLACEMENT_ParseCpus( cpu_set_t *pCpus, const char *list )
+{
+    int result = EINVAL;
+    const char *p = list;
+    char *pEnd;
+    unsigned long first;
+    unsigned long last;
+    unsigned long cpu;
+    bool more = true;
+
+    if ( ( pCpus != NULL ) && ( list != NULL ) )
+    {
+        CPU_ZERO( pCpus );
+        result = EOK;
+
+        while ( ( more == true ) && ( result == EOK ) )
+        {
+            first = strtoul( p, &pEnd, 10 );
+            last = first;
+            if ( ( pEnd != p ) && ( *pEnd == '-' ) )
+            {
+                p = pEnd + 1;
+                last = strtoul( p, &pEnd, 10 );
+            }
+
+            if ( ( pEnd == p ) ||
+                 ( last < first ) ||
+                 ( last >= CPU_SETSIZE ) ||
+                 ( ( *pEnd != ',' ) && ( *pEnd != '\0' ) ) )
+            {
+                result = EINVAL;
+            }
+            else
+            {
+                for ( cpu = first; cpu <= last; cpu++ )
+                {
+                    CPU_SET( cpu, pCpus );
+                }
+
+                more = ( *pEnd == ',' );
+                p = pEnd + 1;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  PLACEMENT_Start                                                           */
+/*!
+    Place the calling thread and the buffers
+
+    The PLACEMENT_Start function sets the nice level of the process,
+    prefers the selected NUMA node for memory allocations, and pins the
+    calling thread to the reader CPUs.  It must be called before any
+    other thread is created so the other threads inherit the placement.
+
+    @param[in]
+        pPlacement
+            pointer to the placement to apply
+
+    @retval EOK the placement was applied
+    @retval EINVAL invalid arguments or NUMA node
+    @retval EPERM the nice level may not be lowered
+    @retval other error from set_mempolicy or pthread_setaffinity_np
+
+==============================================================================*/
+int PLACEMENT_Start( Placement *pPlacement )
+{
+    int result = EINVAL;
+    unsigned long nodes[PLACEMENT_MAX_NODES / NODE_WORD_BITS];
+
+    if ( pPlacement != NULL )
+    {
+        result = EOK;
+
+        if ( ( pPlacement->niced == true ) &&
+             ( setpriority( PRIO_PROCESS, 0, pPlacement->nice ) == -1 ) )
+        {
+            result = errno;
+        }
+
+        if ( ( result == EOK ) && ( pPlacement->numaNode >= 0 ) )
+        {
+            if ( pPlacement->numaNode < PLACEMENT_MAX_NODES )
+            {
+                memset( nodes, 0, sizeof( nodes ) );
+                nodes[pPlacement->numaNode / NODE_WORD_BITS] =
+                    1ul << ( pPlacement->numaNode % NODE_WORD_BITS );
+
+                /* allocate from the node while it has free memory */
+                if ( syscall( SYS_set_mempolicy,
+                              MPOL_PREFERRED,
+                              nodes,
+                              PLACEMENT_MAX_NODES + 1 ) == -1 )
+                {
+                    result = errno;
+                }
+            }
+            else
+            {
+                result = EINVAL;
+            }
+        }
+
+        if ( ( result == EOK ) && ( pPlacement->readerPinned == true ) )
+        {
+            result = pthread_setaffinity_np( pthread_self(),
+                                             sizeof( cpu_set_t ),
+                                             &pPlacement->readerCpus );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  PLACEMENT_Sender                                                          */
+/*!
+    Place a sender thread
+
+    The PLACEMENT_Sender function pins a sender thread to the sender
+    CPUs and sets its real-time priority.
+
+    @param[in]
+        pPlacement
+            pointer to the placement to apply
+
+    @param[in]
+        thread
+            sender thread to place
+
+    @retval EOK the sender thread was placed
+    @retval EINVAL invalid arguments
+    @retval EPERM real-time scheduling is not permitted
+    @retval other error from pthread_setaffinity_np or pthread_setschedparam
+
+==============================================================================*/
+int PLACEMENT_Sender( Placement *pPlacement, pthread_t thread )
+{
+    int result = EINVAL;
+    struct sched_param param;
+
+    if ( pPlacement != NULL )
+    {
+        result = EOK;
+
+        if ( pPlacement->senderPinned == true )
+        {
+            result = pthread_setaffinity_np( thread,
+                                             sizeof( cpu_set_t ),
+                                             &pPlacement->senderCpus );
+        }
+
+        if ( ( result == EOK ) && ( pPlacement->senderPriority > 0 ) )
+        {
+            memset( &param, 0, sizeof( param ) );
+            param.sched_priority = pPlacement->senderPriority;
+            result = pthread_setschedparam( thread, SCHED_FIFO, &param );
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of placement group */
@@ -0,0 +1,399 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup pool pool
+ * @brief Message buffer pool
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file pool.c
+
+    Buffer Pool
+
+    The pool module provides the message and header buffers used by the
+    other modules, so a daemon which runs for months does not fragment
+    the heap of a small device and its memory use stays bounded.
+
+    Buffers come in two sizes: message buffers of the maximum message
+    size, and header buffers which are carved from slabs of several
+    header buffers at a time.  A buffer which is freed is kept on the
+    free list of its size and is handed out again by the next request,
+    so buffers are taken from the system once and then recycled.
+    Requests larger than a message buffer, such as the slot storage of
+    a send pipeline, are allocated on their own.
+
+    Every allocation counts towards a memory cap.  Once the cap is
+    reached a request which cannot be met from a free list fails, so
+    the memory held by the pool can never grow beyond the cap no matter
+    how long the daemon runs.  The pool may be used by several threads.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <iotclient/iotclient.h>
+#include "pool.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of header buffers in each header slab */
+#define POOL_HEADERS_PER_SLAB   ( 16 )
+
+/*! size of a header slab, whose first cache line links it to the next */
+#define POOL_SLAB_SIZE \
+    ( POOL_ALIGN + ( POOL_HEADERS_PER_SLAB * POOL_HEADER_SIZE ) )
+
+/*! free buffer */
+typedef struct _PoolBuffer
+{
+    /*! next free buffer */
+    struct _PoolBuffer *pNext;
+
+} PoolBuffer;
+
+/*! buffer pool */
+typedef struct _Pool
+{
+    /*! mutex serializing the users of the pool */
+    pthread_mutex_t mutex;
+
+    /*! maximum number of bytes held by the pool (0 = unlimited) */
+    size_t cap;
+
+    /*! number of bytes held by the pool */
+    size_t used;
+
+    /*! free header buffers */
+    PoolBuffer *pHeaders;
+
+    /*! free message buffers */
+    PoolBuffer *pMessages;
+
+    /*! header slabs */
+    PoolBuffer *pSlabs;
+
+} Pool;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! process wide buffer pool */
+static Pool pool = { PTHREAD_MUTEX_INITIALIZER, 0, 0, NULL, NULL, NULL };
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void *Take( size_t size );
+static void AddSlab( void );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  POOL_Init                                                                 */
+/*!
+    Set the memory cap of the buffer pool
+
+    The POOL_Init function sets the maximum number of bytes the pool may
+    take from the system.  It should be called at startup, before any
+    buffer is allocated.
+
+    @param[in]
+        cap
+            maximum number of bytes held by the pool (0 = unlimited)
+
+    @retval EOK the memory cap was set
+    @retval EINVAL the cap is too small to hold a message buffer
+
+==============================================================================*/
+int POOL_Init( size_t cap )
+{
+    int result = EINVAL;
+
+    if ( ( cap == 0 ) || ( cap >= POOL_MESSAGE_SIZE ) )
+    {
+        pthread_mutex_lock( &pool.mutex );
+        pool.cap = cap;
+        pthread_mutex_unlock( &pool.mutex );
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  POOL_Alloc                                                                */
+/*!
+    Allocate a buffer
+
+    The POOL_Alloc function allocates a buffer of at least the requested
+    size, aligned to a cache line.  A request which fits in a header or
+    message buffer is met from the free list of that size if possible.
+
+    @param[in]
+        size
+            number of bytes required
+
+    @retval pointer to the buffer
+    @retval NULL the size is 0, or the memory cap has been reached
+
+==============================================================================*/
+void *POOL_Alloc( size_t size )
+{
+    PoolBuffer *p = NULL;
+
+    if ( size > 0 )
+    {
+        pthread_mutex_lock( &pool.mutex );
+
+        if ( size <= POOL_HEADER_SIZE )
+        {
+            if ( pool.pHeaders == NULL )
+            {
+                AddSlab();
+            }
+
+            p = pool.pHeaders;
+            if ( p != NULL )
+            {
+                pool.pHeaders = p->pNext;
+            }
+        }
+        else if ( size <= POOL_MESSAGE_SIZE )
+        {
+            p = pool.pMessages;
+            if ( p != NULL )
+            {
+                pool.pMessages = p->pNext;
+            }
+            else
+            {
+                p = Take( POOL_MESSAGE_SIZE );
+            }
+        }
+        else
+        {
+            p = Take( size );
+        }
+
+        pthread_mutex_unlock( &pool.mutex );
+    }
+
+    if ( p == NULL )
+    {
+        errno = ENOMEM;
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*  POOL_Free                                                                 */
+/*!
+    Free a buffer
+
+    The POOL_Free function returns a header or message buffer to its
+    free list, or releases a larger buffer to the system.
+
+    @param[in]
+        p
+            pointer to the buffer, or NULL
+
+    @param[in]
+        size
+            size the buffer was allocated with
+
+==============================================================================*/
+void POOL_Free( void *p, size_t size )
+{
+    PoolBuffer *pBuffer = (PoolBuffer *)p;
+
+    if ( pBuffer != NULL )
+    {
+        pthread_mutex_lock( &pool.mutex );
+
+        if ( size <= POOL_HEADER_SIZE )
+        {
+            pBuffer->pNext = pool.pHeaders;
+            pool.pHeaders = pBuffer;
+        }
+        else if ( size <= POOL_MESSAGE_SIZE )
+        {
+            pBuffer->pNext = pool.pMessages;
+            pool.pMessages = pBuffer;
+        }
+        else
+        {
+            free( pBuffer );
+            pool.used -= size;
+        }
+
+        pthread_mutex_unlock( &pool.mutex );
+    }
+}
+
+/*============================================================================*/
+/*  POOL_Used                                                                 */
+/*!
+    Get the number of bytes held by the buffer pool
+
+    @retval number of bytes taken from the system, in use or free
+
+==============================================================================*/
+size_t POOL_Used( void )
+{
+    size_t used;
+
+    pthread_mutex_lock( &pool.mutex );
+    used = pool.used;
+    pthread_mutex_unlock( &pool.mutex );
+
+    return used;
+}
+
+/*============================================================================*/
+/*  POOL_Shutdown                                                             */
+/*!
+    Release the free buffers of the pool
+
+    The POOL_Shutdown function releases the free message buffers and the
+    header slabs to the system.  It is called at exit once every buffer
+    has been freed.
+
+==============================================================================*/
+void POOL_Shutdown( void )
+{
+    PoolBuffer *p;
+
+    pthread_mutex_lock( &pool.mutex );
+
+    while ( ( p = pool.pMessages ) != NULL )
+    {
+        pool.pMessages = p->pNext;
+        free( p );
+        pool.used -= POOL_MESSAGE_SIZE;
+    }
+
+    while ( ( p = pool.pSlabs ) != NULL )
+    {
+        pool.pSlabs = p->pNext;
+        free( p );
+        pool.used -= POOL_SLAB_SIZE;
+    }
+
+    pool.pHeaders = NULL;
+
+    pthread_mutex_unlock( &pool.mutex );
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Take                                                                      */
+/*!
+    Take memory from the system
+
+    The Take function allocates cache line aligned memory if it fits
+    within the memory cap.  It is called with the pool locked.
+
+    @param[in]
+        size
+            number of bytes to allocate
+
+    @retval pointer to the memory
+    @retval NULL the memory cap has been reached or allocation failed
+
+==============================================================================*/
+static void *Take( size_t size )
+{
+    void *p = NULL;
+
+    if ( ( pool.cap == 0 ) ||
+         ( ( pool.used <= pool.cap ) && ( size <= pool.cap - pool.used ) ) )
+    {
+        if ( posix_memalign( &p, POOL_ALIGN, size ) == 0 )
+        {
+            pool.used += size;
+        }
+        else
+        {
+            p = NULL;
+        }
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*  AddSlab                                                                   */
+/*!
+    Add a slab of header buffers to the pool
+
+    The AddSlab function takes a header slab from the system and puts
+    its header buffers on the free list.  It is called with the pool
+    locked.
+
+==============================================================================*/
+static void AddSlab( void )
+{
+    PoolBuffer *pSlab;
+    PoolBuffer *pBuffer;
+    size_t i;
+
+    pSlab = Take( POOL_SLAB_SIZE );
+    if ( pSlab != NULL )
+    {
+        pSlab->pNext = pool.pSlabs;
+        pool.pSlabs = pSlab;
+
+        for ( i = 0; i < POOL_HEADERS_PER_SLAB; i++ )
+        {
+            pBuffer = (PoolBuffer *)( (char *)pSlab +
+                                      POOL_ALIGN +
+                                      ( i * POOL_HEADER_SIZE ) );
+            pBuffer->pNext = pool.pHeaders;
+            pool.pHeaders = pBuffer;
+        }
+    }
+}
+
+/*! @}
+ * end of pool group */
@@ -0,0 +1,405 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup priority priority
+ * @brief Urgent message input
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file priority.c
+
+    Priority Input
+
+    The priority module reads urgent messages, such as alarms, from a
+    dedicated FIFO and queues them in the high priority lane of the send
+    pipelines, so they overtake any bulk data which is queued or being
+    read.  The FIFO is read by its own thread, so an urgent message is
+    not held up behind the main input, even while the main input is
+    blocked waiting for a free pipeline slot.
+
+    Each delimited frame written to the FIFO is sent as one message with
+    the message headers and a priority:high header.  The FIFO is kept
+    open for writing by the reader itself so it stays open between
+    writers, which means frames must be terminated by the delimiter.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <iotclient/iotclient.h>
+#include "headers.h"
+#include "template.h"
+#include "reader.h"
+#include "pipeline.h"
+#include "ratelimit.h"
+#include "priority.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! interval in milliseconds at which the reader checks for a stop request */
+#define PRIORITY_POLL_MS    ( 250 )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static void *ReaderThread( void *arg );
+static int PrepareHeaders( PriorityReader *pReader, const char *pHeaders );
+static void Free( PriorityReader *pReader );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  PRIORITY_Start                                                            */
+/*!
+    Start reading urgent messages from a priority FIFO
+
+    The PRIORITY_Start function creates the priority FIFO if it does not
+    exist and starts the thread which reads it.  The urgent messages are
+    spread round-robin over the send pipelines, which must have a high
+    priority lane and must outlive the reader.
+
+    @param[in]
+        pReader
+            pointer to the priority reader to start
+
+    @param[in]
+        fifoName
+            name of the priority FIFO
+
+    @param[in]
+        delimiter
+            frame delimiter
+
+    @param[in]
+        pHeaders
+            compiled message headers, which may contain placeholders
+
+    @param[in]
+        pPipelines
+            array of send pipelines
+
+    @param[in]
+        count
+            number of send pipelines
+
+    @param[in]
+        pRateLimit
+            rate limiter for the urgent messages, or NULL
+
+    @param[in]
+        verbose
+            report errors on stderr
+
+    @retval EOK the priority reader was started
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+    @retval other error creating the FIFO or the reader thread
+
+==============================================================================*/
+int PRIORITY_Start( PriorityReader *pReader,
+                    const char *fifoName,
+                    char delimiter,
+                    const char *pHeaders,
+                    Pipeline *pPipelines,
+                    size_t count,
+                    RateLimit *pRateLimit,
+                    bool verbose )
+{
+    int result = EINVAL;
+
+    if ( ( pReader != NULL ) &&
+         ( fifoName != NULL ) &&
+         ( pHeaders != NULL ) &&
+         ( pPipelines != NULL ) &&
+         ( count > 0 ) )
+    {
+        memset( pReader, 0, sizeof( PriorityReader ) );
+        pReader->delimiter = delimiter;
+        pReader->pPipelines = pPipelines;
+        pReader->count = count;
+        pReader->pRateLimit = pRateLimit;
+        pReader->verbose = verbose;
+
+        pReader->pFifoName = strdup( fifoName );
+        result = ( pReader->pFifoName != NULL ) ? EOK : ENOMEM;
+
+        if ( ( result == EOK ) &&
+             ( mkfifo( fifoName, 0660 ) != 0 ) &&
+             ( errno != EEXIST ) )
+        {
+            result = errno;
+        }
+
+        if ( result == EOK )
+        {
+            result = PrepareHeaders( pReader, pHeaders );
+        }
+
+        if ( result == EOK )
+        {
+            result = pthread_create( &pReader->thread,
+                                     NULL,
+                                     ReaderThread,
+                                     pReader );
+        }
+
+        if ( result == EOK )
+        {
+            pReader->running = true;
+        }
+        else
+        {
+            Free( pReader );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  PRIORITY_Stop                                                             */
+/*!
+    Stop reading urgent messages
+
+    The PRIORITY_Stop function queues the frames already written to the
+    priority FIFO, stops the reader thread and frees its resources.  It
+    must be called before the send pipelines are shut down.
+
+    @param[in]
+        pReader
+            pointer to the priority reader
+
+==============================================================================*/
+void PRIORITY_Stop( PriorityReader *pReader )
+{
+    if ( ( pReader != NULL ) && ( pReader->running == true ) )
+    {
+        __atomic_store_n( &pReader->stopping, 1, __ATOMIC_RELEASE );
+        pthread_join( pReader->thread, NULL );
+        pReader->running = false;
+
+        Free( pReader );
+    }
+}
+
+/*============================================================================*/
+/*  PRIORITY_IsHigh                                                           */
+/*!
+    Check if a message has high priority
+
+    @param[in]
+        pHeaders
+            message headers
+
+    @retval true the message has a priority:high header
+    @retval false the message has normal priority
+
+==============================================================================*/
+bool PRIORITY_IsHigh( const char *pHeaders )
+{
+    const char *pValue;
+    size_t len = 0;
+
+    pValue = HEADERS_Lookup( pHeaders, "priority", &len );
+
+    return ( pValue != NULL ) &&
+           ( len == sizeof( "high" ) - 1 ) &&
+           ( strncmp( pValue, "high", len ) == 0 );
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  ReaderThread                                                              */
+/*!
+    Read urgent messages from the priority FIFO
+
+    The ReaderThread function queues a message in the high priority lane
+    for each frame read from the priority FIFO.  Once it has been asked
+    to stop, it queues the frames which are already waiting and exits.
+
+    @param[in]
+        arg
+            pointer to the PriorityReader
+
+    @retval NULL
+
+==============================================================================*/
+static void *ReaderThread( void *arg )
+{
+    PriorityReader *pReader = (PriorityReader *)arg;
+    RecordReader records;
+    Pipeline *pPipeline;
+    char *pHeaders;
+    char *pRecord;
+    size_t len;
+    int fd;
+    int rc = EOK;
+
+    memset( &records, 0, sizeof( RecordReader ) );
+
+    /* holding the FIFO open for writing means it never reaches EOF */
+    fd = open( pReader->pFifoName, O_RDWR | O_CLOEXEC );
+    if ( fd == -1 )
+    {
+        rc = errno;
+    }
+    else
+    {
+        rc = READER_Init( &records, fd, pReader->delimiter, MAX_IOT_MSG_SIZE );
+        READER_SetTimeout( &records, PRIORITY_POLL_MS );
+    }
+
+    while ( ( rc == EOK ) ||
+            ( rc == E2BIG ) ||
+            ( ( rc == ETIMEDOUT ) &&
+              ( __atomic_load_n( &pReader->stopping,
+                                 __ATOMIC_ACQUIRE ) == 0 ) ) )
+    {
+        rc = READER_Next( &records, &pRecord, &len );
+        if ( ( rc == EOK ) || ( rc == E2BIG ) )
+        {
+            pHeaders = ( pReader->headerTemplate.dynamic == true )
+                       ? TEMPLATE_Render( &pReader->headerTemplate, 0 )
+                       : HEADERS_Get( &pReader->headerBlock );
+
+            pPipeline = &pReader->pPipelines[pReader->next];
+            pReader->next = ( pReader->next + 1 ) % pReader->count;
+
+            /* past the drain deadline the pipeline spools the message */
+            (void)RATELIMIT_Acquire( pReader->pRateLimit, len );
+            PIPELINE_Submit( pPipeline,
+                             PIPELINE_LANE_HIGH,
+                             pHeaders,
+                             pRecord,
+                             len );
+        }
+    }
+
+    if ( ( rc != ETIMEDOUT ) && ( pReader->verbose == true ) )
+    {
+        fprintf( stderr,
+                 "Cannot read %s: %s\n",
+                 pReader->pFifoName,
+                 strerror( rc ) );
+    }
+
+    READER_Free( &records );
+
+    if ( fd != -1 )
+    {
+        close( fd );
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  PrepareHeaders                                                            */
+/*!
+    Compile the headers of the urgent messages
+
+    The PrepareHeaders function adds the priority:high header to the
+    message headers.  The urgent messages have their own header template
+    so its placeholders can be rendered by the reader thread.
+
+    @param[in]
+        pReader
+            pointer to the PriorityReader
+
+    @param[in]
+        pHeaders
+            compiled message headers
+
+    @retval EOK the headers were compiled
+    @retval ENOMEM memory allocation failed
+    @retval other error from HEADERS_Compile or TEMPLATE_Compile
+
+==============================================================================*/
+static int PrepareHeaders( PriorityReader *pReader, const char *pHeaders )
+{
+    int result = ENOMEM;
+    char *pSpec;
+    size_t len;
+
+    len = strlen( pHeaders ) + sizeof( "\n" PRIORITY_HEADER );
+    pSpec = malloc( len );
+    if ( pSpec != NULL )
+    {
+        len = snprintf( pSpec, len, "%s\n" PRIORITY_HEADER, pHeaders );
+        result = HEADERS_Compile( &pReader->headerBlock, pSpec, len );
+        free( pSpec );
+    }
+
+    if ( result == EOK )
+    {
+        result = TEMPLATE_Compile( &pReader->headerTemplate,
+                                   HEADERS_Get( &pReader->headerBlock ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Free                                                                      */
+/*!
+    Free the resources of a priority reader
+
+    @param[in]
+        pReader
+            pointer to the PriorityReader
+
+==============================================================================*/
+static void Free( PriorityReader *pReader )
+{
+    HEADERS_Free( &pReader->headerBlock );
+    TEMPLATE_Free( &pReader->headerTemplate );
+
+    free( pReader->pFifoName );
+    pReader->pFifoName = NULL;
+}
+
+/*! @}
+ * end of priority group */
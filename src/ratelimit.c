@@ -0,0 +1,441 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup ratelimit ratelimit
+ * @brief Message and byte rate limiter
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file ratelimit.c
+
+    Rate Limiter
+
+    The ratelimit module paces messages so they stay within the message
+    and byte quotas of the IOTHub service.  Each quota is a token
+    bucket which is refilled at the configured rate and drained by one
+    token per message or by one token per payload byte.  A full bucket
+    lets a burst of messages through back to back, after which messages
+    are sent at the configured rate.
+
+    Each bucket is stored as the monotonic time at which it will be full
+    again, so no timer is needed to refill it.  A sender which must wait
+    reserves its tokens and then sleeps until the time they are
+    available, without polling.  The limiter may be shared by several
+    threads.
+
+    A sleep ends early at the deadline set when iotsend stops, so the
+    pacing never holds up a shutdown.  A thread which only receives the
+    termination signals while waiting passes its signal mask instead,
+    so a stop ends the sleep as soon as it is requested.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+/* for ppoll() */
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <iotclient/iotclient.h>
+#include "ratelimit.h"
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of nanoseconds in a second */
+#define NSEC_PER_SEC    ( 1000000000ull )
+
+/*! number of nanoseconds in a millisecond */
+#define NSEC_PER_MSEC   ( 1000000ull )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static uint64_t Reserve( TokenBucket *pBucket, uint64_t tokens, uint64_t now );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  RATELIMIT_Init                                                            */
+/*!
+    Initialize a rate limiter
+
+    The RATELIMIT_Init function initializes a rate limiter for a message
+    rate and a byte rate.  The message bucket holds burst messages, or
+    one second of messages if no burst size is given.  The byte bucket
+    holds one second of bytes.  Both buckets start full.
+
+    @param[in]
+        pRateLimit
+            pointer to the rate limiter to initialize
+
+    @param[in]
+        msgRate
+            maximum messages per second (0 = unlimited)
+
+    @param[in]
+        byteRate
+            maximum payload bytes per second (0 = unlimited)
+
+    @param[in]
+        burst
+            maximum number of messages sent back to back
+            (0 = one second of messages)
+
+    @retval EOK the rate limiter was initialized
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int RATELIMIT_Init( RateLimit *pRateLimit,
+                    uint64_t msgRate,
+                    uint64_t byteRate,
+                    uint64_t burst )
+{
+    int result = EINVAL;
+    uint64_t now;
+    pthread_condattr_t attr;
+
+    if ( pRateLimit != NULL )
+    {
+        memset( pRateLimit, 0, sizeof( RateLimit ) );
+
+        if ( burst == 0 )
+        {
+            burst = msgRate;
+        }
+
+        now = UTIL_NowNs();
+
+        pRateLimit->messages.rate = msgRate;
+        if ( msgRate > 0 )
+        {
+            pRateLimit->messages.depth = burst * NSEC_PER_SEC / msgRate;
+            pRateLimit->messages.full = now;
+        }
+
+        pRateLimit->bytes.rate = byteRate;
+        pRateLimit->bytes.depth = NSEC_PER_SEC;
+        pRateLimit->bytes.full = now;
+
+        pRateLimit->enabled = ( msgRate > 0 ) || ( byteRate > 0 );
+        result = pthread_mutex_init( &pRateLimit->mutex, NULL );
+        if ( result == EOK )
+        {
+            /* a sender sleeps on the monotonic clock of the buckets */
+            pthread_condattr_init( &attr );
+            pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+            result = pthread_cond_init( &pRateLimit->cond, &attr );
+            pthread_condattr_destroy( &attr );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RATELIMIT_Acquire                                                         */
+/*!
+    Wait until a message may be sent
+
+    The RATELIMIT_Acquire function takes one message token and one byte
+    token for each payload byte, sleeping until they are available or
+    until the deadline.  It returns immediately if the rate limiter is
+    not enabled.
+
+    @param[in]
+        pRateLimit
+            pointer to the rate limiter, or NULL for no limit
+
+    @param[in]
+        len
+            length of the message payload
+
+    @retval EOK the message may be sent
+    @retval ETIMEDOUT the deadline passed before the tokens were available
+
+==============================================================================*/
+int RATELIMIT_Acquire( RateLimit *pRateLimit, size_t len )
+{
+    return RATELIMIT_Wait( pRateLimit,
+                           RATELIMIT_Reserve( pRateLimit, len ),
+                           NULL );
+}
+
+/*============================================================================*/
+/*  RATELIMIT_Reserve                                                         */
+/*!
+    Reserve the tokens for a message
+
+    The RATELIMIT_Reserve function takes one message token and one byte
+    token for each payload byte without waiting for them, so the caller
+    can wait for them with RATELIMIT_Wait().
+
+    @param[in]
+        pRateLimit
+            pointer to the rate limiter, or NULL for no limit
+
+    @param[in]
+        len
+            length of the message payload
+
+    @retval monotonic time in nanoseconds when the tokens are available,
+            or 0 if the rate limiter is not enabled
+
+==============================================================================*/
+uint64_t RATELIMIT_Reserve( RateLimit *pRateLimit, size_t len )
+{
+    uint64_t now;
+    uint64_t due = 0;
+    uint64_t byteDue;
+
+    if ( ( pRateLimit != NULL ) && ( pRateLimit->enabled == true ) )
+    {
+        pthread_mutex_lock( &pRateLimit->mutex );
+
+        now = UTIL_NowNs();
+        due = Reserve( &pRateLimit->messages, 1, now );
+        byteDue = Reserve( &pRateLimit->bytes, len, now );
+        if ( byteDue > due )
+        {
+            due = byteDue;
+        }
+
+        pthread_mutex_unlock( &pRateLimit->mutex );
+    }
+
+    return due;
+}
+
+/*============================================================================*/
+/*  RATELIMIT_Wait                                                            */
+/*!
+    Wait for reserved tokens
+
+    The RATELIMIT_Wait function sleeps until the tokens reserved by
+    RATELIMIT_Reserve() are available.  The sleep ends early at the
+    deadline, including a deadline set while sleeping.  With a signal
+    mask, the mask is installed while sleeping and the sleep ends when
+    a signal is received, so the caller can check for a stop and wait
+    again for the same tokens.  A deadline set by another thread does
+    not end a sleep with a signal mask.
+
+    @param[in]
+        pRateLimit
+            pointer to the rate limiter, or NULL for no limit
+
+    @param[in]
+        due
+            monotonic time in nanoseconds when the tokens are available
+
+    @param[in]
+        pMask
+            signal mask installed while sleeping, or NULL to sleep until
+            the tokens are available or the deadline passes
+
+    @retval EOK the tokens are available
+    @retval ETIMEDOUT the deadline passed before the tokens were available
+    @retval EINTR the sleep was interrupted by a signal
+
+==============================================================================*/
+int RATELIMIT_Wait( RateLimit *pRateLimit,
+                    uint64_t due,
+                    const sigset_t *pMask )
+{
+    int result = EOK;
+    struct timespec ts;
+    uint64_t deadline;
+    uint64_t until;
+    uint64_t now;
+
+    if ( ( pRateLimit != NULL ) && ( pRateLimit->enabled == true ) )
+    {
+        pthread_mutex_lock( &pRateLimit->mutex );
+
+        now = UTIL_NowNs();
+        while ( ( result == EOK ) && ( now < due ) )
+        {
+            deadline = pRateLimit->deadline * NSEC_PER_MSEC;
+            until = ( ( deadline != 0 ) && ( deadline < due ) )
+                    ? deadline
+                    : due;
+
+            if ( now >= until )
+            {
+                /* out of time: do not wait for the tokens */
+                result = ETIMEDOUT;
+            }
+            else if ( pMask != NULL )
+            {
+                ts.tv_sec = ( until - now ) / NSEC_PER_SEC;
+                ts.tv_nsec = ( until - now ) % NSEC_PER_SEC;
+
+                pthread_mutex_unlock( &pRateLimit->mutex );
+                if ( ( ppoll( NULL, 0, &ts, pMask ) == -1 ) &&
+                     ( errno == EINTR ) )
+                {
+                    result = EINTR;
+                }
+                pthread_mutex_lock( &pRateLimit->mutex );
+            }
+            else
+            {
+                /* the lock is released while sleeping */
+                ts.tv_sec = until / NSEC_PER_SEC;
+                ts.tv_nsec = until % NSEC_PER_SEC;
+                (void)pthread_cond_timedwait( &pRateLimit->cond,
+                                              &pRateLimit->mutex,
+                                              &ts );
+            }
+
+            now = UTIL_NowNs();
+        }
+
+        pthread_mutex_unlock( &pRateLimit->mutex );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RATELIMIT_SetDeadline                                                     */
+/*!
+    Set the time after which senders no longer wait for their tokens
+
+    The RATELIMIT_SetDeadline function bounds the sleeps of the senders
+    when iotsend stops, and wakes the senders already sleeping without
+    a signal mask so they see the new deadline.
+
+    @param[in]
+        pRateLimit
+            pointer to the rate limiter, or NULL for no limit
+
+    @param[in]
+        deadline
+            monotonic time in milliseconds, as from CLOCK_MONOTONIC
+
+==============================================================================*/
+void RATELIMIT_SetDeadline( RateLimit *pRateLimit, uint64_t deadline )
+{
+    if ( ( pRateLimit != NULL ) && ( pRateLimit->enabled == true ) )
+    {
+        pthread_mutex_lock( &pRateLimit->mutex );
+        pRateLimit->deadline = deadline;
+        pthread_cond_broadcast( &pRateLimit->cond );
+        pthread_mutex_unlock( &pRateLimit->mutex );
+    }
+}
+
+/*============================================================================*/
+/*  RATELIMIT_Free                                                            */
+/*!
+    Free the resources used by a rate limiter
+
+    @param[in]
+        pRateLimit
+            pointer to the rate limiter
+
+==============================================================================*/
+void RATELIMIT_Free( RateLimit *pRateLimit )
+{
+    if ( pRateLimit != NULL )
+    {
+        pthread_cond_destroy( &pRateLimit->cond );
+        pthread_mutex_destroy( &pRateLimit->mutex );
+        pRateLimit->enabled = false;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Reserve                                                                   */
+/*!
+    Reserve tokens from a bucket
+
+    The Reserve function takes tokens from a bucket and returns the
+    time at which they are available.  A bucket which is full again has
+    no debt carried forward, so an idle period does not allow more than
+    one bucket of messages to be sent at once.  A request for more
+    tokens than the bucket holds waits until the bucket has been
+    refilled by the excess.
+
+    @param[in]
+        pBucket
+            pointer to the bucket
+
+    @param[in]
+        tokens
+            number of tokens to take
+
+    @param[in]
+        now
+            current monotonic time in nanoseconds
+
+    @retval monotonic time in nanoseconds when the tokens are available
+
+==============================================================================*/
+static uint64_t Reserve( TokenBucket *pBucket, uint64_t tokens, uint64_t now )
+{
+    uint64_t due = now;
+
+    if ( pBucket->rate > 0 )
+    {
+        if ( pBucket->full < now )
+        {
+            pBucket->full = now;
+        }
+
+        pBucket->full += tokens * NSEC_PER_SEC / pBucket->rate;
+
+        if ( pBucket->full > now + pBucket->depth )
+        {
+            due = pBucket->full - pBucket->depth;
+        }
+    }
+
+    return due;
+}
+
+/*! @}
+ * end of ratelimit group */
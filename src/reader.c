@@ -0,0 +1,713 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup reader reader
+ * @brief Delimited record reader
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file reader.c
+
+    Delimited Record Reader
+
+    The Record Reader splits a byte stream read from a file descriptor
+    into records separated by a delimiter character.  Records are
+    returned as soon as their delimiter has been received so a slow
+    producer does not delay delivery of the records it has already
+    written.
+
+    Records are returned as pointers into the reader's input buffer
+    and remain valid until the next call to READER_Next.
+
+    The input may be non-blocking, in which case READER_Next returns
+    EAGAIN when no complete record has been received yet and keeps the
+    partial record for the next call.  The input buffer may be supplied
+    by the caller so buffers can be recycled between inputs.
+
+    In framed mode the input is a sequence of length prefixed frames
+    (see frame.c) rather than delimited records.  Each frame is sliced
+    out of the input buffer using the lengths in its header, so the
+    record bytes are never scanned and may hold any value.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+/* for ppoll() */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <iotclient/iotclient.h>
+#include "pool.h"
+#include "stats.h"
+#include "frame.h"
+#include "reader.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int Fill( RecordReader *pReader );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  READER_Init                                                               */
+/*!
+    Initialize a record reader
+
+    The READER_Init function allocates the input buffer for a record
+    reader and associates it with an input file descriptor.
+
+    @param[in]
+        pReader
+            pointer to the record reader to initialize
+
+    @param[in]
+        fd
+            input file descriptor
+
+    @param[in]
+        delimiter
+            record delimiter character
+
+    @param[in]
+        size
+            maximum record size
+
+    @retval EOK the record reader was initialized
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int READER_Init( RecordReader *pReader, int fd, char delimiter, size_t size )
+{
+    int result = EINVAL;
+
+    if ( ( pReader != NULL ) && ( size > 0 ) )
+    {
+        memset( pReader, 0, sizeof( RecordReader ) );
+        pReader->pBuf = POOL_Alloc( size );
+        if ( pReader->pBuf != NULL )
+        {
+            pReader->size = size;
+            pReader->delimiter = delimiter;
+            pReader->fd = fd;
+            pReader->timeout = -1;
+            pReader->ownsBuffer = true;
+            result = EOK;
+        }
+        else
+        {
+            result = ENOMEM;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  READER_InitBuffer                                                         */
+/*!
+    Initialize a record reader with a caller supplied buffer
+
+    The READER_InitBuffer function initializes a record reader which
+    uses a buffer owned by the caller.  The buffer is not freed by
+    READER_Free.
+
+    @param[in]
+        pReader
+            pointer to the record reader to initialize
+
+    @param[in]
+        fd
+            input file descriptor
+
+    @param[in]
+        delimiter
+            record delimiter character
+
+    @param[in]
+        pBuf
+            pointer to the input buffer
+
+    @param[in]
+        size
+            size of the input buffer (the maximum record size)
+
+    @retval EOK the record reader was initialized
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int READER_InitBuffer( RecordReader *pReader,
+                       int fd,
+                       char delimiter,
+                       char *pBuf,
+                       size_t size )
+{
+    int result = EINVAL;
+
+    if ( ( pReader != NULL ) && ( pBuf != NULL ) && ( size > 0 ) )
+    {
+        memset( pReader, 0, sizeof( RecordReader ) );
+        pReader->pBuf = pBuf;
+        pReader->size = size;
+        pReader->delimiter = delimiter;
+        pReader->fd = fd;
+        pReader->timeout = -1;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  READER_Reset                                                              */
+/*!
+    Reset a record reader
+
+    The READER_Reset function discards any buffered data and
+    associates the record reader with a new input file descriptor.
+    It is used when a FIFO is re-opened after its writer has closed it.
+
+    @param[in]
+        pReader
+            pointer to the record reader to reset
+
+    @param[in]
+        fd
+            new input file descriptor
+
+    @retval EOK the record reader was reset
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int READER_Reset( RecordReader *pReader, int fd )
+{
+    int result = EINVAL;
+
+    if ( pReader != NULL )
+    {
+        pReader->fd = fd;
+        pReader->start = 0;
+        pReader->end = 0;
+        pReader->eof = false;
+        pReader->discard = 0;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  READER_SetTimeout                                                         */
+/*!
+    Set the input timeout of a record reader
+
+    The READER_SetTimeout function sets the maximum time READER_Next
+    will wait for more input before returning ETIMEDOUT.  Records
+    which are already buffered are returned without waiting.
+
+    @param[in]
+        pReader
+            pointer to the record reader
+
+    @param[in]
+        timeout
+            maximum time to wait in milliseconds, or -1 to wait forever
+
+    @retval EOK the timeout was set
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int READER_SetTimeout( RecordReader *pReader, int timeout )
+{
+    int result = EINVAL;
+
+    if ( pReader != NULL )
+    {
+        pReader->timeout = timeout;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  READER_SetInterruptible                                                   */
+/*!
+    Set whether a signal interrupts a record reader
+
+    The READER_SetInterruptible function sets the signal mask which is
+    installed while the reader waits for input, for example to unblock
+    a termination signal which is otherwise blocked.  The mask is only
+    installed for the duration of the wait, so a signal received while
+    the caller handles a record stays pending and ends the next wait
+    as soon as it starts.  An interrupted wait returns ETIMEDOUT so the
+    caller can check why it was interrupted.
+
+    Without a signal mask, a read which is interrupted by a signal is
+    restarted.
+
+    @param[in]
+        pReader
+            pointer to the record reader
+
+    @param[in]
+        pMask
+            signal mask to wait for input with, or NULL to restart
+            interrupted reads
+
+    @retval EOK the setting was changed
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int READER_SetInterruptible( RecordReader *pReader, const sigset_t *pMask )
+{
+    int result = EINVAL;
+
+    if ( pReader != NULL )
+    {
+        pReader->interruptible = ( pMask != NULL );
+        if ( pMask != NULL )
+        {
+            pReader->sigmask = *pMask;
+        }
+
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  READER_Stop                                                               */
+/*!
+    Stop reading the input
+
+    The READER_Stop function stops the record reader from reading any
+    more of its input.  The records which have already been read into
+    the input buffer are still returned, followed by ENODATA as at the
+    end of the input.
+
+    @param[in]
+        pReader
+            pointer to the record reader
+
+    @retval EOK the reader was stopped
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int READER_Stop( RecordReader *pReader )
+{
+    int result = EINVAL;
+
+    if ( pReader != NULL )
+    {
+        pReader->eof = true;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  READER_Next                                                               */
+/*!
+    Get the next record from the reader
+
+    The READER_Next function returns the next delimited record from the
+    input stream.  The delimiter is not included in the record.  Any
+    unterminated data remaining when the end of the input is reached
+    is returned as a final record.
+
+    If a record does not fit in the input buffer, the full buffer is
+    returned as a record and E2BIG is returned to allow the caller
+    to warn that the record was split.
+
+    @param[in]
+        pReader
+            pointer to the record reader
+
+    @param[out]
+        ppRecord
+            pointer to a location to store a pointer to the record data
+
+    @param[out]
+        pLen
+            pointer to a location to store the record length
+
+    @retval EOK a record was returned
+    @retval E2BIG a partial record was returned
+    @retval ENODATA end of input
+    @retval ETIMEDOUT no record was received within the reader timeout
+    @retval EAGAIN no complete record is available on a non-blocking input
+    @retval EINVAL invalid arguments
+    @retval other error from read()
+
+==============================================================================*/
+int READER_Next( RecordReader *pReader, char **ppRecord, size_t *pLen )
+{
+    int result = EINVAL;
+    char *p;
+    char *pRecord;
+    size_t n;
+    size_t scanned = 0;
+
+    if ( ( pReader != NULL ) &&
+         ( ppRecord != NULL ) &&
+         ( pLen != NULL ) )
+    {
+        do
+        {
+            pRecord = &pReader->pBuf[pReader->start];
+            n = pReader->end - pReader->start;
+
+            /* only scan the bytes which have not already been scanned */
+            p = memchr( &pRecord[scanned], pReader->delimiter, n - scanned );
+            if ( p != NULL )
+            {
+                *ppRecord = pRecord;
+                *pLen = p - pRecord;
+                pReader->start += *pLen + 1;
+                result = EOK;
+            }
+            else if ( pReader->eof )
+            {
+                if ( n > 0 )
+                {
+                    /* unterminated final record */
+                    *ppRecord = pRecord;
+                    *pLen = n;
+                    pReader->start = pReader->end;
+                    result = EOK;
+                }
+                else
+                {
+                    result = ENODATA;
+                }
+            }
+            else if ( n == pReader->size )
+            {
+                /* the record does not fit in the buffer */
+                *ppRecord = pRecord;
+                *pLen = n;
+                pReader->start = pReader->end;
+                result = E2BIG;
+            }
+            else
+            {
+                /* Fill keeps the partial record at the start of the
+                   buffer so the scanned portion does not move */
+                scanned = n;
+                result = Fill( pReader );
+                if ( result == EOK )
+                {
+                    result = EINPROGRESS;
+                }
+            }
+        } while ( result == EINPROGRESS );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  READER_NextFrame                                                          */
+/*!
+    Get the next frame from the reader
+
+    The READER_NextFrame function returns the header block and payload
+    of the next length prefixed frame from the input stream.  A frame
+    which does not fit in the input buffer is discarded as it is read,
+    and EMSGSIZE is returned to allow the caller to warn that it was
+    not sent.
+
+    @param[in]
+        pReader
+            pointer to the record reader
+
+    @param[out]
+        ppHeaders
+            pointer to a location to store a pointer to the header block
+
+    @param[out]
+        pHeadersLen
+            pointer to a location to store the header block length
+            (0 = no headers)
+
+    @param[out]
+        ppRecord
+            pointer to a location to store a pointer to the payload
+
+    @param[out]
+        pLen
+            pointer to a location to store the payload length
+
+    @retval EOK a frame was returned
+    @retval EMSGSIZE a frame was too big and is being discarded
+    @retval EBADMSG the input is not framed, or ends inside a frame
+    @retval ENODATA end of input
+    @retval ETIMEDOUT no frame was received within the reader timeout
+    @retval EAGAIN no complete frame is available on a non-blocking input
+    @retval EINVAL invalid arguments
+    @retval other error from read()
+
+==============================================================================*/
+int READER_NextFrame( RecordReader *pReader,
+                      char **ppHeaders,
+                      size_t *pHeadersLen,
+                      char **ppRecord,
+                      size_t *pLen )
+{
+    int result = EINVAL;
+    char *pFrame;
+    size_t n;
+    size_t drop;
+    size_t headersLen = 0;
+    size_t len = 0;
+    size_t total = 0;
+
+    if ( ( pReader != NULL ) &&
+         ( ppHeaders != NULL ) &&
+         ( pHeadersLen != NULL ) &&
+         ( ppRecord != NULL ) &&
+         ( pLen != NULL ) )
+    {
+        do
+        {
+            pFrame = &pReader->pBuf[pReader->start];
+            n = pReader->end - pReader->start;
+
+            if ( pReader->discard > 0 )
+            {
+                /* skip the buffered part of an oversized frame */
+                drop = ( n < pReader->discard ) ? n : pReader->discard;
+                pReader->start += drop;
+                pReader->discard -= drop;
+                result = EINPROGRESS;
+            }
+            else if ( n >= FRAME_HEADER_SIZE )
+            {
+                result = FRAME_Decode( (uint8_t *)pFrame, &headersLen, &len );
+                total = FRAME_HEADER_SIZE + headersLen + len;
+            }
+            else
+            {
+                /* the frame header has not been received yet */
+                result = EAGAIN;
+            }
+
+            if ( result == EBADMSG )
+            {
+                /* the rest of the input cannot be interpreted */
+                pReader->start = pReader->end;
+            }
+            else if ( ( result == EOK ) && ( total > pReader->size ) )
+            {
+                pReader->discard = total;
+                result = EMSGSIZE;
+            }
+            else if ( ( result == EOK ) && ( n >= total ) )
+            {
+                *ppHeaders = &pFrame[FRAME_HEADER_SIZE];
+                *pHeadersLen = headersLen;
+                *ppRecord = &pFrame[FRAME_HEADER_SIZE + headersLen];
+                *pLen = len;
+                pReader->start += total;
+            }
+            else if ( ( result == EINPROGRESS ) && ( pReader->discard == 0 ) )
+            {
+                /* the oversized frame has been discarded */
+            }
+            else if ( pReader->eof )
+            {
+                /* end of input, or the input ends inside a frame */
+                result = ( ( n == 0 ) && ( pReader->discard == 0 ) )
+                         ? ENODATA
+                         : EBADMSG;
+                pReader->start = pReader->end;
+                pReader->discard = 0;
+            }
+            else
+            {
+                /* Fill moves the partial frame to the start of the buffer
+                   and reads as much of the input as fits behind it */
+                result = Fill( pReader );
+                if ( result == EOK )
+                {
+                    result = EINPROGRESS;
+                }
+            }
+        } while ( result == EINPROGRESS );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  READER_Free                                                               */
+/*!
+    Release the resources used by a record reader
+
+    The READER_Free function frees the record reader's input buffer.
+    It does not close the input file descriptor.
+
+    @param[in]
+        pReader
+            pointer to the record reader
+
+==============================================================================*/
+void READER_Free( RecordReader *pReader )
+{
+    if ( pReader != NULL )
+    {
+        if ( ( pReader->pBuf != NULL ) && ( pReader->ownsBuffer == true ) )
+        {
+            POOL_Free( pReader->pBuf, pReader->size );
+        }
+
+        pReader->pBuf = NULL;
+
+        pReader->size = 0;
+        pReader->start = 0;
+        pReader->end = 0;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Fill                                                                      */
+/*!
+    Read more data into the record reader's input buffer
+
+    The Fill function moves any partial record to the start of the
+    input buffer and performs a single read() into the free space
+    following it.  A single read is used so records are returned
+    as soon as they arrive rather than when the buffer is full.
+
+    The reader waits for the input to become readable with ppoll when
+    it has a timeout or is interruptible, so its signal mask is only
+    installed while it waits.
+
+    @param[in]
+        pReader
+            pointer to the record reader
+
+    @retval EOK data was read or the end of input was reached
+    @retval ETIMEDOUT no data was received within the reader timeout,
+            or an interruptible wait was interrupted
+    @retval other error from poll() or read()
+
+==============================================================================*/
+static int Fill( RecordReader *pReader )
+{
+    int result = EOK;
+    size_t n;
+    ssize_t rc;
+    struct pollfd pfd;
+    struct timespec ts;
+
+    n = pReader->end - pReader->start;
+    if ( ( pReader->start > 0 ) && ( n > 0 ) )
+    {
+        memmove( pReader->pBuf, &pReader->pBuf[pReader->start], n );
+    }
+
+    pReader->start = 0;
+    pReader->end = n;
+
+    if ( ( pReader->timeout >= 0 ) || ( pReader->interruptible == true ) )
+    {
+        pfd.fd = pReader->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        ts.tv_sec = pReader->timeout / 1000;
+        ts.tv_nsec = ( pReader->timeout % 1000 ) * 1000000L;
+
+        rc = ppoll( &pfd,
+                    1,
+                    ( pReader->timeout >= 0 ) ? &ts : NULL,
+                    ( pReader->interruptible == true ) ? &pReader->sigmask
+                                                       : NULL );
+        if ( rc == 0 )
+        {
+            result = ETIMEDOUT;
+        }
+        else if ( rc == -1 )
+        {
+            /* report an interrupted wait as a timeout so the caller
+               can re-evaluate its state */
+            result = ( errno == EINTR ) ? ETIMEDOUT : errno;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        do
+        {
+            rc = read( pReader->fd,
+                       &pReader->pBuf[pReader->end],
+                       pReader->size - pReader->end );
+        } while ( ( rc == -1 ) && ( errno == EINTR ) );
+
+        if ( rc > 0 )
+        {
+            pReader->end += rc;
+            STATS_Add( STATS_BYTES_READ, rc );
+        }
+        else if ( rc == 0 )
+        {
+            pReader->eof = true;
+        }
+        else
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of reader group */
@@ -0,0 +1,262 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup retry retry
+ * @brief Retry policy
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file retry.c
+
+    Retry Policy
+
+    The retry module decides whether, and when, a failed operation is
+    retried.  Errors are split into retryable errors, which indicate a
+    transient condition such as a dropped connection or a busy hub,
+    and fatal errors such as an invalid or oversized message, which are
+    never retried.
+
+    Retries are delayed using exponential backoff with full jitter: the
+    delay before a retry is chosen at random between zero and the
+    base delay doubled for each previous attempt, up to a cap.  The
+    randomness spreads the retries of a fleet of devices which lost
+    their connection at the same time, so they do not reconnect in
+    lockstep.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <iotclient/iotclient.h>
+#include "stats.h"
+#include "retry.h"
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! errors which indicate a transient condition */
+static const int retryableErrors[] =
+{
+    EAGAIN,
+    EWOULDBLOCK,
+    EINTR,
+    EBUSY,
+    EIO,
+    ENOBUFS,
+    ETIMEDOUT,
+    ECONNREFUSED,
+    ECONNRESET,
+    ECONNABORTED,
+    ENOTCONN,
+    EPIPE,
+    ENETDOWN,
+    ENETUNREACH,
+    ENETRESET,
+    EHOSTDOWN,
+    EHOSTUNREACH
+};
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  RETRY_Init                                                                */
+/*!
+    Initialize a retry policy with the default settings
+
+    @param[in]
+        pPolicy
+            pointer to the retry policy to initialize
+
+==============================================================================*/
+void RETRY_Init( RetryPolicy *pPolicy )
+{
+    if ( pPolicy != NULL )
+    {
+        pPolicy->maxAttempts = RETRY_DEFAULT_ATTEMPTS;
+        pPolicy->baseMs = RETRY_DEFAULT_BASE_MS;
+        pPolicy->capMs = RETRY_DEFAULT_CAP_MS;
+    }
+}
+
+/*============================================================================*/
+/*  RETRY_IsRetryable                                                         */
+/*!
+    Determine if an error is retryable
+
+    @param[in]
+        err
+            errno value of the failed operation
+
+    @retval true the error indicates a transient condition
+    @retval false the error is fatal
+
+==============================================================================*/
+bool RETRY_IsRetryable( int err )
+{
+    bool retryable = false;
+    size_t i;
+
+    for ( i = 0;
+          i < sizeof( retryableErrors ) / sizeof( retryableErrors[0] );
+          i++ )
+    {
+        if ( retryableErrors[i] == err )
+        {
+            retryable = true;
+            break;
+        }
+    }
+
+    return retryable;
+}
+
+/*============================================================================*/
+/*  RETRY_ShouldRetry                                                         */
+/*!
+    Determine if a failed operation should be retried
+
+    @param[in]
+        pPolicy
+            pointer to the retry policy
+
+    @param[in]
+        err
+            errno value of the last attempt, or EOK if it succeeded
+
+    @param[in]
+        attempts
+            number of attempts made so far
+
+    @retval true the operation should be retried
+    @retval false the operation succeeded, failed with a fatal error,
+            or has used up its attempts
+
+==============================================================================*/
+bool RETRY_ShouldRetry( const RetryPolicy *pPolicy,
+                        int err,
+                        unsigned int attempts )
+{
+    return ( pPolicy != NULL ) &&
+           ( err != EOK ) &&
+           ( ( pPolicy->maxAttempts == 0 ) ||
+             ( attempts < pPolicy->maxAttempts ) ) &&
+           ( RETRY_IsRetryable( err ) == true );
+}
+
+/*============================================================================*/
+/*  RETRY_Delay                                                               */
+/*!
+    Get the delay before the next retry
+
+    The RETRY_Delay function returns a delay chosen uniformly at random
+    between zero and the exponential backoff for the number of attempts
+    made so far (full jitter).  Each delay is counted as a retry.
+
+    @param[in]
+        pPolicy
+            pointer to the retry policy
+
+    @param[in]
+        attempts
+            number of attempts made so far
+
+    @param[in,out]
+        pSeed
+            pointer to the random number generator state of the caller
+
+    @retval retry delay in milliseconds
+
+==============================================================================*/
+unsigned int RETRY_Delay( const RetryPolicy *pPolicy,
+                          unsigned int attempts,
+                          uint64_t *pSeed )
+{
+    uint64_t backoff = 0;
+    uint64_t x;
+
+    if ( ( pPolicy != NULL ) && ( pSeed != NULL ) )
+    {
+        backoff = pPolicy->capMs;
+        if ( ( attempts > 0 ) && ( attempts <= 32 ) )
+        {
+            backoff = (uint64_t)pPolicy->baseMs << ( attempts - 1 );
+            if ( backoff > pPolicy->capMs )
+            {
+                backoff = pPolicy->capMs;
+            }
+        }
+
+        /* xorshift64* */
+        x = *pSeed;
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        *pSeed = x;
+
+        backoff = ( ( x * 2685821657736338717ull ) >> 32 ) % ( backoff + 1 );
+
+        STATS_Add( STATS_RETRIES, 1 );
+    }
+
+    return (unsigned int)backoff;
+}
+
+/*============================================================================*/
+/*  RETRY_Seed                                                                */
+/*!
+    Get a seed for the retry delay random number generator
+
+    The seed combines the process id with the current time so retries
+    from different devices and threads are decorrelated.
+
+    @retval non-zero random number generator seed
+
+==============================================================================*/
+uint64_t RETRY_Seed( void )
+{
+    struct timespec ts;
+    uint64_t seed;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    seed = ( (uint64_t)getpid() << 32 ) ^
+           ( (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec );
+
+    return ( seed != 0 ) ? seed : 1;
+}
+
+/*! @}
+ * end of retry group */
@@ -0,0 +1,689 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup ring ring
+ * @brief Lock-free single producer / single consumer ring
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file ring.c
+
+    Lock-free SPSC Ring
+
+    The ring coordinates a single producer thread and a single consumer
+    thread sharing an array of slots owned by the caller.  The head
+    counter is only written by the producer and the tail counter is
+    only written by the consumer, and they are kept on separate cache
+    lines, so passing a slot between the threads costs one atomic load
+    and one atomic store on each side.
+
+    A thread only sleeps when the ring is full (producer) or empty
+    (consumer).  Before sleeping it raises its waiting flag and checks
+    the ring again; the other thread checks the flag after updating its
+    counter and only then signals the eventfd to wake it up.  Both sides
+    use sequentially consistent operations for the flag handshake so a
+    wakeup can never be lost.
+
+    A consumer may serve several rings in priority order.  The rings
+    share the consumer eventfd of the first ring, so the consumer sleeps
+    until a slot is published in any of them and always takes the next
+    slot from the first non-empty ring.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <iotclient/iotclient.h>
+#include "ring.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of times the consumer polls an empty ring before sleeping
+    on a multi-processor system */
+#define RING_SPIN_COUNT     ( 256 )
+
+/*! hint to the CPU that the thread is spinning */
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define CPU_RELAX()         __builtin_ia32_pause()
+#elif defined( __aarch64__ ) || defined( __arm__ )
+#define CPU_RELAX()         __asm__ __volatile__( "yield" ::: "memory" )
+#else
+#define CPU_RELAX()         __asm__ __volatile__( "" ::: "memory" )
+#endif
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static bool First( Ring *pRings, size_t count, size_t *pRing );
+static bool Stopped( Ring *pRings, size_t count );
+static void SetConsumerWaiting( Ring *pRings, size_t count, int waiting );
+static int Wait( int fd, int timeoutMs );
+static void Wake( int fd );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  RING_Init                                                                 */
+/*!
+    Initialize a ring
+
+    @param[in]
+        pRing
+            pointer to the ring to initialize
+
+    @param[in]
+        depth
+            number of slots in the ring
+
+    @retval EOK the ring was initialized
+    @retval EINVAL invalid arguments
+    @retval other error from eventfd()
+
+==============================================================================*/
+int RING_Init( Ring *pRing, size_t depth )
+{
+    int result = EINVAL;
+
+    if ( ( pRing != NULL ) && ( depth > 0 ) )
+    {
+        memset( pRing, 0, sizeof( Ring ) );
+        pRing->depth = depth;
+
+        /* spinning only helps if the producer runs on another CPU */
+        pRing->spinCount = ( sysconf( _SC_NPROCESSORS_ONLN ) > 1 )
+                           ? RING_SPIN_COUNT
+                           : 0;
+
+        pRing->notEmptyEvent = eventfd( 0, EFD_CLOEXEC );
+        pRing->notFullEvent = eventfd( 0, EFD_CLOEXEC );
+
+        if ( ( pRing->notEmptyEvent != -1 ) &&
+             ( pRing->notFullEvent != -1 ) )
+        {
+            result = EOK;
+        }
+        else
+        {
+            result = errno;
+            RING_Free( pRing );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RING_Acquire                                                              */
+/*!
+    Acquire the next free slot (producer)
+
+    The RING_Acquire function waits until a slot is free and returns its
+    index.  The producer may fill the slot and must then call
+    RING_Publish to pass it to the consumer.
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+    @retval index of the acquired slot
+
+==============================================================================*/
+size_t RING_Acquire( Ring *pRing )
+{
+    uint64_t head = pRing->head;
+
+    while ( head - __atomic_load_n( &pRing->tail, __ATOMIC_ACQUIRE ) ==
+            pRing->depth )
+    {
+        __atomic_store_n( &pRing->producerWaiting, 1, __ATOMIC_SEQ_CST );
+        if ( head - __atomic_load_n( &pRing->tail, __ATOMIC_SEQ_CST ) ==
+             pRing->depth )
+        {
+            (void)Wait( pRing->notFullEvent, -1 );
+        }
+        __atomic_store_n( &pRing->producerWaiting, 0, __ATOMIC_RELAXED );
+    }
+
+    return head % pRing->depth;
+}
+
+/*============================================================================*/
+/*  RING_Publish                                                              */
+/*!
+    Pass the acquired slot to the consumer (producer)
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+==============================================================================*/
+void RING_Publish( Ring *pRing )
+{
+    __atomic_store_n( &pRing->head, pRing->head + 1, __ATOMIC_SEQ_CST );
+
+    if ( __atomic_load_n( &pRing->consumerWaiting, __ATOMIC_SEQ_CST ) )
+    {
+        Wake( pRing->notEmptyEvent );
+    }
+}
+
+/*============================================================================*/
+/*  RING_Peek                                                                 */
+/*!
+    Wait for the next published slot (consumer)
+
+    The RING_Peek function waits until a slot has been published and
+    returns its index.  The consumer must call RING_Release once it has
+    finished with the slot.
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+    @param[out]
+        pIndex
+            pointer to a location to store the slot index
+
+    @retval EOK a slot is available
+    @retval ENODATA the ring is empty and the producer has stopped
+
+==============================================================================*/
+int RING_Peek( Ring *pRing, size_t *pIndex )
+{
+    return RING_PeekTimeout( pRing, pIndex, -1 );
+}
+
+/*============================================================================*/
+/*  RING_PeekTimeout                                                          */
+/*!
+    Wait for the next published slot with a timeout (consumer)
+
+    The RING_PeekTimeout function is the same as RING_Peek but gives up
+    waiting for a slot after the specified timeout.
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+    @param[out]
+        pIndex
+            pointer to a location to store the slot index
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or -1 to wait forever
+
+    @retval EOK a slot is available
+    @retval ETIMEDOUT no slot was published before the timeout
+    @retval ENODATA the ring is empty and the producer has stopped
+
+==============================================================================*/
+int RING_PeekTimeout( Ring *pRing, size_t *pIndex, int timeoutMs )
+{
+    size_t ring;
+
+    return RING_PeekFirst( pRing, 1, &ring, pIndex, timeoutMs );
+}
+
+/*============================================================================*/
+/*  RING_ShareEvent                                                           */
+/*!
+    Share the consumer event of another ring
+
+    The RING_ShareEvent function makes a ring wake up its consumer
+    through the consumer event of another ring, so a consumer serving
+    both rings with RING_PeekFirst can wait for either of them.  It
+    must be called before the rings are used, and the owner ring must
+    be freed last.
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+    @param[in]
+        pOwner
+            pointer to the ring which owns the consumer event
+
+    @retval EOK the consumer event is shared
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int RING_ShareEvent( Ring *pRing, Ring *pOwner )
+{
+    int result = EINVAL;
+
+    if ( ( pRing != NULL ) && ( pOwner != NULL ) && ( pRing != pOwner ) )
+    {
+        if ( ( pRing->sharedEvent == false ) && ( pRing->notEmptyEvent > 0 ) )
+        {
+            close( pRing->notEmptyEvent );
+        }
+
+        pRing->notEmptyEvent = pOwner->notEmptyEvent;
+        pRing->sharedEvent = true;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RING_PeekFirst                                                            */
+/*!
+    Wait for the next published slot of several rings (consumer)
+
+    The RING_PeekFirst function waits until a slot has been published
+    in any of the rings and returns the slot at the front of the first
+    non-empty ring, so the rings are served in strict priority order.
+    Every ring after the first must share the consumer event of the
+    first ring.
+
+    @param[in]
+        pRings
+            array of rings in priority order
+
+    @param[in]
+        count
+            number of rings
+
+    @param[out]
+        pRing
+            pointer to a location to store the index of the ring
+
+    @param[out]
+        pIndex
+            pointer to a location to store the slot index
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or -1 to wait forever
+
+    @retval EOK a slot is available
+    @retval ETIMEDOUT no slot was published before the timeout
+    @retval ENODATA the rings are empty and the producers have stopped
+
+==============================================================================*/
+int RING_PeekFirst( Ring *pRings,
+                    size_t count,
+                    size_t *pRing,
+                    size_t *pIndex,
+                    int timeoutMs )
+{
+    int result = EOK;
+    int spin;
+
+    *pRing = 0;
+
+    /* briefly spin before sleeping since the producer is usually close */
+    for ( spin = 0; ( spin < pRings[0].spinCount ) &&
+                    ( First( pRings, count, pRing ) == false ); spin++ )
+    {
+        CPU_RELAX();
+    }
+
+    while ( First( pRings, count, pRing ) == false )
+    {
+        SetConsumerWaiting( pRings, count, 1 );
+        if ( First( pRings, count, pRing ) == false )
+        {
+            if ( Stopped( pRings, count ) == false )
+            {
+                result = Wait( pRings[0].notEmptyEvent, timeoutMs );
+            }
+            else if ( First( pRings, count, pRing ) == false )
+            {
+                /* a slot may be published just before the stop, so it
+                   is only empty if it is still empty after the stop */
+                SetConsumerWaiting( pRings, count, 0 );
+                result = ENODATA;
+                break;
+            }
+        }
+        SetConsumerWaiting( pRings, count, 0 );
+
+        if ( result == ETIMEDOUT )
+        {
+            break;
+        }
+    }
+
+    *pIndex = pRings[*pRing].tail % pRings[*pRing].depth;
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RING_Release                                                              */
+/*!
+    Return the peeked slot to the producer (consumer)
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+==============================================================================*/
+void RING_Release( Ring *pRing )
+{
+    __atomic_store_n( &pRing->tail, pRing->tail + 1, __ATOMIC_SEQ_CST );
+
+    if ( __atomic_load_n( &pRing->producerWaiting, __ATOMIC_SEQ_CST ) )
+    {
+        Wake( pRing->notFullEvent );
+    }
+}
+
+/*============================================================================*/
+/*  RING_WaitEmpty                                                            */
+/*!
+    Wait until the consumer has released every slot (producer)
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+==============================================================================*/
+void RING_WaitEmpty( Ring *pRing )
+{
+    while ( __atomic_load_n( &pRing->tail, __ATOMIC_ACQUIRE ) != pRing->head )
+    {
+        __atomic_store_n( &pRing->producerWaiting, 1, __ATOMIC_SEQ_CST );
+        if ( __atomic_load_n( &pRing->tail, __ATOMIC_SEQ_CST ) != pRing->head )
+        {
+            (void)Wait( pRing->notFullEvent, -1 );
+        }
+        __atomic_store_n( &pRing->producerWaiting, 0, __ATOMIC_RELAXED );
+    }
+}
+
+/*============================================================================*/
+/*  RING_Stop                                                                 */
+/*!
+    Tell the consumer that no more slots will be published (producer)
+
+    Once the consumer has released the remaining slots, RING_Peek
+    returns ENODATA.
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+==============================================================================*/
+void RING_Stop( Ring *pRing )
+{
+    __atomic_store_n( &pRing->stopped, 1, __ATOMIC_SEQ_CST );
+    Wake( pRing->notEmptyEvent );
+}
+
+/*============================================================================*/
+/*  RING_Count                                                                */
+/*!
+    Get the number of slots which are published but not yet released
+
+    The count is a snapshot and may be slightly out of date when it is
+    read by a thread other than the producer or the consumer.
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+    @retval number of slots in use
+
+==============================================================================*/
+size_t RING_Count( Ring *pRing )
+{
+    uint64_t tail = __atomic_load_n( &pRing->tail, __ATOMIC_ACQUIRE );
+    uint64_t head = __atomic_load_n( &pRing->head, __ATOMIC_ACQUIRE );
+
+    return ( head >= tail ) ? (size_t)( head - tail ) : 0;
+}
+
+/*============================================================================*/
+/*  RING_Free                                                                 */
+/*!
+    Release the resources used by a ring
+
+    @param[in]
+        pRing
+            pointer to the ring
+
+==============================================================================*/
+void RING_Free( Ring *pRing )
+{
+    if ( pRing != NULL )
+    {
+        if ( ( pRing->sharedEvent == false ) && ( pRing->notEmptyEvent > 0 ) )
+        {
+            close( pRing->notEmptyEvent );
+        }
+
+        if ( pRing->notFullEvent > 0 )
+        {
+            close( pRing->notFullEvent );
+        }
+
+        pRing->notEmptyEvent = -1;
+        pRing->notFullEvent = -1;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  First                                                                     */
+/*!
+    Find the first non-empty ring (consumer)
+
+    @param[in]
+        pRings
+            array of rings in priority order
+
+    @param[in]
+        count
+            number of rings
+
+    @param[out]
+        pRing
+            pointer to a location to store the index of the first
+            non-empty ring
+
+    @retval true a ring is non-empty
+    @retval false every ring is empty
+
+==============================================================================*/
+static bool First( Ring *pRings, size_t count, size_t *pRing )
+{
+    bool found = false;
+    size_t i;
+
+    for ( i = 0; ( i < count ) && ( found == false ); i++ )
+    {
+        if ( __atomic_load_n( &pRings[i].head, __ATOMIC_SEQ_CST ) !=
+             pRings[i].tail )
+        {
+            *pRing = i;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/*============================================================================*/
+/*  Stopped                                                                   */
+/*!
+    Check if the producers of every ring have stopped
+
+    @param[in]
+        pRings
+            array of rings
+
+    @param[in]
+        count
+            number of rings
+
+    @retval true every producer has stopped
+    @retval false a producer may still publish slots
+
+==============================================================================*/
+static bool Stopped( Ring *pRings, size_t count )
+{
+    bool stopped = true;
+    size_t i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        if ( __atomic_load_n( &pRings[i].stopped, __ATOMIC_SEQ_CST ) == 0 )
+        {
+            stopped = false;
+        }
+    }
+
+    return stopped;
+}
+
+/*============================================================================*/
+/*  SetConsumerWaiting                                                        */
+/*!
+    Raise or clear the consumer waiting flag of several rings
+
+    @param[in]
+        pRings
+            array of rings
+
+    @param[in]
+        count
+            number of rings
+
+    @param[in]
+        waiting
+            1 to raise the flags, 0 to clear them
+
+==============================================================================*/
+static void SetConsumerWaiting( Ring *pRings, size_t count, int waiting )
+{
+    size_t i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        if ( waiting != 0 )
+        {
+            __atomic_store_n( &pRings[i].consumerWaiting, 1, __ATOMIC_SEQ_CST );
+        }
+        else
+        {
+            __atomic_store_n( &pRings[i].consumerWaiting, 0, __ATOMIC_RELAXED );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Wait                                                                      */
+/*!
+    Wait for an eventfd to be signalled
+
+    @param[in]
+        fd
+            eventfd to wait on
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or -1 to wait forever
+
+    @retval EOK the eventfd was signalled
+    @retval ETIMEDOUT the eventfd was not signalled before the timeout
+
+==============================================================================*/
+static int Wait( int fd, int timeoutMs )
+{
+    int result = EOK;
+    uint64_t value;
+    struct pollfd pfd;
+    int rc;
+
+    if ( timeoutMs >= 0 )
+    {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+
+        do
+        {
+            rc = poll( &pfd, 1, timeoutMs );
+        } while ( ( rc == -1 ) && ( errno == EINTR ) );
+
+        if ( rc == 0 )
+        {
+            result = ETIMEDOUT;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        while ( ( read( fd, &value, sizeof( value ) ) == -1 ) &&
+                ( errno == EINTR ) )
+        {
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Wake                                                                      */
+/*!
+    Signal an eventfd
+
+    @param[in]
+        fd
+            eventfd to signal
+
+==============================================================================*/
+static void Wake( int fd )
+{
+    uint64_t value = 1;
+
+    (void)write( fd, &value, sizeof( value ) );
+}
+
+/*! @}
+ * end of ring group */
@@ -0,0 +1,1458 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup spool spool
+ * @brief On-disk store-and-forward spool
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file spool.c
+
+    Store-and-Forward Spool
+
+    The spool keeps messages which cannot be delivered, for example
+    while the iothub service is down or the cloud link has dropped, and
+    forwards them once connectivity returns.
+
+    Messages are appended to a segmented, append-only log in the spool
+    directory.  Each segment file holds up to SPOOL_SEGMENT_SIZE bytes
+    of messages, and has a compact index file holding the 32-bit offset
+    of each message in the segment.  The index is written after the
+    message, so a message torn by a crash is discarded when the spool is
+    re-opened.  A cursor file records the position of the next message
+    to replay.
+
+    A drainer thread replays the spool over its own IOTClient connection,
+    retrying the connection with an exponential backoff while the hub
+    is unreachable.  The segments are memory mapped for replay, so the
+    messages are sent straight from the page cache without a system call
+    per message.  Fully replayed segments are deleted.
+
+    Messages are delivered at least once: messages replayed since the
+    cursor was last saved may be sent again after a crash.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <time.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <iotclient/iotclient.h>
+#include "retry.h"
+#include "ratelimit.h"
+#include "stats.h"
+#include "spool.h"
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! spooled message marker ("IOTS") */
+#define SPOOL_MAGIC             ( 0x53544f49u )
+
+/*! spooled messages are aligned to this many bytes */
+#define SPOOL_ALIGN             ( 8 )
+
+/*! number of replayed messages between saves of the cursor */
+#define SPOOL_CURSOR_INTERVAL   ( 64 )
+
+/*! minimum time between syncs with the interval fsync policy */
+#define SPOOL_SYNC_INTERVAL_MS  ( 1000 )
+
+/*! initial delay before retrying the drainer connection */
+#define SPOOL_RETRY_MIN_MS      ( 1000 )
+
+/*! maximum delay before retrying the drainer connection */
+#define SPOOL_RETRY_MAX_MS      ( 30000 )
+
+/*! maximum length of a spool file path */
+#define SPOOL_PATH_LEN          ( PATH_MAX )
+
+/*! spooled message header.  The message headers, including their NUL
+    terminator, and the message payload follow */
+typedef struct _SpoolRecord
+{
+    /*! SPOOL_MAGIC */
+    uint32_t magic;
+
+    /*! length of the message headers */
+    uint32_t headerLen;
+
+    /*! length of the message payload */
+    uint32_t dataLen;
+
+    /*! reserved, set to zero */
+    uint32_t reserved;
+
+} SpoolRecord;
+
+/*! replay cursor stored in the cursor file */
+typedef struct _SpoolCursor
+{
+    /*! number of the segment being replayed */
+    uint32_t segment;
+
+    /*! index of the next message to replay in the segment */
+    uint32_t record;
+
+} SpoolCursor;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int Recover( Spool *pSpool );
+static int ScanSegments( Spool *pSpool, uint32_t *pFirst, uint32_t *pLast );
+static int OpenSegment( Spool *pSpool, uint32_t segment, bool create );
+static int GetOffset( int idxFd, uint32_t record, uint64_t *pOffset );
+static int CountRecords( Spool *pSpool, uint32_t segment, uint32_t *pCount );
+static void SaveCursor( Spool *pSpool );
+static void Sync( Spool *pSpool, bool force );
+static void *DrainerThread( void *arg );
+static int Replay( Spool *pSpool );
+static int MapSegment( Spool *pSpool, uint32_t segment, uint64_t size );
+static void FinishSegment( Spool *pSpool );
+static void Wait( Spool *pSpool, uint64_t ms );
+static void MakePath( Spool *pSpool,
+                      uint32_t segment,
+                      const char *ext,
+                      char *pPath );
+static size_t RecordLength( uint32_t headerLen, uint32_t dataLen );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  SPOOL_Open                                                                */
+/*!
+    Open the store-and-forward spool
+
+    The SPOOL_Open function creates the spool directory if required,
+    recovers the spool left by a previous run, discarding any torn
+    message at its end, and starts the drainer thread which replays
+    any spooled messages.
+
+    @param[in]
+        pSpool
+            pointer to the spool to open
+
+    @param[in]
+        dir
+            spool directory
+
+    @param[in]
+        fsyncPolicy
+            fsync policy for the spool files
+
+    @param[in]
+        pRateLimit
+            rate limiter for replayed messages, or NULL for no limit
+
+    @param[in]
+        verbose
+            report spool activity on stderr
+
+    @retval EOK the spool was opened
+    @retval ENOMEM memory allocation failed
+    @retval EINVAL invalid arguments
+    @retval other error creating or reading the spool files
+
+==============================================================================*/
+int SPOOL_Open( Spool *pSpool,
+                const char *dir,
+                SpoolFsync fsyncPolicy,
+                RateLimit *pRateLimit,
+                bool verbose )
+{
+    int result = EINVAL;
+    pthread_condattr_t attr;
+
+    if ( ( pSpool != NULL ) && ( dir != NULL ) )
+    {
+        memset( pSpool, 0, sizeof( Spool ) );
+        pSpool->fsyncPolicy = fsyncPolicy;
+        pSpool->pRateLimit = pRateLimit;
+        pSpool->verbose = verbose;
+        pSpool->segFd = -1;
+        pSpool->idxFd = -1;
+        pSpool->cursorFd = -1;
+
+        pSpool->pDir = strdup( dir );
+        result = ( pSpool->pDir != NULL ) ? EOK : ENOMEM;
+
+        if ( ( result == EOK ) &&
+             ( mkdir( dir, 0750 ) != 0 ) &&
+             ( errno != EEXIST ) )
+        {
+            result = errno;
+        }
+
+        if ( result == EOK )
+        {
+            result = Recover( pSpool );
+        }
+
+        if ( result == EOK )
+        {
+            /* the drainer waits on the monotonic clock while backing off */
+            pthread_mutex_init( &pSpool->mutex, NULL );
+            pthread_condattr_init( &attr );
+            pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+            pthread_cond_init( &pSpool->cond, &attr );
+            pthread_condattr_destroy( &attr );
+
+            result = pthread_create( &pSpool->thread,
+                                     NULL,
+                                     DrainerThread,
+                                     pSpool );
+            if ( result == EOK )
+            {
+                pSpool->running = true;
+            }
+            else
+            {
+                pthread_cond_destroy( &pSpool->cond );
+                pthread_mutex_destroy( &pSpool->mutex );
+            }
+        }
+
+        if ( result != EOK )
+        {
+            if ( pSpool->segFd != -1 )
+            {
+                close( pSpool->segFd );
+            }
+
+            if ( pSpool->idxFd != -1 )
+            {
+                close( pSpool->idxFd );
+            }
+
+            if ( pSpool->cursorFd != -1 )
+            {
+                close( pSpool->cursorFd );
+            }
+
+            free( pSpool->pDir );
+            pSpool->pDir = NULL;
+        }
+        else if ( ( pSpool->verbose == true ) && ( pSpool->pending > 0 ) )
+        {
+            fprintf( stderr,
+                     "Spool: %" PRIu64 " messages to replay\n",
+                     pSpool->pending );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SPOOL_Append                                                              */
+/*!
+    Append a message to the spool
+
+    The SPOOL_Append function appends a message to the segment being
+    written, starting a new segment if the message does not fit, adds
+    its offset to the segment index, and wakes up the drainer thread.
+    The spool files are synced according to the fsync policy.
+
+    SPOOL_Append may be called from any thread.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        pHeaders
+            message headers
+
+    @param[in]
+        pData
+            message payload
+
+    @param[in]
+        len
+            length of the message payload
+
+    @retval EOK the message was spooled
+    @retval E2BIG the message is too big to spool
+    @retval EINVAL invalid arguments
+    @retval other error writing the spool files
+
+==============================================================================*/
+int SPOOL_Append( Spool *pSpool,
+                  const char *pHeaders,
+                  const char *pData,
+                  size_t len )
+{
+    int result = EINVAL;
+    SpoolRecord record;
+    struct iovec iov[4];
+    static const char padding[SPOOL_ALIGN] = { 0 };
+    size_t recLen;
+    uint32_t offset;
+    ssize_t rc;
+
+    if ( ( pSpool != NULL ) &&
+         ( pSpool->running == true ) &&
+         ( pHeaders != NULL ) &&
+         ( ( pData != NULL ) || ( len == 0 ) ) )
+    {
+        record.magic = SPOOL_MAGIC;
+        record.headerLen = strlen( pHeaders ) + 1;
+        record.dataLen = len;
+        record.reserved = 0;
+
+        recLen = RecordLength( record.headerLen, len );
+        result = ( recLen <= SPOOL_SEGMENT_SIZE ) ? EOK : E2BIG;
+
+        pthread_mutex_lock( &pSpool->mutex );
+
+        if ( ( result == EOK ) &&
+             ( pSpool->writeCount > 0 ) &&
+             ( pSpool->writeSize + recLen > SPOOL_SEGMENT_SIZE ) )
+        {
+            /* start a new segment */
+            Sync( pSpool, true );
+            result = OpenSegment( pSpool, pSpool->writeSegment + 1, true );
+        }
+
+        if ( result == EOK )
+        {
+            iov[0].iov_base = &record;
+            iov[0].iov_len = sizeof( SpoolRecord );
+            iov[1].iov_base = (void *)pHeaders;
+            iov[1].iov_len = record.headerLen;
+            iov[2].iov_base = (void *)pData;
+            iov[2].iov_len = len;
+            iov[3].iov_base = (void *)padding;
+            iov[3].iov_len = recLen - sizeof( SpoolRecord ) -
+                             record.headerLen - len;
+
+            offset = pSpool->writeSize;
+
+            rc = writev( pSpool->segFd, iov, 4 );
+            if ( ( rc == (ssize_t)recLen ) &&
+                 ( write( pSpool->idxFd,
+                          &offset,
+                          sizeof( offset ) ) == sizeof( offset ) ) )
+            {
+                pSpool->writeSize += recLen;
+                pSpool->writeCount++;
+                __atomic_add_fetch( &pSpool->pending, 1, __ATOMIC_RELEASE );
+                STATS_Add( STATS_SPOOLED, 1 );
+
+                Sync( pSpool, ( pSpool->fsyncPolicy == SPOOL_FSYNC_ALWAYS ) );
+                pthread_cond_broadcast( &pSpool->cond );
+            }
+            else
+            {
+                result = ( rc == -1 ) ? errno : EIO;
+
+                /* discard the partially written message */
+                if ( ftruncate( pSpool->segFd, pSpool->writeSize ) != 0 )
+                {
+                    result = errno;
+                }
+            }
+        }
+
+        pthread_mutex_unlock( &pSpool->mutex );
+
+        if ( ( result != EOK ) && ( pSpool->verbose == true ) )
+        {
+            fprintf( stderr,
+                     "Spool: cannot spool message: %s\n",
+                     strerror( result ) );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SPOOL_Pending                                                             */
+/*!
+    Get the number of spooled messages waiting to be replayed
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @retval number of messages waiting to be replayed
+
+==============================================================================*/
+uint64_t SPOOL_Pending( Spool *pSpool )
+{
+    return ( pSpool != NULL )
+           ? __atomic_load_n( &pSpool->pending, __ATOMIC_ACQUIRE )
+           : 0;
+}
+
+/*============================================================================*/
+/*  SPOOL_SetDeadline                                                         */
+/*!
+    Set the deadline for replaying the spooled messages
+
+    The SPOOL_SetDeadline function sets the time after which the drainer
+    thread stops replaying messages, so closing the spool does not wait
+    for a long backlog to be forwarded.  The messages which have not been
+    replayed are kept for the next run.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        deadline
+            monotonic time in milliseconds, as from CLOCK_MONOTONIC
+
+==============================================================================*/
+void SPOOL_SetDeadline( Spool *pSpool, uint64_t deadline )
+{
+    if ( pSpool != NULL )
+    {
+        __atomic_store_n( &pSpool->deadline, deadline, __ATOMIC_RELEASE );
+    }
+}
+
+/*============================================================================*/
+/*  SPOOL_Close                                                               */
+/*!
+    Close the store-and-forward spool
+
+    The SPOOL_Close function stops the drainer thread once it has
+    replayed the spooled messages, or as soon as it cannot deliver one,
+    saves the replay cursor, syncs the spool files, and releases the
+    spool resources.  Undelivered messages are kept for the next run.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+==============================================================================*/
+void SPOOL_Close( Spool *pSpool )
+{
+    if ( ( pSpool != NULL ) && ( pSpool->running == true ) )
+    {
+        pthread_mutex_lock( &pSpool->mutex );
+        pSpool->stopping = true;
+        pthread_cond_broadcast( &pSpool->cond );
+        pthread_mutex_unlock( &pSpool->mutex );
+
+        pthread_join( pSpool->thread, NULL );
+        pSpool->running = false;
+
+        SaveCursor( pSpool );
+        Sync( pSpool, true );
+
+        if ( ( pSpool->verbose == true ) && ( pSpool->pending > 0 ) )
+        {
+            fprintf( stderr,
+                     "Spool: %" PRIu64 " messages left to replay\n",
+                     pSpool->pending );
+        }
+
+        if ( pSpool->pMap != NULL )
+        {
+            munmap( pSpool->pMap, pSpool->mapSize );
+            pSpool->pMap = NULL;
+        }
+
+        if ( pSpool->hIoTClient != NULL )
+        {
+            IOTCLIENT_Close( pSpool->hIoTClient );
+            pSpool->hIoTClient = NULL;
+        }
+
+        close( pSpool->segFd );
+        close( pSpool->idxFd );
+        close( pSpool->cursorFd );
+        pSpool->segFd = -1;
+        pSpool->idxFd = -1;
+        pSpool->cursorFd = -1;
+
+        pthread_cond_destroy( &pSpool->cond );
+        pthread_mutex_destroy( &pSpool->mutex );
+
+        free( pSpool->pDir );
+        pSpool->pDir = NULL;
+    }
+}
+
+/*============================================================================*/
+/*  SPOOL_ParseFsync                                                          */
+/*!
+    Convert a policy name to a spool fsync policy
+
+    @param[in]
+        name
+            policy name: interval, always, or never
+
+    @param[out]
+        pPolicy
+            pointer to a location to store the fsync policy
+
+    @retval EOK the policy name was recognized
+    @retval EINVAL unknown policy name
+
+==============================================================================*/
+int SPOOL_ParseFsync( const char *name, SpoolFsync *pPolicy )
+{
+    int result = EINVAL;
+
+    if ( ( name != NULL ) && ( pPolicy != NULL ) )
+    {
+        result = EOK;
+
+        if ( strcmp( name, "interval" ) == 0 )
+        {
+            *pPolicy = SPOOL_FSYNC_INTERVAL;
+        }
+        else if ( strcmp( name, "always" ) == 0 )
+        {
+            *pPolicy = SPOOL_FSYNC_ALWAYS;
+        }
+        else if ( strcmp( name, "never" ) == 0 )
+        {
+            *pPolicy = SPOOL_FSYNC_NEVER;
+        }
+        else
+        {
+            result = EINVAL;
+        }
+    }
+
+    return result;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Recover                                                                   */
+/*!
+    Recover the spool state from the spool directory
+
+    The Recover function finds the segments in the spool directory,
+    re-opens the last one for writing, loads the replay cursor, and
+    counts the messages waiting to be replayed.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @retval EOK the spool was recovered
+    @retval other error reading the spool files
+
+==============================================================================*/
+static int Recover( Spool *pSpool )
+{
+    int result;
+    uint32_t first = 0;
+    uint32_t last = 0;
+    uint32_t segment;
+    uint32_t count;
+    SpoolCursor cursor;
+    char path[SPOOL_PATH_LEN];
+    int fd;
+
+    result = ScanSegments( pSpool, &first, &last );
+    if ( result == EOK )
+    {
+        result = OpenSegment( pSpool, last, false );
+    }
+
+    if ( result == EOK )
+    {
+        snprintf( path, sizeof( path ), "%s/cursor", pSpool->pDir );
+        pSpool->cursorFd = open( path, O_RDWR | O_CREAT, 0640 );
+        if ( pSpool->cursorFd == -1 )
+        {
+            result = errno;
+        }
+        else if ( pread( pSpool->cursorFd,
+                         &cursor,
+                         sizeof( cursor ),
+                         0 ) != sizeof( cursor ) )
+        {
+            /* no cursor: replay from the first segment */
+            cursor.segment = first;
+            cursor.record = 0;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        if ( ( cursor.segment < first ) || ( cursor.segment > last ) )
+        {
+            cursor.segment = first;
+            cursor.record = 0;
+        }
+
+        pSpool->readSegment = cursor.segment;
+        pSpool->readRecord = cursor.record;
+
+        for ( segment = cursor.segment;
+              ( segment <= last ) && ( result == EOK );
+              segment++ )
+        {
+            if ( segment == pSpool->writeSegment )
+            {
+                count = pSpool->writeCount;
+            }
+            else
+            {
+                result = CountRecords( pSpool, segment, &count );
+            }
+
+            if ( segment == cursor.segment )
+            {
+                if ( pSpool->readRecord > count )
+                {
+                    pSpool->readRecord = count;
+                }
+
+                if ( pSpool->readRecord < count )
+                {
+                    /* find the next message to replay */
+                    MakePath( pSpool, segment, "idx", path );
+                    fd = open( path, O_RDONLY );
+                    result = ( fd != -1 )
+                             ? GetOffset( fd,
+                                          pSpool->readRecord,
+                                          &pSpool->readOffset )
+                             : errno;
+                    if ( fd != -1 )
+                    {
+                        close( fd );
+                    }
+                }
+
+                count -= pSpool->readRecord;
+            }
+
+            pSpool->pending += count;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ScanSegments                                                              */
+/*!
+    Find the first and last segments in the spool directory
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[out]
+        pFirst
+            pointer to a location to store the first segment number
+
+    @param[out]
+        pLast
+            pointer to a location to store the last segment number
+
+    @retval EOK the spool directory was scanned
+    @retval other error from opendir
+
+==============================================================================*/
+static int ScanSegments( Spool *pSpool, uint32_t *pFirst, uint32_t *pLast )
+{
+    int result = EOK;
+    DIR *pDir;
+    struct dirent *pEntry;
+    unsigned long segment;
+    char *pEnd;
+    bool found = false;
+
+    pDir = opendir( pSpool->pDir );
+    if ( pDir == NULL )
+    {
+        result = errno;
+    }
+    else
+    {
+        while ( ( pEntry = readdir( pDir ) ) != NULL )
+        {
+            segment = strtoul( pEntry->d_name, &pEnd, 10 );
+            if ( ( pEnd != pEntry->d_name ) &&
+                 ( strcmp( pEnd, ".seg" ) == 0 ) &&
+                 ( segment <= UINT32_MAX ) )
+            {
+                if ( ( found == false ) || ( segment < *pFirst ) )
+                {
+                    *pFirst = segment;
+                }
+
+                if ( ( found == false ) || ( segment > *pLast ) )
+                {
+                    *pLast = segment;
+                }
+
+                found = true;
+            }
+        }
+
+        closedir( pDir );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  OpenSegment                                                               */
+/*!
+    Open a segment for writing
+
+    The OpenSegment function opens a segment and its index for appending.
+    When an existing segment is re-opened, any message at its end which
+    was not completely written, or whose offset was not written to the
+    index, is discarded.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        segment
+            segment number
+
+    @param[in]
+        create
+            create a new, empty segment
+
+    @retval EOK the segment was opened
+    @retval other error opening or recovering the segment
+
+==============================================================================*/
+static int OpenSegment( Spool *pSpool, uint32_t segment, bool create )
+{
+    int result = EOK;
+    int flags = O_RDWR | O_CREAT | O_APPEND | ( create ? O_TRUNC : 0 );
+    char path[SPOOL_PATH_LEN];
+    struct stat segStat;
+    struct stat idxStat;
+    SpoolRecord record;
+    uint64_t offset;
+    uint32_t count = 0;
+    uint64_t size = 0;
+
+    if ( pSpool->segFd != -1 )
+    {
+        close( pSpool->segFd );
+        close( pSpool->idxFd );
+    }
+
+    MakePath( pSpool, segment, "seg", path );
+    pSpool->segFd = open( path, flags, 0640 );
+    MakePath( pSpool, segment, "idx", path );
+    pSpool->idxFd = open( path, flags, 0640 );
+
+    if ( ( pSpool->segFd == -1 ) ||
+         ( pSpool->idxFd == -1 ) ||
+         ( fstat( pSpool->segFd, &segStat ) != 0 ) ||
+         ( fstat( pSpool->idxFd, &idxStat ) != 0 ) )
+    {
+        result = errno;
+    }
+    else
+    {
+        /* find the last message which was completely written */
+        count = idxStat.st_size / sizeof( uint32_t );
+        while ( count > 0 )
+        {
+            if ( ( GetOffset( pSpool->idxFd, count - 1, &offset ) == EOK ) &&
+                 ( pread( pSpool->segFd,
+                          &record,
+                          sizeof( record ),
+                          offset ) == sizeof( record ) ) &&
+                 ( record.magic == SPOOL_MAGIC ) )
+            {
+                size = offset + RecordLength( record.headerLen,
+                                              record.dataLen );
+                if ( size <= (uint64_t)segStat.st_size )
+                {
+                    break;
+                }
+            }
+
+            count--;
+            size = 0;
+        }
+
+        if ( ( ( ftruncate( pSpool->segFd, size ) != 0 ) ||
+               ( ftruncate( pSpool->idxFd,
+                            count * sizeof( uint32_t ) ) != 0 ) ) )
+        {
+            result = errno;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        pSpool->writeSegment = segment;
+        pSpool->writeCount = count;
+        pSpool->writeSize = size;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  GetOffset                                                                 */
+/*!
+    Get the offset of a message from a segment index
+
+    @param[in]
+        idxFd
+            file descriptor of the segment index
+
+    @param[in]
+        record
+            index of the message in the segment
+
+    @param[out]
+        pOffset
+            pointer to a location to store the message offset
+
+    @retval EOK the offset was read
+    @retval ENOENT the message is not in the index
+
+==============================================================================*/
+static int GetOffset( int idxFd, uint32_t record, uint64_t *pOffset )
+{
+    int result = ENOENT;
+    uint32_t offset;
+
+    if ( pread( idxFd,
+                &offset,
+                sizeof( offset ),
+                (off_t)record * sizeof( offset ) ) == sizeof( offset ) )
+    {
+        *pOffset = offset;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  CountRecords                                                              */
+/*!
+    Count the messages in a segment
+
+    The CountRecords function gets the number of messages in a complete
+    segment from the size of its index.  A missing segment is empty.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        segment
+            segment number
+
+    @param[out]
+        pCount
+            pointer to a location to store the number of messages
+
+    @retval EOK the messages were counted
+    @retval other error from stat
+
+==============================================================================*/
+static int CountRecords( Spool *pSpool, uint32_t segment, uint32_t *pCount )
+{
+    int result = EOK;
+    char path[SPOOL_PATH_LEN];
+    struct stat st;
+
+    *pCount = 0;
+
+    MakePath( pSpool, segment, "idx", path );
+    if ( stat( path, &st ) == 0 )
+    {
+        *pCount = st.st_size / sizeof( uint32_t );
+    }
+    else if ( errno != ENOENT )
+    {
+        result = errno;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SaveCursor                                                                */
+/*!
+    Save the replay cursor
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+==============================================================================*/
+static void SaveCursor( Spool *pSpool )
+{
+    SpoolCursor cursor;
+
+    cursor.segment = pSpool->readSegment;
+    cursor.record = pSpool->readRecord;
+
+    if ( ( pwrite( pSpool->cursorFd,
+                   &cursor,
+                   sizeof( cursor ),
+                   0 ) == sizeof( cursor ) ) &&
+         ( pSpool->fsyncPolicy == SPOOL_FSYNC_ALWAYS ) )
+    {
+        (void)fdatasync( pSpool->cursorFd );
+    }
+}
+
+/*============================================================================*/
+/*  Sync                                                                      */
+/*!
+    Sync the segment being written according to the fsync policy
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        force
+            sync now unless the fsync policy is never
+
+==============================================================================*/
+static void Sync( Spool *pSpool, bool force )
+{
+    uint64_t now;
+
+    if ( pSpool->fsyncPolicy != SPOOL_FSYNC_NEVER )
+    {
+        now = UTIL_NowMs();
+        if ( ( force == true ) ||
+             ( now - pSpool->lastSync >= SPOOL_SYNC_INTERVAL_MS ) )
+        {
+            /* the message must be durable before its index entry */
+            (void)fdatasync( pSpool->segFd );
+            (void)fdatasync( pSpool->idxFd );
+            pSpool->lastSync = now;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  DrainerThread                                                             */
+/*!
+    Replay the spooled messages
+
+    The DrainerThread function waits for messages to be spooled and
+    replays them.  If the hub cannot be reached, the replay is retried
+    with a jittered exponential backoff.  When the spool is closed, the drainer
+    replays the remaining messages and exits once they have been sent or
+    one of them cannot be delivered.
+
+    @param[in]
+        arg
+            pointer to the Spool
+
+    @retval NULL
+
+==============================================================================*/
+static void *DrainerThread( void *arg )
+{
+    Spool *pSpool = (Spool *)arg;
+    RetryPolicy policy = { 0, SPOOL_RETRY_MIN_MS, SPOOL_RETRY_MAX_MS };
+    uint64_t seed = RETRY_Seed() ^ (uintptr_t)pSpool;
+    unsigned int attempts = 0;
+    bool done = false;
+    int rc;
+
+    pthread_mutex_lock( &pSpool->mutex );
+
+    while ( done == false )
+    {
+        while ( ( pSpool->pending == 0 ) && ( pSpool->stopping == false ) )
+        {
+            pthread_cond_wait( &pSpool->cond, &pSpool->mutex );
+        }
+
+        if ( pSpool->pending == 0 )
+        {
+            done = true;
+        }
+        else
+        {
+            pthread_mutex_unlock( &pSpool->mutex );
+            rc = Replay( pSpool );
+            pthread_mutex_lock( &pSpool->mutex );
+
+            if ( rc == EOK )
+            {
+                attempts = 0;
+            }
+            else if ( pSpool->stopping == true )
+            {
+                done = true;
+            }
+            else
+            {
+                /* jitter the backoff so many senders do not reconnect at
+                   the same moment */
+                attempts++;
+                Wait( pSpool, RETRY_Delay( &policy, attempts, &seed ) );
+            }
+        }
+    }
+
+    pthread_mutex_unlock( &pSpool->mutex );
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  Replay                                                                    */
+/*!
+    Replay the spooled messages
+
+    The Replay function connects to the hub if required and sends the
+    spooled messages, in order, straight from the memory mapped
+    segments until the spool is empty or a message fails with a
+    retryable error.  A message which fails with a fatal error is
+    dropped and counted, so it does not hold back the messages behind
+    it.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @retval EOK the spool is empty
+    @retval ECONNREFUSED the hub could not be reached
+    @retval other error mapping a segment or sending a message
+
+==============================================================================*/
+static int Replay( Spool *pSpool )
+{
+    int result = EOK;
+    uint32_t writeSegment;
+    uint32_t count;
+    uint64_t size;
+    SpoolRecord *pRecord;
+    char *pHeaders;
+    size_t recLen;
+    uint32_t sent = 0;
+    uint64_t begin;
+    uint64_t deadline;
+    uint64_t end;
+    uint64_t mapped;
+
+    if ( pSpool->hIoTClient == NULL )
+    {
+        pSpool->hIoTClient = IOTCLIENT_Create();
+        if ( pSpool->hIoTClient == NULL )
+        {
+            result = ECONNREFUSED;
+        }
+        else
+        {
+            IOTCLIENT_SetVerbose( pSpool->hIoTClient, pSpool->verbose );
+        }
+    }
+
+    while ( ( result == EOK ) && ( SPOOL_Pending( pSpool ) > 0 ) )
+    {
+        /* get the messages which have been completely written */
+        pthread_mutex_lock( &pSpool->mutex );
+        writeSegment = pSpool->writeSegment;
+        count = pSpool->writeCount;
+        size = pSpool->writeSize;
+        pthread_mutex_unlock( &pSpool->mutex );
+
+        if ( pSpool->readSegment != writeSegment )
+        {
+            /* a complete segment: map the whole file */
+            result = CountRecords( pSpool, pSpool->readSegment, &count );
+            size = 0;
+        }
+
+        if ( ( result == EOK ) && ( pSpool->readRecord < count ) )
+        {
+            result = MapSegment( pSpool, pSpool->readSegment, size );
+        }
+
+        while ( ( result == EOK ) && ( pSpool->readRecord < count ) )
+        {
+            deadline = __atomic_load_n( &pSpool->deadline, __ATOMIC_ACQUIRE );
+            if ( ( deadline != 0 ) && ( UTIL_NowMs() >= deadline ) )
+            {
+                /* keep the rest for the next run */
+                result = ETIMEDOUT;
+                break;
+            }
+
+            pRecord = (SpoolRecord *)&pSpool->pMap[pSpool->readOffset];
+            end = pSpool->readOffset + sizeof( SpoolRecord );
+            if ( end <= pSpool->mapSize )
+            {
+                end = pSpool->readOffset +
+                      RecordLength( pRecord->headerLen, pRecord->dataLen );
+            }
+
+            if ( end > pSpool->mapSize )
+            {
+                /* the record was written after the segment was mapped */
+                mapped = pSpool->mapSize;
+                result = MapSegment( pSpool, pSpool->readSegment, 0 );
+                if ( result != EOK )
+                {
+                    break;
+                }
+
+                if ( pSpool->mapSize > mapped )
+                {
+                    continue;
+                }
+            }
+
+            if ( ( end > pSpool->mapSize ) ||
+                 ( pRecord->magic != SPOOL_MAGIC ) )
+            {
+                /* skip the rest of a damaged segment */
+                fprintf( stderr,
+                         "Spool: segment %" PRIu32 " is damaged\n",
+                         pSpool->readSegment );
+                __atomic_sub_fetch( &pSpool->pending,
+                                    count - pSpool->readRecord,
+                                    __ATOMIC_RELEASE );
+                pSpool->readRecord = count;
+                break;
+            }
+
+            pHeaders = (char *)&pRecord[1];
+            if ( RATELIMIT_Acquire( pSpool->pRateLimit,
+                                    pRecord->dataLen ) != EOK )
+            {
+                /* out of time waiting for the rate limiter */
+                result = ETIMEDOUT;
+                break;
+            }
+
+            begin = STATS_Clock();
+            result = IOTCLIENT_Send( pSpool->hIoTClient,
+                                     pHeaders,
+                                     &pHeaders[pRecord->headerLen],
+                                     pRecord->dataLen );
+            STATS_Sent( begin, pRecord->dataLen, result );
+            if ( ( result != EOK ) && ( RETRY_IsRetryable( result ) == false ) )
+            {
+                /* it would never be sent: drop it so the rest can go */
+                fprintf( stderr,
+                         "Spool: dropped message %" PRIu32
+                         " of segment %" PRIu32 ": %s\n",
+                         pSpool->readRecord,
+                         pSpool->readSegment,
+                         strerror( result ) );
+                STATS_Add( STATS_SPOOL_DROPPED, 1 );
+                result = EOK;
+            }
+
+            if ( result == EOK )
+            {
+                recLen = RecordLength( pRecord->headerLen, pRecord->dataLen );
+                pSpool->readOffset += recLen;
+                pSpool->readRecord++;
+                __atomic_sub_fetch( &pSpool->pending, 1, __ATOMIC_RELEASE );
+
+                if ( ++sent % SPOOL_CURSOR_INTERVAL == 0 )
+                {
+                    SaveCursor( pSpool );
+                }
+            }
+            else
+            {
+                /* reconnect before the next attempt */
+                IOTCLIENT_Close( pSpool->hIoTClient );
+                pSpool->hIoTClient = NULL;
+            }
+        }
+
+        if ( ( result == EOK ) && ( pSpool->readSegment != writeSegment ) )
+        {
+            FinishSegment( pSpool );
+        }
+    }
+
+    SaveCursor( pSpool );
+
+    if ( ( result != EOK ) && ( pSpool->verbose == true ) )
+    {
+        fprintf( stderr,
+                 "Spool: replay stopped: %s\n",
+                 strerror( result ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  MapSegment                                                                */
+/*!
+    Memory map a segment for replay
+
+    The MapSegment function maps the segment being replayed, re-mapping
+    it if the file has grown since it was last mapped.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        segment
+            segment number
+
+    @param[in]
+        size
+            number of bytes of the segment to map, or 0 to map the
+            whole segment
+
+    @retval EOK the segment is mapped
+    @retval other error opening or mapping the segment
+
+==============================================================================*/
+static int MapSegment( Spool *pSpool, uint32_t segment, uint64_t size )
+{
+    int result = EOK;
+    char path[SPOOL_PATH_LEN];
+    struct stat st;
+    void *p;
+    int fd;
+
+    MakePath( pSpool, segment, "seg", path );
+    fd = open( path, O_RDONLY );
+    if ( ( fd == -1 ) || ( fstat( fd, &st ) != 0 ) )
+    {
+        result = errno;
+    }
+    else
+    {
+        if ( ( size == 0 ) || ( size > (uint64_t)st.st_size ) )
+        {
+            size = st.st_size;
+        }
+
+        /* a segment may have grown since it was mapped, even one which
+           has since been completed by the writer */
+        if ( ( pSpool->pMap == NULL ) ||
+             ( pSpool->mapSegment != segment ) ||
+             ( pSpool->mapSize < size ) )
+        {
+            if ( pSpool->pMap != NULL )
+            {
+                munmap( pSpool->pMap, pSpool->mapSize );
+                pSpool->pMap = NULL;
+            }
+
+            p = ( size > 0 )
+                ? mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 )
+                : MAP_FAILED;
+            if ( p == MAP_FAILED )
+            {
+                result = ( size > 0 ) ? errno : ENODATA;
+            }
+            else
+            {
+                (void)madvise( p, size, MADV_SEQUENTIAL );
+                pSpool->pMap = p;
+                pSpool->mapSize = size;
+                pSpool->mapSegment = segment;
+            }
+        }
+    }
+
+    if ( fd != -1 )
+    {
+        close( fd );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  FinishSegment                                                             */
+/*!
+    Delete a fully replayed segment and move on to the next one
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+==============================================================================*/
+static void FinishSegment( Spool *pSpool )
+{
+    char path[SPOOL_PATH_LEN];
+
+    if ( ( pSpool->pMap != NULL ) &&
+         ( pSpool->mapSegment == pSpool->readSegment ) )
+    {
+        munmap( pSpool->pMap, pSpool->mapSize );
+        pSpool->pMap = NULL;
+    }
+
+    MakePath( pSpool, pSpool->readSegment, "seg", path );
+    (void)unlink( path );
+    MakePath( pSpool, pSpool->readSegment, "idx", path );
+    (void)unlink( path );
+
+    pSpool->readSegment++;
+    pSpool->readRecord = 0;
+    pSpool->readOffset = 0;
+
+    SaveCursor( pSpool );
+}
+
+/*============================================================================*/
+/*  Wait                                                                      */
+/*!
+    Wait before retrying the replay
+
+    The Wait function waits for the specified time, or until the spool
+    is closed.  It must be called with the spool mutex held.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        ms
+            time to wait in milliseconds
+
+==============================================================================*/
+static void Wait( Spool *pSpool, uint64_t ms )
+{
+    struct timespec deadline;
+    int rc = EOK;
+
+    clock_gettime( CLOCK_MONOTONIC, &deadline );
+    deadline.tv_sec += ms / 1000;
+    deadline.tv_nsec += ( ms % 1000 ) * 1000000L;
+    if ( deadline.tv_nsec >= 1000000000L )
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    /* newly spooled messages do not cut the backoff short */
+    while ( ( pSpool->stopping == false ) && ( rc != ETIMEDOUT ) )
+    {
+        rc = pthread_cond_timedwait( &pSpool->cond,
+                                     &pSpool->mutex,
+                                     &deadline );
+    }
+}
+
+/*============================================================================*/
+/*  MakePath                                                                  */
+/*!
+    Make the path of a segment file
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        segment
+            segment number
+
+    @param[in]
+        ext
+            file extension: seg or idx
+
+    @param[out]
+        pPath
+            pointer to a buffer of SPOOL_PATH_LEN bytes for the path
+
+==============================================================================*/
+static void MakePath( Spool *pSpool,
+                      uint32_t segment,
+                      const char *ext,
+                      char *pPath )
+{
+    snprintf( pPath,
+              SPOOL_PATH_LEN,
+              "%s/%010" PRIu32 ".%s",
+              pSpool->pDir,
+              segment,
+              ext );
+}
+
+/*============================================================================*/
+/*  RecordLength                                                              */
+/*!
+    Get the length of a spooled message including its padding
+
+    @param[in]
+        headerLen
+            length of the message headers including the NUL terminator
+
+    @param[in]
+        dataLen
+            length of the message payload
+
+    @retval length of the spooled message
+
+==============================================================================*/
+static size_t RecordLength( uint32_t headerLen, uint32_t dataLen )
+{
+    size_t len = sizeof( SpoolRecord ) + (size_t)headerLen + dataLen;
+
+    return ( len + SPOOL_ALIGN - 1 ) & ~(size_t)( SPOOL_ALIGN - 1 );
+}
+
+/*! @}
+ * end of spool group */
@@ -0,0 +1,995 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup stats stats
+ * @brief Hot path statistics
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file stats.c
+
+    Statistics
+
+    The stats module counts what iotsend is doing: the bytes read, the
+    messages and bytes sent, the failed sends, retries, spooled messages,
+    suppressed duplicates and the compression ratio, together with a
+    histogram of the time taken by each call which sends a message to
+    the IOTHub service.
+
+    Every thread records into its own cache line aligned block of
+    counters, so recording takes a thread local lookup and an
+    uncontended store and threads never write to a shared cache line.
+    The blocks are only read, and summed, when the statistics are
+    reported.  Nothing is recorded until the statistics are started.
+
+    The send latency is kept in a log-linear histogram with 8 buckets
+    per power of two nanoseconds, so percentiles are reported to within
+    12.5% of the measured value.
+
+    The totals since startup are written as a single line of key=value
+    pairs, either to stderr every interval, or to each client which
+    connects to the statistics UNIX socket, or both.  The spool depth
+    and send queue occupancy are sampled by a caller supplied function
+    each time the line is formatted.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <iotclient/iotclient.h>
+#include "ring.h"
+#include "stats.h"
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of bits of each latency value which select its sub-bucket */
+#define STATS_SUB_BITS      ( 3 )
+
+/*! number of latency buckets per power of two */
+#define STATS_SUB_BUCKETS   ( 1 << STATS_SUB_BITS )
+
+/*! number of latency buckets covering every 64 bit value */
+#define STATS_BUCKETS       ( ( 64 - STATS_SUB_BITS + 1 ) * STATS_SUB_BUCKETS )
+
+/*! number of pending connections to the statistics socket */
+#define STATS_BACKLOG       ( 4 )
+
+/*! statistics recorded by a single thread */
+typedef struct _StatsThread
+{
+    /*! counters */
+    uint64_t counters[STATS_COUNTERS];
+
+    /*! send latency histogram in nanoseconds */
+    uint64_t latency[STATS_BUCKETS];
+
+    /*! next thread */
+    struct _StatsThread *pNext;
+
+} RING_ALIGNED StatsThread;
+
+/*! process wide statistics */
+typedef struct _Stats
+{
+    /*! mutex protecting the thread list and the sampler */
+    pthread_mutex_t mutex;
+
+    /*! statistics are being recorded */
+    bool enabled;
+
+    /*! result of the most recent operation on the link to the IOTHub */
+    int linkResult;
+
+    /*! error of the most recent failure */
+    int lastError;
+
+    /*! statistics of every thread which has recorded any */
+    StatsThread *pThreads;
+
+    /*! function which samples the gauges, or NULL */
+    StatsSampleFn sampleFn;
+
+    /*! argument passed to the sample function */
+    void *pSampleArg;
+
+    /*! number of seconds between reports on stderr (0 = none) */
+    unsigned int interval;
+
+    /*! path of the statistics socket, or NULL */
+    char *pSocketPath;
+
+    /*! listening statistics socket, or -1 */
+    int listenFd;
+
+    /*! event used to stop the reporter thread */
+    int stopFd;
+
+    /*! monotonic time in nanoseconds when the statistics were started */
+    uint64_t started;
+
+    /*! reporter thread */
+    pthread_t thread;
+
+    /*! reporter thread has been started */
+    bool running;
+
+} Stats;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! process wide statistics */
+static Stats stats = { .mutex = PTHREAD_MUTEX_INITIALIZER,
+                       .listenFd = -1,
+                       .stopFd = -1 };
+
+/*! statistics of the calling thread */
+static __thread StatsThread *pThreadStats;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static StatsThread *Attach( void );
+static void Collect( StatsSnapshot *pSnapshot, uint64_t *pLatency );
+static int Listen( const char *pPath );
+static void *Reporter( void *arg );
+static void Serve( void );
+static double Percentile( const uint64_t *pLatency,
+                          uint64_t total,
+                          double quantile );
+static size_t Bucket( uint64_t value );
+static uint64_t Highest( size_t bucket );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  STATS_Start                                                               */
+/*!
+    Start recording and reporting statistics
+
+    The STATS_Start function enables recording and starts the reporter
+    thread which writes the statistics to stderr every interval and
+    answers connections to the statistics socket.  If neither is
+    requested nothing is recorded.  It should be called before the
+    threads which record statistics are started.
+
+    @param[in]
+        interval
+            number of seconds between reports on stderr (0 = none)
+
+    @param[in]
+        pSocketPath
+            path of the UNIX socket to serve the statistics on, or NULL
+
+    @retval EOK the statistics were started, or are not required
+    @retval other error creating the socket or the reporter thread
+
+==============================================================================*/
+int STATS_Start( unsigned int interval, const char *pSocketPath )
+{
+    int result = EOK;
+
+    if ( ( interval > 0 ) || ( pSocketPath != NULL ) )
+    {
+        stats.interval = interval;
+        stats.stopFd = eventfd( 0, EFD_CLOEXEC );
+        if ( stats.stopFd == -1 )
+        {
+            result = errno;
+        }
+
+        if ( ( result == EOK ) && ( pSocketPath != NULL ) )
+        {
+            result = Listen( pSocketPath );
+        }
+
+        if ( result == EOK )
+        {
+            STATS_Enable();
+            result = pthread_create( &stats.thread, NULL, Reporter, NULL );
+            stats.running = ( result == EOK );
+        }
+
+        if ( result != EOK )
+        {
+            STATS_Stop();
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  STATS_Enable                                                              */
+/*!
+    Start recording statistics
+
+    The STATS_Enable function starts recording statistics for a consumer
+    which takes its own snapshots rather than using the reporter thread.
+    It should be called before the threads which record statistics are
+    started.
+
+==============================================================================*/
+void STATS_Enable( void )
+{
+    if ( __atomic_load_n( &stats.enabled, __ATOMIC_ACQUIRE ) == false )
+    {
+        stats.started = UTIL_NowNs();
+        __atomic_store_n( &stats.enabled, true, __ATOMIC_RELEASE );
+    }
+}
+
+/*============================================================================*/
+/*  STATS_SetSampler                                                          */
+/*!
+    Set the function which samples the gauges
+
+    The sample function is called by the reporter thread each time the
+    statistics are formatted.  Once STATS_SetSampler returns, the
+    previous function is no longer being called, so its state may be
+    released.
+
+    @param[in]
+        fn
+            function which samples the gauges, or NULL
+
+    @param[in]
+        pArg
+            argument passed to the sample function
+
+==============================================================================*/
+void STATS_SetSampler( StatsSampleFn fn, void *pArg )
+{
+    pthread_mutex_lock( &stats.mutex );
+    stats.sampleFn = fn;
+    stats.pSampleArg = pArg;
+    pthread_mutex_unlock( &stats.mutex );
+}
+
+/*============================================================================*/
+/*  STATS_Add                                                                 */
+/*!
+    Add to a counter
+
+    The STATS_Add function adds to a counter of the calling thread.
+
+    @param[in]
+        counter
+            counter to add to
+
+    @param[in]
+        n
+            amount to add
+
+==============================================================================*/
+void STATS_Add( StatsCounter counter, uint64_t n )
+{
+    StatsThread *p = pThreadStats;
+
+    if ( __atomic_load_n( &stats.enabled, __ATOMIC_RELAXED ) == true )
+    {
+        if ( p == NULL )
+        {
+            p = Attach();
+        }
+
+        if ( ( p != NULL ) && ( counter < STATS_COUNTERS ) )
+        {
+            /* only this thread writes the counter */
+            __atomic_store_n( &p->counters[counter],
+                              p->counters[counter] + n,
+                              __ATOMIC_RELAXED );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  STATS_Clock                                                               */
+/*!
+    Get the start time of a send
+
+    The STATS_Clock function returns the time to be passed to STATS_Sent
+    once the send completes.  The clock is not read unless statistics
+    are being recorded.
+
+    @retval monotonic time in nanoseconds, or 0
+
+==============================================================================*/
+uint64_t STATS_Clock( void )
+{
+    return ( __atomic_load_n( &stats.enabled, __ATOMIC_RELAXED ) == true )
+           ? UTIL_NowNs()
+           : 0;
+}
+
+/*============================================================================*/
+/*  STATS_Sent                                                                */
+/*!
+    Record a send to the IOTHub service
+
+    The STATS_Sent function records the time taken by a send, and counts
+    the message and its payload if it was sent, or the failure if not.
+
+    @param[in]
+        start
+            time returned by STATS_Clock before the send
+
+    @param[in]
+        len
+            length of the message payload, or 0 if it is not known
+
+    @param[in]
+        rc
+            result of the send
+
+==============================================================================*/
+void STATS_Sent( uint64_t start, size_t len, int rc )
+{
+    StatsThread *p = pThreadStats;
+    uint64_t now;
+    size_t bucket;
+
+    if ( ( start != 0 ) &&
+         ( __atomic_load_n( &stats.enabled, __ATOMIC_RELAXED ) == true ) )
+    {
+        now = UTIL_NowNs();
+
+        if ( p == NULL )
+        {
+            p = Attach();
+        }
+
+        if ( p != NULL )
+        {
+            bucket = Bucket( ( now > start ) ? now - start : 0 );
+            __atomic_store_n( &p->latency[bucket],
+                              p->latency[bucket] + 1,
+                              __ATOMIC_RELAXED );
+        }
+
+        if ( rc == EOK )
+        {
+            STATS_Add( STATS_MESSAGES_SENT, 1 );
+            STATS_Add( STATS_BYTES_SENT, len );
+        }
+        else
+        {
+            STATS_Add( STATS_SEND_ERRORS, 1 );
+        }
+
+        STATS_Link( rc );
+    }
+}
+
+/*============================================================================*/
+/*  STATS_Link                                                                */
+/*!
+    Record the result of an operation on the link to the IOTHub service
+
+    The STATS_Link function records whether the most recent send or
+    connection attempt succeeded, and the error if it did not.  The
+    shared result is only written when it changes, so the senders do
+    not contend for its cache line while the link is up.
+
+    @param[in]
+        rc
+            result of the operation
+
+==============================================================================*/
+void STATS_Link( int rc )
+{
+    if ( ( __atomic_load_n( &stats.enabled, __ATOMIC_RELAXED ) == true ) &&
+         ( __atomic_load_n( &stats.linkResult, __ATOMIC_RELAXED ) != rc ) )
+    {
+        __atomic_store_n( &stats.linkResult, rc, __ATOMIC_RELAXED );
+        if ( rc != EOK )
+        {
+            __atomic_store_n( &stats.lastError, rc, __ATOMIC_RELAXED );
+        }
+    }
+}
+
+/*============================================================================*/
+/*  STATS_Snapshot                                                            */
+/*!
+    Take a snapshot of the statistics
+
+    The STATS_Snapshot function sums the counters of every thread and
+    samples the gauges.
+
+    @param[out]
+        pSnapshot
+            pointer to the snapshot to fill in
+
+==============================================================================*/
+void STATS_Snapshot( StatsSnapshot *pSnapshot )
+{
+    if ( pSnapshot != NULL )
+    {
+        Collect( pSnapshot, NULL );
+    }
+}
+
+/*============================================================================*/
+/*  STATS_Format                                                              */
+/*!
+    Format the statistics
+
+    The STATS_Format function sums the statistics of every thread,
+    samples the gauges, and formats the totals since the statistics
+    were started as a single newline terminated line of key=value pairs.
+
+    @param[in]
+        pBuf
+            pointer to the buffer to receive the line
+
+    @param[in]
+        size
+            size of the buffer, at least STATS_LINE_SIZE bytes
+
+    @retval length of the line, excluding the terminating NUL
+
+==============================================================================*/
+size_t STATS_Format( char *pBuf, size_t size )
+{
+    StatsSnapshot snapshot;
+    uint64_t *counters = snapshot.counters;
+    uint64_t *gauges = snapshot.gauges;
+    uint64_t latency[STATS_BUCKETS];
+    uint64_t total = 0;
+    uint64_t max = 0;
+    double ratio = 0.0;
+    size_t len = 0;
+    size_t i;
+    int n;
+
+    if ( ( pBuf != NULL ) && ( size > 0 ) )
+    {
+        Collect( &snapshot, latency );
+
+        for ( i = 0; i < STATS_BUCKETS; i++ )
+        {
+            total += latency[i];
+            if ( latency[i] > 0 )
+            {
+                max = Highest( i );
+            }
+        }
+
+        if ( counters[STATS_COMPRESS_IN] > 0 )
+        {
+            ratio = (double)counters[STATS_COMPRESS_OUT] /
+                    (double)counters[STATS_COMPRESS_IN];
+        }
+
+        n = snprintf( pBuf,
+                      size,
+                      "uptime=%" PRIu64
+                      " bytes_read=%" PRIu64
+                      " messages_sent=%" PRIu64
+                      " bytes_sent=%" PRIu64
+                      " send_errors=%" PRIu64
+                      " retries=%" PRIu64
+                      " spooled=%" PRIu64
+                      " spool_dropped=%" PRIu64
+                      " deduped=%" PRIu64
+                      " spool_depth=%" PRIu64
+                      " queue_depth=%" PRIu64
+                      " compress_ratio=%.3f"
+                      " send_us_p50=%.1f"
+                      " send_us_p99=%.1f"
+                      " send_us_p999=%.1f"
+                      " send_us_max=%.1f\n",
+                      ( UTIL_NowNs() - stats.started ) / 1000000000,
+                      counters[STATS_BYTES_READ],
+                      counters[STATS_MESSAGES_SENT],
+                      counters[STATS_BYTES_SENT],
+                      counters[STATS_SEND_ERRORS],
+                      counters[STATS_RETRIES],
+                      counters[STATS_SPOOLED],
+                      counters[STATS_SPOOL_DROPPED],
+                      counters[STATS_DEDUPED],
+                      gauges[STATS_SPOOL_DEPTH],
+                      gauges[STATS_QUEUE_DEPTH],
+                      ratio,
+                      Percentile( latency, total, 0.50 ),
+                      Percentile( latency, total, 0.99 ),
+                      Percentile( latency, total, 0.999 ),
+                      max / 1000.0 );
+        if ( n > 0 )
+        {
+            len = ( (size_t)n < size ) ? (size_t)n : size - 1;
+        }
+    }
+
+    return len;
+}
+
+/*============================================================================*/
+/*  STATS_Stop                                                                */
+/*!
+    Stop reporting statistics
+
+    The STATS_Stop function stops the reporter thread, writing the final
+    totals to stderr if they are being reported there, and removes the
+    statistics socket.  Threads may continue to record statistics until
+    STATS_Shutdown is called.
+
+==============================================================================*/
+void STATS_Stop( void )
+{
+    char line[STATS_LINE_SIZE];
+    uint64_t value = 1;
+
+    if ( stats.running == true )
+    {
+        if ( write( stats.stopFd, &value, sizeof( value ) ) ==
+             sizeof( value ) )
+        {
+            pthread_join( stats.thread, NULL );
+        }
+
+        stats.running = false;
+
+        if ( stats.interval > 0 )
+        {
+            (void)STATS_Format( line, sizeof( line ) );
+            fprintf( stderr, "iotsend: %s", line );
+        }
+    }
+
+    if ( stats.listenFd != -1 )
+    {
+        close( stats.listenFd );
+        stats.listenFd = -1;
+    }
+
+    if ( stats.pSocketPath != NULL )
+    {
+        (void)unlink( stats.pSocketPath );
+        free( stats.pSocketPath );
+        stats.pSocketPath = NULL;
+    }
+
+    if ( stats.stopFd != -1 )
+    {
+        close( stats.stopFd );
+        stats.stopFd = -1;
+    }
+}
+
+/*============================================================================*/
+/*  STATS_Shutdown                                                            */
+/*!
+    Release the statistics
+
+    The STATS_Shutdown function stops recording and releases the block
+    of every thread.  It must only be called once every thread which
+    records statistics has exited.
+
+==============================================================================*/
+void STATS_Shutdown( void )
+{
+    StatsThread *p;
+
+    STATS_Stop();
+
+    __atomic_store_n( &stats.enabled, false, __ATOMIC_RELEASE );
+
+    pthread_mutex_lock( &stats.mutex );
+
+    while ( stats.pThreads != NULL )
+    {
+        p = stats.pThreads;
+        stats.pThreads = p->pNext;
+        free( p );
+    }
+
+    pthread_mutex_unlock( &stats.mutex );
+
+    pThreadStats = NULL;
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  Attach                                                                    */
+/*!
+    Allocate the statistics of the calling thread
+
+    The Attach function allocates a block of statistics for the calling
+    thread on its first recording and adds it to the thread list.
+
+    @retval pointer to the statistics of the calling thread
+    @retval NULL out of memory
+
+==============================================================================*/
+static StatsThread *Attach( void )
+{
+    void *p = NULL;
+
+    if ( posix_memalign( &p, RING_CACHE_LINE, sizeof( StatsThread ) ) == 0 )
+    {
+        memset( p, 0, sizeof( StatsThread ) );
+
+        pthread_mutex_lock( &stats.mutex );
+        ( (StatsThread *)p )->pNext = stats.pThreads;
+        stats.pThreads = p;
+        pthread_mutex_unlock( &stats.mutex );
+
+        pThreadStats = p;
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*  Collect                                                                   */
+/*!
+    Sum the statistics of every thread
+
+    The Collect function sums the counters and, if requested, the send
+    latency histograms of every thread, and samples the gauges.
+
+    @param[out]
+        pSnapshot
+            pointer to the snapshot to fill in
+
+    @param[out]
+        pLatency
+            pointer to an array of STATS_BUCKETS values to receive the
+            summed latency histogram, or NULL
+
+==============================================================================*/
+static void Collect( StatsSnapshot *pSnapshot, uint64_t *pLatency )
+{
+    StatsThread *p;
+    size_t i;
+
+    memset( pSnapshot, 0, sizeof( StatsSnapshot ) );
+    if ( pLatency != NULL )
+    {
+        memset( pLatency, 0, STATS_BUCKETS * sizeof( uint64_t ) );
+    }
+
+    pthread_mutex_lock( &stats.mutex );
+
+    for ( p = stats.pThreads; p != NULL; p = p->pNext )
+    {
+        for ( i = 0; i < STATS_COUNTERS; i++ )
+        {
+            pSnapshot->counters[i] += __atomic_load_n( &p->counters[i],
+                                                       __ATOMIC_RELAXED );
+        }
+
+        for ( i = 0; ( pLatency != NULL ) && ( i < STATS_BUCKETS ); i++ )
+        {
+            pLatency[i] += __atomic_load_n( &p->latency[i], __ATOMIC_RELAXED );
+        }
+    }
+
+    if ( stats.sampleFn != NULL )
+    {
+        stats.sampleFn( stats.pSampleArg, pSnapshot->gauges );
+    }
+
+    pthread_mutex_unlock( &stats.mutex );
+
+    pSnapshot->lastError = __atomic_load_n( &stats.lastError,
+                                            __ATOMIC_RELAXED );
+    pSnapshot->linkUp = ( __atomic_load_n( &stats.linkResult,
+                                           __ATOMIC_RELAXED ) == EOK );
+}
+
+/*============================================================================*/
+/*  Listen                                                                    */
+/*!
+    Open the statistics socket
+
+    The Listen function creates a listening UNIX stream socket at the
+    specified path, replacing any stale socket left by a previous run.
+
+    @param[in]
+        pPath
+            path of the socket
+
+    @retval EOK the socket is listening
+    @retval ENAMETOOLONG the path is too long for a UNIX socket
+    @retval other error from socket(), bind() or listen()
+
+==============================================================================*/
+static int Listen( const char *pPath )
+{
+    struct sockaddr_un addr;
+    int result = EOK;
+
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+
+    if ( strlen( pPath ) >= sizeof( addr.sun_path ) )
+    {
+        result = ENAMETOOLONG;
+    }
+    else
+    {
+        strcpy( addr.sun_path, pPath );
+        (void)unlink( pPath );
+
+        stats.listenFd = socket( AF_UNIX,
+                                 SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                 0 );
+        if ( ( stats.listenFd == -1 ) ||
+             ( bind( stats.listenFd,
+                     (struct sockaddr *)&addr,
+                     sizeof( addr ) ) != 0 ) ||
+             ( listen( stats.listenFd, STATS_BACKLOG ) != 0 ) )
+        {
+            result = errno;
+        }
+        else
+        {
+            stats.pSocketPath = strdup( pPath );
+            if ( stats.pSocketPath == NULL )
+            {
+                result = ENOMEM;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Reporter                                                                  */
+/*!
+    Statistics reporter thread
+
+    The Reporter thread writes the statistics to stderr every interval
+    and answers connections to the statistics socket until it is
+    stopped.
+
+    @param[in]
+        arg
+            unused
+
+    @retval NULL
+
+==============================================================================*/
+static void *Reporter( void *arg )
+{
+    char line[STATS_LINE_SIZE];
+    struct pollfd fds[2];
+    uint64_t period = (uint64_t)stats.interval * 1000000000;
+    uint64_t due = UTIL_NowNs() + period;
+    uint64_t now;
+    bool stopping = false;
+    int timeout;
+    int n;
+
+    (void)arg;
+
+    fds[0].fd = stats.stopFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stats.listenFd;
+    fds[1].events = POLLIN;
+
+    while ( stopping == false )
+    {
+        timeout = -1;
+        if ( period > 0 )
+        {
+            now = UTIL_NowNs();
+            timeout = ( due > now ) ? (int)( ( due - now ) / 1000000 ) + 1 : 0;
+        }
+
+        n = poll( fds, 2, timeout );
+        if ( ( n > 0 ) && ( fds[0].revents != 0 ) )
+        {
+            stopping = true;
+        }
+        else
+        {
+            if ( ( n > 0 ) && ( fds[1].revents & POLLIN ) )
+            {
+                Serve();
+            }
+
+            now = UTIL_NowNs();
+            if ( ( period > 0 ) && ( now >= due ) )
+            {
+                (void)STATS_Format( line, sizeof( line ) );
+                fprintf( stderr, "iotsend: %s", line );
+
+                /* do not try to catch up on missed reports */
+                due = ( due + period > now ) ? due + period : now + period;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  Serve                                                                     */
+/*!
+    Answer a connection to the statistics socket
+
+    The Serve function accepts a pending connection, writes the
+    statistics line to it and closes it.
+
+==============================================================================*/
+static void Serve( void )
+{
+    char line[STATS_LINE_SIZE];
+    size_t len;
+    int fd;
+
+    fd = accept( stats.listenFd, NULL, NULL );
+    if ( fd != -1 )
+    {
+        len = STATS_Format( line, sizeof( line ) );
+        (void)send( fd, line, len, MSG_NOSIGNAL );
+        close( fd );
+    }
+}
+
+/*============================================================================*/
+/*  Percentile                                                                */
+/*!
+    Get a percentile of the send latency
+
+    @param[in]
+        pLatency
+            pointer to the summed latency histogram
+
+    @param[in]
+        total
+            number of values in the histogram
+
+    @param[in]
+        quantile
+            quantile to get, between 0 and 1
+
+    @retval upper bound of the bucket holding the percentile in microseconds
+
+==============================================================================*/
+static double Percentile( const uint64_t *pLatency,
+                          uint64_t total,
+                          double quantile )
+{
+    uint64_t rank = (uint64_t)( quantile * (double)total );
+    uint64_t count = 0;
+    double result = 0.0;
+    size_t i;
+
+    if ( total > 0 )
+    {
+        if ( rank >= total )
+        {
+            rank = total - 1;
+        }
+
+        for ( i = 0; i < STATS_BUCKETS; i++ )
+        {
+            count += pLatency[i];
+            if ( count > rank )
+            {
+                result = Highest( i ) / 1000.0;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Bucket                                                                    */
+/*!
+    Get the latency bucket of a value
+
+    Values below STATS_SUB_BUCKETS have a bucket each.  Above that, each
+    power of two is split into STATS_SUB_BUCKETS buckets selected by
+    the bits following the most significant bit.
+
+    @param[in]
+        value
+            value to get the bucket of
+
+    @retval index of the bucket
+
+==============================================================================*/
+static size_t Bucket( uint64_t value )
+{
+    size_t bucket = (size_t)value;
+    unsigned int shift;
+
+    if ( value >= STATS_SUB_BUCKETS )
+    {
+        shift = 63 - __builtin_clzll( value ) - STATS_SUB_BITS;
+        bucket = ( ( shift + 1 ) << STATS_SUB_BITS ) +
+                 (size_t)( ( value >> shift ) - STATS_SUB_BUCKETS );
+    }
+
+    return bucket;
+}
+
+/*============================================================================*/
+/*  Highest                                                                   */
+/*!
+    Get the highest value of a latency bucket
+
+    @param[in]
+        bucket
+            index of the bucket
+
+    @retval highest value counted in the bucket
+
+==============================================================================*/
+static uint64_t Highest( size_t bucket )
+{
+    uint64_t value = bucket;
+    unsigned int shift;
+
+    if ( bucket >= STATS_SUB_BUCKETS )
+    {
+        shift = ( bucket >> STATS_SUB_BITS ) - 1;
+        value = ( ( (uint64_t)( bucket & ( STATS_SUB_BUCKETS - 1 ) ) +
+                  STATS_SUB_BUCKETS ) << shift ) +
+                ( ( (uint64_t)1 << shift ) - 1 );
+    }
+
+    return value;
+}
+
+/*! @}
+ * end of stats group */
@@ -0,0 +1,957 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup telemetry telemetry
+ * @brief Variable change forwarding
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file telemetry.c
+
+    Telemetry
+
+    The telemetry module forwards variables of the variable server to
+    the IOTHub service when they change, so a daemon does not need to
+    poll the variables and start an iotsend for each value.
+
+    iotsend subscribes to a modification notification for each variable
+    in a list.  The variable server delivers the notifications as
+    SIG_VAR_MODIFIED signals, which are blocked and read from a
+    signalfd, so they wake up the send loop rather than interrupting
+    it.  The signal must be blocked before any other thread is created,
+    so TELEMETRY_Open is called at startup.
+
+    A notification only marks its variable as changed.  The changed
+    variables are read once the coalescing window after the first
+    change has elapsed, and are sent together as a single JSON object
+    mapping each variable name to its value, so a burst of changes
+    produces one message holding the latest value of each variable.
+    A numeric variable whose value has moved by less than the deadband
+    since it was last forwarded is not sent, and no variable is sent
+    more often than the minimum interval.  A change held back by the
+    minimum interval is sent when the interval has elapsed.  The
+    current value of every variable is sent at startup.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+/* for ppoll() */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/signalfd.h>
+#include <iotclient/iotclient.h>
+#include <varserver/varserver.h>
+#include "pool.h"
+#include "telemetry.h"
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of notifications read from the signalfd at a time */
+#define TELEMETRY_SIGNAL_BATCH  ( 16 )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int AddVars( Telemetry *pTelemetry, const char *pNames );
+static int AddVar( Telemetry *pTelemetry, const char *pName, size_t len );
+static int ReadNotifications( Telemetry *pTelemetry );
+static void Changed( Telemetry *pTelemetry, VAR_HANDLE hVar );
+static void Flush( Telemetry *pTelemetry, TelemetryFn fn, void *pArg );
+static int Append( Telemetry *pTelemetry,
+                   TelemetryVar *pVar,
+                   size_t len,
+                   size_t *pLen );
+static size_t Quote( char *pBuf, size_t size, const char *pStr );
+static void Send( Telemetry *pTelemetry,
+                  size_t len,
+                  TelemetryFn fn,
+                  void *pArg );
+static void Defer( Telemetry *pTelemetry, uint64_t due );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  TELEMETRY_Open                                                            */
+/*!
+    Subscribe to changes of a list of variables
+
+    The TELEMETRY_Open function blocks the notification signal, opens
+    the signalfd it is read from, connects to the variable server and
+    requests a modification notification for each variable.  It must
+    be called before any other thread is created, so the notifications
+    are not delivered to a thread which does not expect them.
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        pNames
+            comma separated list of variable names
+
+    @param[in]
+        windowMs
+            time in milliseconds changes are coalesced into one message
+
+    @param[in]
+        deadband
+            minimum change of a numeric variable which is forwarded
+
+    @param[in]
+        minIntervalMs
+            minimum time in milliseconds between forwards of a variable
+
+    @param[in]
+        verbose
+            report errors on stderr
+
+    @retval EOK the variables were subscribed to
+    @retval EINVAL invalid arguments
+    @retval ENOTCONN cannot connect to the variable server
+    @retval ENOENT a variable does not exist
+    @retval ENOMEM out of memory
+    @retval other error from signalfd() or VAR_Notify
+
+==============================================================================*/
+int TELEMETRY_Open( Telemetry *pTelemetry,
+                    const char *pNames,
+                    unsigned int windowMs,
+                    double deadband,
+                    unsigned int minIntervalMs,
+                    bool verbose )
+{
+    int result = EINVAL;
+    sigset_t mask;
+    size_t i;
+
+    if ( ( pTelemetry != NULL ) && ( pNames != NULL ) && ( deadband >= 0.0 ) )
+    {
+        memset( pTelemetry, 0, sizeof( Telemetry ) );
+        pTelemetry->windowMs = windowMs;
+        pTelemetry->deadband = deadband;
+        pTelemetry->minIntervalMs = minIntervalMs;
+        pTelemetry->verbose = verbose;
+
+        sigemptyset( &mask );
+        sigaddset( &mask, SIG_VAR_MODIFIED );
+        result = pthread_sigmask( SIG_BLOCK, &mask, NULL );
+        if ( result == EOK )
+        {
+            pTelemetry->fd = signalfd( -1, &mask, SFD_NONBLOCK | SFD_CLOEXEC );
+            result = ( pTelemetry->fd != -1 ) ? EOK : errno;
+        }
+        else
+        {
+            pTelemetry->fd = -1;
+        }
+
+        if ( result == EOK )
+        {
+            pTelemetry->hVarServer = VARSERVER_Open();
+            result = ( pTelemetry->hVarServer != NULL ) ? EOK : ENOTCONN;
+        }
+
+        if ( result == EOK )
+        {
+            result = AddVars( pTelemetry, pNames );
+        }
+
+        for ( i = 0; ( result == EOK ) && ( i < pTelemetry->count ); i++ )
+        {
+            result = VAR_Notify( pTelemetry->hVarServer,
+                                 pTelemetry->pVars[i].hVar,
+                                 NOTIFY_MODIFIED );
+        }
+
+        if ( result == EOK )
+        {
+            pTelemetry->size = POOL_MESSAGE_SIZE;
+            pTelemetry->pBuf = POOL_Alloc( pTelemetry->size );
+            result = ( pTelemetry->pBuf != NULL ) ? EOK : ENOMEM;
+        }
+
+        if ( result == EOK )
+        {
+            /* send the current value of every variable */
+            pTelemetry->deadline = UTIL_NowMs();
+        }
+        else
+        {
+            TELEMETRY_Close( pTelemetry );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  TELEMETRY_Wait                                                            */
+/*!
+    Wait for variable changes and forward them
+
+    The TELEMETRY_Wait function waits for change notifications until
+    the next message is due, and sends the message when it is.  A
+    message which cannot be sent is reported, and its variables are
+    sent again with the next message.  The signal mask is only
+    installed while waiting, so a signal received while a message is
+    sent ends the next wait as soon as it starts.
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        pMask
+            signal mask installed while waiting, or NULL to wait with
+            the signal mask of the calling thread
+
+    @param[in]
+        fn
+            function called to send each message
+
+    @param[in]
+        pArg
+            argument passed to the send function
+
+    @retval EOK the notifications were processed, or the wait was
+            interrupted by a signal
+    @retval EINVAL invalid arguments
+    @retval other error waiting for notifications
+
+==============================================================================*/
+int TELEMETRY_Wait( Telemetry *pTelemetry,
+                    const sigset_t *pMask,
+                    TelemetryFn fn,
+                    void *pArg )
+{
+    int result = EINVAL;
+    struct pollfd pfd;
+    struct timespec ts;
+    uint64_t now;
+    int timeout = -1;
+    int rc;
+
+    if ( ( pTelemetry != NULL ) && ( pTelemetry->fd != -1 ) && ( fn != NULL ) )
+    {
+        result = EOK;
+
+        if ( pTelemetry->deadline != 0 )
+        {
+            now = UTIL_NowMs();
+            timeout = ( pTelemetry->deadline > now )
+                      ? (int)( pTelemetry->deadline - now )
+                      : 0;
+        }
+
+        pfd.fd = pTelemetry->fd;
+        pfd.events = POLLIN;
+
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = ( timeout % 1000 ) * 1000000L;
+
+        rc = ppoll( &pfd, 1, ( timeout >= 0 ) ? &ts : NULL, pMask );
+        if ( rc > 0 )
+        {
+            result = ReadNotifications( pTelemetry );
+        }
+        else if ( ( rc == -1 ) && ( errno != EINTR ) )
+        {
+            result = errno;
+        }
+
+        if ( ( pTelemetry->deadline != 0 ) &&
+             ( UTIL_NowMs() >= pTelemetry->deadline ) )
+        {
+            Flush( pTelemetry, fn, pArg );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  TELEMETRY_Flush                                                           */
+/*!
+    Forward the pending variable changes
+
+    The TELEMETRY_Flush function sends the variables which have changed
+    without waiting for the end of the coalescing window, for example
+    so the last changes are not lost when forwarding stops.
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        fn
+            function called to send each message
+
+    @param[in]
+        pArg
+            argument passed to the send function
+
+    @retval EOK the pending changes were sent
+    @retval EINVAL invalid arguments
+
+==============================================================================*/
+int TELEMETRY_Flush( Telemetry *pTelemetry, TelemetryFn fn, void *pArg )
+{
+    int result = EINVAL;
+
+    if ( ( pTelemetry != NULL ) && ( pTelemetry->fd != -1 ) && ( fn != NULL ) )
+    {
+        if ( pTelemetry->deadline != 0 )
+        {
+            Flush( pTelemetry, fn, pArg );
+        }
+
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  TELEMETRY_Close                                                           */
+/*!
+    Stop forwarding variable changes
+
+    The TELEMETRY_Close function must only be called for a forwarder
+    which has been opened.
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+==============================================================================*/
+void TELEMETRY_Close( Telemetry *pTelemetry )
+{
+    size_t i;
+
+    if ( pTelemetry != NULL )
+    {
+        if ( pTelemetry->hVarServer != NULL )
+        {
+            VARSERVER_Close( pTelemetry->hVarServer );
+            pTelemetry->hVarServer = NULL;
+        }
+
+        if ( pTelemetry->fd != -1 )
+        {
+            close( pTelemetry->fd );
+            pTelemetry->fd = -1;
+        }
+
+        for ( i = 0; i < pTelemetry->count; i++ )
+        {
+            free( pTelemetry->pVars[i].pName );
+        }
+
+        free( pTelemetry->pVars );
+        pTelemetry->pVars = NULL;
+        pTelemetry->count = 0;
+
+        if ( pTelemetry->pBuf != NULL )
+        {
+            POOL_Free( pTelemetry->pBuf, pTelemetry->size );
+            pTelemetry->pBuf = NULL;
+        }
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  AddVars                                                                   */
+/*!
+    Look up a list of variables
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        pNames
+            comma separated list of variable names
+
+    @retval EOK every variable was found
+    @retval EINVAL the list is empty
+    @retval other error from AddVar
+
+==============================================================================*/
+static int AddVars( Telemetry *pTelemetry, const char *pNames )
+{
+    int result = EOK;
+    const char *p = pNames;
+    const char *pEnd;
+    size_t len;
+
+    while ( ( result == EOK ) && ( *p != '\0' ) )
+    {
+        pEnd = strchr( p, ',' );
+        len = ( pEnd != NULL ) ? (size_t)( pEnd - p ) : strlen( p );
+
+        if ( len > 0 )
+        {
+            result = AddVar( pTelemetry, p, len );
+        }
+
+        p += ( pEnd != NULL ) ? len + 1 : len;
+    }
+
+    if ( ( result == EOK ) && ( pTelemetry->count == 0 ) )
+    {
+        result = EINVAL;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  AddVar                                                                    */
+/*!
+    Look up a variable
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        pName
+            pointer to the variable name
+
+    @param[in]
+        len
+            length of the variable name
+
+    @retval EOK the variable was added
+    @retval ENOENT the variable does not exist
+    @retval ENOMEM out of memory
+
+==============================================================================*/
+static int AddVar( Telemetry *pTelemetry, const char *pName, size_t len )
+{
+    int result = ENOMEM;
+    TelemetryVar *pVars;
+    TelemetryVar *pVar;
+
+    pVars = realloc( pTelemetry->pVars,
+                     ( pTelemetry->count + 1 ) * sizeof( TelemetryVar ) );
+    if ( pVars != NULL )
+    {
+        pTelemetry->pVars = pVars;
+        pVar = &pVars[pTelemetry->count];
+        memset( pVar, 0, sizeof( TelemetryVar ) );
+
+        pVar->pName = strndup( pName, len );
+        if ( pVar->pName != NULL )
+        {
+            pTelemetry->count++;
+
+            pVar->changed = true;
+            pVar->hVar = VAR_FindByName( pTelemetry->hVarServer,
+                                         pVar->pName );
+            result = ( pVar->hVar != VAR_INVALID ) ? EOK : ENOENT;
+            if ( ( result != EOK ) && ( pTelemetry->verbose == true ) )
+            {
+                fprintf( stderr, "Telemetry: %s not found\n", pVar->pName );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ReadNotifications                                                         */
+/*!
+    Read the pending change notifications
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @retval EOK the notifications were read
+    @retval other error reading the signalfd
+
+==============================================================================*/
+static int ReadNotifications( Telemetry *pTelemetry )
+{
+    int result = EOK;
+    struct signalfd_siginfo info[TELEMETRY_SIGNAL_BATCH];
+    ssize_t n;
+    size_t count;
+    size_t i;
+
+    while ( ( n = read( pTelemetry->fd, info, sizeof( info ) ) ) > 0 )
+    {
+        count = (size_t)n / sizeof( struct signalfd_siginfo );
+        for ( i = 0; i < count; i++ )
+        {
+            if ( info[i].ssi_signo == (uint32_t)SIG_VAR_MODIFIED )
+            {
+                Changed( pTelemetry, (VAR_HANDLE)info[i].ssi_int );
+            }
+        }
+    }
+
+    if ( ( n == -1 ) && ( errno != EAGAIN ) && ( errno != EINTR ) )
+    {
+        result = errno;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Changed                                                                   */
+/*!
+    Mark a variable as changed
+
+    The Changed function marks a variable as changed and makes sure a
+    message is due by the end of the coalescing window.
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        hVar
+            handle of the variable which changed
+
+==============================================================================*/
+static void Changed( Telemetry *pTelemetry, VAR_HANDLE hVar )
+{
+    size_t i;
+
+    for ( i = 0; i < pTelemetry->count; i++ )
+    {
+        if ( pTelemetry->pVars[i].hVar == hVar )
+        {
+            pTelemetry->pVars[i].changed = true;
+            Defer( pTelemetry, UTIL_NowMs() + pTelemetry->windowMs );
+            break;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  Flush                                                                     */
+/*!
+    Send the changed variables
+
+    The Flush function reads each changed variable which is not held
+    back by the minimum interval, and sends them as one message, or as
+    several if they do not fit in one.  The variables held back are due
+    when their minimum interval has elapsed.
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        fn
+            function called to send each message
+
+    @param[in]
+        pArg
+            argument passed to the send function
+
+==============================================================================*/
+static void Flush( Telemetry *pTelemetry, TelemetryFn fn, void *pArg )
+{
+    TelemetryVar *pVar;
+    uint64_t now = UTIL_NowMs();
+    uint64_t due;
+    size_t len = 0;
+    size_t i;
+    int rc;
+
+    pTelemetry->deadline = 0;
+
+    for ( i = 0; i < pTelemetry->count; i++ )
+    {
+        pVar = &pTelemetry->pVars[i];
+        due = pVar->lastSent + pTelemetry->minIntervalMs;
+
+        if ( pVar->changed == false )
+        {
+            /* nothing to send */
+        }
+        else if ( ( pVar->sent == true ) && ( due > now ) )
+        {
+            Defer( pTelemetry, due );
+        }
+        else
+        {
+            rc = Append( pTelemetry, pVar, len, &len );
+            if ( ( rc == E2BIG ) && ( len > 0 ) )
+            {
+                /* the message is full: send it and start another */
+                Send( pTelemetry, len, fn, pArg );
+                len = 0;
+                rc = Append( pTelemetry, pVar, len, &len );
+            }
+
+            if ( rc == EOK )
+            {
+                pVar->included = true;
+            }
+            else if ( rc == EALREADY )
+            {
+                /* within the deadband of the value last sent */
+                pVar->changed = false;
+            }
+            else if ( pTelemetry->verbose == true )
+            {
+                fprintf( stderr,
+                         "Telemetry: cannot read %s: %s\n",
+                         pVar->pName,
+                         strerror( rc ) );
+            }
+        }
+    }
+
+    if ( len > 0 )
+    {
+        Send( pTelemetry, len, fn, pArg );
+    }
+}
+
+/*============================================================================*/
+/*  Append                                                                    */
+/*!
+    Append a variable to the message being built
+
+    The Append function reads a variable and appends its name and value
+    to the JSON object being built in the message buffer.
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        pVar
+            pointer to the variable
+
+    @param[in]
+        len
+            length of the message built so far
+
+    @param[out]
+        pLen
+            pointer to a location to store the new length of the message
+
+    @retval EOK the variable was appended
+    @retval EALREADY the value is within the deadband of the value last sent
+    @retval E2BIG the variable does not fit in the message
+    @retval ENOTSUP the variable type cannot be forwarded
+    @retval other error from VAR_Get
+
+==============================================================================*/
+static int Append( Telemetry *pTelemetry,
+                   TelemetryVar *pVar,
+                   size_t len,
+                   size_t *pLen )
+{
+    int result;
+    VarObject obj;
+    char str[TELEMETRY_STR_SIZE];
+    char number[32];
+    char *pBuf = &pTelemetry->pBuf[len];
+    size_t size = pTelemetry->size - len - 1;
+    bool numeric = true;
+    double diff;
+    size_t n;
+    size_t m = 0;
+
+    memset( &obj, 0, sizeof( obj ) );
+    obj.val.str = str;
+    obj.len = sizeof( str );
+
+    result = VAR_Get( pTelemetry->hVarServer, pVar->hVar, &obj );
+    if ( result == EOK )
+    {
+        switch ( obj.type )
+        {
+            case VARTYPE_UINT16:
+                pVar->value = obj.val.ui;
+                snprintf( number, sizeof( number ), "%u", obj.val.ui );
+                break;
+
+            case VARTYPE_INT16:
+                pVar->value = obj.val.i;
+                snprintf( number, sizeof( number ), "%d", obj.val.i );
+                break;
+
+            case VARTYPE_UINT32:
+                pVar->value = obj.val.ul;
+                snprintf( number, sizeof( number ), "%" PRIu32, obj.val.ul );
+                break;
+
+            case VARTYPE_INT32:
+                pVar->value = obj.val.l;
+                snprintf( number, sizeof( number ), "%" PRId32, obj.val.l );
+                break;
+
+            case VARTYPE_UINT64:
+                pVar->value = (double)obj.val.ull;
+                snprintf( number, sizeof( number ), "%" PRIu64, obj.val.ull );
+                break;
+
+            case VARTYPE_INT64:
+                pVar->value = (double)obj.val.ll;
+                snprintf( number, sizeof( number ), "%" PRId64, obj.val.ll );
+                break;
+
+            case VARTYPE_FLOAT:
+                pVar->value = obj.val.f;
+                snprintf( number, sizeof( number ), "%g", obj.val.f );
+                break;
+
+            case VARTYPE_STR:
+                str[sizeof( str ) - 1] = '\0';
+                numeric = false;
+                break;
+
+            default:
+                result = ENOTSUP;
+                break;
+        }
+    }
+
+    if ( ( result == EOK ) && ( numeric == true ) && ( pVar->sent == true ) )
+    {
+        diff = pVar->value - pVar->lastValue;
+        if ( ( diff < pTelemetry->deadband ) &&
+             ( -diff < pTelemetry->deadband ) )
+        {
+            result = EALREADY;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        /* "{" or "," then "name":value, leaving room for the closing "}" */
+        result = E2BIG;
+        if ( size > 1 )
+        {
+            pBuf[m++] = ( len == 0 ) ? '{' : ',';
+            n = Quote( &pBuf[m], size - m, pVar->pName );
+            if ( ( n > 0 ) && ( m + n + 1 < size ) )
+            {
+                m += n;
+                pBuf[m++] = ':';
+                n = ( numeric == true )
+                    ? (size_t)snprintf( &pBuf[m], size - m, "%s", number )
+                    : Quote( &pBuf[m], size - m, str );
+                if ( ( n > 0 ) && ( m + n < size ) )
+                {
+                    *pLen = len + m + n;
+                    result = EOK;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Quote                                                                     */
+/*!
+    Write a JSON string
+
+    @param[in]
+        pBuf
+            pointer to the output buffer
+
+    @param[in]
+        size
+            size of the output buffer
+
+    @param[in]
+        pStr
+            pointer to the NUL terminated string to write
+
+    @retval length of the quoted string
+    @retval 0 the quoted string does not fit in the buffer
+
+==============================================================================*/
+static size_t Quote( char *pBuf, size_t size, const char *pStr )
+{
+    size_t len = 0;
+    unsigned char c;
+
+    if ( size > 0 )
+    {
+        pBuf[len++] = '"';
+    }
+
+    while ( ( *pStr != '\0' ) && ( len + 7 < size ) )
+    {
+        c = (unsigned char)*pStr++;
+        if ( ( c == '"' ) || ( c == '\\' ) )
+        {
+            pBuf[len++] = '\\';
+            pBuf[len++] = c;
+        }
+        else if ( c < 0x20 )
+        {
+            len += snprintf( &pBuf[len], size - len, "\\u%04x", c );
+        }
+        else
+        {
+            pBuf[len++] = c;
+        }
+    }
+
+    if ( ( *pStr == '\0' ) && ( len + 1 < size ) )
+    {
+        pBuf[len++] = '"';
+    }
+    else
+    {
+        len = 0;
+    }
+
+    return len;
+}
+
+/*============================================================================*/
+/*  Send                                                                      */
+/*!
+    Send the message built from the changed variables
+
+    The Send function closes the JSON object and sends it.  If it is
+    sent, its variables are marked as forwarded.  Otherwise they stay
+    changed and are sent with the next message, after the coalescing
+    window.
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        len
+            length of the message
+
+    @param[in]
+        fn
+            function called to send the message
+
+    @param[in]
+        pArg
+            argument passed to the send function
+
+==============================================================================*/
+static void Send( Telemetry *pTelemetry,
+                  size_t len,
+                  TelemetryFn fn,
+                  void *pArg )
+{
+    TelemetryVar *pVar;
+    uint64_t now = UTIL_NowMs();
+    size_t i;
+    int rc;
+
+    pTelemetry->pBuf[len++] = '}';
+    rc = fn( pArg, pTelemetry->pBuf, len );
+
+    for ( i = 0; i < pTelemetry->count; i++ )
+    {
+        pVar = &pTelemetry->pVars[i];
+        if ( ( pVar->included == true ) && ( rc == EOK ) )
+        {
+            pVar->changed = false;
+            pVar->sent = true;
+            pVar->lastValue = pVar->value;
+            pVar->lastSent = now;
+        }
+
+        pVar->included = false;
+    }
+
+    if ( rc != EOK )
+    {
+        if ( pTelemetry->verbose == true )
+        {
+            fprintf( stderr,
+                     "Telemetry: cannot send changes: %s\n",
+                     strerror( rc ) );
+        }
+
+        Defer( pTelemetry, now + pTelemetry->windowMs );
+    }
+}
+
+/*============================================================================*/
+/*  Defer                                                                     */
+/*!
+    Make sure a message is due by a time
+
+    @param[in]
+        pTelemetry
+            pointer to the telemetry forwarder
+
+    @param[in]
+        due
+            monotonic time in milliseconds by which a message is due
+
+==============================================================================*/
+static void Defer( Telemetry *pTelemetry, uint64_t due )
+{
+    if ( ( pTelemetry->deadline == 0 ) || ( due < pTelemetry->deadline ) )
+    {
+        pTelemetry->deadline = due;
+    }
+}
+
+/*! @}
+ * end of telemetry group */
@@ -0,0 +1,543 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup template template
+ * @brief Per-message header templates
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file template.c
+
+    Header Templates
+
+    The template module allows message headers to contain placeholders
+    which are substituted for each message, for example:
+
+    seq:${seq};ts:${ts_ms}
+
+    The following placeholders are supported:
+
+    ${seq}      per-message sequence number starting at 0
+    ${ts_ms}    wall clock time in milliseconds since the epoch
+    ${mono_ms}  monotonic clock time in milliseconds
+    ${hostname} host name
+    ${pid}      process identifier
+    ${chunk}    chunk index of a chunked transfer
+
+    A literal "${" is written as "$${".
+
+    The template is compiled once into a list of literal segments and
+    placeholders, and rendered for each message into a render buffer
+    which is allocated when the template is compiled and sized for the
+    longest possible rendering.  Rendering does not allocate memory or
+    parse format strings.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <iotclient/iotclient.h>
+#include "template.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! maximum number of digits in a rendered 64-bit number */
+#define MAX_DIGITS  ( 20 )
+
+/*! placeholder name to segment type mapping */
+typedef struct _Placeholder
+{
+    /*! placeholder name */
+    const char *name;
+
+    /*! segment type */
+    TemplateOp op;
+
+} Placeholder;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! supported placeholders */
+static const Placeholder placeholders[] =
+{
+    { "seq",      TEMPLATE_SEQ },
+    { "ts_ms",    TEMPLATE_TS_MS },
+    { "mono_ms",  TEMPLATE_MONO_MS },
+    { "hostname", TEMPLATE_HOSTNAME },
+    { "pid",      TEMPLATE_PID },
+    { "chunk",    TEMPLATE_CHUNK }
+};
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int AddSegment( HeaderTemplate *pTemplate,
+                       TemplateOp op,
+                       size_t offset,
+                       size_t len );
+static int LookupPlaceholder( const char *name, size_t len, TemplateOp *pOp );
+static char *RenderNumber( char *p, uint64_t n );
+static uint64_t ClockMs( clockid_t clock );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  TEMPLATE_Compile                                                          */
+/*!
+    Compile a header template
+
+    The TEMPLATE_Compile function splits the template text into literal
+    segments and placeholders, and allocates a render buffer large
+    enough for any rendering of the template.
+
+    @param[in]
+        pTemplate
+            pointer to the header template to compile into
+
+    @param[in]
+        text
+            NUL terminated template text
+
+    @retval EOK the template was compiled
+    @retval EINVAL unknown or unterminated placeholder
+    @retval E2BIG the template has too many segments
+    @retval ENOMEM memory allocation failed
+
+==============================================================================*/
+int TEMPLATE_Compile( HeaderTemplate *pTemplate, const char *text )
+{
+    int result = EINVAL;
+    size_t len;
+    size_t i = 0;
+    size_t out = 0;
+    size_t start = 0;
+    size_t size;
+    const char *pEnd;
+    TemplateOp op;
+
+    if ( ( pTemplate != NULL ) && ( text != NULL ) )
+    {
+        memset( pTemplate, 0, sizeof( HeaderTemplate ) );
+
+        len = strlen( text );
+        pTemplate->pText = malloc( len + 1 );
+        result = ( pTemplate->pText != NULL ) ? EOK : ENOMEM;
+
+        while ( ( result == EOK ) && ( i < len ) )
+        {
+            if ( ( text[i] == '$' ) &&
+                 ( text[i+1] == '$' ) &&
+                 ( text[i+2] == '{' ) )
+            {
+                /* escaped literal "${" */
+                pTemplate->pText[out++] = '$';
+                pTemplate->pText[out++] = '{';
+                i += 3;
+            }
+            else if ( ( text[i] == '$' ) && ( text[i+1] == '{' ) )
+            {
+                pEnd = strchr( &text[i+2], '}' );
+                if ( pEnd == NULL )
+                {
+                    fprintf( stderr, "Unterminated placeholder\n" );
+                    result = EINVAL;
+                }
+                else
+                {
+                    result = LookupPlaceholder( &text[i+2],
+                                                pEnd - &text[i+2],
+                                                &op );
+                }
+
+                if ( result == EOK )
+                {
+                    /* close the preceding literal segment */
+                    if ( out > start )
+                    {
+                        result = AddSegment( pTemplate,
+                                             TEMPLATE_LITERAL,
+                                             start,
+                                             out - start );
+                    }
+
+                    if ( result == EOK )
+                    {
+                        result = AddSegment( pTemplate, op, 0, 0 );
+                        pTemplate->dynamic = true;
+                    }
+
+                    start = out;
+                    i = ( pEnd - text ) + 1;
+                }
+            }
+            else
+            {
+                pTemplate->pText[out++] = text[i++];
+            }
+        }
+
+        if ( ( result == EOK ) && ( out > start ) )
+        {
+            result = AddSegment( pTemplate,
+                                 TEMPLATE_LITERAL,
+                                 start,
+                                 out - start );
+        }
+
+        if ( result == EOK )
+        {
+            if ( gethostname( pTemplate->hostname,
+                              sizeof( pTemplate->hostname ) ) != 0 )
+            {
+                strcpy( pTemplate->hostname, "unknown" );
+            }
+
+            pTemplate->hostname[TEMPLATE_MAX_HOSTNAME] = '\0';
+            pTemplate->hostnameLen = strlen( pTemplate->hostname );
+            pTemplate->pid = (uint64_t)getpid();
+
+            /* size the render buffer for the longest possible rendering */
+            size = out + 1;
+            for ( i = 0; i < pTemplate->count; i++ )
+            {
+                if ( pTemplate->segments[i].op == TEMPLATE_HOSTNAME )
+                {
+                    size += pTemplate->hostnameLen;
+                }
+                else if ( pTemplate->segments[i].op != TEMPLATE_LITERAL )
+                {
+                    size += MAX_DIGITS;
+                }
+            }
+
+            pTemplate->pBuf = malloc( size );
+            if ( pTemplate->pBuf != NULL )
+            {
+                pTemplate->size = size;
+            }
+            else
+            {
+                result = ENOMEM;
+            }
+        }
+
+        if ( result != EOK )
+        {
+            TEMPLATE_Free( pTemplate );
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  TEMPLATE_Render                                                           */
+/*!
+    Render a header template
+
+    The TEMPLATE_Render function substitutes the placeholders of the
+    template into the template's render buffer and advances the
+    sequence number.  The returned buffer is overwritten by the next
+    call to TEMPLATE_Render.
+
+    @param[in]
+        pTemplate
+            pointer to the compiled header template
+
+    @param[in]
+        chunk
+            chunk index substituted for the ${chunk} placeholder
+
+    @retval pointer to the NUL terminated rendered headers
+    @retval NULL the template has not been compiled
+
+==============================================================================*/
+char *TEMPLATE_Render( HeaderTemplate *pTemplate, uint64_t chunk )
+{
+    char *pResult = NULL;
+    TemplateSegment *pSegment;
+    char *p;
+    size_t i;
+
+    if ( ( pTemplate != NULL ) && ( pTemplate->pBuf != NULL ) )
+    {
+        p = pTemplate->pBuf;
+
+        for ( i = 0; i < pTemplate->count; i++ )
+        {
+            pSegment = &pTemplate->segments[i];
+            switch ( pSegment->op )
+            {
+                case TEMPLATE_LITERAL:
+                    memcpy( p,
+                            &pTemplate->pText[pSegment->offset],
+                            pSegment->len );
+                    p += pSegment->len;
+                    break;
+
+                case TEMPLATE_SEQ:
+                    p = RenderNumber( p, pTemplate->seq );
+                    break;
+
+                case TEMPLATE_TS_MS:
+                    p = RenderNumber( p, ClockMs( CLOCK_REALTIME ) );
+                    break;
+
+                case TEMPLATE_MONO_MS:
+                    p = RenderNumber( p, ClockMs( CLOCK_MONOTONIC ) );
+                    break;
+
+                case TEMPLATE_HOSTNAME:
+                    memcpy( p, pTemplate->hostname, pTemplate->hostnameLen );
+                    p += pTemplate->hostnameLen;
+                    break;
+
+                case TEMPLATE_PID:
+                    p = RenderNumber( p, pTemplate->pid );
+                    break;
+
+                case TEMPLATE_CHUNK:
+                    p = RenderNumber( p, chunk );
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        *p = '\0';
+        pTemplate->seq++;
+        pResult = pTemplate->pBuf;
+    }
+
+    return pResult;
+}
+
+/*============================================================================*/
+/*  TEMPLATE_Free                                                             */
+/*!
+    Release the resources used by a header template
+
+    @param[in]
+        pTemplate
+            pointer to the header template
+
+==============================================================================*/
+void TEMPLATE_Free( HeaderTemplate *pTemplate )
+{
+    if ( pTemplate != NULL )
+    {
+        if ( pTemplate->pText != NULL )
+        {
+            free( pTemplate->pText );
+            pTemplate->pText = NULL;
+        }
+
+        if ( pTemplate->pBuf != NULL )
+        {
+            free( pTemplate->pBuf );
+            pTemplate->pBuf = NULL;
+        }
+
+        pTemplate->size = 0;
+        pTemplate->count = 0;
+        pTemplate->dynamic = false;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  AddSegment                                                                */
+/*!
+    Add a segment to a header template
+
+    @param[in]
+        pTemplate
+            pointer to the header template
+
+    @param[in]
+        op
+            segment type
+
+    @param[in]
+        offset
+            offset of a literal segment in the template text
+
+    @param[in]
+        len
+            length of a literal segment
+
+    @retval EOK the segment was added
+    @retval E2BIG the template has too many segments
+
+==============================================================================*/
+static int AddSegment( HeaderTemplate *pTemplate,
+                       TemplateOp op,
+                       size_t offset,
+                       size_t len )
+{
+    int result = E2BIG;
+    TemplateSegment *pSegment;
+
+    if ( pTemplate->count < TEMPLATE_MAX_SEGMENTS )
+    {
+        pSegment = &pTemplate->segments[pTemplate->count++];
+        pSegment->op = op;
+        pSegment->offset = offset;
+        pSegment->len = len;
+        result = EOK;
+    }
+    else
+    {
+        fprintf( stderr, "Too many header template segments\n" );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  LookupPlaceholder                                                         */
+/*!
+    Look up a placeholder by name
+
+    @param[in]
+        name
+            pointer to the placeholder name
+
+    @param[in]
+        len
+            length of the placeholder name
+
+    @param[out]
+        pOp
+            pointer to a location to store the segment type
+
+    @retval EOK the placeholder was found
+    @retval EINVAL unknown placeholder
+
+==============================================================================*/
+static int LookupPlaceholder( const char *name, size_t len, TemplateOp *pOp )
+{
+    int result = EINVAL;
+    size_t i;
+
+    for ( i = 0; i < sizeof( placeholders ) / sizeof( placeholders[0] ); i++ )
+    {
+        if ( ( strlen( placeholders[i].name ) == len ) &&
+             ( strncmp( placeholders[i].name, name, len ) == 0 ) )
+        {
+            *pOp = placeholders[i].op;
+            result = EOK;
+            break;
+        }
+    }
+
+    if ( result != EOK )
+    {
+        fprintf( stderr, "Unknown placeholder: ${%.*s}\n", (int)len, name );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  RenderNumber                                                              */
+/*!
+    Render an unsigned number in decimal
+
+    @param[in]
+        p
+            pointer to the output position
+
+    @param[in]
+        n
+            number to render
+
+    @retval pointer to the output position following the number
+
+==============================================================================*/
+static char *RenderNumber( char *p, uint64_t n )
+{
+    char digits[MAX_DIGITS];
+    int i = 0;
+
+    do
+    {
+        digits[i++] = '0' + ( n % 10 );
+        n /= 10;
+    } while ( n > 0 );
+
+    while ( i > 0 )
+    {
+        *p++ = digits[--i];
+    }
+
+    return p;
+}
+
+/*============================================================================*/
+/*  ClockMs                                                                   */
+/*!
+    Read a clock in milliseconds
+
+    @param[in]
+        clock
+            clock to read
+
+    @retval clock time in milliseconds
+
+==============================================================================*/
+static uint64_t ClockMs( clockid_t clock )
+{
+    struct timespec ts;
+
+    clock_gettime( clock, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*! @}
+ * end of template group */
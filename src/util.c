@@ -0,0 +1,150 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup util util
+ * @brief Shared helpers
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file util.c
+
+    Shared Helpers
+
+    The util module holds the small helpers used throughout iotsend and
+    its benchmarks: the monotonic clock used for deadlines, timeouts
+    and latencies, and the parser for numeric command line arguments.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include "util.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/* the benchmarks use this module without the IOTClient library */
+#ifndef EOK
+#define EOK 0
+#endif
+
+/*! number of nanoseconds in a second */
+#define NSEC_PER_SEC    ( 1000000000ull )
+
+/*! number of nanoseconds in a millisecond */
+#define NSEC_PER_MSEC   ( 1000000ull )
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  UTIL_NowMs                                                                */
+/*!
+    Get the monotonic time in milliseconds
+
+    The time is never 0, so 0 can be used to mean that no deadline is
+    set.
+
+    @retval monotonic time in milliseconds
+
+==============================================================================*/
+uint64_t UTIL_NowMs( void )
+{
+    return ( UTIL_NowNs() / NSEC_PER_MSEC ) + 1;
+}
+
+/*============================================================================*/
+/*  UTIL_NowNs                                                                */
+/*!
+    Get the monotonic time in nanoseconds
+
+    @retval monotonic time in nanoseconds
+
+==============================================================================*/
+uint64_t UTIL_NowNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( (uint64_t)ts.tv_sec * NSEC_PER_SEC ) + (uint64_t)ts.tv_nsec;
+}
+
+/*============================================================================*/
+/*  UTIL_ParseNumber                                                          */
+/*!
+    Parse an unsigned number from a command line argument
+
+    The number may be decimal, hexadecimal with a 0x prefix, or octal
+    with a 0 prefix.
+
+    @param[in]
+        str
+            pointer to the string to parse
+
+    @param[out]
+        pValue
+            pointer to a location to store the parsed value
+
+    @retval EOK the number was parsed
+    @retval EINVAL the string is not a valid number
+
+==============================================================================*/
+int UTIL_ParseNumber( const char *str, size_t *pValue )
+{
+    int result = EINVAL;
+    char *pEnd = NULL;
+    unsigned long long value;
+
+    if ( ( str != NULL ) && ( pValue != NULL ) && ( *str != '-' ) )
+    {
+        errno = 0;
+        value = strtoull( str, &pEnd, 0 );
+        if ( ( errno == 0 ) &&
+             ( pEnd != str ) &&
+             ( *pEnd == '\0' ) &&
+             ( value <= SIZE_MAX ) )
+        {
+            *pValue = (size_t)value;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of util group */
@@ -0,0 +1,678 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup watch watch
+ * @brief Drop directory watcher
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file watch.c
+
+    Drop Directory Watcher
+
+    The watch module picks up the files which applications drop into a
+    directory as soon as they are finished, so each one can be sent as
+    a message over a persistent connection instead of by a separate
+    iotsend process per file.
+
+    The directory is watched with inotify for files which are closed
+    after writing or moved into it.  The files already in the directory
+    when it is opened are picked up too.  Files whose names start with
+    a dot are ignored so they can be written under a temporary name.
+
+    A scan leaves a file which a producer still has open for writing
+    for the inotify event sent when it is closed.  This is checked with
+    a read lease, which needs the file to belong to the user running
+    iotsend.  Any other file is left until it has not been modified for
+    WATCH_SETTLE_MS, so a producer of such files which holds one open
+    without writing to it must write it under a dot name and rename it
+    when done.
+
+    Once a file has been delivered it is deleted, or moved into a done
+    directory if one was given.  A file which could not be delivered is
+    left in the directory and is offered again after the directory is
+    scanned by the next call to WATCH_Wait().
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+/* for ppoll() and F_SETLEASE */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <iotclient/iotclient.h>
+#include "util.h"
+#include "watch.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! size of the inotify event buffer */
+#define WATCH_INOTIFY_BUF_SIZE  ( 4096 )
+
+/*! time a file must be left unmodified before a scan takes it */
+#define WATCH_SETTLE_MS         ( 2000 )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+static int ReadEvents( Watch *pWatch, WatchFileFn pfnFile, void *pArg );
+static int ScanDir( Watch *pWatch, WatchFileFn pfnFile, void *pArg );
+static int SendFile( Watch *pWatch,
+                     const char *name,
+                     bool scanned,
+                     WatchFileFn pfnFile,
+                     void *pArg );
+static bool Settled( Watch *pWatch,
+                     const char *pPath,
+                     const struct stat *pStat );
+static void Done( Watch *pWatch, const char *name, const char *pPath );
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  WATCH_Open                                                                */
+/*!
+    Start watching a drop directory
+
+    The WATCH_Open function creates the drop directory and the done
+    directory if they do not exist, and starts watching the drop
+    directory for files which are closed after writing or moved into it.
+
+    @param[in]
+        pWatch
+            pointer to the directory watcher to initialize
+
+    @param[in]
+        pDir
+            path of the drop directory
+
+    @param[in]
+        pDoneDir
+            directory delivered files are moved to, or NULL to delete them
+
+    @param[in]
+        verbose
+            report file activity on stderr
+
+    @retval EOK the directory is watched
+    @retval EINVAL invalid arguments
+    @retval ENOMEM memory allocation failed
+    @retval other error creating or watching the directory
+
+==============================================================================*/
+int WATCH_Open( Watch *pWatch,
+                const char *pDir,
+                const char *pDoneDir,
+                bool verbose )
+{
+    int result = EINVAL;
+
+    if ( ( pWatch != NULL ) && ( pDir != NULL ) )
+    {
+        memset( pWatch, 0, sizeof( Watch ) );
+        pWatch->fd = -1;
+        pWatch->verbose = verbose;
+        pWatch->scan = true;
+
+        pWatch->pDir = strdup( pDir );
+        result = ( pWatch->pDir != NULL ) ? EOK : ENOMEM;
+    }
+
+    if ( ( result == EOK ) && ( pDoneDir != NULL ) )
+    {
+        pWatch->pDoneDir = strdup( pDoneDir );
+        result = ( pWatch->pDoneDir != NULL ) ? EOK : ENOMEM;
+        if ( ( result == EOK ) &&
+             ( mkdir( pDoneDir, 0750 ) != 0 ) &&
+             ( errno != EEXIST ) )
+        {
+            result = errno;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        if ( ( mkdir( pDir, 0750 ) != 0 ) && ( errno != EEXIST ) )
+        {
+            result = errno;
+        }
+        else
+        {
+            pWatch->fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+            if ( ( pWatch->fd == -1 ) ||
+                 ( inotify_add_watch( pWatch->fd,
+                                      pDir,
+                                      IN_CLOSE_WRITE | IN_MOVED_TO ) == -1 ) )
+            {
+                result = errno;
+            }
+        }
+    }
+
+    if ( ( result != EOK ) && ( result != EINVAL ) )
+    {
+        WATCH_Close( pWatch );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WATCH_Wait                                                                */
+/*!
+    Wait for files to be dropped into the directory and send them
+
+    The WATCH_Wait function calls the file function for each file in
+    the directory which is waiting to be sent, then waits for new files
+    and calls the file function for each of them.  A file is completed
+    once the file function succeeds for it.
+
+    If the file function fails for a file, WATCH_Wait stops and returns
+    its error.  The file is left in the directory and is offered again,
+    together with any other files still waiting, by the next call.
+    A file which a scan leaves because it was modified too recently is
+    offered by a later call, so the wait may end before the timeout.
+
+    The signal mask is only installed while waiting, so a signal
+    received while a file is handled ends the next wait as soon as it
+    starts.
+
+    @param[in]
+        pWatch
+            pointer to the directory watcher
+
+    @param[in]
+        timeoutMs
+            maximum time to wait in milliseconds, or -1 to wait forever
+
+    @param[in]
+        pMask
+            signal mask installed while waiting, or NULL to wait with
+            the signal mask of the calling thread
+
+    @param[in]
+        pfnFile
+            function called with the path of each file
+
+    @param[in]
+        pArg
+            argument passed to the file function
+
+    @retval EOK files were handled
+    @retval ETIMEDOUT no file was dropped before the timeout, or the
+            wait was interrupted by a signal
+    @retval EINVAL invalid arguments
+    @retval other error from the file function, or from ppoll()
+
+==============================================================================*/
+int WATCH_Wait( Watch *pWatch,
+                int timeoutMs,
+                const sigset_t *pMask,
+                WatchFileFn pfnFile,
+                void *pArg )
+{
+    int result = EINVAL;
+    struct pollfd pfd;
+    struct timespec ts;
+    uint64_t now;
+    int n;
+
+    if ( ( pWatch != NULL ) && ( pWatch->fd != -1 ) && ( pfnFile != NULL ) )
+    {
+        result = EOK;
+
+        now = UTIL_NowMs();
+        if ( ( pWatch->scan == true ) && ( pWatch->scanDue <= now ) )
+        {
+            /* read the waiting events first so the files they name are
+               not offered twice */
+            pWatch->scan = false;
+            ReadEvents( pWatch, NULL, NULL );
+            result = ScanDir( pWatch, pfnFile, pArg );
+        }
+
+        if ( ( pWatch->scan == true ) &&
+             ( ( timeoutMs < 0 ) ||
+               ( pWatch->scanDue < now + (uint64_t)timeoutMs ) ) )
+        {
+            /* wake up to take the files which were still being written */
+            timeoutMs = ( pWatch->scanDue > now )
+                        ? (int)( pWatch->scanDue - now )
+                        : 0;
+        }
+    }
+
+    if ( result == EOK )
+    {
+        pfd.fd = pWatch->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = ( timeoutMs % 1000 ) * 1000000L;
+
+        n = ppoll( &pfd, 1, ( timeoutMs >= 0 ) ? &ts : NULL, pMask );
+        if ( n > 0 )
+        {
+            result = ReadEvents( pWatch, pfnFile, pArg );
+        }
+        else if ( ( n == 0 ) || ( errno == EINTR ) )
+        {
+            /* report an interrupted wait as a timeout so the caller
+               can re-evaluate its state */
+            result = ETIMEDOUT;
+        }
+        else
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WATCH_Close                                                               */
+/*!
+    Stop watching a drop directory
+
+    @param[in]
+        pWatch
+            pointer to the directory watcher
+
+==============================================================================*/
+void WATCH_Close( Watch *pWatch )
+{
+    if ( pWatch != NULL )
+    {
+        if ( pWatch->fd != -1 )
+        {
+            close( pWatch->fd );
+            pWatch->fd = -1;
+        }
+
+        free( pWatch->pDir );
+        pWatch->pDir = NULL;
+
+        free( pWatch->pDoneDir );
+        pWatch->pDoneDir = NULL;
+    }
+}
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  ReadEvents                                                                */
+/*!
+    Read the pending inotify events and send the files they name
+
+    If the file function fails, the remaining events are discarded and
+    the directory is scanned again by the next call to WATCH_Wait().
+
+    @param[in]
+        pWatch
+            pointer to the directory watcher
+
+    @param[in]
+        pfnFile
+            function called with the path of each file, or NULL to
+            discard the pending events
+
+    @param[in]
+        pArg
+            argument passed to the file function
+
+    @retval EOK the events were handled
+    @retval other error from the file function
+
+==============================================================================*/
+static int ReadEvents( Watch *pWatch, WatchFileFn pfnFile, void *pArg )
+{
+    int result = EOK;
+    char buf[WATCH_INOTIFY_BUF_SIZE]
+        __attribute__(( aligned( __alignof__( struct inotify_event ) ) ));
+    struct inotify_event *pEvent;
+    ssize_t n;
+    ssize_t offset;
+
+    while ( ( n = read( pWatch->fd, buf, sizeof( buf ) ) ) > 0 )
+    {
+        for ( offset = 0;
+              offset < n;
+              offset += sizeof( *pEvent ) + pEvent->len )
+        {
+            pEvent = (struct inotify_event *)&buf[offset];
+            if ( pEvent->mask & IN_Q_OVERFLOW )
+            {
+                /* events were lost so look at every file */
+                pWatch->scan = true;
+            }
+            else if ( ( pEvent->len > 0 ) &&
+                      ( pfnFile != NULL ) &&
+                      ( result == EOK ) )
+            {
+                result = SendFile( pWatch,
+                                   pEvent->name,
+                                   false,
+                                   pfnFile,
+                                   pArg );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  ScanDir                                                                   */
+/*!
+    Send every file waiting in the directory
+
+    @param[in]
+        pWatch
+            pointer to the directory watcher
+
+    @param[in]
+        pfnFile
+            function called with the path of each file
+
+    @param[in]
+        pArg
+            argument passed to the file function
+
+    @retval EOK the files were sent
+    @retval other error from the file function, or from opendir()
+
+==============================================================================*/
+static int ScanDir( Watch *pWatch, WatchFileFn pfnFile, void *pArg )
+{
+    int result = EOK;
+    DIR *pDir;
+    struct dirent *pEntry;
+
+    pDir = opendir( pWatch->pDir );
+    if ( pDir != NULL )
+    {
+        while ( ( result == EOK ) && ( ( pEntry = readdir( pDir ) ) != NULL ) )
+        {
+            result = SendFile( pWatch, pEntry->d_name, true, pfnFile, pArg );
+        }
+
+        closedir( pDir );
+    }
+    else
+    {
+        result = errno;
+        pWatch->scan = true;
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  SendFile                                                                  */
+/*!
+    Send a file from the directory
+
+    The SendFile function calls the file function for a regular file in
+    the directory, and completes the file if it succeeds.  Names which
+    start with a dot, and files which no longer exist because they were
+    already sent, are skipped.  If the file function fails the directory
+    is scanned again by the next call to WATCH_Wait().  A scan also skips
+    a file which may still be written, and scans again once it settles.
+
+    @param[in]
+        pWatch
+            pointer to the directory watcher
+
+    @param[in]
+        name
+            name of the file
+
+    @param[in]
+        scanned
+            the file was found by a scan rather than by an inotify event
+
+    @param[in]
+        pfnFile
+            function called with the path of the file
+
+    @param[in]
+        pArg
+            argument passed to the file function
+
+    @retval EOK the file was sent or skipped
+    @retval other error from the file function
+
+==============================================================================*/
+static int SendFile( Watch *pWatch,
+                     const char *name,
+                     bool scanned,
+                     WatchFileFn pfnFile,
+                     void *pArg )
+{
+    int result = EOK;
+    char path[PATH_MAX];
+    struct stat st;
+
+    if ( ( name[0] != '.' ) &&
+         ( snprintf( path, sizeof( path ), "%s/%s", pWatch->pDir, name )
+             < (int)sizeof( path ) ) &&
+         ( stat( path, &st ) == 0 ) &&
+         ( S_ISREG( st.st_mode ) ) &&
+         ( ( scanned == false ) || ( Settled( pWatch, path, &st ) == true ) ) )
+    {
+        result = pfnFile( pArg, path );
+        if ( result == EOK )
+        {
+            Done( pWatch, name, path );
+        }
+        else
+        {
+            if ( pWatch->verbose == true )
+            {
+                fprintf( stderr,
+                         "Cannot send %s: %s\n",
+                         path,
+                         strerror( result ) );
+            }
+
+            pWatch->scan = true;
+            pWatch->scanDue = 0;
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Settled                                                                   */
+/*!
+    Check whether a scanned file has finished being written
+
+    The Settled function checks that no process has a file found by a
+    scan open for writing, so a file a producer is still writing is not
+    sent part way through.  Such a file is sent when the inotify event
+    for its close is read.  A read lease cannot be taken on a file which
+    is open for writing, so the check is exact where leases are allowed.
+    Otherwise the file must not have been modified for WATCH_SETTLE_MS,
+    and the directory is scanned again once it would have settled.
+
+    @param[in]
+        pWatch
+            pointer to the directory watcher
+
+    @param[in]
+        pPath
+            path of the file
+
+    @param[in]
+        pStat
+            status of the file
+
+    @retval true the file may be sent
+    @retval false the file may still be written
+
+==============================================================================*/
+static bool Settled( Watch *pWatch,
+                     const char *pPath,
+                     const struct stat *pStat )
+{
+    bool settled = true;
+    bool checked = false;
+    struct timespec now;
+    int64_t ageMs;
+    uint64_t due;
+    int fd;
+
+    fd = open( pPath, O_RDONLY | O_NONBLOCK | O_CLOEXEC );
+    if ( fd != -1 )
+    {
+        if ( fcntl( fd, F_SETLEASE, F_RDLCK ) == 0 )
+        {
+            fcntl( fd, F_SETLEASE, F_UNLCK );
+            checked = true;
+        }
+        else if ( errno == EAGAIN )
+        {
+            /* open for writing: wait for the close event */
+            settled = false;
+            checked = true;
+        }
+
+        close( fd );
+    }
+
+    if ( ( checked == false ) &&
+         ( clock_gettime( CLOCK_REALTIME, &now ) == 0 ) )
+    {
+        /* no lease, e.g. on a file of another user: go by its age */
+        ageMs = ( (int64_t)now.tv_sec - (int64_t)pStat->st_mtim.tv_sec )
+                * 1000 +
+                ( now.tv_nsec - pStat->st_mtim.tv_nsec ) / 1000000;
+
+        /* a file dated well in the future is not being written now */
+        if ( ( ageMs > -WATCH_SETTLE_MS ) && ( ageMs < WATCH_SETTLE_MS ) )
+        {
+            settled = false;
+
+            due = UTIL_NowMs() + WATCH_SETTLE_MS -
+                  (uint64_t)( ( ageMs > 0 ) ? ageMs : 0 );
+            if ( ( pWatch->scan == false ) || ( due < pWatch->scanDue ) )
+            {
+                pWatch->scanDue = due;
+            }
+
+            pWatch->scan = true;
+        }
+    }
+
+    return settled;
+}
+
+/*============================================================================*/
+/*  Done                                                                      */
+/*!
+    Complete a delivered file
+
+    The Done function moves a delivered file into the done directory,
+    or deletes it if there is no done directory.  A file which cannot
+    be moved is deleted so it is not sent again.
+
+    @param[in]
+        pWatch
+            pointer to the directory watcher
+
+    @param[in]
+        name
+            name of the file
+
+    @param[in]
+        pPath
+            path of the file
+
+==============================================================================*/
+static void Done( Watch *pWatch, const char *name, const char *pPath )
+{
+    char path[PATH_MAX];
+    int rc = ENOENT;
+
+    if ( pWatch->pDoneDir != NULL )
+    {
+        rc = ENAMETOOLONG;
+        if ( snprintf( path, sizeof( path ), "%s/%s", pWatch->pDoneDir, name )
+                < (int)sizeof( path ) )
+        {
+            rc = ( rename( pPath, path ) == 0 ) ? EOK : errno;
+        }
+
+        if ( rc != EOK )
+        {
+            fprintf( stderr,
+                     "Cannot move %s to %s: %s\n",
+                     pPath,
+                     pWatch->pDoneDir,
+                     strerror( rc ) );
+        }
+    }
+
+    if ( rc != EOK )
+    {
+        unlink( pPath );
+    }
+
+    if ( pWatch->verbose == true )
+    {
+        fprintf( stderr, "Sent %s\n", pPath );
+    }
+}
+
+/*! @}
+ * end of watch group */
@@ -0,0 +1,448 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup batchtest batchtest
+ * @brief Unit tests of client-side batching
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file batchtest.c
+
+    Batch Unit Tests
+
+    The batchtest program checks the flush thresholds of a batch: the
+    record count, the byte threshold including the framing overhead,
+    records which must be sent on their own, and the linger timeout.
+    It also checks the JSON array and length prefixed framing of the
+    batched records.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <iotclient/iotclient.h>
+#include "batch.h"
+#include "test.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! size of the test batch buffers */
+#define TEST_BATCH_SIZE     ( 100 )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestInit( void );
+static void TestJson( void );
+static void TestLengthPrefixed( void );
+static void TestCount( void );
+static void TestBytes( void );
+static void TestOversized( void );
+static void TestLinger( void );
+static void TestParseFormat( void );
+static bool IsData( Batch *pBatch, const void *pData, size_t len );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the batch unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "batch_init", TestInit );
+    TEST_Run( "batch_json", TestJson );
+    TEST_Run( "batch_length_prefixed", TestLengthPrefixed );
+    TEST_Run( "batch_count", TestCount );
+    TEST_Run( "batch_bytes", TestBytes );
+    TEST_Run( "batch_oversized", TestOversized );
+    TEST_Run( "batch_linger", TestLinger );
+    TEST_Run( "batch_parse_format", TestParseFormat );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestInit                                                                  */
+/*!
+    Check that the byte threshold defaults to, and is capped at, the
+    size of the batch buffer
+
+==============================================================================*/
+static void TestInit( void )
+{
+    Batch batch;
+
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            0,
+                            0,
+                            0 ) == EOK );
+    TEST_CHECK( batch.maxBytes == TEST_BATCH_SIZE );
+    TEST_CHECK( BATCH_IsFull( &batch ) == false );
+    BATCH_Free( &batch );
+
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            2 * TEST_BATCH_SIZE,
+                            0,
+                            0 ) == EOK );
+    TEST_CHECK( batch.maxBytes == TEST_BATCH_SIZE );
+    BATCH_Free( &batch );
+
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            40,
+                            0,
+                            0 ) == EOK );
+    TEST_CHECK( batch.maxBytes == 40 );
+    BATCH_Free( &batch );
+
+    TEST_CHECK( BATCH_Init( NULL,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            0,
+                            0,
+                            0 ) == EINVAL );
+}
+
+/*============================================================================*/
+/*  TestJson                                                                  */
+/*!
+    Check that the records of a JSON batch are the elements of an array,
+    and that a cleared batch starts a new array
+
+==============================================================================*/
+static void TestJson( void )
+{
+    static const char first[] = "[{\"a\":1},{\"b\":2},3]";
+    static const char second[] = "[\"x\"]";
+    size_t len;
+    Batch batch;
+
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            0,
+                            0,
+                            0 ) == EOK );
+
+    TEST_CHECK( BATCH_GetData( &batch, &len ) == NULL );
+
+    TEST_CHECK( BATCH_Add( &batch, "{\"a\":1}", 7 ) == EOK );
+    TEST_CHECK( BATCH_Add( &batch, "{\"b\":2}", 7 ) == EOK );
+    TEST_CHECK( BATCH_Add( &batch, "3", 1 ) == EOK );
+    TEST_CHECK( batch.count == 3 );
+    TEST_CHECK( IsData( &batch, first, strlen( first ) ) == true );
+
+    BATCH_Clear( &batch );
+    TEST_CHECK( BATCH_GetData( &batch, &len ) == NULL );
+    TEST_CHECK( BATCH_Add( &batch, "\"x\"", 3 ) == EOK );
+    TEST_CHECK( IsData( &batch, second, strlen( second ) ) == true );
+
+    BATCH_Free( &batch );
+}
+
+/*============================================================================*/
+/*  TestLengthPrefixed                                                        */
+/*!
+    Check that each record of a length prefixed batch is preceded by its
+    32-bit big-endian length
+
+==============================================================================*/
+static void TestLengthPrefixed( void )
+{
+    static const uint8_t expected[] =
+    {
+        0, 0, 0, 3, 'o', 'n', 'e',
+        0, 0, 0, 0,
+        0, 0, 0, 2, '\n', '\0'
+    };
+    Batch batch;
+
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_LP,
+                            TEST_BATCH_SIZE,
+                            0,
+                            0,
+                            0 ) == EOK );
+
+    TEST_CHECK( BATCH_Add( &batch, "one", 3 ) == EOK );
+    TEST_CHECK( BATCH_Add( &batch, "", 0 ) == EOK );
+    TEST_CHECK( BATCH_Add( &batch, "\n", 2 ) == EOK );
+    TEST_CHECK( IsData( &batch, expected, sizeof( expected ) ) == true );
+
+    BATCH_Free( &batch );
+}
+
+/*============================================================================*/
+/*  TestCount                                                                 */
+/*!
+    Check that a batch is full once it holds the maximum number of
+    records
+
+==============================================================================*/
+static void TestCount( void )
+{
+    Batch batch;
+
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            0,
+                            3,
+                            0 ) == EOK );
+
+    TEST_CHECK( BATCH_Add( &batch, "1", 1 ) == EOK );
+    TEST_CHECK( BATCH_Add( &batch, "2", 1 ) == EOK );
+    TEST_CHECK( BATCH_IsFull( &batch ) == false );
+    TEST_CHECK( BATCH_Add( &batch, "3", 1 ) == EOK );
+    TEST_CHECK( BATCH_IsFull( &batch ) == true );
+
+    BATCH_Clear( &batch );
+    TEST_CHECK( BATCH_IsFull( &batch ) == false );
+
+    BATCH_Free( &batch );
+}
+
+/*============================================================================*/
+/*  TestBytes                                                                 */
+/*!
+    Check that the byte threshold counts the framing of the records,
+    that a batch is full once the next record could not fit, and that a
+    record which would pass the threshold is refused
+
+==============================================================================*/
+static void TestBytes( void )
+{
+    Batch batch;
+
+    /* 20 bytes hold "[12345678,12345678]" with the closing bracket */
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            20,
+                            0,
+                            0 ) == EOK );
+
+    TEST_CHECK( BATCH_Add( &batch, "12345678", 8 ) == EOK );
+    TEST_CHECK( batch.len == 9 );
+    TEST_CHECK( BATCH_IsFull( &batch ) == false );
+
+    TEST_CHECK( BATCH_Add( &batch, "12345678", 8 ) == EOK );
+    TEST_CHECK( batch.len == 18 );
+    TEST_CHECK( BATCH_IsFull( &batch ) == true );
+
+    TEST_CHECK( BATCH_Add( &batch, "1", 1 ) == ENOSPC );
+    TEST_CHECK( batch.count == 2 );
+    BATCH_Free( &batch );
+
+    /* the length prefix counts against the threshold */
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_LP,
+                            TEST_BATCH_SIZE,
+                            20,
+                            0,
+                            0 ) == EOK );
+
+    TEST_CHECK( BATCH_Add( &batch, "123456", 6 ) == EOK );
+    TEST_CHECK( BATCH_IsFull( &batch ) == false );
+    TEST_CHECK( BATCH_Add( &batch, "1234567", 7 ) == ENOSPC );
+    TEST_CHECK( BATCH_Add( &batch, "123456", 6 ) == EOK );
+    TEST_CHECK( batch.len == 20 );
+    TEST_CHECK( BATCH_IsFull( &batch ) == true );
+
+    BATCH_Free( &batch );
+}
+
+/*============================================================================*/
+/*  TestOversized                                                             */
+/*!
+    Check that a record over the byte threshold is accepted in an empty
+    batch, and that a record which cannot fit in the batch buffer is
+    refused so it can be sent on its own
+
+==============================================================================*/
+static void TestOversized( void )
+{
+    char record[TEST_BATCH_SIZE];
+    Batch batch;
+
+    memset( record, '7', sizeof( record ) );
+
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            20,
+                            0,
+                            0 ) == EOK );
+
+    TEST_CHECK( BATCH_Add( &batch, record, 50 ) == EOK );
+    TEST_CHECK( BATCH_IsFull( &batch ) == true );
+    BATCH_Clear( &batch );
+
+    /* the buffer holds the record with its brackets */
+    TEST_CHECK( BATCH_Add( &batch,
+                           record,
+                           TEST_BATCH_SIZE - 1 ) == E2BIG );
+    TEST_CHECK( BATCH_Add( &batch,
+                           record,
+                           TEST_BATCH_SIZE - 2 ) == EOK );
+    TEST_CHECK( batch.count == 1 );
+
+    /* past the byte threshold the next record waits for a flush */
+    TEST_CHECK( BATCH_Add( &batch, record, 1 ) == ENOSPC );
+
+    BATCH_Free( &batch );
+}
+
+/*============================================================================*/
+/*  TestLinger                                                                */
+/*!
+    Check that the linger timeout starts with the first record of a
+    batch
+
+==============================================================================*/
+static void TestLinger( void )
+{
+    Batch batch;
+    int timeout;
+
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            0,
+                            0,
+                            1000 ) == EOK );
+
+    TEST_CHECK( BATCH_GetTimeout( &batch ) == -1 );
+    TEST_CHECK( BATCH_Add( &batch, "1", 1 ) == EOK );
+    timeout = BATCH_GetTimeout( &batch );
+    TEST_CHECK( ( timeout > 900 ) && ( timeout <= 1001 ) );
+
+    BATCH_Clear( &batch );
+    TEST_CHECK( BATCH_GetTimeout( &batch ) == -1 );
+    BATCH_Free( &batch );
+
+    /* without a linger time the batch must be flushed straight away */
+    TEST_CHECK( BATCH_Init( &batch,
+                            BATCH_FORMAT_JSON,
+                            TEST_BATCH_SIZE,
+                            0,
+                            0,
+                            0 ) == EOK );
+    TEST_CHECK( BATCH_Add( &batch, "1", 1 ) == EOK );
+    TEST_CHECK( BATCH_GetTimeout( &batch ) == 0 );
+    BATCH_Free( &batch );
+}
+
+/*============================================================================*/
+/*  TestParseFormat                                                           */
+/*!
+    Check the batch format names
+
+==============================================================================*/
+static void TestParseFormat( void )
+{
+    BatchFormat format = BATCH_FORMAT_JSON;
+
+    TEST_CHECK( BATCH_ParseFormat( "lp", &format ) == EOK );
+    TEST_CHECK( format == BATCH_FORMAT_LP );
+    TEST_CHECK( BATCH_ParseFormat( "json", &format ) == EOK );
+    TEST_CHECK( format == BATCH_FORMAT_JSON );
+    TEST_CHECK( BATCH_ParseFormat( "csv", &format ) == ENOTSUP );
+    TEST_CHECK( BATCH_ParseFormat( NULL, &format ) == EINVAL );
+}
+
+/*============================================================================*/
+/*  IsData                                                                    */
+/*!
+    Check the framed data of a batch
+
+    @param[in]
+        pBatch
+            pointer to the batch
+
+    @param[in]
+        pData
+            expected framed data
+
+    @param[in]
+        len
+            length of the expected data
+
+    @retval true the batch holds the expected data
+    @retval false the batch holds different data
+
+==============================================================================*/
+static bool IsData( Batch *pBatch, const void *pData, size_t len )
+{
+    size_t batchLen = 0;
+    char *pBatchData;
+
+    pBatchData = BATCH_GetData( pBatch, &batchLen );
+
+    return ( pBatchData != NULL ) &&
+           ( batchLen == len ) &&
+           ( memcmp( pBatchData, pData, len ) == 0 );
+}
+
+/*! @}
+ * end of batchtest group */
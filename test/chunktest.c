@@ -0,0 +1,499 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup chunktest chunktest
+ * @brief Unit tests of chunked transfers and their checkpoints
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file chunktest.c
+
+    Chunked Transfer Unit Tests
+
+    The chunktest program checks that a mapped input and an input read
+    from a file are split into numbered chunks which share a transfer
+    identifier and carry the chunk sequence headers, that a transfer
+    resumed from a checkpoint continues with the same identifier,
+    numbering and data as the interrupted transfer, and that
+    checkpoints are saved, loaded and removed.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <iotclient/iotclient.h>
+#include "chunk.h"
+#include "checkpoint.h"
+#include "test.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! size of the test input */
+#define TEST_INPUT_SIZE     ( 10000 )
+
+/*! maximum number of payload bytes in a test chunk */
+#define TEST_CHUNK_SIZE     ( 4096 )
+
+/*! number of chunks of the test input */
+#define TEST_CHUNK_COUNT    ( 3 )
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! test input */
+static char input[TEST_INPUT_SIZE];
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestMapped( void );
+static void TestFile( void );
+static void TestResume( void );
+static void TestResumeFile( void );
+static void TestCheckpoint( void );
+static bool IsChunk( ChunkTransfer *pTransfer,
+                     int fd,
+                     const char *pTransferId,
+                     size_t index );
+static bool HasHeader( const char *pHeaders, const char *pHeader );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the chunked transfer unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    size_t i;
+
+    (void)argc;
+    (void)argv;
+
+    for ( i = 0; i < sizeof( input ); i++ )
+    {
+        input[i] = (char)( i * 7 + i / 251 );
+    }
+
+    TEST_Run( "chunk_mapped", TestMapped );
+    TEST_Run( "chunk_file", TestFile );
+    TEST_Run( "chunk_resume", TestResume );
+    TEST_Run( "chunk_resume_file", TestResumeFile );
+    TEST_Run( "checkpoint", TestCheckpoint );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestMapped                                                                */
+/*!
+    Check that a mapped input is split into numbered chunks
+
+==============================================================================*/
+static void TestMapped( void )
+{
+    ChunkTransfer transfer;
+    char transferId[CHUNK_ID_LEN+1];
+    char *pData;
+    char *pHeaders;
+    size_t len;
+    size_t i;
+
+    TEST_CHECK( CHUNK_Init( &transfer,
+                            "source:test",
+                            TEST_CHUNK_SIZE,
+                            sizeof( input ) ) == EOK );
+    TEST_CHECK( CHUNK_Map( &transfer, input, sizeof( input ) ) == EOK );
+    TEST_CHECK( strlen( transfer.transferId ) == CHUNK_ID_LEN );
+    memcpy( transferId, transfer.transferId, sizeof( transferId ) );
+
+    for ( i = 0; i < TEST_CHUNK_COUNT; i++ )
+    {
+        TEST_CHECK( IsChunk( &transfer, -1, transferId, i ) == true );
+    }
+
+    TEST_CHECK( CHUNK_Next( &transfer,
+                            -1,
+                            &pData,
+                            &len,
+                            &pHeaders ) == ENODATA );
+
+    CHUNK_Free( &transfer );
+}
+
+/*============================================================================*/
+/*  TestFile                                                                  */
+/*!
+    Check that an input read from a file is split into numbered chunks
+
+==============================================================================*/
+static void TestFile( void )
+{
+    char *pDir = TEST_TempDir();
+    char path[PATH_MAX];
+    ChunkTransfer transfer;
+    char transferId[CHUNK_ID_LEN+1];
+    char *pData;
+    char *pHeaders;
+    size_t len;
+    size_t i;
+    int fd;
+
+    TEST_CHECK( pDir != NULL );
+    snprintf( path, sizeof( path ), "%s/input", pDir );
+
+    fd = open( path, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+    TEST_CHECK( fd != -1 );
+    TEST_CHECK( write( fd, input, sizeof( input ) ) ==
+                (ssize_t)sizeof( input ) );
+    TEST_CHECK( lseek( fd, 0, SEEK_SET ) == 0 );
+
+    TEST_CHECK( CHUNK_Init( &transfer,
+                            "source:test",
+                            TEST_CHUNK_SIZE,
+                            sizeof( input ) ) == EOK );
+    memcpy( transferId, transfer.transferId, sizeof( transferId ) );
+
+    for ( i = 0; i < TEST_CHUNK_COUNT; i++ )
+    {
+        TEST_CHECK( IsChunk( &transfer, fd, transferId, i ) == true );
+    }
+
+    TEST_CHECK( CHUNK_Next( &transfer,
+                            fd,
+                            &pData,
+                            &len,
+                            &pHeaders ) == ENODATA );
+
+    CHUNK_Free( &transfer );
+    close( fd );
+    TEST_RemoveDir( pDir );
+    free( pDir );
+}
+
+/*============================================================================*/
+/*  TestResume                                                                */
+/*!
+    Check that a resumed transfer continues the interrupted transfer
+
+==============================================================================*/
+static void TestResume( void )
+{
+    ChunkTransfer transfer;
+    char transferId[CHUNK_ID_LEN+1];
+
+    /* interrupt a transfer after its first chunk */
+    TEST_CHECK( CHUNK_Init( &transfer,
+                            "source:test",
+                            TEST_CHUNK_SIZE,
+                            sizeof( input ) ) == EOK );
+    TEST_CHECK( CHUNK_Map( &transfer, input, sizeof( input ) ) == EOK );
+    memcpy( transferId, transfer.transferId, sizeof( transferId ) );
+    TEST_CHECK( IsChunk( &transfer, -1, transferId, 0 ) == true );
+    CHUNK_Free( &transfer );
+
+    TEST_CHECK( CHUNK_Init( &transfer,
+                            "source:test",
+                            TEST_CHUNK_SIZE,
+                            sizeof( input ) ) == EOK );
+    TEST_CHECK( CHUNK_Map( &transfer, input, sizeof( input ) ) == EOK );
+    TEST_CHECK( CHUNK_Resume( &transfer,
+                              transferId,
+                              1,
+                              TEST_CHUNK_SIZE ) == EOK );
+    TEST_CHECK( IsChunk( &transfer, -1, transferId, 1 ) == true );
+    TEST_CHECK( IsChunk( &transfer, -1, transferId, 2 ) == true );
+    CHUNK_Free( &transfer );
+
+    /* every chunk was sent before the transfer was interrupted */
+    TEST_CHECK( CHUNK_Init( &transfer,
+                            "source:test",
+                            TEST_CHUNK_SIZE,
+                            sizeof( input ) ) == EOK );
+    TEST_CHECK( CHUNK_Map( &transfer, input, sizeof( input ) ) == EOK );
+    TEST_CHECK( CHUNK_Resume( &transfer,
+                              transferId,
+                              TEST_CHUNK_COUNT,
+                              sizeof( input ) ) == EOK );
+    TEST_CHECK( transfer.done == true );
+    CHUNK_Free( &transfer );
+
+    /* a transfer identifier must be complete */
+    TEST_CHECK( CHUNK_Init( &transfer,
+                            "source:test",
+                            TEST_CHUNK_SIZE,
+                            sizeof( input ) ) == EOK );
+    TEST_CHECK( CHUNK_Resume( &transfer, "1234", 1, 0 ) == EINVAL );
+    CHUNK_Free( &transfer );
+}
+
+/*============================================================================*/
+/*  TestResumeFile                                                            */
+/*!
+    Check that a transfer read from a file resumes at the offset of the
+    interrupted chunk
+
+==============================================================================*/
+static void TestResumeFile( void )
+{
+    char *pDir = TEST_TempDir();
+    char path[PATH_MAX];
+    ChunkTransfer transfer;
+    char transferId[CHUNK_ID_LEN+1];
+    int fd;
+
+    TEST_CHECK( pDir != NULL );
+    snprintf( path, sizeof( path ), "%s/input", pDir );
+
+    fd = open( path, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+    TEST_CHECK( fd != -1 );
+    TEST_CHECK( write( fd, input, sizeof( input ) ) ==
+                (ssize_t)sizeof( input ) );
+
+    /* interrupt a transfer after its second chunk */
+    TEST_CHECK( lseek( fd, 0, SEEK_SET ) == 0 );
+    TEST_CHECK( CHUNK_Init( &transfer,
+                            "source:test",
+                            TEST_CHUNK_SIZE,
+                            sizeof( input ) ) == EOK );
+    memcpy( transferId, transfer.transferId, sizeof( transferId ) );
+    TEST_CHECK( IsChunk( &transfer, fd, transferId, 0 ) == true );
+    TEST_CHECK( IsChunk( &transfer, fd, transferId, 1 ) == true );
+    CHUNK_Free( &transfer );
+
+    TEST_CHECK( lseek( fd, 2 * TEST_CHUNK_SIZE, SEEK_SET ) ==
+                2 * TEST_CHUNK_SIZE );
+    TEST_CHECK( CHUNK_Init( &transfer,
+                            "source:test",
+                            TEST_CHUNK_SIZE,
+                            sizeof( input ) ) == EOK );
+    TEST_CHECK( CHUNK_Resume( &transfer,
+                              transferId,
+                              2,
+                              2 * TEST_CHUNK_SIZE ) == EOK );
+    TEST_CHECK( IsChunk( &transfer, fd, transferId, 2 ) == true );
+    CHUNK_Free( &transfer );
+
+    close( fd );
+    TEST_RemoveDir( pDir );
+    free( pDir );
+}
+
+/*============================================================================*/
+/*  TestCheckpoint                                                            */
+/*!
+    Check that a checkpoint is saved, loaded and removed, and that a
+    damaged checkpoint is rejected
+
+==============================================================================*/
+static void TestCheckpoint( void )
+{
+    char *pDir = TEST_TempDir();
+    char path[PATH_MAX];
+    static const char damaged[] = "transferid:xyz\n";
+    Checkpoint saved;
+    Checkpoint loaded;
+    int fd;
+
+    TEST_CHECK( pDir != NULL );
+    snprintf( path, sizeof( path ), "%s/input.checkpoint", pDir );
+
+    memset( &saved, 0, sizeof( saved ) );
+    memcpy( saved.transferId,
+            "0123456789abcdef0123456789abcdef",
+            CHUNK_ID_LEN + 1 );
+    saved.index = 17;
+    saved.offset = 17 * TEST_CHUNK_SIZE;
+    saved.chunkSize = TEST_CHUNK_SIZE;
+    saved.size = 5000000000ULL;
+    saved.mtime = 1700000000123456789ULL;
+
+    TEST_CHECK( CHECKPOINT_Load( &loaded, path ) == ENOENT );
+    TEST_CHECK( CHECKPOINT_Save( &saved, path ) == EOK );
+
+    memset( &loaded, 0, sizeof( loaded ) );
+    TEST_CHECK( CHECKPOINT_Load( &loaded, path ) == EOK );
+    TEST_CHECK( strcmp( loaded.transferId, saved.transferId ) == 0 );
+    TEST_CHECK( loaded.index == saved.index );
+    TEST_CHECK( loaded.offset == saved.offset );
+    TEST_CHECK( loaded.chunkSize == saved.chunkSize );
+    TEST_CHECK( loaded.size == saved.size );
+    TEST_CHECK( loaded.mtime == saved.mtime );
+
+    TEST_CHECK( CHECKPOINT_Remove( path ) == EOK );
+    TEST_CHECK( CHECKPOINT_Load( &loaded, path ) == ENOENT );
+    TEST_CHECK( CHECKPOINT_Remove( path ) == EOK );
+
+    fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+    TEST_CHECK( fd != -1 );
+    TEST_CHECK( write( fd, damaged, strlen( damaged ) ) ==
+                (ssize_t)strlen( damaged ) );
+    close( fd );
+    TEST_CHECK( CHECKPOINT_Load( &loaded, path ) == EBADMSG );
+
+    TEST_RemoveDir( pDir );
+    free( pDir );
+}
+
+/*============================================================================*/
+/*  IsChunk                                                                   */
+/*!
+    Check the next chunk of the test input
+
+    @param[in]
+        pTransfer
+            pointer to the chunked transfer
+
+    @param[in]
+        fd
+            input file descriptor (unused for mapped inputs)
+
+    @param[in]
+        pTransferId
+            expected transfer identifier
+
+    @param[in]
+        index
+            expected chunk index
+
+    @retval true the chunk has the expected data and headers
+    @retval false a different chunk or an error was returned
+
+==============================================================================*/
+static bool IsChunk( ChunkTransfer *pTransfer,
+                     int fd,
+                     const char *pTransferId,
+                     size_t index )
+{
+    uint64_t offset = (uint64_t)index * TEST_CHUNK_SIZE;
+    size_t expected = sizeof( input ) - offset;
+    bool last = ( index == TEST_CHUNK_COUNT - 1 );
+    char header[64];
+    char *pData = NULL;
+    char *pHeaders = NULL;
+    size_t len = 0;
+    bool ok;
+
+    if ( expected > TEST_CHUNK_SIZE )
+    {
+        expected = TEST_CHUNK_SIZE;
+    }
+
+    ok = ( CHUNK_Next( pTransfer, fd, &pData, &len, &pHeaders ) == EOK ) &&
+         ( len == expected ) &&
+         ( memcmp( pData, &input[offset], len ) == 0 ) &&
+         ( HasHeader( pHeaders, "source:test" ) == true );
+
+    snprintf( header, sizeof( header ), "transferid:%s", pTransferId );
+    ok = ok && ( HasHeader( pHeaders, header ) == true );
+
+    snprintf( header, sizeof( header ), "chunk:%zu", index );
+    ok = ok && ( HasHeader( pHeaders, header ) == true );
+
+    snprintf( header, sizeof( header ), "chunks:%d", TEST_CHUNK_COUNT );
+    ok = ok && ( HasHeader( pHeaders, header ) == true );
+
+    snprintf( header, sizeof( header ), "offset:%llu",
+              (unsigned long long)offset );
+    ok = ok && ( HasHeader( pHeaders, header ) == true );
+
+    ok = ok && ( HasHeader( pHeaders, "lastchunk:true" ) == last );
+
+    return ok;
+}
+
+/*============================================================================*/
+/*  HasHeader                                                                 */
+/*!
+    Check whether a header block holds a header line
+
+    @param[in]
+        pHeaders
+            NUL terminated header block of newline separated headers
+
+    @param[in]
+        pHeader
+            header line to look for
+
+    @retval true the header block holds the header line
+    @retval false the header block does not hold the header line
+
+==============================================================================*/
+static bool HasHeader( const char *pHeaders, const char *pHeader )
+{
+    size_t len = strlen( pHeader );
+    const char *p = pHeaders;
+    bool found = false;
+
+    while ( ( p != NULL ) && ( found == false ) )
+    {
+        found = ( strncmp( p, pHeader, len ) == 0 ) &&
+                ( ( p[len] == '\n' ) || ( p[len] == '\0' ) );
+
+        p = strchr( p, '\n' );
+        if ( p != NULL )
+        {
+            p++;
+        }
+    }
+
+    return found;
+}
+
+/*! @}
+ * end of chunktest group */
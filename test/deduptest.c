@@ -0,0 +1,303 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup deduptest deduptest
+ * @brief Unit tests of the duplicate payload filter
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file deduptest.c
+
+    Duplicate Filter Unit Tests
+
+    The deduptest program checks that the duplicate filter suppresses a
+    payload which repeats the last payload of its stream, that streams
+    are told apart by the value of their key header, that an unchanged
+    payload is sent again once its heartbeat is due, and that a stream
+    whose last message could not be sent is forgotten.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <iotclient/iotclient.h>
+#include "dedup.h"
+#include "test.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of nanoseconds in a second */
+#define NSEC_PER_SEC        ( 1000000000ull )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestSingleStream( void );
+static void TestStreams( void );
+static void TestLongPayload( void );
+static void TestHeartbeat( void );
+static void TestForget( void );
+static void TestInvalid( void );
+static int Check( Dedup *pDedup, const char *pHeaders, const char *pPayload );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the duplicate filter unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "dedup_single_stream", TestSingleStream );
+    TEST_Run( "dedup_streams", TestStreams );
+    TEST_Run( "dedup_long_payload", TestLongPayload );
+    TEST_Run( "dedup_heartbeat", TestHeartbeat );
+    TEST_Run( "dedup_forget", TestForget );
+    TEST_Run( "dedup_invalid", TestInvalid );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestSingleStream                                                          */
+/*!
+    Check that only a payload which repeats the last payload is
+    suppressed when all the messages belong to one stream
+
+==============================================================================*/
+static void TestSingleStream( void )
+{
+    Dedup dedup;
+
+    TEST_CHECK( DEDUP_Init( &dedup, NULL, 0 ) == EOK );
+
+    TEST_CHECK( Check( &dedup, "a:1\n", "21.5" ) == EOK );
+    TEST_CHECK( Check( &dedup, "a:2\n", "21.5" ) == EALREADY );
+    TEST_CHECK( Check( &dedup, NULL, "21.5" ) == EALREADY );
+    TEST_CHECK( Check( &dedup, NULL, "21.6" ) == EOK );
+    TEST_CHECK( Check( &dedup, NULL, "21.5" ) == EOK );
+
+    /* a prefix of the last payload is a different payload */
+    TEST_CHECK( Check( &dedup, NULL, "21." ) == EOK );
+    TEST_CHECK( Check( &dedup, NULL, "" ) == EOK );
+    TEST_CHECK( Check( &dedup, NULL, "" ) == EALREADY );
+
+    DEDUP_Free( &dedup );
+}
+
+/*============================================================================*/
+/*  TestStreams                                                               */
+/*!
+    Check that the streams are told apart by the value of the key header,
+    and that messages without the key header share a stream
+
+==============================================================================*/
+static void TestStreams( void )
+{
+    Dedup dedup;
+
+    TEST_CHECK( DEDUP_Init( &dedup, "sensor", 0 ) == EOK );
+
+    TEST_CHECK( Check( &dedup, "sensor:1\n", "on" ) == EOK );
+    TEST_CHECK( Check( &dedup, "sensor:2\n", "on" ) == EOK );
+    TEST_CHECK( Check( &dedup, "unit:C\nsensor:1\n", "on" ) == EALREADY );
+    TEST_CHECK( Check( &dedup, "sensor:2\nunit:C\n", "on" ) == EALREADY );
+
+    TEST_CHECK( Check( &dedup, "sensor:1\n", "off" ) == EOK );
+    TEST_CHECK( Check( &dedup, "sensor:2\n", "on" ) == EALREADY );
+
+    TEST_CHECK( Check( &dedup, "unit:C\n", "on" ) == EOK );
+    TEST_CHECK( Check( &dedup, NULL, "on" ) == EALREADY );
+
+    /* the value is the whole value, not a prefix */
+    TEST_CHECK( Check( &dedup, "sensor:10\n", "off" ) == EOK );
+
+    DEDUP_Free( &dedup );
+}
+
+/*============================================================================*/
+/*  TestLongPayload                                                           */
+/*!
+    Check that a change anywhere in a payload of several hash stripes
+    is detected
+
+==============================================================================*/
+static void TestLongPayload( void )
+{
+    char payload[101];
+    Dedup dedup;
+    size_t i;
+
+    memset( payload, 'x', sizeof( payload ) - 1 );
+    payload[sizeof( payload ) - 1] = '\0';
+
+    TEST_CHECK( DEDUP_Init( &dedup, NULL, 0 ) == EOK );
+    TEST_CHECK( Check( &dedup, NULL, payload ) == EOK );
+
+    for ( i = 0; i < sizeof( payload ) - 1; i++ )
+    {
+        payload[i] = 'y';
+        TEST_CHECK( Check( &dedup, NULL, payload ) == EOK );
+        TEST_CHECK( Check( &dedup, NULL, payload ) == EALREADY );
+        payload[i] = 'x';
+    }
+
+    DEDUP_Free( &dedup );
+}
+
+/*============================================================================*/
+/*  TestHeartbeat                                                             */
+/*!
+    Check that an unchanged payload is sent again once its heartbeat is
+    due, and that the heartbeat restarts from that message
+
+==============================================================================*/
+static void TestHeartbeat( void )
+{
+    Dedup dedup;
+    size_t i;
+
+    TEST_CHECK( DEDUP_Init( &dedup, NULL, 60 ) == EOK );
+    TEST_CHECK( dedup.heartbeat == 60 * NSEC_PER_SEC );
+
+    TEST_CHECK( Check( &dedup, NULL, "idle" ) == EOK );
+    TEST_CHECK( Check( &dedup, NULL, "idle" ) == EALREADY );
+
+    /* the one stream is in the first entry: age its last payload */
+    for ( i = 0; i < DEDUP_TABLE_SIZE; i++ )
+    {
+        if ( dedup.pEntries[i].used == true )
+        {
+            dedup.pEntries[i].sent -= 61 * NSEC_PER_SEC;
+        }
+    }
+
+    TEST_CHECK( Check( &dedup, NULL, "idle" ) == EOK );
+    TEST_CHECK( Check( &dedup, NULL, "idle" ) == EALREADY );
+
+    DEDUP_Free( &dedup );
+}
+
+/*============================================================================*/
+/*  TestForget                                                                */
+/*!
+    Check that a forgotten stream sends its next payload even if it is
+    unchanged, and that the other streams are not affected
+
+==============================================================================*/
+static void TestForget( void )
+{
+    Dedup dedup;
+
+    TEST_CHECK( DEDUP_Init( &dedup, "id", 0 ) == EOK );
+
+    TEST_CHECK( Check( &dedup, "id:a\n", "1" ) == EOK );
+    TEST_CHECK( Check( &dedup, "id:b\n", "1" ) == EOK );
+
+    DEDUP_Forget( &dedup, "id:a\n" );
+    TEST_CHECK( Check( &dedup, "id:a\n", "1" ) == EOK );
+    TEST_CHECK( Check( &dedup, "id:a\n", "1" ) == EALREADY );
+    TEST_CHECK( Check( &dedup, "id:b\n", "1" ) == EALREADY );
+
+    DEDUP_Free( &dedup );
+}
+
+/*============================================================================*/
+/*  TestInvalid                                                               */
+/*!
+    Check that invalid arguments are rejected
+
+==============================================================================*/
+static void TestInvalid( void )
+{
+    Dedup dedup;
+
+    TEST_CHECK( DEDUP_Init( NULL, NULL, 0 ) == EINVAL );
+    TEST_CHECK( Check( NULL, NULL, "1" ) == EINVAL );
+
+    TEST_CHECK( DEDUP_Init( &dedup, NULL, 0 ) == EOK );
+    TEST_CHECK( DEDUP_Check( &dedup, NULL, NULL, 0 ) == EINVAL );
+    DEDUP_Free( &dedup );
+}
+
+/*============================================================================*/
+/*  Check                                                                     */
+/*!
+    Check a NUL terminated payload with the duplicate filter
+
+    @param[in]
+        pDedup
+            pointer to the duplicate filter
+
+    @param[in]
+        pHeaders
+            headers of the message, or NULL
+
+    @param[in]
+        pPayload
+            NUL terminated payload
+
+    @retval result of DEDUP_Check
+
+==============================================================================*/
+static int Check( Dedup *pDedup, const char *pHeaders, const char *pPayload )
+{
+    return DEDUP_Check( pDedup, pHeaders, pPayload, strlen( pPayload ) );
+}
+
+/*! @}
+ * end of deduptest group */
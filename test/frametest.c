@@ -0,0 +1,365 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup frametest frametest
+ * @brief Unit tests of the length prefixed message framing
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file frametest.c
+
+    Message Framing Unit Tests
+
+    The frametest program checks that frames written by FRAME_Write are
+    read back by the record reader with their headers and payloads, and
+    that frames which are too big, streams which end in the middle of a
+    frame and invalid frame headers are detected.  The input is written
+    to a pipe which is closed before it is read.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <iotclient/iotclient.h>
+#include "frame.h"
+#include "reader.h"
+#include "test.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestFrames( void );
+static void TestOversizedFrame( void );
+static void TestTruncatedFrame( void );
+static void TestFrameHeader( void );
+static int Input( const void *pData, size_t len );
+static bool IsFrame( RecordReader *pReader,
+                     const char *pHeaders,
+                     const char *pPayload );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the message framing unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "frame_read", TestFrames );
+    TEST_Run( "frame_oversized", TestOversizedFrame );
+    TEST_Run( "frame_truncated", TestTruncatedFrame );
+    TEST_Run( "frame_header", TestFrameHeader );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestFrames                                                                */
+/*!
+    Check that frames written by FRAME_Write are read back with their
+    headers and payloads, including binary and empty payloads
+
+==============================================================================*/
+static void TestFrames( void )
+{
+    static const char binary[] = { 'a', '\n', '\0', 'b' };
+    RecordReader reader;
+    char *pHeaders;
+    char *pRecord;
+    size_t headersLen;
+    size_t len;
+    int fds[2];
+
+    TEST_CHECK( pipe( fds ) == 0 );
+    TEST_CHECK( FRAME_Write( fds[1], "key:1", "first", 5 ) == EOK );
+    TEST_CHECK( FRAME_Write( fds[1], NULL, "second", 6 ) == EOK );
+    TEST_CHECK( FRAME_Write( fds[1], "key:3", "", 0 ) == EOK );
+    TEST_CHECK( FRAME_Write( fds[1], NULL, binary, sizeof( binary ) ) == EOK );
+    close( fds[1] );
+
+    TEST_CHECK( READER_Init( &reader, fds[0], '\n', 64 ) == EOK );
+
+    TEST_CHECK( IsFrame( &reader, "key:1", "first" ) == true );
+    TEST_CHECK( IsFrame( &reader, "", "second" ) == true );
+    TEST_CHECK( IsFrame( &reader, "key:3", "" ) == true );
+
+    TEST_CHECK( READER_NextFrame( &reader,
+                                  &pHeaders,
+                                  &headersLen,
+                                  &pRecord,
+                                  &len ) == EOK );
+    TEST_CHECK( ( headersLen == 0 ) &&
+                ( len == sizeof( binary ) ) &&
+                ( memcmp( pRecord, binary, len ) == 0 ) );
+
+    TEST_CHECK( READER_NextFrame( &reader,
+                                  &pHeaders,
+                                  &headersLen,
+                                  &pRecord,
+                                  &len ) == ENODATA );
+
+    READER_Free( &reader );
+    close( fds[0] );
+}
+
+/*============================================================================*/
+/*  TestOversizedFrame                                                        */
+/*!
+    Check that a frame which does not fit in the input buffer is
+    discarded, and that the following frames are not affected
+
+==============================================================================*/
+static void TestOversizedFrame( void )
+{
+    char big[200];
+    RecordReader reader;
+    char *pHeaders;
+    char *pRecord;
+    size_t headersLen;
+    size_t len;
+    int fds[2];
+
+    memset( big, 'x', sizeof( big ) );
+
+    TEST_CHECK( pipe( fds ) == 0 );
+    TEST_CHECK( FRAME_Write( fds[1], "n:1", "before", 6 ) == EOK );
+    TEST_CHECK( FRAME_Write( fds[1], "n:2", big, sizeof( big ) ) == EOK );
+    TEST_CHECK( FRAME_Write( fds[1], "n:3", "after", 5 ) == EOK );
+    close( fds[1] );
+
+    TEST_CHECK( READER_Init( &reader, fds[0], '\n', 64 ) == EOK );
+
+    TEST_CHECK( IsFrame( &reader, "n:1", "before" ) == true );
+    TEST_CHECK( READER_NextFrame( &reader,
+                                  &pHeaders,
+                                  &headersLen,
+                                  &pRecord,
+                                  &len ) == EMSGSIZE );
+    TEST_CHECK( IsFrame( &reader, "n:3", "after" ) == true );
+    TEST_CHECK( READER_NextFrame( &reader,
+                                  &pHeaders,
+                                  &headersLen,
+                                  &pRecord,
+                                  &len ) == ENODATA );
+
+    READER_Free( &reader );
+    close( fds[0] );
+}
+
+/*============================================================================*/
+/*  TestTruncatedFrame                                                        */
+/*!
+    Check that an input which ends in the middle of a frame, or which
+    is not framed, is reported as damaged
+
+==============================================================================*/
+static void TestTruncatedFrame( void )
+{
+    static const char text[] = "not a frame\n";
+    uint8_t frame[FRAME_HEADER_SIZE + 16];
+    RecordReader reader;
+    char *pHeaders;
+    char *pRecord;
+    size_t headersLen;
+    size_t len;
+    int fd;
+
+    /* a frame header announcing more data than the input holds */
+    TEST_CHECK( FRAME_Encode( frame, 3, 13 ) == EOK );
+    memcpy( &frame[FRAME_HEADER_SIZE], "n:1partial", 10 );
+
+    fd = Input( frame, FRAME_HEADER_SIZE + 10 );
+    TEST_CHECK( fd != -1 );
+    TEST_CHECK( READER_Init( &reader, fd, '\n', 64 ) == EOK );
+    TEST_CHECK( READER_NextFrame( &reader,
+                                  &pHeaders,
+                                  &headersLen,
+                                  &pRecord,
+                                  &len ) == EBADMSG );
+    TEST_CHECK( READER_NextFrame( &reader,
+                                  &pHeaders,
+                                  &headersLen,
+                                  &pRecord,
+                                  &len ) == ENODATA );
+    READER_Free( &reader );
+    close( fd );
+
+    fd = Input( text, strlen( text ) );
+    TEST_CHECK( fd != -1 );
+    TEST_CHECK( READER_Init( &reader, fd, '\n', 64 ) == EOK );
+    TEST_CHECK( READER_NextFrame( &reader,
+                                  &pHeaders,
+                                  &headersLen,
+                                  &pRecord,
+                                  &len ) == EBADMSG );
+    TEST_CHECK( READER_NextFrame( &reader,
+                                  &pHeaders,
+                                  &headersLen,
+                                  &pRecord,
+                                  &len ) == ENODATA );
+    READER_Free( &reader );
+    close( fd );
+}
+
+/*============================================================================*/
+/*  TestFrameHeader                                                           */
+/*!
+    Check that frame headers are encoded and decoded, and that invalid
+    frame headers are rejected
+
+==============================================================================*/
+static void TestFrameHeader( void )
+{
+    uint8_t frame[FRAME_HEADER_SIZE];
+    size_t headersLen = 0;
+    size_t len = 0;
+
+    TEST_CHECK( FRAME_Encode( frame, 17, 70000 ) == EOK );
+    TEST_CHECK( FRAME_Decode( frame, &headersLen, &len ) == EOK );
+    TEST_CHECK( ( headersLen == 17 ) && ( len == 70000 ) );
+
+    TEST_CHECK( FRAME_Encode( frame, FRAME_MAX_HEADERS + 1, 1 ) == E2BIG );
+
+    TEST_CHECK( FRAME_Encode( frame, 0, 1 ) == EOK );
+    frame[0] ^= 0xFF;
+    TEST_CHECK( FRAME_Decode( frame, &headersLen, &len ) == EBADMSG );
+}
+
+/*============================================================================*/
+/*  Input                                                                     */
+/*!
+    Create an input stream holding the given data
+
+    @param[in]
+        pData
+            pointer to the input data
+
+    @param[in]
+        len
+            length of the input data, which must fit in a pipe
+
+    @retval file descriptor of the read end of a closed pipe
+    @retval -1 the pipe could not be created
+
+==============================================================================*/
+static int Input( const void *pData, size_t len )
+{
+    int fds[2];
+    int fd = -1;
+
+    if ( pipe( fds ) == 0 )
+    {
+        if ( write( fds[1], pData, len ) == (ssize_t)len )
+        {
+            fd = fds[0];
+        }
+        else
+        {
+            close( fds[0] );
+        }
+
+        close( fds[1] );
+    }
+
+    return fd;
+}
+
+/*============================================================================*/
+/*  IsFrame                                                                   */
+/*!
+    Check the next frame from a record reader
+
+    @param[in]
+        pReader
+            pointer to the record reader
+
+    @param[in]
+        pHeaders
+            expected header block
+
+    @param[in]
+        pPayload
+            expected payload
+
+    @retval true the expected frame was returned
+    @retval false a different frame or an error was returned
+
+==============================================================================*/
+static bool IsFrame( RecordReader *pReader,
+                     const char *pHeaders,
+                     const char *pPayload )
+{
+    char *pFrameHeaders = NULL;
+    char *pRecord = NULL;
+    size_t headersLen = 0;
+    size_t len = 0;
+    int result;
+
+    result = READER_NextFrame( pReader,
+                               &pFrameHeaders,
+                               &headersLen,
+                               &pRecord,
+                               &len );
+
+    return ( result == EOK ) &&
+           ( headersLen == strlen( pHeaders ) ) &&
+           ( memcmp( pFrameHeaders, pHeaders, headersLen ) == 0 ) &&
+           ( len == strlen( pPayload ) ) &&
+           ( memcmp( pRecord, pPayload, len ) == 0 );
+}
+
+/*! @}
+ * end of frametest group */
@@ -0,0 +1,365 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup headerstest headerstest
+ * @brief Unit tests of the message headers
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file headerstest.c
+
+    Header Unit Tests
+
+    The headerstest program checks that a header specification is
+    compiled into a rendered header block, that its headers can be
+    looked up in both the compiled and the rendered block, that headers
+    are merged into a rendered block, and that the header section at
+    the start of a message is found.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <iotclient/iotclient.h>
+#include "headers.h"
+#include "test.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestCompile( void );
+static void TestCompileInvalid( void );
+static void TestFind( void );
+static void TestLookup( void );
+static void TestMerge( void );
+static void TestSectionLength( void );
+static int Compile( HeaderBlock *pBlock, const char *spec );
+static bool Value( const char *pValue, size_t len, const char *pExpected );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the header unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "headers_compile", TestCompile );
+    TEST_Run( "headers_compile_invalid", TestCompileInvalid );
+    TEST_Run( "headers_find", TestFind );
+    TEST_Run( "headers_lookup", TestLookup );
+    TEST_Run( "headers_merge", TestMerge );
+    TEST_Run( "headers_section_length", TestSectionLength );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestCompile                                                               */
+/*!
+    Check that a header specification is rendered one key:value pair per
+    line with white space trimmed, a repeated key replacing the earlier
+    value, and a blank line terminating the block
+
+==============================================================================*/
+static void TestCompile( void )
+{
+    HeaderBlock block;
+
+    TEST_CHECK( Compile( &block, " a : 1 ;b:2\nc:x:y;;a:3;" ) == EOK );
+    TEST_CHECK( block.count == 3 );
+    TEST_CHECK( strcmp( HEADERS_Get( &block ), "a:3\nb:2\nc:x:y\n\n" ) == 0 );
+    TEST_CHECK( block.len == strlen( HEADERS_Get( &block ) ) );
+    HEADERS_Free( &block );
+    TEST_CHECK( HEADERS_Get( &block ) == NULL );
+
+    /* an empty value is a header */
+    TEST_CHECK( Compile( &block, "a:" ) == EOK );
+    TEST_CHECK( strcmp( HEADERS_Get( &block ), "a:\n\n" ) == 0 );
+    HEADERS_Free( &block );
+
+    /* an empty specification renders the terminating blank line only */
+    TEST_CHECK( Compile( &block, "" ) == EOK );
+    TEST_CHECK( block.count == 0 );
+    TEST_CHECK( strcmp( HEADERS_Get( &block ), "\n" ) == 0 );
+    HEADERS_Free( &block );
+
+    TEST_CHECK( HEADERS_Get( NULL ) == NULL );
+}
+
+/*============================================================================*/
+/*  TestCompileInvalid                                                        */
+/*!
+    Check that malformed header specifications and too many headers are
+    rejected
+
+==============================================================================*/
+static void TestCompileInvalid( void )
+{
+    HeaderBlock block;
+    char spec[HEADERS_MAX_COUNT * 8];
+    char *p = spec;
+    size_t i;
+
+    TEST_CHECK( Compile( &block, "a:1;b" ) == EINVAL );
+    HEADERS_Free( &block );
+    TEST_CHECK( Compile( &block, " :1" ) == EINVAL );
+    HEADERS_Free( &block );
+    TEST_CHECK( Compile( NULL, "a:1" ) == EINVAL );
+    TEST_CHECK( HEADERS_Compile( &block, NULL, 0 ) == EINVAL );
+
+    for ( i = 0; i < HEADERS_MAX_COUNT; i++ )
+    {
+        p += sprintf( p, "h%zu:%zu;", i, i );
+    }
+
+    TEST_CHECK( Compile( &block, spec ) == EOK );
+    TEST_CHECK( block.count == HEADERS_MAX_COUNT );
+    HEADERS_Free( &block );
+
+    /* a repeated key does not count against the limit */
+    sprintf( p, "h0:x" );
+    TEST_CHECK( Compile( &block, spec ) == EOK );
+    HEADERS_Free( &block );
+
+    sprintf( p, "extra:x" );
+    TEST_CHECK( Compile( &block, spec ) == E2BIG );
+    HEADERS_Free( &block );
+}
+
+/*============================================================================*/
+/*  TestFind                                                                  */
+/*!
+    Check that a header is looked up by its whole key in a compiled
+    header block
+
+==============================================================================*/
+static void TestFind( void )
+{
+    HeaderBlock block;
+    const char *pValue;
+    size_t len = 0;
+
+    TEST_CHECK( Compile( &block, "id:42;idx:7;unit:C" ) == EOK );
+
+    pValue = HEADERS_Find( &block, "id", &len );
+    TEST_CHECK( Value( pValue, len, "42" ) );
+    pValue = HEADERS_Find( &block, "idx", &len );
+    TEST_CHECK( Value( pValue, len, "7" ) );
+    pValue = HEADERS_Find( &block, "unit", &len );
+    TEST_CHECK( Value( pValue, len, "C" ) );
+
+    TEST_CHECK( HEADERS_Find( &block, "i", &len ) == NULL );
+    TEST_CHECK( HEADERS_Find( &block, "units", &len ) == NULL );
+    TEST_CHECK( HEADERS_Find( &block, "C", &len ) == NULL );
+    TEST_CHECK( HEADERS_Find( &block, NULL, &len ) == NULL );
+    TEST_CHECK( HEADERS_Find( &block, "id", NULL ) == NULL );
+
+    HEADERS_Free( &block );
+    TEST_CHECK( HEADERS_Find( &block, "id", &len ) == NULL );
+}
+
+/*============================================================================*/
+/*  TestLookup                                                                */
+/*!
+    Check that a header is looked up by its whole key in a rendered
+    header block, and that the search stops at the end of the header
+    section
+
+==============================================================================*/
+static void TestLookup( void )
+{
+    const char *pHeaders = "id:42\nidx:7\nunit:\n\nbody:1\n";
+    const char *pValue;
+    size_t len = 0;
+
+    pValue = HEADERS_Lookup( pHeaders, "id", &len );
+    TEST_CHECK( Value( pValue, len, "42" ) );
+    pValue = HEADERS_Lookup( pHeaders, "idx", &len );
+    TEST_CHECK( Value( pValue, len, "7" ) );
+    pValue = HEADERS_Lookup( pHeaders, "unit", &len );
+    TEST_CHECK( Value( pValue, len, "" ) );
+
+    TEST_CHECK( HEADERS_Lookup( pHeaders, "i", &len ) == NULL );
+    TEST_CHECK( HEADERS_Lookup( pHeaders, "body", &len ) == NULL );
+
+    /* the last line need not be terminated */
+    pValue = HEADERS_Lookup( "a:1\nb:2", "b", &len );
+    TEST_CHECK( Value( pValue, len, "2" ) );
+
+    TEST_CHECK( HEADERS_Lookup( "", "a", &len ) == NULL );
+    TEST_CHECK( HEADERS_Lookup( NULL, "a", &len ) == NULL );
+}
+
+/*============================================================================*/
+/*  TestMerge                                                                 */
+/*!
+    Check that the headers of a specification are merged into a rendered
+    header block, replacing the headers with the same key, and that a
+    buffer which is too small is rejected
+
+==============================================================================*/
+static void TestMerge( void )
+{
+    const char *pHeaders = "a:1\nb:2\n\n";
+    const char *spec = "b:3;c:4";
+    const char *pExpected = "a:1\nb:3\nc:4\n\n";
+    char buf[64];
+
+    TEST_CHECK( HEADERS_Merge( pHeaders,
+                               spec,
+                               strlen( spec ),
+                               buf,
+                               sizeof( buf ) ) == EOK );
+    TEST_CHECK( strcmp( buf, pExpected ) == 0 );
+
+    /* the merged block and its NUL terminator must fit */
+    TEST_CHECK( HEADERS_Merge( pHeaders,
+                               spec,
+                               strlen( spec ),
+                               buf,
+                               strlen( pExpected ) + 1 ) == EOK );
+    TEST_CHECK( HEADERS_Merge( pHeaders,
+                               spec,
+                               strlen( spec ),
+                               buf,
+                               strlen( pExpected ) ) == E2BIG );
+
+    TEST_CHECK( HEADERS_Merge( "\n", "a:1", 3, buf, sizeof( buf ) ) == EOK );
+    TEST_CHECK( strcmp( buf, "a:1\n\n" ) == 0 );
+
+    TEST_CHECK( HEADERS_Merge( pHeaders, "x", 1, buf, sizeof( buf ) ) ==
+                EINVAL );
+    TEST_CHECK( HEADERS_Merge( NULL, spec, 1, buf, sizeof( buf ) ) ==
+                EINVAL );
+}
+
+/*============================================================================*/
+/*  TestSectionLength                                                         */
+/*!
+    Check that the header section at the start of a message is found,
+    and that a payload is not mistaken for headers
+
+==============================================================================*/
+static void TestSectionLength( void )
+{
+    const char *pMessage = "id:1\nx-unit.a_b:C\n\n{\"t\":1}";
+    const char *pJson = "{\"a\":1}\n\n";
+
+    TEST_CHECK( HEADERS_SectionLength( pMessage, strlen( pMessage ) ) ==
+                strlen( "id:1\nx-unit.a_b:C\n\n" ) );
+
+    /* the section must end within the message */
+    TEST_CHECK( HEADERS_SectionLength( pMessage, 18 ) == 0 );
+    TEST_CHECK( HEADERS_SectionLength( pMessage, 19 ) == 19 );
+
+    TEST_CHECK( HEADERS_SectionLength( pJson, strlen( pJson ) ) == 0 );
+    TEST_CHECK( HEADERS_SectionLength( "\nid:1\n\n", 7 ) == 0 );
+    TEST_CHECK( HEADERS_SectionLength( "id\n\n", 4 ) == 0 );
+    TEST_CHECK( HEADERS_SectionLength( ":1\n\n", 4 ) == 0 );
+    TEST_CHECK( HEADERS_SectionLength( "a b:1\n\n", 7 ) == 0 );
+    TEST_CHECK( HEADERS_SectionLength( "", 0 ) == 0 );
+}
+
+/*============================================================================*/
+/*  Compile                                                                   */
+/*!
+    Compile a NUL terminated header specification
+
+    @param[in]
+        pBlock
+            pointer to the header block
+
+    @param[in]
+        spec
+            NUL terminated header specification
+
+    @retval result of HEADERS_Compile
+
+==============================================================================*/
+static int Compile( HeaderBlock *pBlock, const char *spec )
+{
+    return HEADERS_Compile( pBlock, spec, strlen( spec ) );
+}
+
+/*============================================================================*/
+/*  Value                                                                     */
+/*!
+    Check a header value which is not NUL terminated
+
+    @param[in]
+        pValue
+            pointer to the header value, or NULL
+
+    @param[in]
+        len
+            length of the header value
+
+    @param[in]
+        pExpected
+            NUL terminated expected value
+
+    @retval true the value is the expected value
+    @retval false the value was not found or is different
+
+==============================================================================*/
+static bool Value( const char *pValue, size_t len, const char *pExpected )
+{
+    return ( pValue != NULL ) &&
+           ( len == strlen( pExpected ) ) &&
+           ( memcmp( pValue, pExpected, len ) == 0 );
+}
+
+/*! @}
+ * end of headerstest group */
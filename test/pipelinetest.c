@@ -0,0 +1,829 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup pipelinetest pipelinetest
+ * @brief Unit tests of the send pipeline
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file pipelinetest.c
+
+    Send Pipeline Unit Tests
+
+    The pipelinetest program checks that the messages submitted to a
+    send pipeline are sent once each and in order, that high priority
+    messages overtake the queued normal messages, and that failed sends
+    are retried according to the retry policy: transient errors until
+    the attempts are used up, in place when the order must be kept, and
+    fatal errors not at all.  It also checks that the drain deadline
+    ends a retry delay.
+
+    The hub is simulated with the send hook of the mock IOTClient
+    backend, which records the messages, makes chosen sends fail and
+    can hold up a send until it is released.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <pthread.h>
+#include <iotclient/iotclient.h>
+#include "pipeline.h"
+#include "mockiot.h"
+#include "util.h"
+#include "test.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! maximum number of messages recorded by the hub */
+#define TEST_MAX_MESSAGES   ( 1024 )
+
+/*! number of message slots of each lane of the test pipelines */
+#define TEST_DEPTH          ( 8 )
+
+/*! size of the header and payload buffers of the test pipelines */
+#define TEST_BUF_SIZE       ( 64 )
+
+/*! simulated hub */
+typedef struct _TestHub
+{
+    /*! mutex protecting the hub state */
+    pthread_mutex_t mutex;
+
+    /*! condition signalled when the hub state changes */
+    pthread_cond_t cond;
+
+    /*! the send of this message blocks until released (-1 = none) */
+    long blockAt;
+
+    /*! the blocked send is waiting to be released */
+    bool blocked;
+
+    /*! the sends of this message fail (-1 = none) */
+    long failAt;
+
+    /*! error returned by the failed sends */
+    int failErr;
+
+    /*! number of sends of the message which fail (UINT_MAX = all) */
+    unsigned int failCount;
+
+    /*! number of messages received */
+    size_t count;
+
+    /*! sequence number of each message received */
+    long seq[TEST_MAX_MESSAGES];
+
+    /*! number of sends of each message, by sequence number */
+    unsigned int attempts[TEST_MAX_MESSAGES];
+
+} TestHub;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! simulated hub */
+static TestHub hub;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestOrder( void );
+static void TestInvalid( void );
+static void TestPriority( void );
+static void TestRetry( void );
+static void TestRetryOrdered( void );
+static void TestFatal( void );
+static void TestAttempts( void );
+static void TestDeadline( void );
+static void ResetHub( void );
+static void FailAt( long seq, int err, unsigned int count );
+static void BlockAt( long seq );
+static void Release( void );
+static bool WaitAttempts( long seq, unsigned int attempts );
+static int HubSend( void *pArg,
+                    const char *pHeaders,
+                    const char *pBody,
+                    size_t len );
+static int Start( Pipeline *pPipeline,
+                  size_t lanes,
+                  bool ordered,
+                  unsigned int maxAttempts,
+                  unsigned int delayMs );
+static void Stop( Pipeline *pPipeline );
+static int Submit( Pipeline *pPipeline, size_t lane, long seq );
+static bool Received( const long *pSeq, size_t count );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the send pipeline unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    pthread_mutex_init( &hub.mutex, NULL );
+    pthread_cond_init( &hub.cond, NULL );
+    MOCKIOT_SetSendHook( HubSend, &hub );
+
+    TEST_Run( "pipeline_order", TestOrder );
+    TEST_Run( "pipeline_invalid", TestInvalid );
+    TEST_Run( "pipeline_priority", TestPriority );
+    TEST_Run( "pipeline_retry", TestRetry );
+    TEST_Run( "pipeline_retry_ordered", TestRetryOrdered );
+    TEST_Run( "pipeline_fatal", TestFatal );
+    TEST_Run( "pipeline_attempts", TestAttempts );
+    TEST_Run( "pipeline_deadline", TestDeadline );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestOrder                                                                 */
+/*!
+    Check that the submitted messages are sent once each and in order,
+    with a ring much smaller than the number of messages
+
+==============================================================================*/
+static void TestOrder( void )
+{
+    static long expected[TEST_MAX_MESSAGES];
+    Pipeline pipeline;
+    bool submitted = true;
+    long seq;
+
+    ResetHub();
+
+    TEST_CHECK( Start( &pipeline, 1, false, 1, 0 ) == EOK );
+    for ( seq = 0; seq < TEST_MAX_MESSAGES; seq++ )
+    {
+        expected[seq] = seq;
+        if ( Submit( &pipeline, PIPELINE_LANE_NORMAL, seq ) != EOK )
+        {
+            submitted = false;
+        }
+    }
+
+    TEST_CHECK( submitted == true );
+    TEST_CHECK( PIPELINE_Drain( &pipeline ) == EOK );
+    TEST_CHECK( PIPELINE_Pending( &pipeline ) == 0 );
+    TEST_CHECK( Received( expected, TEST_MAX_MESSAGES ) == true );
+    TEST_CHECK( PIPELINE_Shutdown( &pipeline ) == EOK );
+    IOTCLIENT_Close( pipeline.hIoTClient );
+}
+
+/*============================================================================*/
+/*  TestInvalid                                                               */
+/*!
+    Check that a message which does not fit in a slot is refused so it
+    can be sent directly, and that a stopped pipeline refuses messages
+
+==============================================================================*/
+static void TestInvalid( void )
+{
+    char headers[TEST_BUF_SIZE + 1];
+    char data[TEST_BUF_SIZE + 1];
+    Pipeline pipeline;
+
+    ResetHub();
+
+    memset( headers, 'h', sizeof( headers ) );
+    headers[TEST_BUF_SIZE] = '\0';
+    memset( data, 'd', sizeof( data ) );
+
+    TEST_CHECK( Start( &pipeline, 1, false, 1, 0 ) == EOK );
+
+    /* the header buffer also holds the NUL terminator */
+    TEST_CHECK( PIPELINE_Submit( &pipeline,
+                                 PIPELINE_LANE_NORMAL,
+                                 headers,
+                                 data,
+                                 1 ) == E2BIG );
+    headers[TEST_BUF_SIZE - 1] = '\0';
+    TEST_CHECK( PIPELINE_Submit( &pipeline,
+                                 PIPELINE_LANE_NORMAL,
+                                 headers,
+                                 data,
+                                 TEST_BUF_SIZE + 1 ) == E2BIG );
+    TEST_CHECK( PIPELINE_Submit( &pipeline,
+                                 PIPELINE_LANE_NORMAL,
+                                 NULL,
+                                 data,
+                                 1 ) == EINVAL );
+    TEST_CHECK( PIPELINE_Submit( &pipeline,
+                                 PIPELINE_LANE_NORMAL,
+                                 "seq:0",
+                                 NULL,
+                                 0 ) == EOK );
+
+    TEST_CHECK( PIPELINE_Shutdown( &pipeline ) == EOK );
+    TEST_CHECK( hub.count == 1 );
+
+    TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, 1 ) == EINVAL );
+    TEST_CHECK( PIPELINE_Drain( &pipeline ) == EINVAL );
+    IOTCLIENT_Close( pipeline.hIoTClient );
+}
+
+/*============================================================================*/
+/*  TestPriority                                                              */
+/*!
+    Check that a high priority message is sent before the normal
+    messages queued ahead of it
+
+==============================================================================*/
+static void TestPriority( void )
+{
+    static const long expected[] = { 0, 100, 101, 1, 2, 3 };
+    Pipeline pipeline;
+
+    ResetHub();
+    BlockAt( 0 );
+
+    TEST_CHECK( Start( &pipeline, 2, false, 1, 0 ) == EOK );
+
+    /* hold up the sender with the first message */
+    TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, 0 ) == EOK );
+    pthread_mutex_lock( &hub.mutex );
+    while ( hub.blocked == false )
+    {
+        pthread_cond_wait( &hub.cond, &hub.mutex );
+    }
+    pthread_mutex_unlock( &hub.mutex );
+
+    TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, 1 ) == EOK );
+    TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, 2 ) == EOK );
+    TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_HIGH, 100 ) == EOK );
+    TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, 3 ) == EOK );
+    TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_HIGH, 101 ) == EOK );
+    TEST_CHECK( PIPELINE_Pending( &pipeline ) == 6 );
+
+    Release();
+
+    TEST_CHECK( PIPELINE_Drain( &pipeline ) == EOK );
+    TEST_CHECK( Received( expected,
+                          sizeof( expected ) / sizeof( expected[0] ) ) );
+    Stop( &pipeline );
+}
+
+/*============================================================================*/
+/*  TestRetry                                                                 */
+/*!
+    Check that a message which fails with a transient error is set aside
+    and retried, without holding up the messages behind it
+
+==============================================================================*/
+static void TestRetry( void )
+{
+    static const long expected[] = { 0, 1, 3, 4, 2 };
+    Pipeline pipeline;
+    long seq;
+
+    ResetHub();
+    FailAt( 2, ECONNRESET, 2 );
+
+    /* a long retry delay lets the messages behind overtake the retry */
+    TEST_CHECK( Start( &pipeline, 1, false, 4, 200 ) == EOK );
+    for ( seq = 0; seq < 5; seq++ )
+    {
+        TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, seq ) == EOK );
+    }
+
+    TEST_CHECK( PIPELINE_Drain( &pipeline ) == EOK );
+    TEST_CHECK( hub.attempts[2] == 3 );
+    TEST_CHECK( Received( expected,
+                          sizeof( expected ) / sizeof( expected[0] ) ) );
+    TEST_CHECK( PIPELINE_Pending( &pipeline ) == 0 );
+    Stop( &pipeline );
+}
+
+/*============================================================================*/
+/*  TestRetryOrdered                                                          */
+/*!
+    Check that an ordered pipeline retries a message in place so the
+    messages are sent in order
+
+==============================================================================*/
+static void TestRetryOrdered( void )
+{
+    static const long expected[] = { 0, 1, 2, 3, 4 };
+    Pipeline pipeline;
+    long seq;
+
+    ResetHub();
+    FailAt( 2, ECONNRESET, 2 );
+
+    TEST_CHECK( Start( &pipeline, 1, true, 4, 5 ) == EOK );
+    TEST_CHECK( pipeline.pRetries == NULL );
+    for ( seq = 0; seq < 5; seq++ )
+    {
+        TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, seq ) == EOK );
+    }
+
+    TEST_CHECK( PIPELINE_Drain( &pipeline ) == EOK );
+    TEST_CHECK( hub.attempts[2] == 3 );
+    TEST_CHECK( Received( expected,
+                          sizeof( expected ) / sizeof( expected[0] ) ) );
+    Stop( &pipeline );
+}
+
+/*============================================================================*/
+/*  TestFatal                                                                 */
+/*!
+    Check that a message which fails with a fatal error is not retried,
+    and that the error is reported by the next drain only
+
+==============================================================================*/
+static void TestFatal( void )
+{
+    static const long expected[] = { 0, 2, 3 };
+    Pipeline pipeline;
+    long seq;
+
+    ResetHub();
+    FailAt( 1, EPERM, UINT_MAX );
+
+    TEST_CHECK( Start( &pipeline, 1, false, 0, 1 ) == EOK );
+    for ( seq = 0; seq < 4; seq++ )
+    {
+        TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, seq ) == EOK );
+    }
+
+    TEST_CHECK( PIPELINE_Drain( &pipeline ) == EPERM );
+    TEST_CHECK( hub.attempts[1] == 1 );
+    TEST_CHECK( Received( expected,
+                          sizeof( expected ) / sizeof( expected[0] ) ) );
+
+    TEST_CHECK( PIPELINE_Drain( &pipeline ) == EOK );
+    TEST_CHECK( PIPELINE_Shutdown( &pipeline ) == EPERM );
+    IOTCLIENT_Close( pipeline.hIoTClient );
+}
+
+/*============================================================================*/
+/*  TestAttempts                                                              */
+/*!
+    Check that a message which keeps failing with a transient error is
+    given up on once its attempts are used up, in and out of place
+
+==============================================================================*/
+static void TestAttempts( void )
+{
+    static const long expected[] = { 1 };
+    Pipeline pipeline;
+    bool ordered;
+
+    for ( ordered = false; ; ordered = true )
+    {
+        ResetHub();
+        FailAt( 0, ECONNRESET, UINT_MAX );
+
+        TEST_CHECK( Start( &pipeline, 1, ordered, 3, 1 ) == EOK );
+        TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, 0 ) == EOK );
+        TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, 1 ) == EOK );
+
+        TEST_CHECK( PIPELINE_Drain( &pipeline ) == ECONNRESET );
+        TEST_CHECK( hub.attempts[0] == 3 );
+        TEST_CHECK( Received( expected, 1 ) == true );
+        TEST_CHECK( PIPELINE_Shutdown( &pipeline ) == ECONNRESET );
+        IOTCLIENT_Close( pipeline.hIoTClient );
+
+        if ( ordered == true )
+        {
+            break;
+        }
+    }
+}
+
+/*============================================================================*/
+/*  TestDeadline                                                              */
+/*!
+    Check that setting the deadline ends the retry delay of a message,
+    and that the queued messages are given up on rather than sent
+
+==============================================================================*/
+static void TestDeadline( void )
+{
+    Pipeline pipeline;
+    uint64_t start;
+
+    ResetHub();
+    FailAt( 0, ECONNRESET, UINT_MAX );
+
+    /* the message would be retried for ever, ten seconds apart */
+    TEST_CHECK( Start( &pipeline, 1, true, 0, 10000 ) == EOK );
+    TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, 0 ) == EOK );
+    TEST_CHECK( Submit( &pipeline, PIPELINE_LANE_NORMAL, 1 ) == EOK );
+    TEST_CHECK( WaitAttempts( 0, 1 ) == true );
+
+    start = UTIL_NowMs();
+    PIPELINE_SetDeadline( &pipeline, UTIL_NowMs() );
+    TEST_CHECK( PIPELINE_Drain( &pipeline ) == ECANCELED );
+    TEST_CHECK( UTIL_NowMs() - start < 1000 );
+
+    TEST_CHECK( hub.count == 0 );
+    TEST_CHECK( hub.attempts[1] == 0 );
+    Stop( &pipeline );
+}
+
+/*============================================================================*/
+/*  ResetHub                                                                  */
+/*!
+    Forget the messages received by the simulated hub
+
+==============================================================================*/
+static void ResetHub( void )
+{
+    pthread_mutex_lock( &hub.mutex );
+    hub.blockAt = -1;
+    hub.blocked = false;
+    hub.failAt = -1;
+    hub.failErr = EOK;
+    hub.failCount = 0;
+    hub.count = 0;
+    memset( hub.attempts, 0, sizeof( hub.attempts ) );
+    pthread_mutex_unlock( &hub.mutex );
+}
+
+/*============================================================================*/
+/*  FailAt                                                                    */
+/*!
+    Make the sends of a message fail
+
+    @param[in]
+        seq
+            sequence number of the message
+
+    @param[in]
+        err
+            error returned by the failed sends
+
+    @param[in]
+        count
+            number of sends which fail (UINT_MAX = all)
+
+==============================================================================*/
+static void FailAt( long seq, int err, unsigned int count )
+{
+    pthread_mutex_lock( &hub.mutex );
+    hub.failAt = seq;
+    hub.failErr = err;
+    hub.failCount = count;
+    pthread_mutex_unlock( &hub.mutex );
+}
+
+/*============================================================================*/
+/*  BlockAt                                                                   */
+/*!
+    Hold up the send of a message until it is released
+
+    @param[in]
+        seq
+            sequence number of the message
+
+==============================================================================*/
+static void BlockAt( long seq )
+{
+    pthread_mutex_lock( &hub.mutex );
+    hub.blockAt = seq;
+    pthread_mutex_unlock( &hub.mutex );
+}
+
+/*============================================================================*/
+/*  Release                                                                   */
+/*!
+    Release a send held up by BlockAt
+
+==============================================================================*/
+static void Release( void )
+{
+    pthread_mutex_lock( &hub.mutex );
+    hub.blockAt = -1;
+    pthread_cond_broadcast( &hub.cond );
+    pthread_mutex_unlock( &hub.mutex );
+}
+
+/*============================================================================*/
+/*  WaitAttempts                                                              */
+/*!
+    Wait for a number of sends of a message
+
+    @param[in]
+        seq
+            sequence number of the message
+
+    @param[in]
+        attempts
+            number of sends to wait for
+
+    @retval true the message was sent at least that many times
+    @retval false the sends did not happen in time
+
+==============================================================================*/
+static bool WaitAttempts( long seq, unsigned int attempts )
+{
+    uint64_t deadline = UTIL_NowMs() + 10000;
+    struct timespec ts;
+    bool ok;
+
+    pthread_mutex_lock( &hub.mutex );
+    while ( ( hub.attempts[seq] < attempts ) &&
+            ( UTIL_NowMs() < deadline ) )
+    {
+        clock_gettime( CLOCK_REALTIME, &ts );
+        ts.tv_sec++;
+        (void)pthread_cond_timedwait( &hub.cond, &hub.mutex, &ts );
+    }
+
+    ok = ( hub.attempts[seq] >= attempts );
+    pthread_mutex_unlock( &hub.mutex );
+
+    return ok;
+}
+
+/*============================================================================*/
+/*  HubSend                                                                   */
+/*!
+    Receive a message at the simulated hub
+
+    The HubSend function records the sequence number in the headers of
+    the message, unless the send is made to fail.
+
+    @param[in]
+        pArg
+            pointer to the TestHub
+
+    @param[in]
+        pHeaders
+            message headers
+
+    @param[in]
+        pBody
+            message payload
+
+    @param[in]
+        len
+            length of the message payload
+
+    @retval EOK the message was received
+    @retval other the error chosen for the message by FailAt
+
+==============================================================================*/
+static int HubSend( void *pArg,
+                    const char *pHeaders,
+                    const char *pBody,
+                    size_t len )
+{
+    TestHub *pHub = (TestHub *)pArg;
+    long seq = -1;
+    int result = EOK;
+
+    (void)pBody;
+    (void)len;
+
+    if ( strncmp( pHeaders, "seq:", 4 ) == 0 )
+    {
+        seq = strtol( &pHeaders[4], NULL, 10 );
+    }
+
+    pthread_mutex_lock( &pHub->mutex );
+
+    while ( ( pHub->blockAt != -1 ) && ( pHub->blockAt == seq ) )
+    {
+        pHub->blocked = true;
+        pthread_cond_broadcast( &pHub->cond );
+        pthread_cond_wait( &pHub->cond, &pHub->mutex );
+    }
+
+    if ( ( seq >= 0 ) && ( seq < TEST_MAX_MESSAGES ) )
+    {
+        pHub->attempts[seq]++;
+        pthread_cond_broadcast( &pHub->cond );
+    }
+
+    if ( ( seq == pHub->failAt ) && ( pHub->failCount > 0 ) )
+    {
+        if ( pHub->failCount != UINT_MAX )
+        {
+            pHub->failCount--;
+        }
+
+        result = pHub->failErr;
+    }
+    else if ( pHub->count < TEST_MAX_MESSAGES )
+    {
+        pHub->seq[pHub->count++] = seq;
+    }
+
+    pthread_mutex_unlock( &pHub->mutex );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Start                                                                     */
+/*!
+    Start a test pipeline on a new mock connection
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        lanes
+            number of priority lanes
+
+    @param[in]
+        ordered
+            retry the messages in place to keep them in order
+
+    @param[in]
+        maxAttempts
+            maximum number of attempts of each message (0 = unlimited)
+
+    @param[in]
+        delayMs
+            delay between the retries in milliseconds
+
+    @retval EOK the pipeline was started
+    @retval other error from PIPELINE_Init
+
+==============================================================================*/
+static int Start( Pipeline *pPipeline,
+                  size_t lanes,
+                  bool ordered,
+                  unsigned int maxAttempts,
+                  unsigned int delayMs )
+{
+    RetryPolicy retry;
+
+    /* a base delay of the cap makes every delay at most the cap */
+    retry.maxAttempts = maxAttempts;
+    retry.baseMs = delayMs;
+    retry.capMs = delayMs;
+
+    return PIPELINE_Init( pPipeline,
+                          IOTCLIENT_Create(),
+                          TEST_DEPTH,
+                          lanes,
+                          TEST_BUF_SIZE,
+                          TEST_BUF_SIZE,
+                          false,
+                          &retry,
+                          ordered );
+}
+
+/*============================================================================*/
+/*  Stop                                                                      */
+/*!
+    Shut down a test pipeline and close its mock connection
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+==============================================================================*/
+static void Stop( Pipeline *pPipeline )
+{
+    (void)PIPELINE_Shutdown( pPipeline );
+    IOTCLIENT_Close( pPipeline->hIoTClient );
+}
+
+/*============================================================================*/
+/*  Submit                                                                    */
+/*!
+    Submit a numbered message
+
+    @param[in]
+        pPipeline
+            pointer to the pipeline
+
+    @param[in]
+        lane
+            PIPELINE_LANE_HIGH or PIPELINE_LANE_NORMAL
+
+    @param[in]
+        seq
+            sequence number of the message
+
+    @retval result of PIPELINE_Submit
+
+==============================================================================*/
+static int Submit( Pipeline *pPipeline, size_t lane, long seq )
+{
+    char headers[32];
+    char payload[32];
+
+    snprintf( headers, sizeof( headers ), "seq:%ld", seq );
+    snprintf( payload, sizeof( payload ), "%ld", seq );
+
+    return PIPELINE_Submit( pPipeline,
+                            lane,
+                            headers,
+                            payload,
+                            strlen( payload ) );
+}
+
+/*============================================================================*/
+/*  Received                                                                  */
+/*!
+    Check the messages received by the simulated hub
+
+    @param[in]
+        pSeq
+            sequence numbers of the messages expected, in order
+
+    @param[in]
+        count
+            number of messages expected
+
+    @retval true the messages were received once each and in order
+    @retval false a message was lost, repeated or out of order
+
+==============================================================================*/
+static bool Received( const long *pSeq, size_t count )
+{
+    bool ok;
+    size_t i;
+
+    pthread_mutex_lock( &hub.mutex );
+
+    ok = ( hub.count == count );
+    for ( i = 0; ( ok == true ) && ( i < count ); i++ )
+    {
+        ok = ( hub.seq[i] == pSeq[i] );
+    }
+
+    if ( ok == false )
+    {
+        fprintf( stderr, "received %zu of %zu messages:", hub.count, count );
+        for ( i = 0; i < hub.count; i++ )
+        {
+            fprintf( stderr, " %ld", hub.seq[i] );
+        }
+
+        fprintf( stderr, "\n" );
+    }
+
+    pthread_mutex_unlock( &hub.mutex );
+
+    return ok;
+}
+
+/*! @}
+ * end of pipelinetest group */
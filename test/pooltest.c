@@ -0,0 +1,319 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup pooltest pooltest
+ * @brief Unit tests of the buffer pool
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file pooltest.c
+
+    Buffer Pool Unit Tests
+
+    The pooltest program checks that header buffers are carved from
+    slabs, that freed header and message buffers are reused, that larger
+    buffers are returned to the system, that the memory cap is enforced,
+    and that the pool gives its memory back at shutdown.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <iotclient/iotclient.h>
+#include "pool.h"
+#include "test.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of header buffers in each header slab */
+#define TEST_HEADERS_PER_SLAB   ( 16 )
+
+/*! size of a header slab including the cache line which links it */
+#define TEST_SLAB_SIZE \
+    ( POOL_ALIGN + ( TEST_HEADERS_PER_SLAB * POOL_HEADER_SIZE ) )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestHeaders( void );
+static void TestMessages( void );
+static void TestLarge( void );
+static void TestCap( void );
+static void TestInvalid( void );
+static bool Aligned( void *p );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the buffer pool unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "pool_headers", TestHeaders );
+    TEST_Run( "pool_messages", TestMessages );
+    TEST_Run( "pool_large", TestLarge );
+    TEST_Run( "pool_cap", TestCap );
+    TEST_Run( "pool_invalid", TestInvalid );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestHeaders                                                               */
+/*!
+    Check that header buffers are carved from slabs without overlapping,
+    that a new slab is only added when a slab is used up, and that freed
+    header buffers are reused
+
+==============================================================================*/
+static void TestHeaders( void )
+{
+    char *buffers[TEST_HEADERS_PER_SLAB + 1];
+    bool separate = true;
+    bool aligned = true;
+    char *p;
+    size_t i;
+    size_t j;
+
+    TEST_CHECK( POOL_Init( 0 ) == EOK );
+    TEST_CHECK( POOL_Used() == 0 );
+
+    for ( i = 0; i < TEST_HEADERS_PER_SLAB; i++ )
+    {
+        buffers[i] = POOL_Alloc( ( i == 0 ) ? 1 : POOL_HEADER_SIZE );
+        TEST_CHECK( buffers[i] != NULL );
+        aligned = aligned && Aligned( buffers[i] );
+        memset( buffers[i], (int)i, POOL_HEADER_SIZE );
+    }
+
+    TEST_CHECK( aligned == true );
+    TEST_CHECK( POOL_Used() == TEST_SLAB_SIZE );
+
+    /* each buffer still holds its own fill */
+    for ( i = 0; i < TEST_HEADERS_PER_SLAB; i++ )
+    {
+        for ( j = 0; j < POOL_HEADER_SIZE; j++ )
+        {
+            separate = separate && ( buffers[i][j] == (char)i );
+        }
+    }
+
+    TEST_CHECK( separate == true );
+
+    buffers[i] = POOL_Alloc( POOL_HEADER_SIZE );
+    TEST_CHECK( buffers[i] != NULL );
+    TEST_CHECK( POOL_Used() == 2 * TEST_SLAB_SIZE );
+
+    for ( i = 0; i <= TEST_HEADERS_PER_SLAB; i++ )
+    {
+        POOL_Free( buffers[i], POOL_HEADER_SIZE );
+    }
+
+    /* the last buffer freed is the first reused */
+    p = POOL_Alloc( 100 );
+    TEST_CHECK( p == buffers[TEST_HEADERS_PER_SLAB] );
+    POOL_Free( p, 100 );
+    TEST_CHECK( POOL_Used() == 2 * TEST_SLAB_SIZE );
+
+    POOL_Shutdown();
+    TEST_CHECK( POOL_Used() == 0 );
+}
+
+/*============================================================================*/
+/*  TestMessages                                                              */
+/*!
+    Check that a request larger than a header buffer takes a whole
+    message buffer, and that freed message buffers are reused
+
+==============================================================================*/
+static void TestMessages( void )
+{
+    char *p;
+    char *q;
+
+    TEST_CHECK( POOL_Init( 0 ) == EOK );
+
+    p = POOL_Alloc( POOL_HEADER_SIZE + 1 );
+    TEST_CHECK( ( p != NULL ) && Aligned( p ) );
+    TEST_CHECK( POOL_Used() == POOL_MESSAGE_SIZE );
+    memset( p, 0, POOL_MESSAGE_SIZE );
+
+    q = POOL_Alloc( POOL_MESSAGE_SIZE );
+    TEST_CHECK( ( q != NULL ) && ( q != p ) );
+    TEST_CHECK( POOL_Used() == 2 * POOL_MESSAGE_SIZE );
+
+    POOL_Free( p, POOL_HEADER_SIZE + 1 );
+    TEST_CHECK( POOL_Used() == 2 * POOL_MESSAGE_SIZE );
+    TEST_CHECK( POOL_Alloc( POOL_MESSAGE_SIZE ) == p );
+    TEST_CHECK( POOL_Used() == 2 * POOL_MESSAGE_SIZE );
+
+    POOL_Free( p, POOL_MESSAGE_SIZE );
+    POOL_Free( q, POOL_MESSAGE_SIZE );
+
+    POOL_Shutdown();
+    TEST_CHECK( POOL_Used() == 0 );
+}
+
+/*============================================================================*/
+/*  TestLarge                                                                 */
+/*!
+    Check that a buffer larger than a message buffer is taken from the
+    system and returned to it when it is freed
+
+==============================================================================*/
+static void TestLarge( void )
+{
+    size_t size = POOL_MESSAGE_SIZE + 1;
+    char *p;
+
+    TEST_CHECK( POOL_Init( 0 ) == EOK );
+
+    p = POOL_Alloc( size );
+    TEST_CHECK( ( p != NULL ) && Aligned( p ) );
+    TEST_CHECK( POOL_Used() == size );
+    memset( p, 0, size );
+
+    POOL_Free( p, size );
+    TEST_CHECK( POOL_Used() == 0 );
+
+    POOL_Shutdown();
+}
+
+/*============================================================================*/
+/*  TestCap                                                                   */
+/*!
+    Check that the memory cap limits the memory taken from the system
+    but not the reuse of the free buffers
+
+==============================================================================*/
+static void TestCap( void )
+{
+    char *p;
+    char *q;
+
+    TEST_CHECK( POOL_Init( POOL_MESSAGE_SIZE - 1 ) == EINVAL );
+    TEST_CHECK( POOL_Init( 2 * POOL_MESSAGE_SIZE ) == EOK );
+
+    p = POOL_Alloc( POOL_MESSAGE_SIZE );
+    q = POOL_Alloc( POOL_MESSAGE_SIZE );
+    TEST_CHECK( ( p != NULL ) && ( q != NULL ) );
+
+    errno = 0;
+    TEST_CHECK( POOL_Alloc( POOL_MESSAGE_SIZE ) == NULL );
+    TEST_CHECK( errno == ENOMEM );
+    TEST_CHECK( POOL_Alloc( 1 ) == NULL );
+    TEST_CHECK( POOL_Alloc( 2 * POOL_MESSAGE_SIZE ) == NULL );
+    TEST_CHECK( POOL_Used() == 2 * POOL_MESSAGE_SIZE );
+
+    POOL_Free( q, POOL_MESSAGE_SIZE );
+    TEST_CHECK( POOL_Alloc( POOL_MESSAGE_SIZE ) == q );
+
+    POOL_Free( p, POOL_MESSAGE_SIZE );
+    POOL_Free( q, POOL_MESSAGE_SIZE );
+    POOL_Shutdown();
+    TEST_CHECK( POOL_Used() == 0 );
+
+    /* a header slab fits once the message buffers are released */
+    p = POOL_Alloc( 1 );
+    TEST_CHECK( p != NULL );
+    POOL_Free( p, 1 );
+    POOL_Shutdown();
+
+    TEST_CHECK( POOL_Init( 0 ) == EOK );
+}
+
+/*============================================================================*/
+/*  TestInvalid                                                               */
+/*!
+    Check that an empty request is rejected and that freeing NULL has no
+    effect
+
+==============================================================================*/
+static void TestInvalid( void )
+{
+    TEST_CHECK( POOL_Init( 0 ) == EOK );
+
+    errno = 0;
+    TEST_CHECK( POOL_Alloc( 0 ) == NULL );
+    TEST_CHECK( errno == ENOMEM );
+
+    POOL_Free( NULL, POOL_HEADER_SIZE );
+    POOL_Free( NULL, POOL_MESSAGE_SIZE + 1 );
+    TEST_CHECK( POOL_Used() == 0 );
+}
+
+/*============================================================================*/
+/*  Aligned                                                                   */
+/*!
+    Check the alignment of a buffer
+
+    @param[in]
+        p
+            pointer to the buffer
+
+    @retval true the buffer is aligned to a cache line
+    @retval false the buffer is not aligned
+
+==============================================================================*/
+static bool Aligned( void *p )
+{
+    return ( (uintptr_t)p % POOL_ALIGN ) == 0;
+}
+
+/*! @}
+ * end of pooltest group */
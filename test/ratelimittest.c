@@ -0,0 +1,504 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup ratelimittest ratelimittest
+ * @brief Unit tests of the rate limiter
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file ratelimittest.c
+
+    Rate Limiter Unit Tests
+
+    The ratelimittest program checks the token bucket arithmetic of the
+    rate limiter: the burst of messages sent back to back, the pacing
+    of the messages and bytes after the burst, and oversized messages.
+    It also checks that a wait for tokens ends at the deadline, when
+    the deadline is set while waiting, and when a signal is received.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <iotclient/iotclient.h>
+#include "ratelimit.h"
+#include "util.h"
+#include "test.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of nanoseconds in a millisecond */
+#define NSEC_PER_MSEC       ( 1000000ull )
+
+/*! allowance for the scheduling of the test threads in nanoseconds */
+#define TEST_SLACK_NS       ( 200 * NSEC_PER_MSEC )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestDisabled( void );
+static void TestBurst( void );
+static void TestDefaultBurst( void );
+static void TestBytes( void );
+static void TestOversized( void );
+static void TestCombined( void );
+static void TestDeadline( void );
+static void TestSetDeadline( void );
+static void TestSignal( void );
+static bool IsDue( uint64_t due, uint64_t before, uint64_t after, uint64_t ms );
+static void *Acquirer( void *arg );
+static void OnSignal( int signum );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the rate limiter unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "ratelimit_disabled", TestDisabled );
+    TEST_Run( "ratelimit_burst", TestBurst );
+    TEST_Run( "ratelimit_default_burst", TestDefaultBurst );
+    TEST_Run( "ratelimit_bytes", TestBytes );
+    TEST_Run( "ratelimit_oversized", TestOversized );
+    TEST_Run( "ratelimit_combined", TestCombined );
+    TEST_Run( "ratelimit_deadline", TestDeadline );
+    TEST_Run( "ratelimit_set_deadline", TestSetDeadline );
+    TEST_Run( "ratelimit_signal", TestSignal );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestDisabled                                                              */
+/*!
+    Check that a rate limiter without rates never makes a sender wait
+
+==============================================================================*/
+static void TestDisabled( void )
+{
+    RateLimit rateLimit;
+    size_t i;
+
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 0, 0, 0 ) == EOK );
+    TEST_CHECK( rateLimit.enabled == false );
+
+    for ( i = 0; i < 1000; i++ )
+    {
+        TEST_CHECK( RATELIMIT_Reserve( &rateLimit, 1000000 ) == 0 );
+    }
+
+    TEST_CHECK( RATELIMIT_Acquire( &rateLimit, 1000000 ) == EOK );
+    RATELIMIT_Free( &rateLimit );
+
+    TEST_CHECK( RATELIMIT_Acquire( NULL, 1000000 ) == EOK );
+    TEST_CHECK( RATELIMIT_Init( NULL, 1, 1, 1 ) == EINVAL );
+}
+
+/*============================================================================*/
+/*  TestBurst                                                                 */
+/*!
+    Check that a burst of messages is available at once, and that the
+    messages after the burst are paced at the message rate
+
+==============================================================================*/
+static void TestBurst( void )
+{
+    RateLimit rateLimit;
+    uint64_t before;
+    uint64_t after;
+    uint64_t due[7];
+    size_t i;
+
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 10, 0, 5 ) == EOK );
+
+    before = UTIL_NowNs();
+    for ( i = 0; i < 7; i++ )
+    {
+        due[i] = RATELIMIT_Reserve( &rateLimit, 100 );
+    }
+    after = UTIL_NowNs();
+
+    for ( i = 0; i < 5; i++ )
+    {
+        TEST_CHECK( IsDue( due[i], before, after, 0 ) == true );
+    }
+
+    TEST_CHECK( IsDue( due[5], before, after, 100 ) == true );
+    TEST_CHECK( IsDue( due[6], before, after, 200 ) == true );
+
+    RATELIMIT_Free( &rateLimit );
+}
+
+/*============================================================================*/
+/*  TestDefaultBurst                                                          */
+/*!
+    Check that the burst defaults to one second of messages
+
+==============================================================================*/
+static void TestDefaultBurst( void )
+{
+    RateLimit rateLimit;
+    uint64_t before;
+    uint64_t after;
+    uint64_t due[5];
+    size_t i;
+
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 4, 0, 0 ) == EOK );
+
+    before = UTIL_NowNs();
+    for ( i = 0; i < 5; i++ )
+    {
+        due[i] = RATELIMIT_Reserve( &rateLimit, 0 );
+    }
+    after = UTIL_NowNs();
+
+    for ( i = 0; i < 4; i++ )
+    {
+        TEST_CHECK( IsDue( due[i], before, after, 0 ) == true );
+    }
+
+    TEST_CHECK( IsDue( due[4], before, after, 250 ) == true );
+
+    RATELIMIT_Free( &rateLimit );
+}
+
+/*============================================================================*/
+/*  TestBytes                                                                 */
+/*!
+    Check that one second of bytes is available at once, and that the
+    following bytes are paced at the byte rate
+
+==============================================================================*/
+static void TestBytes( void )
+{
+    RateLimit rateLimit;
+    uint64_t before;
+    uint64_t after;
+    uint64_t due[4];
+    size_t i;
+
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 0, 1000, 0 ) == EOK );
+
+    before = UTIL_NowNs();
+    for ( i = 0; i < 4; i++ )
+    {
+        due[i] = RATELIMIT_Reserve( &rateLimit, 500 );
+    }
+    after = UTIL_NowNs();
+
+    TEST_CHECK( IsDue( due[0], before, after, 0 ) == true );
+    TEST_CHECK( IsDue( due[1], before, after, 0 ) == true );
+    TEST_CHECK( IsDue( due[2], before, after, 500 ) == true );
+    TEST_CHECK( IsDue( due[3], before, after, 1000 ) == true );
+
+    RATELIMIT_Free( &rateLimit );
+}
+
+/*============================================================================*/
+/*  TestOversized                                                             */
+/*!
+    Check that a message bigger than the byte bucket waits until the
+    bucket has been refilled by the excess
+
+==============================================================================*/
+static void TestOversized( void )
+{
+    RateLimit rateLimit;
+    uint64_t before;
+    uint64_t after;
+    uint64_t due;
+
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 0, 1000, 0 ) == EOK );
+
+    before = UTIL_NowNs();
+    due = RATELIMIT_Reserve( &rateLimit, 3000 );
+    after = UTIL_NowNs();
+
+    TEST_CHECK( IsDue( due, before, after, 2000 ) == true );
+
+    RATELIMIT_Free( &rateLimit );
+}
+
+/*============================================================================*/
+/*  TestCombined                                                              */
+/*!
+    Check that a message waits for the later of its message token and
+    its byte tokens
+
+==============================================================================*/
+static void TestCombined( void )
+{
+    RateLimit rateLimit;
+    uint64_t before;
+    uint64_t after;
+    uint64_t due[3];
+
+    /* the message bucket is the limit */
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 2, 1000000, 1 ) == EOK );
+    before = UTIL_NowNs();
+    due[0] = RATELIMIT_Reserve( &rateLimit, 10 );
+    due[1] = RATELIMIT_Reserve( &rateLimit, 10 );
+    after = UTIL_NowNs();
+    TEST_CHECK( IsDue( due[0], before, after, 0 ) == true );
+    TEST_CHECK( IsDue( due[1], before, after, 500 ) == true );
+    RATELIMIT_Free( &rateLimit );
+
+    /* the byte bucket is the limit */
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 1000, 100, 0 ) == EOK );
+    before = UTIL_NowNs();
+    due[0] = RATELIMIT_Reserve( &rateLimit, 100 );
+    due[1] = RATELIMIT_Reserve( &rateLimit, 50 );
+    due[2] = RATELIMIT_Reserve( &rateLimit, 50 );
+    after = UTIL_NowNs();
+    TEST_CHECK( IsDue( due[0], before, after, 0 ) == true );
+    TEST_CHECK( IsDue( due[1], before, after, 500 ) == true );
+    TEST_CHECK( IsDue( due[2], before, after, 1000 ) == true );
+    RATELIMIT_Free( &rateLimit );
+}
+
+/*============================================================================*/
+/*  TestDeadline                                                              */
+/*!
+    Check that a sender stops waiting for its tokens at the deadline
+
+==============================================================================*/
+static void TestDeadline( void )
+{
+    RateLimit rateLimit;
+    uint64_t start;
+    uint64_t elapsed;
+
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 1, 0, 1 ) == EOK );
+    TEST_CHECK( RATELIMIT_Acquire( &rateLimit, 0 ) == EOK );
+
+    /* the next token is due in one second */
+    start = UTIL_NowNs();
+    RATELIMIT_SetDeadline( &rateLimit, UTIL_NowMs() + 50 );
+    TEST_CHECK( RATELIMIT_Acquire( &rateLimit, 0 ) == ETIMEDOUT );
+    elapsed = UTIL_NowNs() - start;
+    TEST_CHECK( elapsed >= 40 * NSEC_PER_MSEC );
+    TEST_CHECK( elapsed < 50 * NSEC_PER_MSEC + TEST_SLACK_NS );
+
+    /* once the deadline has passed a sender does not wait */
+    start = UTIL_NowNs();
+    TEST_CHECK( RATELIMIT_Acquire( &rateLimit, 0 ) == ETIMEDOUT );
+    TEST_CHECK( UTIL_NowNs() - start < TEST_SLACK_NS );
+
+    /* tokens due before the deadline are still waited for */
+    RATELIMIT_Free( &rateLimit );
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 20, 0, 1 ) == EOK );
+    RATELIMIT_SetDeadline( &rateLimit, UTIL_NowMs() + 10000 );
+    TEST_CHECK( RATELIMIT_Acquire( &rateLimit, 0 ) == EOK );
+    start = UTIL_NowNs();
+    TEST_CHECK( RATELIMIT_Acquire( &rateLimit, 0 ) == EOK );
+    TEST_CHECK( UTIL_NowNs() - start >= 40 * NSEC_PER_MSEC );
+
+    RATELIMIT_Free( &rateLimit );
+}
+
+/*============================================================================*/
+/*  TestSetDeadline                                                           */
+/*!
+    Check that setting the deadline wakes a sender already waiting for
+    its tokens
+
+==============================================================================*/
+static void TestSetDeadline( void )
+{
+    RateLimit rateLimit;
+    pthread_t thread;
+    void *pResult = NULL;
+    uint64_t start;
+
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 1, 0, 1 ) == EOK );
+    TEST_CHECK( RATELIMIT_Acquire( &rateLimit, 0 ) == EOK );
+
+    start = UTIL_NowNs();
+    TEST_CHECK( pthread_create( &thread, NULL, Acquirer, &rateLimit ) == 0 );
+
+    /* let the sender start waiting for the token due in one second */
+    usleep( 20000 );
+    RATELIMIT_SetDeadline( &rateLimit, UTIL_NowMs() );
+
+    pthread_join( thread, &pResult );
+    TEST_CHECK( (intptr_t)pResult == ETIMEDOUT );
+    TEST_CHECK( UTIL_NowNs() - start < 20 * NSEC_PER_MSEC + TEST_SLACK_NS );
+
+    RATELIMIT_Free( &rateLimit );
+}
+
+/*============================================================================*/
+/*  TestSignal                                                                */
+/*!
+    Check that a signal ends a wait with a signal mask, and that the
+    reserved tokens can then be waited for again
+
+==============================================================================*/
+static void TestSignal( void )
+{
+    RateLimit rateLimit;
+    struct sigaction sa;
+    sigset_t blocked;
+    sigset_t old;
+    sigset_t mask;
+    uint64_t start;
+    uint64_t due;
+
+    memset( &sa, 0, sizeof( sa ) );
+    sa.sa_handler = OnSignal;
+    TEST_CHECK( sigaction( SIGUSR1, &sa, NULL ) == 0 );
+
+    sigemptyset( &blocked );
+    sigaddset( &blocked, SIGUSR1 );
+    pthread_sigmask( SIG_BLOCK, &blocked, &old );
+    mask = old;
+    sigdelset( &mask, SIGUSR1 );
+
+    TEST_CHECK( RATELIMIT_Init( &rateLimit, 1, 0, 1 ) == EOK );
+    TEST_CHECK( RATELIMIT_Acquire( &rateLimit, 0 ) == EOK );
+
+    /* the pending signal is received as soon as the wait starts */
+    start = UTIL_NowNs();
+    due = RATELIMIT_Reserve( &rateLimit, 0 );
+    raise( SIGUSR1 );
+    TEST_CHECK( RATELIMIT_Wait( &rateLimit, due, &mask ) == EINTR );
+    TEST_CHECK( UTIL_NowNs() - start < TEST_SLACK_NS );
+
+    /* the deadline ends the next wait for the same tokens */
+    RATELIMIT_SetDeadline( &rateLimit, UTIL_NowMs() + 20 );
+    TEST_CHECK( RATELIMIT_Wait( &rateLimit, due, &mask ) == ETIMEDOUT );
+    TEST_CHECK( UTIL_NowNs() - start < 20 * NSEC_PER_MSEC + TEST_SLACK_NS );
+
+    /* tokens which are already due are available */
+    TEST_CHECK( RATELIMIT_Wait( &rateLimit, start, &mask ) == EOK );
+
+    RATELIMIT_Free( &rateLimit );
+    pthread_sigmask( SIG_SETMASK, &old, NULL );
+}
+
+/*============================================================================*/
+/*  IsDue                                                                     */
+/*!
+    Check the time at which reserved tokens are available
+
+    @param[in]
+        due
+            time returned by RATELIMIT_Reserve
+
+    @param[in]
+        before
+            monotonic time in nanoseconds before the tokens were reserved
+
+    @param[in]
+        after
+            monotonic time in nanoseconds after the tokens were reserved
+
+    @param[in]
+        ms
+            expected delay in milliseconds from the time of the reservation
+
+    @retval true the tokens are available after the expected delay
+    @retval false the tokens are available at a different time
+
+==============================================================================*/
+static bool IsDue( uint64_t due, uint64_t before, uint64_t after, uint64_t ms )
+{
+    return ( due >= before + ms * NSEC_PER_MSEC ) &&
+           ( due <= after + ms * NSEC_PER_MSEC );
+}
+
+/*============================================================================*/
+/*  Acquirer                                                                  */
+/*!
+    Wait for a message token
+
+    @param[in]
+        arg
+            pointer to the RateLimit
+
+    @retval result of RATELIMIT_Acquire
+
+==============================================================================*/
+static void *Acquirer( void *arg )
+{
+    return (void *)(intptr_t)RATELIMIT_Acquire( (RateLimit *)arg, 0 );
+}
+
+/*============================================================================*/
+/*  OnSignal                                                                  */
+/*!
+    Handle the test signal
+
+    The handler does nothing: receiving the signal ends the wait.
+
+    @param[in]
+        signum
+            signal number
+
+==============================================================================*/
+static void OnSignal( int signum )
+{
+    (void)signum;
+}
+
+/*! @}
+ * end of ratelimittest group */
@@ -0,0 +1,227 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup readertest readertest
+ * @brief Unit tests of the record reader
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file readertest.c
+
+    Record Reader Unit Tests
+
+    The readertest program checks that the record reader splits a
+    stream into delimited records, including empty records, an
+    unterminated final record and records which do not fit in the
+    input buffer.  The input is written to a pipe which is closed
+    before it is read.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <iotclient/iotclient.h>
+#include "reader.h"
+#include "test.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestRecords( void );
+static void TestSplitRecord( void );
+static int Input( const void *pData, size_t len );
+static bool IsRecord( RecordReader *pReader, int expected, const char *pText );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the record reader unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "reader_records", TestRecords );
+    TEST_Run( "reader_split_record", TestSplitRecord );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestRecords                                                               */
+/*!
+    Check that delimited records are returned in order, including empty
+    records and an unterminated final record
+
+==============================================================================*/
+static void TestRecords( void )
+{
+    static const char input[] = "one\ntwo\n\nthree";
+    RecordReader reader;
+    int fd = Input( input, strlen( input ) );
+
+    TEST_CHECK( fd != -1 );
+    TEST_CHECK( READER_Init( &reader, fd, '\n', 64 ) == EOK );
+
+    TEST_CHECK( IsRecord( &reader, EOK, "one" ) == true );
+    TEST_CHECK( IsRecord( &reader, EOK, "two" ) == true );
+    TEST_CHECK( IsRecord( &reader, EOK, "" ) == true );
+    TEST_CHECK( IsRecord( &reader, EOK, "three" ) == true );
+    TEST_CHECK( IsRecord( &reader, ENODATA, NULL ) == true );
+
+    READER_Free( &reader );
+    close( fd );
+}
+
+/*============================================================================*/
+/*  TestSplitRecord                                                           */
+/*!
+    Check that a record which does not fit in the input buffer is
+    returned in parts, and that the following records are not affected
+
+==============================================================================*/
+static void TestSplitRecord( void )
+{
+    static const char input[] = "0123456789AB\nxy\n";
+    RecordReader reader;
+    int fd = Input( input, strlen( input ) );
+
+    TEST_CHECK( fd != -1 );
+    TEST_CHECK( READER_Init( &reader, fd, '\n', 8 ) == EOK );
+
+    TEST_CHECK( IsRecord( &reader, E2BIG, "01234567" ) == true );
+    TEST_CHECK( IsRecord( &reader, EOK, "89AB" ) == true );
+    TEST_CHECK( IsRecord( &reader, EOK, "xy" ) == true );
+    TEST_CHECK( IsRecord( &reader, ENODATA, NULL ) == true );
+
+    READER_Free( &reader );
+    close( fd );
+}
+
+/*============================================================================*/
+/*  Input                                                                     */
+/*!
+    Create an input stream holding the given data
+
+    @param[in]
+        pData
+            pointer to the input data
+
+    @param[in]
+        len
+            length of the input data, which must fit in a pipe
+
+    @retval file descriptor of the read end of a closed pipe
+    @retval -1 the pipe could not be created
+
+==============================================================================*/
+static int Input( const void *pData, size_t len )
+{
+    int fds[2];
+    int fd = -1;
+
+    if ( pipe( fds ) == 0 )
+    {
+        if ( write( fds[1], pData, len ) == (ssize_t)len )
+        {
+            fd = fds[0];
+        }
+        else
+        {
+            close( fds[0] );
+        }
+
+        close( fds[1] );
+    }
+
+    return fd;
+}
+
+/*============================================================================*/
+/*  IsRecord                                                                  */
+/*!
+    Check the next record from a record reader
+
+    @param[in]
+        pReader
+            pointer to the record reader
+
+    @param[in]
+        expected
+            expected result of READER_Next
+
+    @param[in]
+        pText
+            expected record, or NULL if no record is expected
+
+    @retval true the expected result and record were returned
+    @retval false a different result or record was returned
+
+==============================================================================*/
+static bool IsRecord( RecordReader *pReader, int expected, const char *pText )
+{
+    char *pRecord = NULL;
+    size_t len = 0;
+    int result;
+
+    result = READER_Next( pReader, &pRecord, &len );
+
+    return ( result == expected ) &&
+           ( ( pText == NULL ) ||
+             ( ( len == strlen( pText ) ) &&
+               ( memcmp( pRecord, pText, len ) == 0 ) ) );
+}
+
+/*! @}
+ * end of readertest group */
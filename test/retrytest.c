@@ -0,0 +1,313 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup retrytest retrytest
+ * @brief Unit tests of the retry policy
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file retrytest.c
+
+    Retry Policy Unit Tests
+
+    The retrytest program checks that the retry policy retries the
+    transient errors and not the fatal ones, that it stops once the
+    attempts are used up, and that the jittered retry delays stay
+    within the exponential backoff and its cap.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <iotclient/iotclient.h>
+#include "retry.h"
+#include "test.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of delays drawn for each attempt by the delay tests */
+#define TEST_DRAWS          ( 1000 )
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestClassification( void );
+static void TestAttempts( void );
+static void TestDelayBounds( void );
+static void TestDelayCap( void );
+static void TestDelaySeed( void );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the retry policy unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "retry_classification", TestClassification );
+    TEST_Run( "retry_attempts", TestAttempts );
+    TEST_Run( "retry_delay_bounds", TestDelayBounds );
+    TEST_Run( "retry_delay_cap", TestDelayCap );
+    TEST_Run( "retry_delay_seed", TestDelaySeed );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestClassification                                                        */
+/*!
+    Check that transient errors are retried and fatal errors are not
+
+==============================================================================*/
+static void TestClassification( void )
+{
+    static const int transient[] =
+    {
+        EAGAIN, EINTR, EBUSY, EIO, ENOBUFS, ETIMEDOUT, ECONNREFUSED,
+        ECONNRESET, ECONNABORTED, ENOTCONN, EPIPE, ENETDOWN,
+        ENETUNREACH, ENETRESET, EHOSTDOWN, EHOSTUNREACH
+    };
+    static const int fatal[] =
+    {
+        EINVAL, E2BIG, EPERM, EACCES, ENOENT, ENOMEM, EMSGSIZE,
+        EBADMSG, ECANCELED, ENOTSUP
+    };
+    RetryPolicy policy;
+    size_t i;
+
+    RETRY_Init( &policy );
+
+    for ( i = 0; i < sizeof( transient ) / sizeof( transient[0] ); i++ )
+    {
+        TEST_CHECK( RETRY_IsRetryable( transient[i] ) == true );
+        TEST_CHECK( RETRY_ShouldRetry( &policy, transient[i], 1 ) == true );
+    }
+
+    for ( i = 0; i < sizeof( fatal ) / sizeof( fatal[0] ); i++ )
+    {
+        TEST_CHECK( RETRY_IsRetryable( fatal[i] ) == false );
+        TEST_CHECK( RETRY_ShouldRetry( &policy, fatal[i], 1 ) == false );
+    }
+
+    /* a successful attempt is never retried */
+    TEST_CHECK( RETRY_IsRetryable( EOK ) == false );
+    TEST_CHECK( RETRY_ShouldRetry( &policy, EOK, 1 ) == false );
+    TEST_CHECK( RETRY_ShouldRetry( NULL, EIO, 1 ) == false );
+}
+
+/*============================================================================*/
+/*  TestAttempts                                                              */
+/*!
+    Check that a failed operation is retried until its attempts are used
+    up, or without limit when the number of attempts is 0
+
+==============================================================================*/
+static void TestAttempts( void )
+{
+    RetryPolicy policy;
+
+    RETRY_Init( &policy );
+    TEST_CHECK( policy.maxAttempts == RETRY_DEFAULT_ATTEMPTS );
+    TEST_CHECK( policy.baseMs == RETRY_DEFAULT_BASE_MS );
+    TEST_CHECK( policy.capMs == RETRY_DEFAULT_CAP_MS );
+
+    policy.maxAttempts = 3;
+    TEST_CHECK( RETRY_ShouldRetry( &policy, ECONNRESET, 1 ) == true );
+    TEST_CHECK( RETRY_ShouldRetry( &policy, ECONNRESET, 2 ) == true );
+    TEST_CHECK( RETRY_ShouldRetry( &policy, ECONNRESET, 3 ) == false );
+
+    /* a single attempt is never retried */
+    policy.maxAttempts = 1;
+    TEST_CHECK( RETRY_ShouldRetry( &policy, ECONNRESET, 1 ) == false );
+
+    policy.maxAttempts = 0;
+    TEST_CHECK( RETRY_ShouldRetry( &policy, ECONNRESET, 1000000 ) == true );
+    TEST_CHECK( RETRY_ShouldRetry( &policy, EINVAL, 1 ) == false );
+}
+
+/*============================================================================*/
+/*  TestDelayBounds                                                           */
+/*!
+    Check that each retry delay is at most the exponential backoff for
+    its attempt, and that the delays spread over the backoff
+
+==============================================================================*/
+static void TestDelayBounds( void )
+{
+    RetryPolicy policy;
+    uint64_t seed = 1;
+    unsigned int attempts;
+    unsigned int backoff;
+    unsigned int delay;
+    unsigned int max;
+    bool inRange;
+    size_t i;
+
+    policy.maxAttempts = 0;
+    policy.baseMs = 100;
+    policy.capMs = 100000;
+
+    for ( attempts = 1; attempts <= 8; attempts++ )
+    {
+        backoff = policy.baseMs << ( attempts - 1 );
+        inRange = true;
+        max = 0;
+
+        for ( i = 0; i < TEST_DRAWS; i++ )
+        {
+            delay = RETRY_Delay( &policy, attempts, &seed );
+            if ( delay > backoff )
+            {
+                inRange = false;
+            }
+
+            if ( delay > max )
+            {
+                max = delay;
+            }
+        }
+
+        TEST_CHECK( inRange == true );
+
+        /* full jitter: the delays reach the top half of the backoff */
+        TEST_CHECK( max > backoff / 2 );
+    }
+
+    TEST_CHECK( RETRY_Delay( NULL, 1, &seed ) == 0 );
+    TEST_CHECK( RETRY_Delay( &policy, 1, NULL ) == 0 );
+}
+
+/*============================================================================*/
+/*  TestDelayCap                                                              */
+/*!
+    Check that the retry delays never exceed the cap, however many
+    attempts were made
+
+==============================================================================*/
+static void TestDelayCap( void )
+{
+    RetryPolicy policy;
+    uint64_t seed = 12345;
+    unsigned int attempts;
+    bool capped = true;
+    size_t i;
+
+    policy.maxAttempts = 0;
+    policy.baseMs = 100;
+    policy.capMs = 250;
+
+    for ( attempts = 1; attempts <= 100; attempts++ )
+    {
+        for ( i = 0; i < TEST_DRAWS / 10; i++ )
+        {
+            if ( RETRY_Delay( &policy, attempts, &seed ) > policy.capMs )
+            {
+                capped = false;
+            }
+        }
+    }
+
+    TEST_CHECK( capped == true );
+
+    /* a zero delay policy retries straight away */
+    policy.baseMs = 0;
+    policy.capMs = 0;
+    TEST_CHECK( RETRY_Delay( &policy, 3, &seed ) == 0 );
+}
+
+/*============================================================================*/
+/*  TestDelaySeed                                                             */
+/*!
+    Check that the retry delays follow the seed of the caller, so each
+    thread draws its own sequence
+
+==============================================================================*/
+static void TestDelaySeed( void )
+{
+    RetryPolicy policy;
+    uint64_t seed1 = 42;
+    uint64_t seed2 = 42;
+    uint64_t seed3 = 43;
+    bool same = true;
+    bool different = false;
+    unsigned int delay;
+    size_t i;
+
+    RETRY_Init( &policy );
+    policy.capMs = 100000;
+
+    for ( i = 0; i < 100; i++ )
+    {
+        delay = RETRY_Delay( &policy, 10, &seed1 );
+        if ( delay != RETRY_Delay( &policy, 10, &seed2 ) )
+        {
+            same = false;
+        }
+
+        if ( delay != RETRY_Delay( &policy, 10, &seed3 ) )
+        {
+            different = true;
+        }
+    }
+
+    TEST_CHECK( same == true );
+    TEST_CHECK( different == true );
+    TEST_CHECK( RETRY_Seed() != 0 );
+}
+
+/*! @}
+ * end of retrytest group */
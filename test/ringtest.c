@@ -0,0 +1,400 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup ringtest ringtest
+ * @brief Unit tests of the lock-free ring
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file ringtest.c
+
+    Ring Unit Tests
+
+    The ringtest program checks that the single producer / single
+    consumer ring passes every published slot to the consumer exactly
+    once and in order, that the consumer only sees the end of the ring
+    once the slots published before the stop have been taken, and that
+    the producer can wait for the consumer to empty the ring, and that
+    several rings are served in priority order.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <iotclient/iotclient.h>
+#include "ring.h"
+#include "test.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! number of slots of the test rings */
+#define TEST_DEPTH          ( 8 )
+
+/*! number of values passed through the ring by the order test */
+#define TEST_COUNT          ( 200000 )
+
+/*! number of times the stop race is run */
+#define TEST_STOP_RUNS      ( 2000 )
+
+/*! ring and the slots it coordinates */
+typedef struct _TestRing
+{
+    /*! ring coordinating the slots */
+    Ring ring;
+
+    /*! slot values */
+    uint64_t slots[TEST_DEPTH];
+
+    /*! number of values to publish */
+    uint64_t count;
+
+    /*! number of slots taken by the consumer */
+    uint64_t taken;
+
+} TestRing;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestOrder( void );
+static void TestStopRace( void );
+static void TestPublishedBeforeStop( void );
+static void TestPriority( void );
+static void TestTimeout( void );
+static void TestWaitEmpty( void );
+static void *Producer( void *arg );
+static void *Consumer( void *arg );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the ring unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "ring_order", TestOrder );
+    TEST_Run( "ring_stop_race", TestStopRace );
+    TEST_Run( "ring_published_before_stop", TestPublishedBeforeStop );
+    TEST_Run( "ring_priority", TestPriority );
+    TEST_Run( "ring_timeout", TestTimeout );
+    TEST_Run( "ring_wait_empty", TestWaitEmpty );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestOrder                                                                 */
+/*!
+    Check that the consumer takes every value once and in order
+
+==============================================================================*/
+static void TestOrder( void )
+{
+    TestRing test;
+    pthread_t thread;
+    uint64_t expected = 0;
+    bool inOrder = true;
+    size_t idx;
+
+    TEST_CHECK( RING_Init( &test.ring, TEST_DEPTH ) == EOK );
+    test.count = TEST_COUNT;
+
+    TEST_CHECK( pthread_create( &thread, NULL, Producer, &test ) == 0 );
+
+    while ( RING_Peek( &test.ring, &idx ) == EOK )
+    {
+        if ( test.slots[idx] != expected )
+        {
+            inOrder = false;
+        }
+
+        expected++;
+        RING_Release( &test.ring );
+    }
+
+    pthread_join( thread, NULL );
+
+    TEST_CHECK( inOrder == true );
+    TEST_CHECK( expected == TEST_COUNT );
+    TEST_CHECK( RING_Count( &test.ring ) == 0 );
+
+    RING_Free( &test.ring );
+}
+
+/*============================================================================*/
+/*  TestStopRace                                                              */
+/*!
+    Check that a slot published just before the stop is not lost
+
+    The consumer is waiting on an empty ring when the producer publishes
+    a slot and stops straight away, so the stop races with the slot.
+
+==============================================================================*/
+static void TestStopRace( void )
+{
+    TestRing test;
+    pthread_t thread;
+    size_t lost = 0;
+    size_t run;
+
+    for ( run = 0; run < TEST_STOP_RUNS; run++ )
+    {
+        TEST_CHECK( RING_Init( &test.ring, TEST_DEPTH ) == EOK );
+        test.taken = 0;
+
+        TEST_CHECK( pthread_create( &thread, NULL, Consumer, &test ) == 0 );
+
+        test.slots[RING_Acquire( &test.ring )] = run;
+        RING_Publish( &test.ring );
+        RING_Stop( &test.ring );
+
+        pthread_join( thread, NULL );
+        if ( test.taken != 1 )
+        {
+            lost++;
+        }
+
+        RING_Free( &test.ring );
+    }
+
+    TEST_CHECK( lost == 0 );
+}
+
+/*============================================================================*/
+/*  TestPublishedBeforeStop                                                   */
+/*!
+    Check that the slots published before the stop are taken before the
+    end of the ring is reported
+
+==============================================================================*/
+static void TestPublishedBeforeStop( void )
+{
+    Ring ring;
+    size_t idx;
+    size_t i;
+
+    TEST_CHECK( RING_Init( &ring, TEST_DEPTH ) == EOK );
+
+    for ( i = 0; i < 3; i++ )
+    {
+        (void)RING_Acquire( &ring );
+        RING_Publish( &ring );
+    }
+
+    RING_Stop( &ring );
+
+    for ( i = 0; i < 3; i++ )
+    {
+        TEST_CHECK( RING_Peek( &ring, &idx ) == EOK );
+        TEST_CHECK( idx == i );
+        RING_Release( &ring );
+    }
+
+    TEST_CHECK( RING_Peek( &ring, &idx ) == ENODATA );
+
+    RING_Free( &ring );
+}
+
+/*============================================================================*/
+/*  TestPriority                                                              */
+/*!
+    Check that several rings are served in priority order
+
+==============================================================================*/
+static void TestPriority( void )
+{
+    Ring rings[2];
+    size_t ring;
+    size_t idx;
+
+    TEST_CHECK( RING_Init( &rings[0], TEST_DEPTH ) == EOK );
+    TEST_CHECK( RING_Init( &rings[1], TEST_DEPTH ) == EOK );
+    TEST_CHECK( RING_ShareEvent( &rings[1], &rings[0] ) == EOK );
+
+    /* the low priority slot is published first */
+    (void)RING_Acquire( &rings[1] );
+    RING_Publish( &rings[1] );
+    (void)RING_Acquire( &rings[0] );
+    RING_Publish( &rings[0] );
+
+    TEST_CHECK( RING_PeekFirst( rings, 2, &ring, &idx, -1 ) == EOK );
+    TEST_CHECK( ring == 0 );
+    RING_Release( &rings[0] );
+
+    TEST_CHECK( RING_PeekFirst( rings, 2, &ring, &idx, -1 ) == EOK );
+    TEST_CHECK( ring == 1 );
+    RING_Release( &rings[1] );
+
+    RING_Stop( &rings[0] );
+    RING_Stop( &rings[1] );
+    TEST_CHECK( RING_PeekFirst( rings, 2, &ring, &idx, -1 ) == ENODATA );
+
+    /* the owner of the shared event is freed last */
+    RING_Free( &rings[1] );
+    RING_Free( &rings[0] );
+}
+
+/*============================================================================*/
+/*  TestTimeout                                                               */
+/*!
+    Check that waiting on an empty ring times out
+
+==============================================================================*/
+static void TestTimeout( void )
+{
+    Ring ring;
+    size_t idx;
+
+    TEST_CHECK( RING_Init( &ring, TEST_DEPTH ) == EOK );
+    TEST_CHECK( RING_PeekTimeout( &ring, &idx, 10 ) == ETIMEDOUT );
+    TEST_CHECK( RING_Count( &ring ) == 0 );
+
+    RING_Free( &ring );
+}
+
+/*============================================================================*/
+/*  TestWaitEmpty                                                             */
+/*!
+    Check that the producer waits until the consumer has released every
+    slot
+
+==============================================================================*/
+static void TestWaitEmpty( void )
+{
+    TestRing test;
+    pthread_t thread;
+    size_t i;
+
+    TEST_CHECK( RING_Init( &test.ring, TEST_DEPTH ) == EOK );
+    test.taken = 0;
+
+    for ( i = 0; i < TEST_DEPTH; i++ )
+    {
+        test.slots[RING_Acquire( &test.ring )] = i;
+        RING_Publish( &test.ring );
+    }
+
+    TEST_CHECK( RING_Count( &test.ring ) == TEST_DEPTH );
+    TEST_CHECK( pthread_create( &thread, NULL, Consumer, &test ) == 0 );
+
+    RING_WaitEmpty( &test.ring );
+    TEST_CHECK( RING_Count( &test.ring ) == 0 );
+    TEST_CHECK( __atomic_load_n( &test.taken, __ATOMIC_ACQUIRE ) ==
+                TEST_DEPTH );
+
+    RING_Stop( &test.ring );
+    pthread_join( thread, NULL );
+
+    RING_Free( &test.ring );
+}
+
+/*============================================================================*/
+/*  Producer                                                                  */
+/*!
+    Publish a sequence of values and stop the ring
+
+    @param[in]
+        arg
+            pointer to the TestRing
+
+    @retval NULL
+
+==============================================================================*/
+static void *Producer( void *arg )
+{
+    TestRing *pTest = (TestRing *)arg;
+    uint64_t i;
+
+    for ( i = 0; i < pTest->count; i++ )
+    {
+        pTest->slots[RING_Acquire( &pTest->ring )] = i;
+        RING_Publish( &pTest->ring );
+    }
+
+    RING_Stop( &pTest->ring );
+
+    return NULL;
+}
+
+/*============================================================================*/
+/*  Consumer                                                                  */
+/*!
+    Take slots until the end of the ring is reported
+
+    @param[in]
+        arg
+            pointer to the TestRing
+
+    @retval NULL
+
+==============================================================================*/
+static void *Consumer( void *arg )
+{
+    TestRing *pTest = (TestRing *)arg;
+    size_t idx;
+
+    while ( RING_Peek( &pTest->ring, &idx ) == EOK )
+    {
+        __atomic_add_fetch( &pTest->taken, 1, __ATOMIC_RELEASE );
+        RING_Release( &pTest->ring );
+    }
+
+    return NULL;
+}
+
+/*! @}
+ * end of ringtest group */
@@ -0,0 +1,731 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup spooltest spooltest
+ * @brief Unit tests of the store-and-forward spool
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file spooltest.c
+
+    Spool Unit Tests
+
+    The spooltest program checks that spooled messages are replayed
+    once each and in order: straight away when the hub can be reached,
+    after the spool is re-opened by a later run, across segment
+    rollovers, after a torn write at the end of a segment, and when the
+    segment being replayed grows and is completed while it is mapped.
+    A message which the hub rejects with a fatal error is dropped so
+    the messages behind it are still replayed.
+
+    It is built with small spool segments so a few messages fill a
+    segment.  The hub is simulated with the send hook of the mock
+    IOTClient backend, which records the replayed messages and makes
+    the sends fail while the hub is meant to be down.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <iotclient/iotclient.h>
+#include "spool.h"
+#include "mockiot.h"
+#include "util.h"
+#include "test.h"
+
+/*==============================================================================
+        Private definitions
+==============================================================================*/
+
+/*! maximum number of messages recorded by the hub */
+#define TEST_MAX_MESSAGES   ( 1024 )
+
+/*! maximum time to wait for the spool to be replayed */
+#define TEST_TIMEOUT_MS     ( 10000 )
+
+/*! simulated hub */
+typedef struct _TestHub
+{
+    /*! mutex protecting the hub state */
+    pthread_mutex_t mutex;
+
+    /*! condition signalled when the hub state changes */
+    pthread_cond_t cond;
+
+    /*! every send fails */
+    bool down;
+
+    /*! the send of this message blocks until released (-1 = none) */
+    long blockAt;
+
+    /*! the send of this message fails with a fatal error (-1 = none) */
+    long rejectAt;
+
+    /*! the blocked send is waiting to be released */
+    bool blocked;
+
+    /*! number of messages received */
+    size_t count;
+
+    /*! sequence number of each message received */
+    long seq[TEST_MAX_MESSAGES];
+
+    /*! every message had the headers of its sequence number */
+    bool headersMatch;
+
+} TestHub;
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! simulated hub */
+static TestHub hub;
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestReplay( void );
+static void TestRecover( void );
+static void TestTornWrite( void );
+static void TestRollover( void );
+static void TestGrowWhileReplaying( void );
+static void TestDropRejected( void );
+static void ResetHub( bool down );
+static void SetDown( bool down );
+static int HubSend( void *pArg,
+                    const char *pHeaders,
+                    const char *pBody,
+                    size_t len );
+static int Append( Spool *pSpool, long first, long count );
+static bool WaitPending( Spool *pSpool, uint64_t pending );
+static bool InOrder( long count );
+static size_t CountSegments( const char *pDir );
+static int OpenSpool( Spool *pSpool, const char *pDir );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the spool unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    pthread_mutex_init( &hub.mutex, NULL );
+    pthread_cond_init( &hub.cond, NULL );
+    MOCKIOT_SetSendHook( HubSend, &hub );
+
+    TEST_Run( "spool_replay", TestReplay );
+    TEST_Run( "spool_recover", TestRecover );
+    TEST_Run( "spool_torn_write", TestTornWrite );
+    TEST_Run( "spool_rollover", TestRollover );
+    TEST_Run( "spool_grow_while_replaying", TestGrowWhileReplaying );
+    TEST_Run( "spool_drop_rejected", TestDropRejected );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestReplay                                                                */
+/*!
+    Check that messages spooled while the hub is up are replayed in order
+
+==============================================================================*/
+static void TestReplay( void )
+{
+    char *pDir = TEST_TempDir();
+    Spool spool;
+
+    ResetHub( false );
+
+    TEST_CHECK( pDir != NULL );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( Append( &spool, 0, 20 ) == EOK );
+    TEST_CHECK( WaitPending( &spool, 0 ) == true );
+    SPOOL_Close( &spool );
+
+    TEST_CHECK( InOrder( 20 ) == true );
+
+    TEST_RemoveDir( pDir );
+    free( pDir );
+}
+
+/*============================================================================*/
+/*  TestRecover                                                               */
+/*!
+    Check that the messages left by a run are replayed by the next run
+
+==============================================================================*/
+static void TestRecover( void )
+{
+    char *pDir = TEST_TempDir();
+    Spool spool;
+
+    ResetHub( true );
+
+    TEST_CHECK( pDir != NULL );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( Append( &spool, 0, 30 ) == EOK );
+    SPOOL_Close( &spool );
+
+    /* the messages survive a run which could not reach the hub */
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( SPOOL_Pending( &spool ) == 30 );
+    TEST_CHECK( Append( &spool, 30, 10 ) == EOK );
+    SPOOL_Close( &spool );
+
+    TEST_CHECK( hub.count == 0 );
+
+    SetDown( false );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( WaitPending( &spool, 0 ) == true );
+    SPOOL_Close( &spool );
+
+    TEST_CHECK( InOrder( 40 ) == true );
+
+    /* nothing is replayed twice */
+    ResetHub( false );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( SPOOL_Pending( &spool ) == 0 );
+    SPOOL_Close( &spool );
+    TEST_CHECK( hub.count == 0 );
+
+    TEST_RemoveDir( pDir );
+    free( pDir );
+}
+
+/*============================================================================*/
+/*  TestTornWrite                                                             */
+/*!
+    Check that a message torn at the end of a segment is discarded
+
+==============================================================================*/
+static void TestTornWrite( void )
+{
+    char *pDir = TEST_TempDir();
+    char path[PATH_MAX];
+    static const char garbage[] = "STOI partial message";
+    uint32_t offset = 0;
+    struct stat st;
+    Spool spool;
+    int fd;
+
+    ResetHub( true );
+
+    TEST_CHECK( pDir != NULL );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( Append( &spool, 0, 5 ) == EOK );
+    SPOOL_Close( &spool );
+
+    /* simulate a crash in the middle of writing a message */
+    snprintf( path, sizeof( path ), "%s/0000000000.seg", pDir );
+    TEST_CHECK( stat( path, &st ) == 0 );
+    offset = st.st_size;
+    fd = open( path, O_WRONLY | O_APPEND );
+    TEST_CHECK( fd != -1 );
+    TEST_CHECK( write( fd, garbage, sizeof( garbage ) ) ==
+                (ssize_t)sizeof( garbage ) );
+    close( fd );
+
+    snprintf( path, sizeof( path ), "%s/0000000000.idx", pDir );
+    fd = open( path, O_WRONLY | O_APPEND );
+    TEST_CHECK( fd != -1 );
+    TEST_CHECK( write( fd, &offset, sizeof( offset ) ) ==
+                (ssize_t)sizeof( offset ) );
+    close( fd );
+
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( SPOOL_Pending( &spool ) == 5 );
+    TEST_CHECK( Append( &spool, 5, 1 ) == EOK );
+    SPOOL_Close( &spool );
+
+    SetDown( false );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( WaitPending( &spool, 0 ) == true );
+    SPOOL_Close( &spool );
+
+    TEST_CHECK( InOrder( 6 ) == true );
+
+    TEST_RemoveDir( pDir );
+    free( pDir );
+}
+
+/*============================================================================*/
+/*  TestRollover                                                              */
+/*!
+    Check that messages spanning several segments are replayed in order
+    and that the replayed segments are deleted
+
+==============================================================================*/
+static void TestRollover( void )
+{
+    char *pDir = TEST_TempDir();
+    Spool spool;
+
+    ResetHub( true );
+
+    TEST_CHECK( pDir != NULL );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( Append( &spool, 0, 200 ) == EOK );
+    SPOOL_Close( &spool );
+
+    TEST_CHECK( CountSegments( pDir ) > 2 );
+
+    SetDown( false );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( WaitPending( &spool, 0 ) == true );
+    SPOOL_Close( &spool );
+
+    TEST_CHECK( InOrder( 200 ) == true );
+
+    /* only the segment being written is kept */
+    TEST_CHECK( CountSegments( pDir ) == 1 );
+
+    TEST_RemoveDir( pDir );
+    free( pDir );
+}
+
+/*============================================================================*/
+/*  TestGrowWhileReplaying                                                    */
+/*!
+    Check that a segment which grows while it is replayed is replayed
+    in full
+
+    The drainer maps the segment being written while it holds a single
+    message.  More messages are written to it while that message is
+    being sent, until the writer moves on to the next segment, so the
+    drainer finds the segment complete and larger than its mapping.
+
+==============================================================================*/
+static void TestGrowWhileReplaying( void )
+{
+    char *pDir = TEST_TempDir();
+    Spool spool;
+
+    ResetHub( false );
+    hub.blockAt = 0;
+
+    TEST_CHECK( pDir != NULL );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( Append( &spool, 0, 1 ) == EOK );
+
+    /* wait for the drainer to send the first message */
+    pthread_mutex_lock( &hub.mutex );
+    while ( hub.blocked == false )
+    {
+        pthread_cond_wait( &hub.cond, &hub.mutex );
+    }
+    pthread_mutex_unlock( &hub.mutex );
+
+    TEST_CHECK( Append( &spool, 1, 100 ) == EOK );
+    TEST_CHECK( CountSegments( pDir ) > 1 );
+
+    pthread_mutex_lock( &hub.mutex );
+    hub.blockAt = -1;
+    pthread_cond_broadcast( &hub.cond );
+    pthread_mutex_unlock( &hub.mutex );
+
+    TEST_CHECK( WaitPending( &spool, 0 ) == true );
+    SPOOL_Close( &spool );
+
+    TEST_CHECK( InOrder( 101 ) == true );
+
+    TEST_RemoveDir( pDir );
+    free( pDir );
+}
+
+/*============================================================================*/
+/*  TestDropRejected                                                          */
+/*!
+    Check that a message rejected with a fatal error is dropped and the
+    messages behind it are replayed
+
+==============================================================================*/
+static void TestDropRejected( void )
+{
+    char *pDir = TEST_TempDir();
+    Spool spool;
+    bool ok;
+    long i;
+
+    ResetHub( true );
+    hub.rejectAt = 4;
+
+    TEST_CHECK( pDir != NULL );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( Append( &spool, 0, 10 ) == EOK );
+    SPOOL_Close( &spool );
+
+    SetDown( false );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( WaitPending( &spool, 0 ) == true );
+    SPOOL_Close( &spool );
+
+    pthread_mutex_lock( &hub.mutex );
+    ok = ( hub.count == 9 ) && ( hub.headersMatch == true );
+    for ( i = 0; ( ok == true ) && ( i < 9 ); i++ )
+    {
+        ok = ( hub.seq[i] == ( ( i < 4 ) ? i : i + 1 ) );
+    }
+    pthread_mutex_unlock( &hub.mutex );
+
+    TEST_CHECK( ok == true );
+
+    /* the dropped message is not replayed by a later run */
+    ResetHub( false );
+    TEST_CHECK( OpenSpool( &spool, pDir ) == EOK );
+    TEST_CHECK( SPOOL_Pending( &spool ) == 0 );
+    SPOOL_Close( &spool );
+    TEST_CHECK( hub.count == 0 );
+
+    TEST_RemoveDir( pDir );
+    free( pDir );
+}
+
+/*============================================================================*/
+/*  ResetHub                                                                  */
+/*!
+    Forget the messages received by the simulated hub
+
+    @param[in]
+        down
+            every send fails until the hub is brought up
+
+==============================================================================*/
+static void ResetHub( bool down )
+{
+    pthread_mutex_lock( &hub.mutex );
+    hub.down = down;
+    hub.blockAt = -1;
+    hub.rejectAt = -1;
+    hub.blocked = false;
+    hub.count = 0;
+    hub.headersMatch = true;
+    pthread_mutex_unlock( &hub.mutex );
+}
+
+/*============================================================================*/
+/*  SetDown                                                                   */
+/*!
+    Bring the simulated hub down or up
+
+    @param[in]
+        down
+            every send fails
+
+==============================================================================*/
+static void SetDown( bool down )
+{
+    pthread_mutex_lock( &hub.mutex );
+    hub.down = down;
+    pthread_mutex_unlock( &hub.mutex );
+}
+
+/*============================================================================*/
+/*  HubSend                                                                   */
+/*!
+    Receive a message at the simulated hub
+
+    The HubSend function records the sequence number in the payload of
+    the message, and checks that the headers carry the same sequence
+    number.
+
+    @param[in]
+        pArg
+            pointer to the TestHub
+
+    @param[in]
+        pHeaders
+            message headers
+
+    @param[in]
+        pBody
+            message payload
+
+    @param[in]
+        len
+            length of the message payload
+
+    @retval EOK the message was received
+    @retval ECONNRESET the hub is down
+    @retval EPERM the hub rejected the message
+
+==============================================================================*/
+static int HubSend( void *pArg,
+                    const char *pHeaders,
+                    const char *pBody,
+                    size_t len )
+{
+    TestHub *pHub = (TestHub *)pArg;
+    char buf[32];
+    char headers[32];
+    long seq;
+    int result = EOK;
+
+    snprintf( buf, sizeof( buf ), "%.*s", (int)len, pBody );
+    seq = strtol( buf, NULL, 10 );
+    snprintf( headers, sizeof( headers ), "seq:%ld", seq );
+
+    pthread_mutex_lock( &pHub->mutex );
+
+    while ( ( pHub->blockAt != -1 ) && ( pHub->blockAt == seq ) )
+    {
+        pHub->blocked = true;
+        pthread_cond_broadcast( &pHub->cond );
+        pthread_cond_wait( &pHub->cond, &pHub->mutex );
+    }
+
+    if ( pHub->down == true )
+    {
+        result = ECONNRESET;
+    }
+    else if ( pHub->rejectAt == seq )
+    {
+        result = EPERM;
+    }
+    else if ( pHub->count < TEST_MAX_MESSAGES )
+    {
+        pHub->seq[pHub->count++] = seq;
+        if ( strcmp( pHeaders, headers ) != 0 )
+        {
+            pHub->headersMatch = false;
+        }
+    }
+
+    pthread_mutex_unlock( &pHub->mutex );
+
+    return result;
+}
+
+/*============================================================================*/
+/*  Append                                                                    */
+/*!
+    Spool a run of numbered messages
+
+    Each message carries its sequence number in its headers and in its
+    payload, which is padded so a few messages fill a segment.
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        first
+            sequence number of the first message
+
+    @param[in]
+        count
+            number of messages
+
+    @retval EOK the messages were spooled
+    @retval other error from SPOOL_Append
+
+==============================================================================*/
+static int Append( Spool *pSpool, long first, long count )
+{
+    int result = EOK;
+    char headers[32];
+    char payload[96];
+    long seq;
+
+    for ( seq = first; ( seq < first + count ) && ( result == EOK ); seq++ )
+    {
+        snprintf( headers, sizeof( headers ), "seq:%ld", seq );
+        memset( payload, ' ', sizeof( payload ) );
+        snprintf( payload, sizeof( payload ), "%ld", seq );
+        result = SPOOL_Append( pSpool, headers, payload, sizeof( payload ) );
+    }
+
+    return result;
+}
+
+/*============================================================================*/
+/*  WaitPending                                                               */
+/*!
+    Wait for the number of messages waiting to be replayed to drop
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        pending
+            number of messages to wait for
+
+    @retval true the number of messages dropped to the given number
+    @retval false the spool was not replayed in time
+
+==============================================================================*/
+static bool WaitPending( Spool *pSpool, uint64_t pending )
+{
+    uint64_t deadline = UTIL_NowMs() + TEST_TIMEOUT_MS;
+
+    while ( ( SPOOL_Pending( pSpool ) > pending ) &&
+            ( UTIL_NowMs() < deadline ) )
+    {
+        usleep( 1000 );
+    }
+
+    return ( SPOOL_Pending( pSpool ) <= pending );
+}
+
+/*============================================================================*/
+/*  InOrder                                                                   */
+/*!
+    Check the messages received by the simulated hub
+
+    @param[in]
+        count
+            number of messages expected
+
+    @retval true the messages 0 to count - 1 were received in order,
+            once each and with their headers
+    @retval false a message was lost, repeated or out of order
+
+==============================================================================*/
+static bool InOrder( long count )
+{
+    bool ok;
+    long i;
+
+    pthread_mutex_lock( &hub.mutex );
+
+    ok = ( hub.count == (size_t)count ) && ( hub.headersMatch == true );
+    for ( i = 0; ( ok == true ) && ( i < count ); i++ )
+    {
+        ok = ( hub.seq[i] == i );
+    }
+
+    if ( ok == false )
+    {
+        fprintf( stderr,
+                 "received %zu of %ld messages\n",
+                 hub.count,
+                 count );
+    }
+
+    pthread_mutex_unlock( &hub.mutex );
+
+    return ok;
+}
+
+/*============================================================================*/
+/*  CountSegments                                                             */
+/*!
+    Count the segment files in a spool directory
+
+    @param[in]
+        pDir
+            spool directory
+
+    @retval number of segment files
+
+==============================================================================*/
+static size_t CountSegments( const char *pDir )
+{
+    DIR *pDirStream;
+    struct dirent *pEntry;
+    size_t count = 0;
+    size_t len;
+
+    pDirStream = opendir( pDir );
+    if ( pDirStream != NULL )
+    {
+        while ( ( pEntry = readdir( pDirStream ) ) != NULL )
+        {
+            len = strlen( pEntry->d_name );
+            if ( ( len > 4 ) &&
+                 ( strcmp( &pEntry->d_name[len - 4], ".seg" ) == 0 ) )
+            {
+                count++;
+            }
+        }
+
+        closedir( pDirStream );
+    }
+
+    return count;
+}
+
+/*============================================================================*/
+/*  OpenSpool                                                                 */
+/*!
+    Open a spool without syncing to disk
+
+    @param[in]
+        pSpool
+            pointer to the spool
+
+    @param[in]
+        pDir
+            spool directory
+
+    @retval EOK the spool was opened
+    @retval other error from SPOOL_Open
+
+==============================================================================*/
+static int OpenSpool( Spool *pSpool, const char *pDir )
+{
+    return SPOOL_Open( pSpool, pDir, SPOOL_FSYNC_NEVER, NULL, false );
+}
+
+/*! @}
+ * end of spooltest group */
@@ -0,0 +1,322 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+
+/*!
+ * @defgroup templatetest templatetest
+ * @brief Unit tests of the header templates
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file templatetest.c
+
+    Header Template Unit Tests
+
+    The templatetest program checks that the literal text of a header
+    template is rendered unchanged, that each placeholder is substituted
+    with its value, that the render buffer holds the longest possible
+    rendering, and that malformed templates are rejected.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <iotclient/iotclient.h>
+#include "template.h"
+#include "test.h"
+
+/*==============================================================================
+        Private function declarations
+==============================================================================*/
+
+int main( int argc, char **argv );
+static void TestLiteral( void );
+static void TestSequence( void );
+static void TestProcess( void );
+static void TestClock( void );
+static void TestLongest( void );
+static void TestInvalid( void );
+static uint64_t ClockMs( clockid_t clock );
+
+/*==============================================================================
+        Private function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  main                                                                      */
+/*!
+    Run the header template unit tests
+
+    @param[in]
+        argc
+            number of arguments on the command line
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @retval EXIT_SUCCESS every test passed
+    @retval EXIT_FAILURE a test failed
+
+==============================================================================*/
+int main( int argc, char **argv )
+{
+    (void)argc;
+    (void)argv;
+
+    TEST_Run( "template_literal", TestLiteral );
+    TEST_Run( "template_sequence", TestSequence );
+    TEST_Run( "template_process", TestProcess );
+    TEST_Run( "template_clock", TestClock );
+    TEST_Run( "template_longest", TestLongest );
+    TEST_Run( "template_invalid", TestInvalid );
+
+    return TEST_Report();
+}
+
+/*============================================================================*/
+/*  TestLiteral                                                               */
+/*!
+    Check that a template without placeholders is rendered unchanged,
+    with an escaped placeholder rendered as literal text
+
+==============================================================================*/
+static void TestLiteral( void )
+{
+    HeaderTemplate tmpl;
+    char *pHeaders;
+
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, "a:1\nb:$${seq}$\n" ) == EOK );
+    TEST_CHECK( tmpl.dynamic == false );
+
+    pHeaders = TEMPLATE_Render( &tmpl, 0 );
+    TEST_CHECK( ( pHeaders != NULL ) &&
+                ( strcmp( pHeaders, "a:1\nb:${seq}$\n" ) == 0 ) );
+
+    pHeaders = TEMPLATE_Render( &tmpl, 1 );
+    TEST_CHECK( ( pHeaders != NULL ) &&
+                ( strcmp( pHeaders, "a:1\nb:${seq}$\n" ) == 0 ) );
+
+    TEMPLATE_Free( &tmpl );
+    TEST_CHECK( TEMPLATE_Render( &tmpl, 0 ) == NULL );
+
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, "" ) == EOK );
+    pHeaders = TEMPLATE_Render( &tmpl, 0 );
+    TEST_CHECK( ( pHeaders != NULL ) && ( pHeaders[0] == '\0' ) );
+    TEMPLATE_Free( &tmpl );
+}
+
+/*============================================================================*/
+/*  TestSequence                                                              */
+/*!
+    Check that the sequence number advances with every rendering and
+    that the chunk index is substituted
+
+==============================================================================*/
+static void TestSequence( void )
+{
+    HeaderTemplate tmpl;
+    char expected[64];
+    char *pHeaders;
+    uint64_t i;
+
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, "seq:${seq}\nchunk:${chunk}\n" ) ==
+                EOK );
+    TEST_CHECK( tmpl.dynamic == true );
+
+    for ( i = 0; i < 12; i++ )
+    {
+        sprintf( expected,
+                 "seq:%" PRIu64 "\nchunk:%" PRIu64 "\n",
+                 i,
+                 i * 7 );
+        pHeaders = TEMPLATE_Render( &tmpl, i * 7 );
+        TEST_CHECK( ( pHeaders != NULL ) &&
+                    ( strcmp( pHeaders, expected ) == 0 ) );
+    }
+
+    TEMPLATE_Free( &tmpl );
+}
+
+/*============================================================================*/
+/*  TestProcess                                                               */
+/*!
+    Check that the host name and process identifier are substituted
+
+==============================================================================*/
+static void TestProcess( void )
+{
+    HeaderTemplate tmpl;
+    char hostname[TEMPLATE_MAX_HOSTNAME+1];
+    char expected[TEMPLATE_MAX_HOSTNAME+64];
+    char *pHeaders;
+
+    if ( gethostname( hostname, sizeof( hostname ) ) != 0 )
+    {
+        strcpy( hostname, "unknown" );
+    }
+
+    hostname[TEMPLATE_MAX_HOSTNAME] = '\0';
+    sprintf( expected, "host:%s\npid:%d\n", hostname, (int)getpid() );
+
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, "host:${hostname}\npid:${pid}\n" ) ==
+                EOK );
+    pHeaders = TEMPLATE_Render( &tmpl, 0 );
+    TEST_CHECK( ( pHeaders != NULL ) &&
+                ( strcmp( pHeaders, expected ) == 0 ) );
+
+    TEMPLATE_Free( &tmpl );
+}
+
+/*============================================================================*/
+/*  TestClock                                                                 */
+/*!
+    Check that the wall clock and monotonic clock times are the times of
+    the rendering
+
+==============================================================================*/
+static void TestClock( void )
+{
+    HeaderTemplate tmpl;
+    uint64_t ts = 0;
+    uint64_t mono = 0;
+    uint64_t tsBefore;
+    uint64_t monoBefore;
+    char *pHeaders;
+
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, "ts:${ts_ms};mono:${mono_ms}" ) ==
+                EOK );
+
+    tsBefore = ClockMs( CLOCK_REALTIME );
+    monoBefore = ClockMs( CLOCK_MONOTONIC );
+    pHeaders = TEMPLATE_Render( &tmpl, 0 );
+
+    TEST_CHECK( ( pHeaders != NULL ) &&
+                ( sscanf( pHeaders,
+                          "ts:%" SCNu64 ";mono:%" SCNu64,
+                          &ts,
+                          &mono ) == 2 ) );
+    TEST_CHECK( ( ts >= tsBefore ) && ( ts <= ClockMs( CLOCK_REALTIME ) ) );
+    TEST_CHECK( ( mono >= monoBefore ) &&
+                ( mono <= ClockMs( CLOCK_MONOTONIC ) ) );
+
+    TEMPLATE_Free( &tmpl );
+}
+
+/*============================================================================*/
+/*  TestLongest                                                               */
+/*!
+    Check that the render buffer holds the rendering of the largest
+    numbers
+
+==============================================================================*/
+static void TestLongest( void )
+{
+    HeaderTemplate tmpl;
+    char *pHeaders;
+
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, "${chunk}${chunk}${hostname}" ) ==
+                EOK );
+    pHeaders = TEMPLATE_Render( &tmpl, UINT64_MAX );
+    TEST_CHECK( pHeaders != NULL );
+    TEST_CHECK( strlen( pHeaders ) < tmpl.size );
+    TEST_CHECK( strncmp( pHeaders,
+                         "1844674407370955161518446744073709551615",
+                         40 ) == 0 );
+    TEST_CHECK( strcmp( &pHeaders[40], tmpl.hostname ) == 0 );
+
+    TEMPLATE_Free( &tmpl );
+}
+
+/*============================================================================*/
+/*  TestInvalid                                                               */
+/*!
+    Check that unknown and unterminated placeholders, templates with too
+    many segments, and invalid arguments are rejected
+
+==============================================================================*/
+static void TestInvalid( void )
+{
+    HeaderTemplate tmpl;
+    char text[( TEMPLATE_MAX_SEGMENTS + 1 ) * 8];
+    char *p = text;
+    size_t i;
+
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, "a:${sequence}" ) == EINVAL );
+    TEST_CHECK( tmpl.pBuf == NULL );
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, "a:${seq" ) == EINVAL );
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, "a:${}" ) == EINVAL );
+    TEST_CHECK( TEMPLATE_Compile( NULL, "a:1" ) == EINVAL );
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, NULL ) == EINVAL );
+    TEST_CHECK( TEMPLATE_Render( NULL, 0 ) == NULL );
+
+    /* each placeholder follows a literal, so this is one segment over */
+    for ( i = 0; i < ( TEMPLATE_MAX_SEGMENTS / 2 ); i++ )
+    {
+        p += sprintf( p, "-${seq}" );
+    }
+
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, text ) == EOK );
+    TEMPLATE_Free( &tmpl );
+
+    sprintf( p, "-" );
+    TEST_CHECK( TEMPLATE_Compile( &tmpl, text ) == E2BIG );
+}
+
+/*============================================================================*/
+/*  ClockMs                                                                   */
+/*!
+    Read a clock in milliseconds
+
+    @param[in]
+        clock
+            clock to read
+
+    @retval clock time in milliseconds
+
+==============================================================================*/
+static uint64_t ClockMs( clockid_t clock )
+{
+    struct timespec ts;
+
+    clock_gettime( clock, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*! @}
+ * end of templatetest group */
@@ -0,0 +1,229 @@
+/*==============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+==============================================================================*/
+
+/*!
+ * @defgroup test test
+ * @brief Unit test support
+ * @{
+ */
+
+/*============================================================================*/
+/*!
+@file test.c
+
+    Unit Test Support
+
+    The test module is shared by the unit test programs run by ctest.
+    Each test program runs its test cases with TEST_Run, which reports
+    every check which fails, and exits with the status returned by
+    TEST_Report so ctest sees the failure.
+
+    The test programs which send messages are linked with the mock
+    IOTClient backend of the benchmark instead of the IOTClient library,
+    so they do not need a live IOTHub service.
+
+*/
+/*============================================================================*/
+
+/*==============================================================================
+        Includes
+==============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "test.h"
+
+/*==============================================================================
+        Private file scoped variables
+==============================================================================*/
+
+/*! number of test cases run */
+static int tests;
+
+/*! number of test cases with a failed check */
+static int failedTests;
+
+/*! number of failed checks in the current test case */
+static int failures;
+
+/*==============================================================================
+        Public function definitions
+==============================================================================*/
+
+/*============================================================================*/
+/*  TEST_Check                                                                */
+/*!
+    Check a condition of a test case
+
+    The TEST_Check function reports a condition which does not hold on
+    stderr and fails the current test case.  It is called through the
+    TEST_CHECK macro.
+
+    @param[in]
+        ok
+            the condition holds
+
+    @param[in]
+        pCond
+            text of the condition
+
+    @param[in]
+        pFile
+            source file of the check
+
+    @param[in]
+        line
+            source line of the check
+
+    @retval true the condition holds
+    @retval false the condition does not hold
+
+==============================================================================*/
+bool TEST_Check( bool ok, const char *pCond, const char *pFile, int line )
+{
+    if ( ok == false )
+    {
+        fprintf( stderr, "%s:%d: check failed: %s\n", pFile, line, pCond );
+        failures++;
+    }
+
+    return ok;
+}
+
+/*============================================================================*/
+/*  TEST_Run                                                                  */
+/*!
+    Run a test case
+
+    @param[in]
+        pName
+            name of the test case
+
+    @param[in]
+        pfnTest
+            function implementing the test case
+
+==============================================================================*/
+void TEST_Run( const char *pName, void (*pfnTest)( void ) )
+{
+    failures = 0;
+    pfnTest();
+
+    tests++;
+    if ( failures > 0 )
+    {
+        failedTests++;
+    }
+
+    printf( "%-40s %s\n", pName, ( failures == 0 ) ? "ok" : "FAILED" );
+}
+
+/*============================================================================*/
+/*  TEST_Report                                                               */
+/*!
+    Report the result of the test cases
+
+    @retval EXIT_SUCCESS every test case passed
+    @retval EXIT_FAILURE a test case failed
+
+==============================================================================*/
+int TEST_Report( void )
+{
+    printf( "%d of %d tests passed\n", tests - failedTests, tests );
+
+    return ( failedTests == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*============================================================================*/
+/*  TEST_TempDir                                                              */
+/*!
+    Create a temporary directory for a test case
+
+    @retval path of the new directory, to be freed by the caller
+    @retval NULL the directory could not be created
+
+==============================================================================*/
+char *TEST_TempDir( void )
+{
+    const char *pBase = getenv( "TMPDIR" );
+    char path[PATH_MAX];
+    char *pDir = NULL;
+
+    snprintf( path,
+              sizeof( path ),
+              "%s/iotsend-test.XXXXXX",
+              ( pBase != NULL ) ? pBase : "/tmp" );
+
+    if ( mkdtemp( path ) != NULL )
+    {
+        pDir = strdup( path );
+    }
+
+    return pDir;
+}
+
+/*============================================================================*/
+/*  TEST_RemoveDir                                                            */
+/*!
+    Remove a temporary directory and the files in it
+
+    @param[in]
+        pDir
+            path of the directory
+
+==============================================================================*/
+void TEST_RemoveDir( const char *pDir )
+{
+    DIR *pDirStream;
+    struct dirent *pEntry;
+    char path[PATH_MAX];
+
+    if ( pDir != NULL )
+    {
+        pDirStream = opendir( pDir );
+        if ( pDirStream != NULL )
+        {
+            while ( ( pEntry = readdir( pDirStream ) ) != NULL )
+            {
+                if ( pEntry->d_name[0] != '.' )
+                {
+                    snprintf( path, sizeof( path ), "%s/%s",
+                              pDir, pEntry->d_name );
+                    (void)unlink( path );
+                }
+            }
+
+            closedir( pDirStream );
+        }
+
+        (void)rmdir( pDir );
+    }
+}
+
+/*! @}
+ * end of test group */